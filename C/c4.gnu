@@ -17,6 +17,8 @@ CBL {
 		c4log_setCallbackLevel;
 		c4log_binaryFileLevel;
 		c4log_setBinaryFileLevel;
+		c4log_setAsync;
+		c4log_droppedMessageCount;
 		c4log_getDomain;
 		c4log_getDomainName;
 		c4log_warnOnErrors;
@@ -33,9 +35,11 @@ CBL {
 		c4db_delete;
 		c4db_deleteAtPath;
 		c4db_compact;
+		c4db_backup;
 		c4db_rekey;
 		c4db_getPath;
 		c4db_getConfig;
+		c4db_getStorageStats;
 		c4db_getDocumentCount;
 		c4db_getLastSequence;
 		c4db_getMaxRevTreeDepth;
@@ -87,6 +91,7 @@ CBL {
 		c4db_enumerateChanges;
 		c4db_enumerateAllDocs;
 		c4db_createIndex;
+		c4db_createVectorIndex;
 		c4db_deleteIndex;
 		c4db_getIndexes;
 		c4enum_next;
@@ -162,6 +167,7 @@ CBL {
 
 		c4pred_registerModel;
 		c4pred_unregisterModel;
+		c4pred_encodeVector;
 
 		FLSlice_Equal;
 		FLSlice_Compare;
@@ -280,6 +286,7 @@ CBL {
 		c4_getBuildInfo;
 		c4_setTempDir;
 		c4_runAsyncTask;
+		c4_getMetrics;
 
 		c4log;
 		c4vlog;
@@ -308,6 +315,7 @@ CBL {
 		c4db_getRemoteDBID;
 		c4db_exists;
 		c4db_startHousekeeping;
+		c4db_setExpirationBatching;
 		c4db_findDocAncestors;
 
 		c4doc_removeRevisionBody;
@@ -355,6 +363,11 @@ CBL {
 
 		c4error_return;
 		c4db_markSynced;
+		c4blob_getChunkList;
+		c4blob_createFromChunks;
+		c4_startTracing;
+		c4_stopTracing;
+		c4db_setMaintenanceInterval;
 		c4_dumpInstances;
 		gC4ExpectExceptions;
 		c4log_enableFatalExceptionBacktrace;
@@ -23,7 +23,10 @@
 #include "Actor.hh"
 #include "Backtrace.hh"
 #include "FilePath.hh"
+#include "Instrumentation.hh"
+#include "Metrics.hh"
 #include "Logging.hh"
+#include "LogQueue.hh"
 #include "StringUtil.hh"
 
 #include "WebSocketInterface.hh"
@@ -348,6 +351,9 @@ C4LogLevel c4log_binaryFileLevel() noexcept      {return (C4LogLevel)LogDomain::
 void c4log_setCallbackLevel(C4LogLevel level) noexcept   {LogDomain::setCallbackLogLevel((LogLevel)level);} //LCOV_EXCL_LINE
 void c4log_setBinaryFileLevel(C4LogLevel level) noexcept {LogDomain::setFileLogLevel((LogLevel)level);}
 
+void c4log_setAsync(bool async) noexcept                {LogQueue::setEnabled(async);}
+uint64_t c4log_droppedMessageCount() noexcept           {return LogQueue::droppedCount();}
+
 
 CBL_CORE_API const C4LogDomain kC4DefaultLog    = (C4LogDomain)&kC4Cpp_DefaultLog;
 CBL_CORE_API const C4LogDomain kC4DatabaseLog   = (C4LogDomain)&DBLog;
@@ -422,7 +428,8 @@ void c4log(C4LogDomain c4Domain, C4LogLevel level, const char *fmt, ...) noexcep
 
 void c4vlog(C4LogDomain c4Domain, C4LogLevel level, const char *fmt, va_list args) noexcept {
     try {
-        ((LogDomain*)c4Domain)->vlog((LogLevel)level, fmt, args);
+        // The format string may not outlive this call, so it can't be queued:
+        ((LogDomain*)c4Domain)->vlogUnqueued((LogLevel)level, fmt, args);
     } catch (...) { }
 }
 
@@ -488,3 +495,18 @@ void c4_setTempDir(C4String path) C4API {
 void c4_runAsyncTask(void (*task)(void*), void *context) C4API {
     actor::Mailbox::runAsyncTask(task, context);
 }
+
+
+void c4_startTracing() C4API {
+    Signpost::startTracing();
+}
+
+
+C4StringResult c4_stopTracing() C4API {
+    return sliceResult(Signpost::stopTracing());
+}
+
+
+C4StringResult c4_getMetrics() C4API {
+    return sliceResult(metrics::Metric::toJSON());
+}
@@ -18,6 +18,7 @@
 
 #include "c4Internal.hh"
 #include "c4BlobStore.h"
+#include "c4Private.h"
 #include "c4Database.hh"
 #include "BlobStore.hh"
 
@@ -119,9 +120,12 @@ C4SliceResult c4blob_getContents(C4BlobStore* store, C4BlobKey key, C4Error* out
 
 C4StringResult c4blob_getFilePath(C4BlobStore* store, C4BlobKey key, C4Error* outError) noexcept {
     try {
-        auto path = store->get(asInternal(key)).path();
+        Blob blob = store->get(asInternal(key));
+        auto path = blob.path();
         if (!path.exists()) {
-            recordError(LiteCoreDomain, kC4ErrorNotFound, outError);
+            // A small blob may be packed into a shared file instead of having its own:
+            recordError(LiteCoreDomain, blob.exists() ? kC4ErrorUnsupported : kC4ErrorNotFound,
+                        outError);
             return {nullptr, 0};
         } else if (store->isEncrypted()) {
             recordError(LiteCoreDomain, kC4ErrorWrongFormat, outError);
@@ -154,6 +158,31 @@ bool c4blob_create(C4BlobStore* store,
 }
 
 
+C4SliceResult c4blob_getChunkList(C4BlobStore* store, C4BlobKey key, C4Error* outError) noexcept {
+    try {
+        clearError(outError);
+        return C4SliceResult(store->get(asInternal(key)).chunkListJSON());
+    } catchError(outError)
+    return {nullptr, 0};
+}
+
+
+bool c4blob_createFromChunks(C4BlobStore* store,
+                             C4Slice chunkList,
+                             const C4BlobKey *expectedKey,
+                             C4BlobKey *outKey,
+                             C4Error* outError) noexcept
+{
+    try {
+        Blob blob = store->putChunked(chunkList, asInternal(expectedKey));
+        if (outKey)
+            *outKey = external(blob.key());
+        return true;
+    } catchError(outError)
+    return false;
+}
+
+
 bool c4blob_delete(C4BlobStore* store, C4BlobKey key, C4Error* outError) noexcept {
     try {
         store->get(asInternal(key)).del();
@@ -234,7 +263,10 @@ uint64_t c4stream_bytesWritten(C4WriteStream* stream) {
 
 
 C4BlobKey c4stream_computeBlobKey(C4WriteStream* stream) noexcept {
-    return external( asInternal(stream)->computeKey() );
+    try {
+        return external( asInternal(stream)->computeKey() );
+    } catchExceptions()
+    return {};
 }
 
 
@@ -67,7 +67,8 @@ static C4DatabaseConfig newToOldConfig(const C4DatabaseConfig2 *config2) {
         config2->flags | kC4DB_AutoCompact | kC4DB_SharedKeys,
         NULL,
         kC4RevisionTrees,
-        config2->encryptionKey
+        config2->encryptionKey,
+        config2->tuning
     };
 }
 
@@ -167,6 +168,20 @@ bool c4db_compact(C4Database* database, C4Error *outError) noexcept {
 }
 
 
+bool c4db_backup(C4Database* database, C4String destinationPath, C4BackupFlags flags,
+                 C4BackupProgressCallback callback, void *context,
+                 C4Error *outError) noexcept
+{
+    return tryCatch(outError, [&]{
+        database->backup(FilePath(slice(destinationPath).asString()),
+                         (flags & kC4BackupIncremental) != 0,
+                         [&](const C4BackupProgress &progress) {
+                             return !callback || callback(context, &progress);
+                         });
+    });
+}
+
+
 bool c4db_rekey(C4Database* database, const C4EncryptionKey *newKey, C4Error *outError) noexcept {
     return tryCatch(outError, bind(&Database::rekey, database, newKey));
 }
@@ -182,6 +197,21 @@ const C4DatabaseConfig* c4db_getConfig(C4Database *database) noexcept {
 }
 
 
+bool c4db_getStorageStats(C4Database *database, C4StorageStats *outStats,
+                          C4Error *outError) noexcept
+{
+    return tryCatch(outError, [&] {
+        auto stats = ((SQLiteDataFile*)database->dataFile())->stats();
+        *outStats = C4StorageStats {
+            stats.cacheHits, stats.cacheMisses, stats.cacheUsed,
+            stats.cacheSize, stats.mmapSize,
+            stats.pageSize, stats.pageCount, stats.freePages,
+            stats.walSize, stats.walFrames, stats.checkpointLag
+        };
+    });
+}
+
+
 uint64_t c4db_getDocumentCount(C4Database* database) noexcept {
     return tryCatch<uint64_t>(nullptr, bind(&Database::countDocuments, database));
 }
@@ -19,6 +19,7 @@
 #include "c4Internal.hh"
 #include "c4Database.h"
 #include "c4Document.h"
+#include "c4Private.h"
 
 #include "c4Database.hh"
 #include "KeyStore.hh"
@@ -78,3 +79,15 @@ bool c4db_startHousekeeping(C4Database *db) C4API {
         return db->startHousekeeping();
     });
 }
+
+
+void c4db_setExpirationBatching(C4Database *db, unsigned maxDocsPerTransaction,
+                                unsigned yieldMilliseconds) C4API
+{
+    db->setExpirationBatching(maxDocsPerTransaction, std::chrono::milliseconds(yieldMilliseconds));
+}
+
+
+void c4db_setMaintenanceInterval(C4Database *db, unsigned milliseconds) C4API {
+    db->setMaintenanceInterval(std::chrono::milliseconds(milliseconds));
+}
@@ -18,6 +18,8 @@
 //
 
 #include "c4PredictiveQuery.h"
+#include "c4Internal.hh"
+#include "VectorDistance.hh"
 
 #ifdef COUCHBASE_ENTERPRISE
 
@@ -82,3 +84,13 @@ bool c4pred_unregisterModel(const char *name) C4API {
     abort();
 #endif
 }
+
+
+C4SliceResult c4pred_encodeVector(const float *values, size_t count, bool halfPrecision) C4API {
+    try {
+        auto type = halfPrecision ? litecore::VectorElementType::Float16
+                                  : litecore::VectorElementType::Float32;
+        return C4SliceResult(litecore::PackedVector::encode(values, count, type));
+    } catchExceptions()
+    return {};
+}
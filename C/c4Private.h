@@ -116,6 +116,33 @@ bool c4db_findDocAncestors(C4Database *database,
 #define kC4AncestorExists               C4STR("1")
 #define kC4AncestorExistsButNotCurrent  C4STR("2")
 
+/** If a blob is stored as chunks, returns the list of its chunks as a JSON array of
+    `["sha1-...", length]` pairs; else returns a null slice and no error.
+    Used by the replicator to send only the chunks the peer doesn't have. */
+C4SliceResult c4blob_getChunkList(C4BlobStore* C4NONNULL, C4BlobKey, C4Error*) C4API;
+
+/** Stores a blob made of chunks that are already in the store, given a JSON chunk list as
+    returned by \ref c4blob_getChunkList. Fails with kC4ErrorNotFound if a chunk is missing.
+    If `expectedKey` is not NULL, the operation fails unless the chunks' data has that key. */
+bool c4blob_createFromChunks(C4BlobStore* C4NONNULL,
+                             C4Slice chunkList,
+                             const C4BlobKey *expectedKey,
+                             C4BlobKey *outKey,
+                             C4Error *outError) C4API;
+
+/** Starts recording LiteCore's profiling signposts (transactions, queries, replication,
+    BLIP frames...) into per-thread buffers, discarding any previously recorded. */
+void c4_startTracing(void) C4API;
+
+/** Stops recording signposts, and returns the ones recorded since \ref c4_startTracing as
+    Chrome trace-event JSON, which can be opened in Perfetto's UI or chrome://tracing. */
+C4StringResult c4_stopTracing(void) C4API;
+
+/** Sets how often the housekeeping task started by \ref c4db_startHousekeeping checks
+    whether the database is idle enough to checkpoint its WAL and vacuum free pages.
+    (Defaults to 5 seconds.) Only exposed for testing. */
+void c4db_setMaintenanceInterval(C4Database *db C4NONNULL, unsigned milliseconds) C4API;
+
 /** Call this to use BuiltInWebSocket as the WebSocket implementation.
     (Only available if linked with libLiteCoreWebSocket) */
 void C4RegisterBuiltInWebSocket();
@@ -137,6 +164,7 @@ C4Replicator* c4repl_newWithWebSocket(C4Database* db,
 namespace litecore { namespace constants {
     extern const C4Slice kLocalCheckpointStore;
     extern const C4Slice kPeerCheckpointStore;
+    extern const C4Slice kPartialBlobStore;
     extern const C4Slice kPreviousPrivateUUIDKey;
 }}
 
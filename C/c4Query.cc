@@ -213,13 +213,40 @@ bool c4db_createIndex(C4Database *database,
                       const C4IndexOptions *indexOptions,
                       C4Error *outError) noexcept
 {
-    static_assert(sizeof(C4IndexOptions) == sizeof(IndexSpec::Options),
-                  "IndexSpec::Options types must match");
     return tryCatch(outError, [&]{
+        IndexSpec::Options options = { };
+        if (indexOptions) {
+            options.language = indexOptions->language;
+            options.ignoreDiacritics = indexOptions->ignoreDiacritics;
+            options.disableStemming = indexOptions->disableStemming;
+            options.stopWords = indexOptions->stopWords;
+        }
         database->defaultKeyStore().createIndex(slice(name),
                                                 indexSpecJSON,
                                                 (IndexSpec::Type)indexType,
-                                                (const IndexSpec::Options*)indexOptions);
+                                                indexOptions ? &options : nullptr);
+    });
+}
+
+
+bool c4db_createVectorIndex(C4Database *database,
+                            C4Slice name,
+                            C4Slice indexSpecJSON,
+                            const C4VectorIndexOptions *vectorOptions,
+                            C4Error *outError) noexcept
+{
+    return tryCatch(outError, [&]{
+        IndexSpec::Options options = { };
+        if (vectorOptions) {
+            if (vectorOptions->version < 1 || vectorOptions->version > kC4VectorIndexOptionsVersion)
+                error::_throw(error::InvalidParameter, "Unknown C4VectorIndexOptions version");
+            options.numCentroids = vectorOptions->numCentroids;
+            options.numProbes = vectorOptions->numProbes;
+        }
+        database->defaultKeyStore().createIndex(slice(name),
+                                                indexSpecJSON,
+                                                IndexSpec::kVector,
+                                                &options);
     });
 }
 
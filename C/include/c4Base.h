@@ -355,6 +355,17 @@ void c4log_setCallbackLevel(C4LogLevel level) C4API;
 C4LogLevel c4log_binaryFileLevel(void) C4API;
 void c4log_setBinaryFileLevel(C4LogLevel level) C4API;
 
+/** Enables or disables asynchronous logging. While it's enabled, logging a message just copies
+    it into a buffer belonging to the calling thread, and a background thread formats it, writes
+    it to the binary file and passes it to the callback. If a thread logs faster than that, its
+    messages below the Warning level are dropped; see \ref c4log_droppedMessageCount.
+    Warnings and errors, and messages logged with c4log or c4vlog, are still logged synchronously.
+    Disabling asynchronous logging delivers any messages still queued. */
+void c4log_setAsync(bool async) C4API;
+
+/** Returns the number of messages asynchronous logging has dropped so far. */
+uint64_t c4log_droppedMessageCount(void) C4API;
+
 /** Looks up a named log domain.
     @param name  The name of the domain, or NULL for the default domain.
     @param create  If true, the domain will be created if it doesn't exist.
@@ -440,6 +451,16 @@ void c4_setTempDir(C4String path) C4API;
         future time when `task` is called. */
 void c4_runAsyncTask(void (*task)(void*) C4NONNULL, void *context) C4API;
 
+/** Returns LiteCore's runtime metrics as a JSON object, mapping each metric's name to its value.
+    Names are dotted paths grouped by subsystem, e.g. "db.commitUsec" or "blip.bytesSent".
+    * A counter's value is a number that only increases.
+    * A gauge's value is an object with its current "value" and its "max".
+    * A histogram's value is an object with "count", "mean", "max" and the percentiles "p50",
+      "p90", "p99" and "p999". Histograms whose names end in "Usec" record times in
+      microseconds.
+    The values are totals since the process started. */
+C4StringResult c4_getMetrics(void) C4API;
+
 #ifdef __cplusplus
 }
 #endif
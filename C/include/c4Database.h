@@ -43,6 +43,10 @@ extern "C" {
         kC4DB_SharedKeys    = 0x10, // OBSOLETE; shared keys are always used
         kC4DB_NoUpgrade     = 0x20, ///< Disable upgrading an older-version database
         kC4DB_NonObservable = 0x40, ///< Disable c4DatabaseObserver
+        kC4DB_ChunkedBlobs  = 0x80, ///< Store large blobs as deduplicated chunks
+        kC4DB_CrossProcessNotifications = 0x100, ///< Observe commits made by other processes
+        kC4DB_PackedBlobs   = 0x200, ///< Pack small blobs into shared files (c4blob_getFilePath
+                                     ///< can't return their paths; older versions can't read them)
     };
 
     /** Document versioning system (also determines database storage schema) */
@@ -71,12 +75,34 @@ extern "C" {
     typedef const char* C4StorageEngine;
     CBL_CORE_API extern C4StorageEngine const kC4SQLiteStorageEngine;
 
+    /** SQLite `synchronous` modes (see <https://sqlite.org/pragma.html#pragma_synchronous>) */
+    typedef C4_ENUM(uint8_t, C4SQLiteSynchronous) {
+        kC4SQLiteSyncDefault = 0,   ///< LiteCore's default (normal)
+        kC4SQLiteSyncOff,           ///< Never sync; a crash or power loss may corrupt the db
+        kC4SQLiteSyncNormal,        ///< Sync at checkpoints; a power loss may lose recent commits
+        kC4SQLiteSyncFull,          ///< Sync at every commit
+    };
+
+    /** Storage engine tuning, part of C4DatabaseConfig. Zero values mean LiteCore's defaults
+        (shown in parentheses), so a zeroed struct gives the usual behavior. */
+    typedef struct C4StorageTuning {
+        int64_t cacheSize;              ///< Page cache size per connection, in bytes (10MB)
+        int64_t mmapSize;               ///< Bytes of the file to memory-map; negative disables
+                                        ///< (50MB; disabled on macOS)
+        int64_t journalSizeLimit;       ///< Size the WAL is truncated to after a checkpoint (5MB)
+        uint32_t pageSize;              ///< Page size of a newly created database (4096)
+        C4SQLiteSynchronous synchronous;///< When to sync to disk (normal)
+        bool autoSize;                  ///< Size the cache & memory-map from the database's size
+                                        ///< and the physical memory, unless given explicitly
+    } C4StorageTuning;
+
     /** Main database configuration struct. */
     typedef struct C4DatabaseConfig {
         C4DatabaseFlags flags;          ///< Create, ReadOnly, AutoCompact, Bundled...
         C4StorageEngine storageEngine;  ///< Which storage to use, or NULL for no preference
         C4DocumentVersioning versioning;///< Type of document versioning
         C4EncryptionKey encryptionKey;  ///< Encryption to use creating/opening the db
+        C4StorageTuning tuning;         ///< Storage engine tuning
     } C4DatabaseConfig;
 
     /** Main database configuration struct (version 2) for use with c4db_openNamed etc.. */
@@ -84,6 +110,7 @@ extern "C" {
         C4Slice parentDirectory;        ///< Directory for databases
         C4DatabaseFlags flags;          ///< Create, ReadOnly, NoUpgrade (AutoCompact & SharedKeys always set)
         C4EncryptionKey encryptionKey;  ///< Encryption to use creating/opening the db
+        C4StorageTuning tuning;         ///< Storage engine tuning
     } C4DatabaseConfig2;
 
 
@@ -205,6 +232,28 @@ extern "C" {
     /** Returns the configuration the database was opened with. */
     const C4DatabaseConfig* c4db_getConfig(C4Database* C4NONNULL) C4API;
 
+    /** Storage engine statistics, returned by c4db_getStorageStats. The cache and WAL-frame
+        figures are for this C4Database's own connection to the file. */
+    typedef struct C4StorageStats {
+        uint64_t cacheHits;             ///< Page cache hits
+        uint64_t cacheMisses;           ///< Page cache misses
+        uint64_t cacheUsed;             ///< Bytes of memory used by the page cache
+        int64_t  cacheSize;             ///< Page cache size limit, in bytes
+        int64_t  mmapSize;              ///< Bytes of the file that may be memory-mapped
+        uint64_t pageSize;              ///< Size of a page, in bytes
+        uint64_t pageCount;             ///< Number of pages in the database file
+        uint64_t freePages;             ///< Number of unused pages in the database file
+        uint64_t walSize;               ///< Size of the WAL file, in bytes
+        uint64_t walFrames;             ///< Number of pages in the WAL
+        uint64_t checkpointLag;         ///< Number of pages in the WAL not yet checkpointed
+    } C4StorageStats;
+
+    /** Gets statistics about the database's storage engine: page cache hit rate, WAL size
+        and checkpoint lag, and the effective tuning parameters. */
+    bool c4db_getStorageStats(C4Database* C4NONNULL,
+                              C4StorageStats *outStats C4NONNULL,
+                              C4Error *outError) C4API;
+
     /** Returns the number of (undeleted) documents in the database. */
     uint64_t c4db_getDocumentCount(C4Database* database C4NONNULL) C4API;
 
@@ -223,6 +272,14 @@ extern "C" {
         @return  True if the task started, false if it couldn't (i.e. database is read-only.) */
     bool c4db_startHousekeeping(C4Database *db C4NONNULL) C4API;
 
+    /** Limits how many expired documents the housekeeping task purges in one transaction, and
+        sets how long it waits before purging the next batch, so that a mass expiration doesn't
+        lock out other writers. (Defaults to 1000 documents and 50ms; a maximum of 0 restores
+        the defaults.) Applies to the running task, or to the next one started. */
+    void c4db_setExpirationBatching(C4Database *db C4NONNULL,
+                                    unsigned maxDocsPerTransaction,
+                                    unsigned yieldMilliseconds) C4API;
+
     /** Returns the number of revisions of a document that are tracked. (Defaults to 20.) */
     uint32_t c4db_getMaxRevTreeDepth(C4Database *database C4NONNULL) C4API;
 
@@ -250,6 +307,49 @@ extern "C" {
     bool c4db_compact(C4Database* database C4NONNULL, C4Error *outError) C4API;
 
 
+    /** @} */
+    /** \name Backup
+        @{ */
+
+
+    /** Flags for c4db_backup. */
+    typedef C4_OPTIONS(uint32_t, C4BackupFlags) {
+        kC4BackupIncremental = 1,   ///< Update an existing backup instead of creating a new one
+    };
+
+    /** Progress of a backup, passed to its callback. */
+    typedef struct {
+        uint64_t pagesCopied, pagesTotal;   ///< Database pages copied so far / in all
+        uint64_t blobsCopied, blobsTotal;   ///< Blobs checked or copied so far / in all
+    } C4BackupProgress;
+
+    /** Callback for c4db_backup; return false to cancel the backup. */
+    typedef bool (*C4BackupProgressCallback)(void *context,
+                                             const C4BackupProgress *progress C4NONNULL);
+
+    /** Copies the database, and its blobs, to a new directory while it stays open and in use.
+        The copy is a consistent snapshot of the latest committed state, and can be opened like
+        any other database (with the same encryption key.)
+        Without the kC4BackupIncremental flag, the destination must not exist yet. With it, an
+        existing backup at the destination is brought up to date: only blobs it doesn't already
+        have are copied, and blobs that have since been deleted are removed from it.
+        If the callback returns false, the backup stops with the error POSIX ECANCELED; an
+        existing backup is left as it was, except possibly for some added blobs.
+        @param database  The database to back up.
+        @param destinationPath  The directory to back up to (usually ending in ".cblite2".)
+        @param flags  Backup flags.
+        @param callback  Called periodically with the progress, or NULL.
+        @param context  Passed to the callback.
+        @param outError  On failure, error info will be stored here.
+        @return  True on success, false on failure or cancellation. */
+    bool c4db_backup(C4Database* database C4NONNULL,
+                     C4String destinationPath,
+                     C4BackupFlags flags,
+                     C4BackupProgressCallback callback,
+                     void *context,
+                     C4Error *outError) C4API;
+
+
     /** @} */
     /** \name Transactions
         @{ */
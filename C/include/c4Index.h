@@ -33,6 +33,8 @@ extern "C" {
         kC4FullTextIndex,      ///< Full-text index
         kC4ArrayIndex,         ///< Index of array values, for use with UNNEST
         kC4PredictiveIndex,    ///< Index of prediction() results (Enterprise Edition only)
+        kC4VectorIndex,        ///< Approximate nearest-neighbor index of vectors (Enterprise Edition only)
+        kC4HotPropertyIndex,   ///< Property materialized in a table, for faster queries
     };
 
 
@@ -71,11 +73,31 @@ extern "C" {
     } C4IndexOptions;
 
 
+    /** The current version of C4VectorIndexOptions. */
+    #define kC4VectorIndexOptionsVersion 1
+
+    /** Options for a vector index, passed to \ref c4db_createVectorIndex. */
+    typedef struct {
+        /** The version of this struct the caller was compiled with; set this to
+            kC4VectorIndexOptionsVersion. */
+        uint32_t version;
+
+        /** Number of clusters (centroids) the index partitions the vectors into.
+            If zero, a default based on the number of documents will be used. */
+        unsigned numCentroids;
+
+        /** Number of clusters, nearest to the target vector, that a query on the index
+            searches. Higher values give more accurate results but slower queries.
+            If zero, a default based on the number of centroids will be used. */
+        unsigned numProbes;
+    } C4VectorIndexOptions;
+
+
     /** Creates a database index, of the values of specific expressions across all documents.
         The name is used to identify the index for later updating or deletion; if an index with the
         same name already exists, it will be replaced unless it has the exact same expressions.
 
-        Currently four types of indexes are supported:
+        Currently six types of indexes are supported:
 
         * Value indexes speed up queries by making it possible to look up property (or expression)
           values without scanning every document. They're just like regular indexes in SQL or N1QL.
@@ -90,6 +112,16 @@ extern "C" {
           (across all documents) as a table in the SQLite database, and creating a SQL index on it.
         * Predictive indexes optimize queries that use the PREDICTION() function, by materializing
           the function's results as a table and creating a SQL index on a result property.
+        * Vector indexes optimize nearest-neighbor queries of the form
+          `ORDER BY euclidean_distance(vector, $target) LIMIT k`. The vectors are partitioned
+          into clusters when the index is created, and a query only searches the clusters whose
+          centroids are nearest the target, so the results are approximate.
+        * Hot-property indexes materialize a frequently-queried property as a table column, kept
+          up to date as documents change. Queries then read the property from that column
+          instead of from the document body, in both the WHERE clause and the results. Only
+          string and numeric values are materialized; other values are read from the body.
+          This saves decoding bodies, but doesn't let a comparison on the property use an index;
+          create a value index for that.
 
         Note: If some documents are missing the values to be indexed,
         those documents will just be omitted from the index. It's not an error.
@@ -102,11 +134,23 @@ extern "C" {
         In a predictive index, the expression is a PREDICTION() call in JSON query syntax,
         including the optional 3rd parameter that gives the result property to extract (and index.)
 
+        In a vector index, the expression must evaluate to an array of numbers or a packed vector
+        (see `c4pred_encodeVector`), all of the same length. The clusters are computed from the
+        documents that exist when the index is created, so it's best to create it after the
+        initial data has been loaded; to re-cluster, delete and re-create the index.
+
+        In a hot-property index, the single expression must be a document property path.
+
         `indexSpecJSON` specifies the index as a JSON object, with properties:
         * `WHAT`: An array of expressions in the JSON query syntax. (Note that each
           expression is already an array, so there are two levels of nesting.)
         * `WHERE`: An optional expression. Including this creates a _partial index_: documents
           for which this expression returns `false` or `null` will be skipped.
+        * `INCLUDE`: An optional array of expressions, for a value index only. Including this
+          creates a _covering index_, which also stores the values of these expressions (and of
+          the `WHAT` expressions) for every document. A query that uses no other properties,
+          apart from `_id` and `_sequence`, is then answered from the index alone, without
+          reading any document bodies. A covering index can't have a `WHERE` clause.
 
         For backwards compatibility, `indexSpecJSON` may be an array; this is treated as if it were
         a dictionary with a `WHAT` key mapping to that array.
@@ -130,6 +174,21 @@ extern "C" {
                           const C4IndexOptions *indexOptions,
                           C4Error *outError) C4API;
 
+    /** Creates a vector index, like \ref c4db_createIndex with type kC4VectorIndex, but with
+        options specific to vector indexes. An existing index with the same name is replaced
+        unless it has the same expression and options. (Enterprise Edition only.)
+        @param database  The database to index.
+        @param name  The name of the index.
+        @param indexSpecJSON  The definition of the index in JSON form.
+        @param vectorOptions  Options for the index, or NULL for defaults.
+        @param outError  On failure, will be set to the error status.
+        @return  True on success, false on failure. */
+    bool c4db_createVectorIndex(C4Database *database C4NONNULL,
+                                C4String name,
+                                C4String indexSpecJSON,
+                                const C4VectorIndexOptions *vectorOptions,
+                                C4Error *outError) C4API;
+
     /** Deletes an index that was created by `c4db_createIndex`.
         @param database  The database to index.
         @param name The name of the index to delete
@@ -102,6 +102,20 @@ extern "C" {
     bool c4pred_unregisterModel(const char* C4NONNULL name) C4API;
 
 
+    /** Encodes an array of floats as a packed vector. Store the result in a document (or a
+        prediction result) as a Fleece data value, or pass it as a query parameter; the
+        `euclidean_distance` and `cosine_distance` query functions accept packed vectors as well
+        as arrays of numbers, and process them much faster.
+        @param values  The vector's components.
+        @param count  The number of components.
+        @param halfPrecision  If true, the components are stored as 16-bit floats, halving the
+                    size at the expense of precision.
+        @return  The encoded vector data. */
+    C4SliceResult c4pred_encodeVector(const float *values,
+                                      size_t count,
+                                      bool halfPrecision) C4API;
+
+
     /** @} */
 
 #ifdef __cplusplus
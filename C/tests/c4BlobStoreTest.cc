@@ -19,6 +19,8 @@
 #include "c4Test.hh"
 #include "c4BlobStore.h"
 #include "c4Private.h"
+#include "SecureSymmetricCrypto.hh"
+#include "Benchmark.hh"
 #include <fstream>
 
 using namespace std;
@@ -325,6 +327,180 @@ N_WAY_TEST_CASE_METHOD(BlobStoreTest, "write blobs of many sizes", "[blob][Encry
 }
 
 
+N_WAY_TEST_CASE_METHOD(BlobStoreTest, "write and read large blocks", "[blob][Encryption][C]") {
+    // Large writes and reads of encrypted blobs process several file blocks at once:
+    const vector<size_t> kSizes = {3*4096, 8*4096 + 17, 100000, 20*4096};
+    for (size_t size : kSizes) {
+        INFO("Testing " << size << "-byte blob");
+        string blob(size, '\0');
+        for (size_t i = 0; i < size; i++)
+            blob[i] = char(i * 7 + i / 4096);
+        C4Error error;
+        C4WriteStream *stream = c4blob_openWriteStream(store, &error);
+        REQUIRE(stream);
+        REQUIRE(c4stream_write(stream, blob.data(), blob.size(), &error));
+        C4BlobKey key = c4stream_computeBlobKey(stream);
+        REQUIRE(c4stream_install(stream, nullptr, &error));
+        c4stream_closeWriter(stream);
+
+        C4ReadStream *reader = c4blob_openReadStream(store, key, &error);
+        REQUIRE(reader);
+        string readBack(size + 100, '\0');
+        CHECK(c4stream_read(reader, &readBack[0], readBack.size(), &error) == size);
+        readBack.resize(size);
+        CHECK(readBack == blob);
+
+        // Read from a position in the middle of a block:
+        REQUIRE(c4stream_seek(reader, 1000, &error));
+        CHECK(c4stream_read(reader, &readBack[0], size - 1000, &error) == size - 1000);
+        CHECK(memcmp(readBack.data(), &blob[1000], size - 1000) == 0);
+        c4stream_close(reader);
+    }
+}
+
+
+TEST_CASE("AES256Cipher", "[blob][Encryption][C]") {
+    using namespace litecore;
+    uint8_t keyBytes[kAES256KeySize], ivBytes[4 * kAESIVSize];
+    for (size_t i = 0; i < sizeof(keyBytes); i++)
+        keyBytes[i] = uint8_t(i * 11 + 1);
+    for (size_t i = 0; i < sizeof(ivBytes); i++)
+        ivBytes[i] = uint8_t(i * 13 + 5);
+    slice key(keyBytes, sizeof(keyBytes)), iv(ivBytes, kAESIVSize);
+    AES256Cipher encryptor(true, key), decryptor(false, key);
+
+    // The cipher's output must match AES256's:
+    for (size_t size : {0, 1, 15, 16, 17, 4095, 4096}) {
+        INFO("Testing " << size << " bytes");
+        string plaintext(size, '\0');
+        for (size_t i = 0; i < size; i++)
+            plaintext[i] = char(i * 3);
+        for (bool padding : {false, true}) {
+            if (!padding && size % kAESBlockSize != 0)
+                continue;
+            uint8_t expected[4096 + kAESBlockSize], actual[4096 + kAESBlockSize];
+            size_t expectedSize = AES256(true, key, iv, padding,
+                                         slice(expected, sizeof(expected)), slice(plaintext));
+            size_t actualSize = encryptor.crypt(iv, padding,
+                                                slice(actual, sizeof(actual)), slice(plaintext));
+            REQUIRE(actualSize == expectedSize);
+            CHECK(memcmp(actual, expected, actualSize) == 0);
+
+            uint8_t decrypted[4096 + kAESBlockSize];
+            size_t decryptedSize = decryptor.crypt(iv, padding,
+                                                   slice(decrypted, sizeof(decrypted)),
+                                                   slice(actual, actualSize));
+            CHECK(slice(decrypted, decryptedSize) == slice(plaintext));
+        }
+    }
+
+    // Several messages at once, which must match one at a time:
+    static constexpr size_t kLength = 1024;
+    string messages(4 * kLength, '\0');
+    for (size_t i = 0; i < messages.size(); i++)
+        messages[i] = char(i * 5);
+    string ciphertext(messages.size(), '\0');
+    encryptor.cryptMessages(4, kLength, ivBytes, &ciphertext[0], messages.data());
+    for (unsigned m = 0; m < 4; m++) {
+        uint8_t expected[kLength];
+        AES256(true, key, slice(&ivBytes[m * kAESIVSize], kAESIVSize), false,
+               slice(expected, kLength), slice(&messages[m * kLength], kLength));
+        CHECK(memcmp(&ciphertext[m * kLength], expected, kLength) == 0);
+    }
+    decryptor.cryptMessages(4, kLength, ivBytes, &ciphertext[0], ciphertext.data());
+    CHECK(ciphertext == messages);
+}
+
+
+N_WAY_TEST_CASE_METHOD(BlobStoreTest, "Blob stream throughput", "[blob][Encryption][Perf][C][.slow]") {
+    static constexpr size_t kBlobSize = 64 * 1024 * 1024, kChunkSize = 64 * 1024;
+    string chunk(kChunkSize, '\0');
+    for (size_t i = 0; i < kChunkSize; i++)
+        chunk[i] = char(i * 7);
+
+    C4Error error;
+    fleece::Stopwatch st;
+    C4WriteStream *stream = c4blob_openWriteStream(store, &error);
+    REQUIRE(stream);
+    for (size_t pos = 0; pos < kBlobSize; pos += kChunkSize) {
+        chunk[0] = char(pos / kChunkSize);      // make each chunk different
+        REQUIRE(c4stream_write(stream, chunk.data(), kChunkSize, &error));
+    }
+    C4BlobKey key = c4stream_computeBlobKey(stream);
+    REQUIRE(c4stream_install(stream, nullptr, &error));
+    c4stream_closeWriter(stream);
+    st.printReport("Writing blob", kBlobSize / kChunkSize, "64KB");
+
+    st.reset();
+    C4ReadStream *reader = c4blob_openReadStream(store, key, &error);
+    REQUIRE(reader);
+    size_t total = 0, bytesRead;
+    while ((bytesRead = c4stream_read(reader, &chunk[0], kChunkSize, &error)) > 0)
+        total += bytesRead;
+    c4stream_close(reader);
+    st.printReport("Reading blob", kBlobSize / kChunkSize, "64KB");
+    CHECK(total == kBlobSize);
+}
+
+
+N_WAY_TEST_CASE_METHOD(BlobStoreTest, "Blob ingestion throughput", "[blob][Encryption][Perf][C][.slow]") {
+    // Writes 1GB in 1MB pieces, through the hashing/encryption/I-O pipeline:
+    static constexpr size_t kBlobSize = 1024 * 1024 * 1024, kChunkSize = 1024 * 1024;
+    string chunk(kChunkSize, '\0');
+    for (size_t i = 0; i < kChunkSize; i++)
+        chunk[i] = char(i * 7);
+
+    C4Error error;
+    fleece::Stopwatch st;
+    C4WriteStream *stream = c4blob_openWriteStream(store, &error);
+    REQUIRE(stream);
+    for (size_t pos = 0; pos < kBlobSize; pos += kChunkSize) {
+        chunk[0] = char(pos / kChunkSize);
+        REQUIRE(c4stream_write(stream, chunk.data(), kChunkSize, &error));
+    }
+    REQUIRE(c4stream_install(stream, nullptr, &error));
+    c4stream_closeWriter(stream);
+    st.printReport("Ingesting 1GB blob", kBlobSize / kChunkSize, "MB");
+}
+
+
+N_WAY_TEST_CASE_METHOD(BlobStoreTest, "write pipelined blob", "[blob][Encryption][C]") {
+    // A blob this large is hashed, encrypted and written on background threads:
+    static constexpr size_t kBlobSize = 3 * 1024 * 1024 + 12345;
+    string data(kBlobSize, '\0');
+    for (size_t i = 0; i < kBlobSize; i++)
+        data[i] = char(i * 13 + (i >> 12));
+    C4BlobKey expectedKey = c4blob_computeKey({data.data(), data.size()});
+
+    C4Error error;
+    C4WriteStream *stream = c4blob_openWriteStream(store, &error);
+    REQUIRE(stream);
+    size_t pos = 0, length = 1;
+    while (pos < kBlobSize) {
+        length = min((length * 3) % 100000 + 1, kBlobSize - pos);      // assorted write sizes
+        REQUIRE(c4stream_write(stream, &data[pos], length, &error));
+        pos += length;
+    }
+    C4BlobKey key = c4stream_computeBlobKey(stream);
+    CHECK(memcmp(&key, &expectedKey, sizeof(key)) == 0);
+    REQUIRE(c4stream_install(stream, &expectedKey, &error));
+    c4stream_closeWriter(stream);
+
+    C4SliceResult contents = c4blob_getContents(store, key, &error);
+    REQUIRE(contents.size == kBlobSize);
+    CHECK(memcmp(contents.buf, data.data(), kBlobSize) == 0);
+    c4slice_free(contents);
+
+    // Installing the same data again finds it already present:
+    stream = c4blob_openWriteStream(store, &error);
+    REQUIRE(stream);
+    REQUIRE(c4stream_write(stream, data.data(), data.size(), &error));
+    REQUIRE(c4stream_install(stream, nullptr, &error));
+    c4stream_closeWriter(stream);
+    CHECK(c4blob_getSize(store, key) == kBlobSize);
+}
+
+
 N_WAY_TEST_CASE_METHOD(BlobStoreTest, "write blob and cancel", "[blob][Encryption][C]") {
     // Write the blob:
     C4Error error;
@@ -20,10 +20,12 @@
 #include "c4Private.h"
 #include "c4DocEnumerator.h"
 #include "c4BlobStore.h"
+#include "c4Observer.h"
 #include "FilePath.hh"
 #include <cmath>
 #include <errno.h>
 #include <iostream>
+#include <set>
 #include <thread>
 
 #include "sqlite3.h"
@@ -445,6 +447,55 @@ N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database Auto-Expiration After Reopen",
     C4Log("---- Done...");
 }
 
+N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database Auto-Expiration In Batches", "[Database][C]")
+{
+    // Expire more docs than fit in one batch, with a long enough pause between batches that
+    // each one can be seen:
+    constexpr unsigned kNumDocs = 35, kBatchSize = 10;
+    c4db_setExpirationBatching(db, kBatchSize, 300);
+
+    C4Error err;
+    auto expire = c4_now() + 1000*ms;
+    set<string> docIDs;
+    for (unsigned i = 0; i < kNumDocs; ++i) {
+        string docID = "expire_me_" + to_string(i);
+        createRev(slice(docID), kRevID, kFleeceBody);
+        REQUIRE(c4doc_setExpiration(db, slice(docID), expire, &err));
+        docIDs.insert(docID);
+    }
+    C4DatabaseObserver *observer = c4dbobs_create(db, [](C4DatabaseObserver*, void*) { },
+                                                   nullptr);
+    REQUIRE(c4db_startHousekeeping(db));
+
+    // Watch the doc count go down, one batch at a time:
+    C4Log("---- Wait till expiration time...");
+    set<uint64_t> counts;
+    for (int i = 0; i < 500 && c4db_getDocumentCount(db) > 0; ++i) {
+        counts.insert(c4db_getDocumentCount(db));
+        this_thread::sleep_for(10ms);
+    }
+    CHECK(c4db_getDocumentCount(db) == 0);
+    counts.insert(0);
+    CHECK(counts == (set<uint64_t>{0, 5, 15, 25, 35}));
+
+    // Every purged doc was reported to observers:
+    set<string> purged;
+    C4DatabaseChange changes[100];
+    bool external;
+    uint32_t n;
+    while ((n = c4dbobs_getChanges(observer, changes, 100, &external)) > 0) {
+        CHECK(external);
+        for (uint32_t i = 0; i < n; ++i) {
+            CHECK(changes[i].sequence == 0);
+            purged.insert(string((const char*)changes[i].docID.buf, changes[i].docID.size));
+        }
+        c4dbobs_releaseChanges(changes, n);
+    }
+    CHECK(purged == docIDs);
+    c4dbobs_free(observer);
+    C4Log("---- Done...");
+}
+
 N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database CancelExpire", "[Database][C]")
 {
     C4Slice docID = C4STR("expire_me");
@@ -489,6 +540,203 @@ N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database BlobStore", "[Database][C]")
     REQUIRE(blobs != nullptr);
 }
 
+N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database BlobStore Packing", "[Database][blob][C]")
+{
+    C4Error err;
+    string small = "This is a small blob, which will be packed with others";
+    string large(100000, 'x');
+    C4BlobKey smallKey, largeKey;
+
+    // Packing is off by default:
+    C4BlobStore *store = c4db_getBlobStore(db, &err);
+    REQUIRE(store);
+    REQUIRE(c4blob_create(store, slice(small), nullptr, &smallKey, &err));
+    C4SliceResult unpackedPath = c4blob_getFilePath(store, smallKey, &err);
+    CHECK((unpackedPath.buf != nullptr) == !isEncrypted());
+    c4slice_free(unpackedPath);
+    REQUIRE(c4blob_delete(store, smallKey, &err));
+
+    auto config = *c4db_getConfig(db);
+    config.flags |= kC4DB_PackedBlobs;
+    closeDB();
+    db = c4db_open(databasePath(), &config, &err);
+    REQUIRE(db);
+    store = c4db_getBlobStore(db, &err);
+    REQUIRE(store);
+
+    // Small blobs are packed together; large ones get their own files:
+    REQUIRE(c4blob_create(store, slice(small), nullptr, &smallKey, &err));
+    REQUIRE(c4blob_create(store, slice(large), nullptr, &largeKey, &err));
+
+    CHECK(c4blob_getSize(store, smallKey) >= (int64_t)small.size());
+    alloc_slice contents = c4blob_getContents(store, smallKey, &err);
+    CHECK(contents == slice(small));
+    alloc_slice largeContents = c4blob_getContents(store, largeKey, &err);
+    CHECK(largeContents == slice(large));
+
+    C4SliceResult path = c4blob_getFilePath(store, smallKey, &err);
+    CHECK(path.buf == nullptr);
+    CHECK(err.code == kC4ErrorUnsupported);
+    path = c4blob_getFilePath(store, largeKey, &err);
+    CHECK((path.buf != nullptr) == !isEncrypted());
+    c4slice_free(path);
+
+    // Packed blobs can be read as streams:
+    C4ReadStream *reader = c4blob_openReadStream(store, smallKey, &err);
+    REQUIRE(reader);
+    CHECK(c4stream_getLength(reader, &err) == (int64_t)small.size());
+    REQUIRE(c4stream_seek(reader, 8, &err));
+    char buf[5];
+    CHECK(c4stream_read(reader, buf, sizeof(buf), &err) == sizeof(buf));
+    CHECK(string(buf, sizeof(buf)) == "small");
+    c4stream_close(reader);
+
+    REQUIRE(c4blob_delete(store, smallKey, &err));
+    CHECK(c4blob_getSize(store, smallKey) == -1);
+    CHECK(c4blob_getSize(store, largeKey) > 0);
+
+    // Re-adding a deleted blob works:
+    REQUIRE(c4blob_create(store, slice(small), nullptr, &smallKey, &err));
+    alloc_slice readdedContents = c4blob_getContents(store, smallKey, &err);
+    CHECK(readdedContents == slice(small));
+
+    // Compaction deletes unused blobs, packed or not:
+    REQUIRE(c4db_compact(db, &err));
+    CHECK(c4blob_getSize(store, smallKey) == -1);
+    CHECK(c4blob_getSize(store, largeKey) == -1);
+}
+
+
+N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database BlobStore Packing Torn Record", "[Database][blob][C]")
+{
+    C4Error err;
+    auto config = *c4db_getConfig(db);
+    config.flags |= kC4DB_PackedBlobs;
+    closeDB();
+    db = c4db_open(databasePath(), &config, &err);
+    REQUIRE(db);
+    C4BlobStore *store = c4db_getBlobStore(db, &err);
+    REQUIRE(store);
+
+    string blob1 = "The first small blob";
+    C4BlobKey key1;
+    REQUIRE(c4blob_create(store, slice(blob1), nullptr, &key1, &err));
+    closeDB();
+
+    // Simulate a crash in the middle of appending a record:
+    auto segment = litecore::FilePath(databasePathString(), "")
+                                .subdirectoryNamed("Attachments")["000001.blobpack"];
+    int64_t goodSize = segment.dataSize();
+    REQUIRE(goodSize > 0);
+    FILE *f = fopen(segment.path().c_str(), "ab");
+    REQUIRE(f);
+    fwrite("torn record", 1, 11, f);
+    fclose(f);
+
+    // Opening the pack truncates the torn record, so new blobs are appended after the good ones:
+    db = c4db_open(databasePath(), &config, &err);
+    REQUIRE(db);
+    store = c4db_getBlobStore(db, &err);
+    REQUIRE(store);
+    alloc_slice contents1 = c4blob_getContents(store, key1, &err);
+    CHECK(contents1 == slice(blob1));
+    CHECK(segment.dataSize() == goodSize);
+
+    string blob2 = "The second small blob";
+    C4BlobKey key2;
+    REQUIRE(c4blob_create(store, slice(blob2), nullptr, &key2, &err));
+    CHECK(segment.dataSize() > goodSize);
+    alloc_slice contents2 = c4blob_getContents(store, key2, &err);
+    CHECK(contents2 == slice(blob2));
+}
+
+
+N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database BlobStore Chunking", "[Database][blob][C]")
+{
+    C4Error err;
+    auto config = *c4db_getConfig(db);
+    config.flags |= kC4DB_ChunkedBlobs;
+    closeDB();
+    db = c4db_open(databasePath(), &config, &err);
+    REQUIRE(db);
+    C4BlobStore *store = c4db_getBlobStore(db, &err);
+    REQUIRE(store);
+
+    // Pseudo-random data, so the chunker finds boundaries in it:
+    string original(2 * 1024 * 1024, '\0');
+    uint32_t state = 12345;
+    for (char &c : original) {
+        state = state * 1103515245 + 12345;
+        c = char(state >> 24);
+    }
+    string edited = original;
+    edited.insert(1024 * 1024, "This text was inserted in the middle of the blob");
+
+    auto chunksOf = [&](C4BlobKey key) {
+        alloc_slice json = c4blob_getChunkList(store, key, &err);
+        vector<string> chunks;
+        for (Array::iterator i(Doc::fromJSON(json).asArray()); i; ++i)
+            chunks.push_back(i.value().asArray()[0].asstring());
+        return chunks;
+    };
+
+    C4BlobKey key1, key2;
+    {
+        TransactionHelper t(db);
+        vector<string> atts {original};
+        key1 = addDocWithAttachments("doc1"_sl, atts, "application/octet-stream")[0];
+    }
+    REQUIRE(c4blob_create(store, slice(edited), nullptr, &key2, &err));
+
+    // Large blobs are stored as chunks, and read back intact:
+    auto chunks1 = chunksOf(key1), chunks2 = chunksOf(key2);
+    CHECK(chunks1.size() > 8);
+    CHECK(c4blob_getSize(store, key1) == (int64_t)original.size());
+    alloc_slice contents = c4blob_getContents(store, key2, &err);
+    CHECK(contents == slice(edited));
+    C4SliceResult path = c4blob_getFilePath(store, key1, &err);
+    CHECK(path.buf == nullptr);
+    CHECK(err.code == kC4ErrorUnsupported);
+
+    C4ReadStream *reader = c4blob_openReadStream(store, key2, &err);
+    REQUIRE(reader);
+    CHECK(c4stream_getLength(reader, &err) == (int64_t)edited.size());
+    REQUIRE(c4stream_seek(reader, 1024 * 1024 + 5, &err));
+    char buf[4];
+    CHECK(c4stream_read(reader, buf, sizeof(buf), &err) == sizeof(buf));
+    CHECK(string(buf, sizeof(buf)) == "text");
+    c4stream_close(reader);
+
+    // The edit only changed the chunks around it:
+    size_t shared = count_if(chunks2.begin(), chunks2.end(), [&](const string &chunk) {
+        return find(chunks1.begin(), chunks1.end(), chunk) != chunks1.end();
+    });
+    CHECK(shared >= chunks2.size() - 2);
+
+    // A blob can be recreated from its chunk list, but only if the key matches:
+    alloc_slice list1 = c4blob_getChunkList(store, key1, &err);
+    REQUIRE(c4blob_delete(store, key1, &err));
+    CHECK(c4blob_getSize(store, key1) == -1);
+    {
+        ExpectingExceptions x;
+        CHECK(!c4blob_createFromChunks(store, list1, &key2, nullptr, &err));
+        CHECK(err.domain == LiteCoreDomain);
+        CHECK(err.code == kC4ErrorCorruptData);
+    }
+    C4BlobKey key;
+    REQUIRE(c4blob_createFromChunks(store, list1, nullptr, &key, &err));
+    CHECK(memcmp(&key, &key1, sizeof(key)) == 0);
+    contents = c4blob_getContents(store, key1, &err);
+    CHECK(contents == slice(original));
+
+    // Compaction keeps the chunks of blobs in use, and deletes the rest:
+    REQUIRE(c4db_compact(db, &err));
+    contents = c4blob_getContents(store, key1, &err);
+    CHECK(contents == slice(original));
+    CHECK(c4blob_getSize(store, key2) == -1);
+}
+
+
 N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database Compact", "[Database][C]")
 {
     C4Error err;
@@ -629,6 +877,82 @@ N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database copy", "[Database][C]") {
 }
 
 
+N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database Backup", "[Database][blob][C]") {
+    C4Error error;
+    C4BlobStore *store = c4db_getBlobStore(db, &error);
+    REQUIRE(store);
+    string blob1 = "This is the first blob", blob2(100000, 'b');
+    C4BlobKey key1, key2;
+    REQUIRE(c4blob_create(store, slice(blob1), nullptr, &key1, &error));
+    REQUIRE(c4blob_create(store, slice(blob2), nullptr, &key2, &error));
+    createRev("doc001"_sl, kRevID, kFleeceBody);
+    createRev("doc002"_sl, kRevID, kFleeceBody);
+
+    string backupPath = TempDir() + "backup.cblite2" + kPathSeparator;
+    if (!c4db_deleteAtPath(slice(backupPath), &error))
+        REQUIRE(error.code == 0);
+
+    auto onProgress = [](void *context, const C4BackupProgress *progress) {
+        *(C4BackupProgress*)context = *progress;
+        return true;
+    };
+    C4BackupProgress progress = {};
+    REQUIRE(c4db_backup(db, slice(backupPath), 0, onProgress, &progress, &error));
+    CHECK(progress.pagesTotal > 0);
+    CHECK(progress.pagesCopied == progress.pagesTotal);
+    CHECK(progress.blobsCopied == 2);
+    CHECK(progress.blobsTotal == 2);
+
+    C4DatabaseConfig config = *c4db_getConfig(db);
+    config.flags &= ~kC4DB_Create;
+    auto checkBackup = [&](unsigned expectedDocs, bool hasBlob1) {
+        C4Database *backup = c4db_open(slice(backupPath), &config, &error);
+        REQUIRE(backup);
+        CHECK(c4db_getDocumentCount(backup) == expectedDocs);
+        C4BlobStore *backupStore = c4db_getBlobStore(backup, &error);
+        REQUIRE(backupStore);
+        CHECK((c4blob_getSize(backupStore, key1) >= 0) == hasBlob1);
+        if (hasBlob1) {
+            alloc_slice contents = c4blob_getContents(backupStore, key1, &error);
+            CHECK(contents == slice(blob1));
+        }
+        alloc_slice contents2 = c4blob_getContents(backupStore, key2, &error);
+        CHECK(contents2 == slice(blob2));
+        REQUIRE(c4db_close(backup, &error));
+        c4db_release(backup);
+    };
+    checkBackup(2, true);
+
+    // A non-incremental backup won't overwrite an existing one:
+    {
+        ExpectingExceptions x;
+        REQUIRE(!c4db_backup(db, slice(backupPath), 0, nullptr, nullptr, &error));
+        CHECK(error.domain == POSIXDomain);
+        CHECK(error.code == EEXIST);
+    }
+
+    // An incremental backup picks up new docs and drops deleted blobs:
+    createRev("doc003"_sl, kRevID, kFleeceBody);
+    REQUIRE(c4blob_delete(store, key1, &error));
+    REQUIRE(c4db_backup(db, slice(backupPath), kC4BackupIncremental, nullptr, nullptr, &error));
+    checkBackup(3, false);
+
+    // Cancelling leaves the existing backup alone:
+    createRev("doc004"_sl, kRevID, kFleeceBody);
+    {
+        ExpectingExceptions x;
+        auto cancel = [](void *context, const C4BackupProgress *progress) {return false;};
+        REQUIRE(!c4db_backup(db, slice(backupPath), kC4BackupIncremental, cancel, nullptr,
+                             &error));
+        CHECK(error.domain == POSIXDomain);
+        CHECK(error.code == ECANCELED);
+    }
+    checkBackup(3, false);
+
+    REQUIRE(c4db_deleteAtPath(slice(backupPath), &error));
+}
+
+
 N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database Config2 And ExtraInfo", "[Database][C]") {
     C4DatabaseConfig2 config = {};
     config.parentDirectory = slice(TempDir());
@@ -674,6 +998,69 @@ N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database Config2 And ExtraInfo", "[Datab
 }
 
 
+N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database Storage Tuning", "[Database][C]") {
+    C4Error error;
+    C4StorageStats stats;
+    REQUIRE(c4db_getStorageStats(db, &stats, &error));
+    CHECK(stats.pageSize == 4096);
+    CHECK(stats.cacheSize == 10 * 1024 * 1024);
+
+    C4DatabaseConfig2 config = {};
+    config.parentDirectory = slice(TempDir());
+    config.flags = kC4DB_Create;
+    config.encryptionKey = c4db_getConfig(db)->encryptionKey;
+    config.tuning.cacheSize = 32 * 1024 * 1024;
+    config.tuning.mmapSize = -1;
+    config.tuning.pageSize = 8192;
+    config.tuning.synchronous = kC4SQLiteSyncFull;
+    const string db2Name = kDatabaseName + "_tuned";
+    c4db_deleteNamed(slice(db2Name), config.parentDirectory, &error);
+    C4Database *db2 = c4db_openNamed(slice(db2Name), &config, &error);
+    REQUIRE(db2);
+
+    {
+        TransactionHelper t(db2);
+        for (int i = 0; i < 100; ++i) {
+            char docID[20];
+            sprintf(docID, "doc-%03d", i);
+            createRev(db2, slice(docID), kRevID, kFleeceBody);
+        }
+    }
+    REQUIRE(c4db_getStorageStats(db2, &stats, &error));
+    CHECK(stats.pageSize == 8192);
+    CHECK(stats.cacheSize == 32 * 1024 * 1024);
+    CHECK(stats.mmapSize == 0);
+    CHECK(stats.pageCount > 0);
+    CHECK(stats.walFrames > 0);
+    CHECK(stats.walSize >= stats.walFrames * stats.pageSize);
+    CHECK(stats.checkpointLag <= stats.walFrames);
+    CHECK(stats.cacheHits + stats.cacheMisses > 0);
+    CHECK(c4db_close(db2, &error));
+    c4db_release(db2);
+
+    // An invalid page size is rejected:
+    config.tuning.pageSize = 1000;
+    c4db_deleteNamed(slice(db2Name), config.parentDirectory, &error);
+    {
+        ExpectingExceptions x;
+        CHECK(!c4db_openNamed(slice(db2Name), &config, &error));
+    }
+    CHECK(error.domain == LiteCoreDomain);
+    CHECK(error.code == kC4ErrorInvalidParameter);
+
+    // Auto-sizing never goes below the defaults:
+    config.tuning = {};
+    config.tuning.autoSize = true;
+    db2 = c4db_openNamed(slice(db2Name), &config, &error);
+    REQUIRE(db2);
+    REQUIRE(c4db_getStorageStats(db2, &stats, &error));
+    CHECK(stats.cacheSize >= 10 * 1024 * 1024);
+    CHECK(c4db_close(db2, &error));
+    c4db_release(db2);
+    REQUIRE(c4db_deleteNamed(slice(db2Name), config.parentDirectory, &error));
+}
+
+
 #pragma mark - SCHEMA UPGRADES
 
 
@@ -770,3 +1157,34 @@ TEST_CASE("Database Upgrade From 2.7", "[Database][Upgrade][C]") {
     testOpeningOlderDBFixture("upgrade_2.7.cblite2", kC4DB_NoUpgrade);
     testOpeningOlderDBFixture("upgrade_2.7.cblite2", kC4DB_ReadOnly);
 }
+
+
+N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database Background Maintenance", "[Database][C]") {
+    // Create and then delete about 4MB of raw docs, leaving their pages on the freelist:
+    C4Error error;
+    const string body(4000, 'x');
+    for (int pass = 0; pass < 2; ++pass) {
+        TransactionHelper t(db);
+        for (int i = 0; i < 1000; ++i) {
+            string key = "doc-" + to_string(i);
+            REQUIRE(c4raw_put(db, "maintenance"_sl, slice(key), nullslice,
+                              (pass == 0 ? slice(body) : nullslice), &error));
+        }
+    }
+    C4StorageStats stats;
+    REQUIRE(c4db_getStorageStats(db, &stats, &error));
+    const uint64_t initialPageCount = stats.pageCount;
+    CHECK(stats.freePages * stats.pageSize > 2 * 1024 * 1024);
+
+    // Once the database goes idle, the housekeeper should vacuum most of them away:
+    REQUIRE(c4db_startHousekeeping(db));
+    c4db_setMaintenanceInterval(db, 20);
+    for (int i = 0; i < 200; ++i) {
+        this_thread::sleep_for(chrono::milliseconds(50));
+        REQUIRE(c4db_getStorageStats(db, &stats, &error));
+        if (stats.freePages * stats.pageSize < 1024 * 1024)
+            break;
+    }
+    CHECK(stats.freePages * stats.pageSize < 1024 * 1024);
+    CHECK(stats.pageCount < initialPageCount);
+}
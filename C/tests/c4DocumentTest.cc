@@ -1061,3 +1061,80 @@ N_WAY_TEST_CASE_METHOD(C4Test, "Document Clobber Remote Rev", "[Database][C]") {
     c4doc_release(updatedDocRefreshed);
 }
 
+
+
+// Returns the number of revision bodies stored outside the default KeyStore's documents.
+static int64_t countExternalBodies(C4Database *db) {
+    C4Error error;
+    alloc_slice result = c4db_rawQuery(db, "SELECT count(*) FROM kv__bodies_default"_sl, &error);
+    if (!result)
+        return 0;       // (the table is created when it's first needed)
+    Doc rows(result, kFLTrusted);
+    return rows.root().asArray()[0].asArray()[0].asInt();
+}
+
+
+N_WAY_TEST_CASE_METHOD(C4Test, "Document External Revision Bodies", "[Document][C]") {
+    if (!isRevTrees())
+        return;
+    // Create a doc whose first revision has a big body that's kept after it's replaced:
+    std::string json = "{\"text\":\"" + std::string(10000, 'x') + "\"}";
+    alloc_slice bigBody = json2fleece(json.c_str());
+    createRev(kDocID, kRevID, bigBody, kRevKeepBody);
+    CHECK(countExternalBodies(db) == 0);
+    createRev(kDocID, kRev2ID, kFleeceBody);
+    CHECK(countExternalBodies(db) == 1);
+
+    // The document's record should contain only the current revision's body:
+    C4Error error;
+    C4RawDocument *raw = c4raw_get(db, "default"_sl, kDocID, &error);
+    REQUIRE(raw);
+    CHECK(raw->body.size < 1000);
+    c4raw_free(raw);
+
+    // But the old revision's body can still be read:
+    reopenDB();
+    C4Document *doc = c4doc_get(db, kDocID, true, &error);
+    REQUIRE(doc);
+    CHECK(doc->selectedRev.revID == kRev2ID);
+    CHECK(doc->selectedRev.body == kFleeceBody);
+    REQUIRE(c4doc_selectParentRevision(doc));
+    CHECK(doc->selectedRev.revID == kRevID);
+    CHECK(c4doc_hasRevisionBody(doc));
+    CHECK(slice(doc->selectedRev.body) == bigBody);
+    c4doc_release(doc);
+
+    // Keeping a newer revision's body discards the old one:
+    createRev(kDocID, kRev3ID, kFleeceBody, kRevKeepBody);
+    doc = c4doc_get(db, kDocID, true, &error);
+    REQUIRE(doc);
+    REQUIRE(c4doc_selectRevision(doc, kRevID, true, &error));
+    CHECK(!c4doc_hasRevisionBody(doc));
+    CHECK(doc->selectedRev.body == kC4SliceNull);
+    c4doc_release(doc);
+    CHECK(countExternalBodies(db) == 0);
+
+    // Pruning a revision deletes its external body:
+    c4db_setMaxRevTreeDepth(db, 2);
+    createRev("pruned"_sl, kRevID, bigBody, kRevKeepBody);
+    createRev("pruned"_sl, kRev2ID, kFleeceBody);
+    CHECK(countExternalBodies(db) == 1);
+    createRev("pruned"_sl, kRev3ID, kFleeceBody);
+    CHECK(countExternalBodies(db) == 0);
+
+    // Purging a document deletes its external bodies:
+    createRev("purged"_sl, kRevID, bigBody, kRevKeepBody);
+    createRev("purged"_sl, kRev2ID, kFleeceBody);
+    CHECK(countExternalBodies(db) == 1);
+    {
+        TransactionHelper t(db);
+        REQUIRE(c4db_purgeDoc(db, "purged"_sl, &error));
+        REQUIRE(c4db_purgeDoc(db, kDocID, &error));
+    }
+    CHECK(countExternalBodies(db) == 0);
+    CHECK(c4db_getDocumentCount(db) == 1);
+
+    // The body store is reserved:
+    CHECK(c4raw_get(db, "_bodies_default"_sl, "x"_sl, &error) == nullptr);
+    CHECK(error.code == kC4ErrorInvalidParameter);
+}
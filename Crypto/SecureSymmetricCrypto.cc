@@ -24,10 +24,20 @@
     #include <MacTypes.h>
     #include <CommonCrypto/CommonCrypto.h>
 #else
+    #include "mbedtls/aes.h"
     #include "mbedtls/cipher.h"
     #include "mbedtls/pkcs5.h"
 #endif
 
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+    #define LITECORE_AESNI 1
+    #include <wmmintrin.h>
+#else
+    #define LITECORE_AESNI 0
+#endif
+#include <algorithm>
+#include <string.h>
+
 
 namespace litecore {
     using namespace fleece;
@@ -156,5 +166,289 @@ namespace litecore {
 
 #endif
 
-}
 
+#pragma mark - AES-NI:
+
+
+#if LITECORE_AESNI
+
+    // AES-256 with Intel's AES instructions. The key expansion follows Intel's white paper
+    // "Advanced Encryption Standard (AES) New Instructions Set".
+
+    #define AESNI_FN __attribute__((target("aes,sse2")))
+
+    // Returns k ^ (k << 32) ^ (k << 64) ^ (k << 96)
+    AESNI_FN static inline __m128i aesniPrefixXor(__m128i k) {
+        k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+        return _mm_xor_si128(k, _mm_slli_si128(k, 8));
+    }
+
+    AESNI_FN static void aesniExpandKey(const uint8_t *key, bool encrypt, __m128i rk[15]) {
+        __m128i k1 = _mm_loadu_si128((const __m128i*)key);
+        __m128i k2 = _mm_loadu_si128((const __m128i*)(key + 16));
+        rk[0] = k1;
+        rk[1] = k2;
+        // (_mm_aeskeygenassist_si128 requires a constant round number, so this is unrolled.)
+        #define EXPAND_EVEN(I, RCON) \
+            k1 = _mm_xor_si128(aesniPrefixXor(k1), \
+                               _mm_shuffle_epi32(_mm_aeskeygenassist_si128(k2, RCON), 0xff)); \
+            rk[I] = k1;
+        #define EXPAND_ODD(I) \
+            k2 = _mm_xor_si128(aesniPrefixXor(k2), \
+                               _mm_shuffle_epi32(_mm_aeskeygenassist_si128(k1, 0), 0xaa)); \
+            rk[I] = k2;
+        EXPAND_EVEN( 2, 0x01)   EXPAND_ODD( 3)
+        EXPAND_EVEN( 4, 0x02)   EXPAND_ODD( 5)
+        EXPAND_EVEN( 6, 0x04)   EXPAND_ODD( 7)
+        EXPAND_EVEN( 8, 0x08)   EXPAND_ODD( 9)
+        EXPAND_EVEN(10, 0x10)   EXPAND_ODD(11)
+        EXPAND_EVEN(12, 0x20)   EXPAND_ODD(13)
+        EXPAND_EVEN(14, 0x40)
+        #undef EXPAND_EVEN
+        #undef EXPAND_ODD
+
+        if (!encrypt) {
+            // The "equivalent inverse cipher" uses the round keys in reverse order, with
+            // InvMixColumns applied to the inner ones:
+            std::reverse(&rk[0], &rk[15]);
+            for (int i = 1; i < 14; ++i)
+                rk[i] = _mm_aesimc_si128(rk[i]);
+        }
+    }
+
+
+    // Encrypts `n` (up to kMaxInterleave) CBC messages at once. Each message's blocks depend on
+    // each other, but the messages don't, so interleaving them keeps the AES unit busy.
+    AESNI_FN static void aesniEncryptCBC(const __m128i rk[15], unsigned n, const uint8_t *ivs,
+                                         uint8_t *dst, const uint8_t *src, size_t length)
+    {
+        __m128i state[AES256Cipher::kMaxInterleave];
+        for (unsigned m = 0; m < n; ++m)
+            state[m] = _mm_loadu_si128((const __m128i*)(ivs + m * kAESIVSize));
+        for (size_t pos = 0; pos < length; pos += kAESBlockSize) {
+            for (unsigned m = 0; m < n; ++m) {
+                __m128i block = _mm_loadu_si128((const __m128i*)(src + m * length + pos));
+                state[m] = _mm_xor_si128(state[m], _mm_xor_si128(block, rk[0]));
+            }
+            for (int r = 1; r < 14; ++r) {
+                __m128i key = rk[r];
+                for (unsigned m = 0; m < n; ++m)
+                    state[m] = _mm_aesenc_si128(state[m], key);
+            }
+            for (unsigned m = 0; m < n; ++m) {
+                state[m] = _mm_aesenclast_si128(state[m], rk[14]);
+                _mm_storeu_si128((__m128i*)(dst + m * length + pos), state[m]);
+            }
+        }
+    }
+
+
+    // Decrypts a CBC message. Unlike encryption, each block depends only on the ciphertext, so
+    // eight blocks are decrypted at once.
+    AESNI_FN static void aesniDecryptCBC(const __m128i rk[15], const uint8_t *iv,
+                                         uint8_t *dst, const uint8_t *src, size_t length)
+    {
+        static constexpr unsigned kBatch = 8;
+        __m128i prev = _mm_loadu_si128((const __m128i*)iv);
+        size_t pos = 0;
+        for (; pos + kBatch * kAESBlockSize <= length; pos += kBatch * kAESBlockSize) {
+            __m128i in[kBatch], x[kBatch];
+            for (unsigned i = 0; i < kBatch; ++i) {
+                in[i] = _mm_loadu_si128((const __m128i*)(src + pos + i * kAESBlockSize));
+                x[i] = _mm_xor_si128(in[i], rk[0]);
+            }
+            for (int r = 1; r < 14; ++r) {
+                __m128i key = rk[r];
+                for (unsigned i = 0; i < kBatch; ++i)
+                    x[i] = _mm_aesdec_si128(x[i], key);
+            }
+            for (unsigned i = 0; i < kBatch; ++i) {
+                x[i] = _mm_xor_si128(_mm_aesdeclast_si128(x[i], rk[14]), (i ? in[i-1] : prev));
+                _mm_storeu_si128((__m128i*)(dst + pos + i * kAESBlockSize), x[i]);
+            }
+            prev = in[kBatch - 1];
+        }
+        for (; pos < length; pos += kAESBlockSize) {
+            __m128i in = _mm_loadu_si128((const __m128i*)(src + pos));
+            __m128i x = _mm_xor_si128(in, rk[0]);
+            for (int r = 1; r < 14; ++r)
+                x = _mm_aesdec_si128(x, rk[r]);
+            x = _mm_xor_si128(_mm_aesdeclast_si128(x, rk[14]), prev);
+            _mm_storeu_si128((__m128i*)(dst + pos), x);
+            prev = in;
+        }
+    }
+
+#endif // LITECORE_AESNI
+
+
+#pragma mark - AES256CIPHER:
+
+
+    struct AES256Cipher::Impl {
+#if LITECORE_AESNI
+        __m128i roundKeys[15];
+        bool aesni {false};
+#endif
+#ifdef __APPLE__
+        CCCryptorRef cryptor {nullptr};
+#else
+        mbedtls_aes_context aes;
+#endif
+    };
+
+
+    AES256Cipher::AES256Cipher(bool encrypt, slice key)
+    :_encrypt(encrypt)
+    ,_impl(new Impl)
+    {
+        DebugAssert(key.size == kAES256KeySize);
+#if LITECORE_AESNI
+        if (__builtin_cpu_supports("aes")) {
+            _impl->aesni = true;
+            aesniExpandKey((const uint8_t*)key.buf, encrypt, _impl->roundKeys);
+            return;
+        }
+#endif
+#ifdef __APPLE__
+        // (No padding; crypt() does the PKCS7 padding itself.)
+        CCCryptorStatus status = CCCryptorCreate((encrypt ? kCCEncrypt : kCCDecrypt),
+                                                 kCCAlgorithmAES, 0,
+                                                 key.buf, key.size, nullptr,
+                                                 &_impl->cryptor);
+        if (status != kCCSuccess)
+            error::_throw(error::CryptoError);
+#else
+        mbedtls_aes_init(&_impl->aes);
+        int err;
+        if (encrypt)
+            err = mbedtls_aes_setkey_enc(&_impl->aes, (const unsigned char*)key.buf, 256);
+        else
+            err = mbedtls_aes_setkey_dec(&_impl->aes, (const unsigned char*)key.buf, 256);
+        if (err)
+            error::_throw(error::CryptoError);
+#endif
+    }
+
+
+    AES256Cipher::~AES256Cipher() {
+#if LITECORE_AESNI
+        if (_impl->aesni) {
+            memset((void*)_impl->roundKeys, 0, sizeof(_impl->roundKeys));
+            return;
+        }
+#endif
+#ifdef __APPLE__
+        if (_impl->cryptor)
+            CCCryptorRelease(_impl->cryptor);
+#else
+        mbedtls_aes_free(&_impl->aes);
+#endif
+    }
+
+
+    bool AES256Cipher::hardwareAccelerated() const {
+#if LITECORE_AESNI
+        if (_impl->aesni)
+            return true;
+#endif
+#ifdef __APPLE__
+        return true;    // CommonCrypto uses the AES hardware by itself
+#else
+        return false;
+#endif
+    }
+
+
+    // Encrypts or decrypts a single CBC message without padding.
+    void AES256Cipher::cryptBlocks(const uint8_t *iv, uint8_t *dst, const uint8_t *src,
+                                   size_t length)
+    {
+#if LITECORE_AESNI
+        if (_impl->aesni) {
+            if (_encrypt)
+                aesniEncryptCBC(_impl->roundKeys, 1, iv, dst, src, length);
+            else
+                aesniDecryptCBC(_impl->roundKeys, iv, dst, src, length);
+            return;
+        }
+#endif
+#ifdef __APPLE__
+        size_t outSize;
+        if (CCCryptorReset(_impl->cryptor, iv) != kCCSuccess
+                || CCCryptorUpdate(_impl->cryptor, src, length, dst, length, &outSize) != kCCSuccess)
+            error::_throw(error::CryptoError);
+#else
+        uint8_t ivCopy[kAESIVSize];
+        memcpy(ivCopy, iv, kAESIVSize);
+        if (mbedtls_aes_crypt_cbc(&_impl->aes, (_encrypt ? MBEDTLS_AES_ENCRYPT : MBEDTLS_AES_DECRYPT),
+                                  length, ivCopy, src, dst) != 0)
+            error::_throw(error::CryptoError);
+#endif
+    }
+
+
+    size_t AES256Cipher::crypt(slice iv, bool padding, slice dst, slice src) {
+        DebugAssert(iv.size == kAESIVSize, "IV is wrong size");
+        auto in = (const uint8_t*)src.buf;
+        auto out = (uint8_t*)dst.buf;
+        size_t fullLength = src.size & ~(kAESBlockSize - 1);
+        if (_encrypt) {
+            size_t outSize = padding ? fullLength + kAESBlockSize : src.size;
+            if ((!padding && fullLength != src.size) || dst.size < outSize)
+                error::_throw(error::CryptoError);
+            cryptBlocks((const uint8_t*)iv.buf, out, in, fullLength);
+            if (padding) {
+                // PKCS7: fill out the last block with bytes whose value is the padding length
+                uint8_t last[kAESBlockSize];
+                size_t remainder = src.size - fullLength;
+                memcpy(last, in + fullLength, remainder);
+                memset(last + remainder, int(kAESBlockSize - remainder), kAESBlockSize - remainder);
+                const uint8_t *lastIV = fullLength ? (out + fullLength - kAESBlockSize)
+                                                   : (const uint8_t*)iv.buf;
+                cryptBlocks(lastIV, out + fullLength, last, kAESBlockSize);
+            }
+            return outSize;
+        } else {
+            if (fullLength != src.size || (padding && src.size == 0) || dst.size < src.size)
+                error::_throw(error::CryptoError);
+            cryptBlocks((const uint8_t*)iv.buf, out, in, src.size);
+            if (!padding)
+                return src.size;
+            uint8_t pad = out[src.size - 1];
+            if (pad == 0 || pad > kAESBlockSize)
+                error::_throw(error::CryptoError);
+            for (size_t i = src.size - pad; i < src.size; ++i) {
+                if (out[i] != pad)
+                    error::_throw(error::CryptoError);
+            }
+            return src.size - pad;
+        }
+    }
+
+
+    void AES256Cipher::cryptMessages(unsigned count, size_t length, const void *ivs,
+                                     void *dst, const void *src)
+    {
+        DebugAssert(length % kAESBlockSize == 0);
+        auto iv = (const uint8_t*)ivs;
+        auto out = (uint8_t*)dst;
+        auto in = (const uint8_t*)src;
+#if LITECORE_AESNI
+        if (_impl->aesni && _encrypt) {
+            while (count > 0) {
+                unsigned n = std::min(count, kMaxInterleave);
+                aesniEncryptCBC(_impl->roundKeys, n, iv, out, in, length);
+                count -= n;
+                iv += n * kAESIVSize;
+                out += n * length;
+                in += n * length;
+            }
+            return;
+        }
+#endif
+        for (unsigned i = 0; i < count; ++i)
+            cryptBlocks(iv + i * kAESIVSize, out + i * length, in + i * length, length);
+    }
+
+}
@@ -18,6 +18,7 @@
 
 #pragma once
 #include "Base.hh"
+#include <memory>
 
 namespace litecore {
 
@@ -33,6 +34,39 @@ namespace litecore {
                   slice dst,           // output buffer & capacity
                   slice src);          // input data
 
+    /** A reusable AES256-CBC cipher for one key and direction. Unlike AES256(), it computes the
+        key schedule only once, and it uses the CPU's AES instructions when they're available.
+        Not thread-safe. */
+    class AES256Cipher {
+    public:
+        AES256Cipher(bool encrypt, slice key);
+        ~AES256Cipher();
+
+        /** Encrypts or decrypts one message, like AES256(), and returns the output size. */
+        size_t crypt(slice iv, bool padding, slice dst, slice src);
+
+        /** Encrypts or decrypts `count` independent messages of `length` bytes each, without
+            padding; `length` must be a multiple of kAESBlockSize. Message `i` is at offset
+            `i*length` in both `src` and `dst` (which may be the same), and its IV is at offset
+            `i*kAESIVSize` in `ivs`. With AES instructions, up to kMaxInterleave messages are
+            processed at once, interleaved, which is several times faster than one at a time. */
+        void cryptMessages(unsigned count, size_t length, const void *ivs,
+                           void *dst, const void *src);
+
+        static constexpr unsigned kMaxInterleave = 8;
+
+        /** True if AES instructions are being used. */
+        bool hardwareAccelerated() const;
+
+    private:
+        struct Impl;
+        void cryptBlocks(const uint8_t *iv, uint8_t *dst, const uint8_t *src, size_t length);
+
+        bool const _encrypt;
+        std::unique_ptr<Impl> _impl;
+    };
+
+
     /** Converts a password string into a key using PBKDF2. */
     bool DeriveKeyFromPassword(slice password,
                                void *outKey,
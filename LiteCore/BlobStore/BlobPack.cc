@@ -0,0 +1,552 @@
+//
+// BlobPack.cc
+//
+// Copyright © 2019 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "BlobPack.hh"
+#include "Error.hh"
+#include "Logging.hh"
+#include "PlatformIO.hh"
+#include "StringUtil.hh"
+#include <algorithm>
+#include <set>
+#include <errno.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+namespace litecore {
+    using namespace std;
+    using namespace fleece;
+
+    extern LogDomain BlobLog;
+
+
+    // A segment file is a sequence of records, each a RecordHeader followed by the stored data
+    // of a blob (which is encrypted if the BlobStore is.)
+    struct RecordHeader {
+        uint8_t digest[20];     // blobKey
+        uint8_t size[4];        // Size of the data, big-endian
+        uint8_t flags;          // kLiveRecord or kDeletedRecord
+        uint8_t magic[3];       // kRecordMagic
+    };
+    static_assert(sizeof(RecordHeader) == 28, "RecordHeader is padded");
+
+    static constexpr size_t kFlagsOffset = offsetof(RecordHeader, flags);
+    static constexpr uint8_t kLiveRecord = 0, kDeletedRecord = 1;
+    static constexpr uint8_t kRecordMagic[3] = {'B', 'P', 'k'};
+
+    static constexpr const char* kSegmentExtension = ".blobpack";
+
+
+    static RecordHeader makeHeader(const blobKey &key, uint32_t size) {
+        RecordHeader header;
+        memcpy(header.digest, slice(key).buf, sizeof(header.digest));
+        header.size[0] = uint8_t(size >> 24);
+        header.size[1] = uint8_t(size >> 16);
+        header.size[2] = uint8_t(size >> 8);
+        header.size[3] = uint8_t(size);
+        header.flags = kLiveRecord;
+        memcpy(header.magic, kRecordMagic, sizeof(header.magic));
+        return header;
+    }
+
+
+    static uint32_t headerSize(const RecordHeader &header) {
+        return (uint32_t(header.size[0]) << 24) | (uint32_t(header.size[1]) << 16)
+             | (uint32_t(header.size[2]) << 8)  |  uint32_t(header.size[3]);
+    }
+
+
+    static uint64_t recordSize(uint32_t dataSize) {
+        return sizeof(RecordHeader) + dataSize;
+    }
+
+
+    static void checkErr(FILE *file) {
+        int err = ferror(file);
+        if (_usuallyFalse(err != 0))
+            error::_throw(error::POSIX, err);
+    }
+
+
+    // Flushes a file's data to the disk.
+    static void syncFile(FILE *file) {
+        fflush(file);
+        checkErr(file);
+#ifdef _MSC_VER
+        int result = _commit(_fileno(file));
+#else
+        int result = fsync(fileno(file));
+#endif
+        if (result != 0)
+            error::_throwErrno();
+    }
+
+
+    size_t BlobPack::blobKeyHash::operator() (const blobKey &key) const {
+        size_t h;       // (the key is a SHA-1 digest, so any bytes of it are a good hash)
+        memcpy(&h, slice(key).buf, sizeof(h));
+        return h;
+    }
+
+
+#pragma mark - LIFECYCLE:
+
+
+    shared_ptr<BlobPack> BlobPack::forDirectory(const FilePath &dir) {
+        static mutex sMutex;
+        static unordered_map<string, weak_ptr<BlobPack>> sPacks;
+        lock_guard<mutex> lock(sMutex);
+        auto &entry = sPacks[dir.path()];
+        auto pack = entry.lock();
+        if (!pack) {
+            pack.reset(new BlobPack(dir));
+            entry = pack;
+        }
+        return pack;
+    }
+
+
+    BlobPack::BlobPack(const FilePath &dir)
+    :_dir(dir)
+    { }
+
+
+    BlobPack::~BlobPack() {
+        closeFiles();
+    }
+
+
+    /*static*/ bool BlobPack::isSegmentFile(const FilePath &path) {
+        return hasSuffix(path.fileName(), kSegmentExtension);
+    }
+
+
+    FilePath BlobPack::segmentPath(unsigned number) const {
+        return _dir[format("%06u%s", number, kSegmentExtension)];
+    }
+
+
+    FILE* BlobPack::segmentFile(Segment &seg) {
+        if (!seg.file) {
+            seg.file = fopen_u8(segmentPath(seg.number).path().c_str(), "rb");
+            if (!seg.file)
+                error::_throwErrno();
+        }
+        return seg.file;
+    }
+
+
+    void BlobPack::close() {
+        lock_guard<mutex> lock(_mutex);
+        closeFiles();
+        _segments.clear();
+        _index.clear();
+        _loaded = false;
+    }
+
+
+    void BlobPack::closeFiles() {
+        if (_appendFile) {
+            fclose(_appendFile);
+            _appendFile = nullptr;
+        }
+        for (auto &seg : _segments) {
+            if (seg.file) {
+                fclose(seg.file);
+                seg.file = nullptr;
+            }
+        }
+    }
+
+
+#pragma mark - INDEXING:
+
+
+    // Builds the index by scanning all segment files, truncating any incomplete records.
+    void BlobPack::load() {
+        if (_loaded)
+            return;
+        vector<unsigned> numbers;
+        _dir.forEachFile([&](const FilePath &path) {
+            if (isSegmentFile(path))
+                numbers.push_back((unsigned)strtoul(path.fileName().c_str(), nullptr, 10));
+        });
+        sort(numbers.begin(), numbers.end());
+        for (auto number : numbers) {
+            _segments.push_back({number});
+            scan(unsigned(_segments.size() - 1), true);
+        }
+        _loaded = true;
+        if (!_index.empty())
+            LogVerbose(BlobLog, "BlobPack: %zu blobs in %zu segments of %s",
+                       _index.size(), _segments.size(), _dir.path().c_str());
+    }
+
+
+    // Picks up records appended by another process since the pack was loaded.
+    void BlobPack::refresh() {
+        if (!_loaded)
+            return load();
+        if (!_segments.empty()) {
+            auto &last = _segments.back();
+            if (!last.removed && segmentPath(last.number).dataSize() > int64_t(last.scannedTo))
+                scan(unsigned(_segments.size() - 1));
+        }
+        unsigned next = _segments.empty() ? 1 : _segments.back().number + 1;
+        while (segmentPath(next).exists()) {
+            _segments.push_back({next++});
+            scan(unsigned(_segments.size() - 1));
+        }
+    }
+
+
+    // Adds the records of a segment, starting at its `scannedTo` offset, to the index.
+    // If `repair` is true, a record cut short by a crash is truncated from the file.
+    void BlobPack::scan(unsigned segIndex, bool repair) {
+        auto &seg = _segments[segIndex];
+        FILE *file = segmentFile(seg);
+        fseeko(file, 0, SEEK_END);
+        uint64_t fileSize = ftello(file);
+        fseeko(file, seg.scannedTo, SEEK_SET);
+        checkErr(file);
+
+        uint64_t pos = seg.scannedTo;
+        bool torn = false;
+        seg.sealed = false;
+        while (pos < fileSize) {
+            RecordHeader header;
+            bool valid = fread(&header, sizeof(header), 1, file) == 1
+                      && memcmp(header.magic, kRecordMagic, sizeof(kRecordMagic)) == 0;
+            uint32_t size = valid ? headerSize(header) : 0;
+            if (!valid || pos + recordSize(size) > fileSize) {
+                // A record that runs past the end of the file is incomplete; one with a bad
+                // header (and room for a whole header) is corrupt.
+                torn = valid || fileSize - pos < sizeof(header);
+                seg.sealed = true;
+                break;
+            }
+            if (header.flags == kLiveRecord) {
+                blobKey key;
+                key.digest.setDigest(slice(header.digest, sizeof(header.digest)));
+                auto i = _index.find(key);
+                if (i == _index.end()) {
+                    _index.emplace(key, Location{segIndex, pos, size});
+                    seg.liveBytes += recordSize(size);
+                } else if (i->second.segment != segIndex || i->second.offset != pos) {
+                    // Duplicate left by an interrupted compaction; use the later one:
+                    _segments[i->second.segment].liveBytes -= recordSize(i->second.size);
+                    i->second = Location{segIndex, pos, size};
+                    seg.liveBytes += recordSize(size);
+                }
+            }
+            pos += recordSize(size);
+            fseeko(file, pos, SEEK_SET);
+        }
+        checkErr(file);
+        if (seg.sealed) {
+            // Each record is appended with a single write, so one that's incomplete when the pack
+            // is loaded was interrupted by a crash, and can be cut off. Otherwise, don't append
+            // after it, and look at it again next time.
+            if (repair && torn && truncateSegment(seg, pos)) {
+                Warn("BlobPack: truncated incomplete record at offset %llu of %s",
+                     (unsigned long long)pos, segmentPath(seg.number).path().c_str());
+                seg.sealed = false;
+            } else {
+                Warn("BlobPack: %s record at offset %llu of %s",
+                     (torn ? "incomplete" : "invalid"),
+                     (unsigned long long)pos, segmentPath(seg.number).path().c_str());
+            }
+        }
+        if (!seg.sealed)
+            seg.scannedTo = pos;
+        if (pos >= kMaxSegmentSize)
+            seg.sealed = true;
+    }
+
+
+    // Cuts a segment file off at `size`; returns false if it can't be written to.
+    bool BlobPack::truncateSegment(Segment &seg, uint64_t size) {
+        if (seg.file) {
+            fclose(seg.file);
+            seg.file = nullptr;
+        }
+        FILE *file = fopen_u8(segmentPath(seg.number).path().c_str(), "r+b");
+        if (!file)
+            return false;
+#ifdef _MSC_VER
+        bool ok = _chsize_s(_fileno(file), size) == 0;
+#else
+        bool ok = ftruncate(fileno(file), off_t(size)) == 0;
+#endif
+        fclose(file);
+        return ok;
+    }
+
+
+    const BlobPack::Location* BlobPack::find(const blobKey &key, bool refreshIfMissing) {
+        load();
+        auto i = _index.find(key);
+        if (i == _index.end() && refreshIfMissing) {
+            refresh();
+            i = _index.find(key);
+        }
+        return (i != _index.end()) ? &i->second : nullptr;
+    }
+
+
+#pragma mark - READING:
+
+
+    bool BlobPack::has(const blobKey &key) {
+        lock_guard<mutex> lock(_mutex);
+        return find(key, true) != nullptr;
+    }
+
+
+    int64_t BlobPack::dataSize(const blobKey &key) {
+        lock_guard<mutex> lock(_mutex);
+        auto loc = find(key, true);
+        return loc ? loc->size : -1;
+    }
+
+
+    alloc_slice BlobPack::read(const blobKey &key) {
+        lock_guard<mutex> lock(_mutex);
+        auto loc = find(key, true);
+        return loc ? readRecord(key, *loc) : alloc_slice();
+    }
+
+
+    alloc_slice BlobPack::readRecord(const blobKey &key, const Location &loc) {
+        FILE *file = segmentFile(_segments[loc.segment]);
+        fseeko(file, loc.offset, SEEK_SET);
+        RecordHeader header;
+        if (fread(&header, sizeof(header), 1, file) < 1) {
+            checkErr(file);
+            error::_throw(error::CorruptData, "BlobPack: segment is truncated");
+        }
+        // The header is checked in case another process deleted or compacted the record:
+        if (memcmp(header.digest, slice(key).buf, sizeof(header.digest)) != 0
+                || header.flags != kLiveRecord || headerSize(header) != loc.size)
+            return {};
+        alloc_slice data(loc.size);
+        if (fread((void*)data.buf, 1, data.size, file) < data.size) {
+            checkErr(file);
+            error::_throw(error::CorruptData, "BlobPack: segment is truncated");
+        }
+        return data;
+    }
+
+
+    uint64_t BlobPack::count() {
+        lock_guard<mutex> lock(_mutex);
+        load();
+        return _index.size();
+    }
+
+
+    uint64_t BlobPack::totalSize() {
+        lock_guard<mutex> lock(_mutex);
+        load();
+        uint64_t total = 0;
+        for (auto &entry : _index)
+            total += entry.second.size;
+        return total;
+    }
+
+
+    vector<blobKey> BlobPack::keys() {
+        lock_guard<mutex> lock(_mutex);
+        load();
+        vector<blobKey> keys;
+        keys.reserve(_index.size());
+        for (auto &entry : _index)
+            keys.push_back(entry.first);
+        return keys;
+    }
+
+
+#pragma mark - WRITING:
+
+
+    void BlobPack::add(const blobKey &key, slice storedData) {
+        lock_guard<mutex> lock(_mutex);
+        if (!find(key, true))
+            append(key, storedData);
+    }
+
+
+    void BlobPack::append(const blobKey &key, slice storedData) {
+        Assert(storedData.size <= UINT32_MAX);
+        if (_appendFile && _segments[_appendSegment].sealed) {
+            fclose(_appendFile);
+            _appendFile = nullptr;
+        }
+        if (!_appendFile) {
+            // Append to the latest segment, or start a new one if it's full:
+            if (_segments.empty() || _segments.back().sealed || _segments.back().removed) {
+                unsigned number = _segments.empty() ? 1 : _segments.back().number + 1;
+                _segments.push_back({number});
+            }
+            _appendSegment = unsigned(_segments.size() - 1);
+            auto path = segmentPath(_segments[_appendSegment].number);
+            _appendFile = fopen_u8(path.path().c_str(), "ab");
+            if (!_appendFile)
+                error::_throwErrno();
+            setvbuf(_appendFile, nullptr, _IONBF, 0);   // so each record is one write() call
+        }
+
+        // Write the header and data together, in append mode, so records from another process
+        // writing to the same segment can't be interleaved with it:
+        auto header = makeHeader(key, uint32_t(storedData.size));
+        alloc_slice record(recordSize(uint32_t(storedData.size)));
+        memcpy((void*)record.buf, &header, sizeof(header));
+        memcpy((void*)&record[sizeof(header)], storedData.buf, storedData.size);
+        if (fwrite(record.buf, record.size, 1, _appendFile) < 1)
+            checkErr(_appendFile);
+        uint64_t end = ftello(_appendFile);
+        uint64_t offset = end - record.size;
+
+        auto &seg = _segments[_appendSegment];
+        _index[key] = Location{_appendSegment, offset, uint32_t(storedData.size)};
+        seg.liveBytes += record.size;
+        if (offset == seg.scannedTo)
+            seg.scannedTo = end;
+        if (end >= kMaxSegmentSize)
+            seg.sealed = true;
+    }
+
+
+    bool BlobPack::del(const blobKey &key) {
+        lock_guard<mutex> lock(_mutex);
+        auto loc = find(key, true);
+        if (!loc)
+            return false;
+        markDeleted(key, *loc);
+        return true;
+    }
+
+
+    // Marks a record as deleted in its segment file, and removes it from the index.
+    void BlobPack::markDeleted(const blobKey &key, const Location &loc) {
+        auto &seg = _segments[loc.segment];
+        auto path = segmentPath(seg.number);
+        FILE *file = fopen_u8(path.path().c_str(), "r+b");
+        if (!file)
+            error::_throwErrno();
+        fseeko(file, loc.offset + kFlagsOffset, SEEK_SET);
+        fputc(kDeletedRecord, file);
+        int err = ferror(file);
+        fclose(file);
+        if (err)
+            error::_throw(error::POSIX, err);
+        seg.liveBytes -= recordSize(loc.size);
+        _index.erase(key);
+    }
+
+
+    void BlobPack::deleteAllExcept(const unordered_set<string> &inUse) {
+        lock_guard<mutex> lock(_mutex);
+        load();
+        vector<blobKey> unused;
+        for (auto &entry : _index) {
+            if (inUse.find(entry.first.filename()) == inUse.end())
+                unused.push_back(entry.first);
+        }
+        for (auto &key : unused)
+            markDeleted(key, _index[key]);
+        if (!unused.empty())
+            LogTo(BlobLog, "BlobPack: deleted %zu unused blobs", unused.size());
+    }
+
+
+    double BlobPack::deadFraction() {
+        lock_guard<mutex> lock(_mutex);
+        load();
+        uint64_t total = 0, live = 0;
+        for (auto &seg : _segments) {
+            if (!seg.removed) {
+                total += seg.scannedTo;
+                live += seg.liveBytes;
+            }
+        }
+        return total ? double(total - live) / total : 0.0;
+    }
+
+
+    void BlobPack::compact() {
+        lock_guard<mutex> lock(_mutex);
+        load();
+        for (unsigned segIndex = 0; segIndex < _segments.size(); ++segIndex) {
+            auto &seg = _segments[segIndex];
+            if (seg.removed || seg.scannedTo == 0
+                    || double(seg.scannedTo - seg.liveBytes) < kCompactionThreshold * seg.scannedTo)
+                continue;
+            // Copy the live records to the latest segment (never this one), then delete this:
+            seg.sealed = true;
+            vector<pair<blobKey,Location>> live;
+            for (auto &entry : _index) {
+                if (entry.second.segment == segIndex)
+                    live.push_back(entry);
+            }
+            set<unsigned> written;
+            for (auto &entry : live) {
+                alloc_slice data = readRecord(entry.first, entry.second);
+                if (data) {
+                    append(entry.first, data);
+                    written.insert(_appendSegment);
+                } else {
+                    _index.erase(entry.first);
+                }
+            }
+            // The copies have to be on disk before the original is deleted:
+            for (unsigned i : written)
+                syncSegment(i);
+            LogTo(BlobLog, "BlobPack: compacted segment %u, moving %zu blobs",
+                  _segments[segIndex].number, live.size());
+            auto &compacted = _segments[segIndex];     // (`seg` may have moved)
+            if (compacted.file) {
+                fclose(compacted.file);
+                compacted.file = nullptr;
+            }
+            if (_appendFile && _appendSegment == segIndex) {
+                fclose(_appendFile);
+                _appendFile = nullptr;
+            }
+            segmentPath(compacted.number).del();
+            compacted.removed = true;
+            compacted.liveBytes = compacted.scannedTo = 0;
+        }
+    }
+
+
+    void BlobPack::syncSegment(unsigned segIndex) {
+        if (_appendFile && _appendSegment == segIndex)
+            return syncFile(_appendFile);
+        FILE *file = fopen_u8(segmentPath(_segments[segIndex].number).path().c_str(), "r+b");
+        if (!file)
+            error::_throwErrno();
+        try {
+            syncFile(file);
+        } catch (...) {
+            fclose(file);
+            throw;
+        }
+        fclose(file);
+    }
+
+}
@@ -0,0 +1,126 @@
+//
+// BlobPack.hh
+//
+// Copyright © 2019 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "BlobStore.hh"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace litecore {
+
+    /** Stores small blobs of a BlobStore by appending them to shared "segment" files in its
+        directory, instead of creating a file per blob.
+        Each record in a segment describes itself, so the index of blobs is rebuilt by scanning
+        the segments when the pack is first used. Deleting a blob just marks its record as
+        deleted; `compact` rewrites segments that are mostly deleted records.
+        There's one instance per directory in a process; use `forDirectory` to get it.
+        This class is thread-safe. */
+    class BlobPack {
+    public:
+        static std::shared_ptr<BlobPack> forDirectory(const FilePath &dir);
+
+        ~BlobPack();
+
+        /** Returns true if the file is a segment file of a BlobPack. */
+        static bool isSegmentFile(const FilePath&);
+
+        bool has(const blobKey&);
+
+        /** Returns the size of the blob's stored data, or -1 if it's not in the pack. */
+        int64_t dataSize(const blobKey&);
+
+        /** Returns the blob's stored data, or a null slice if it's not in the pack. */
+        alloc_slice read(const blobKey&);
+
+        /** Adds a blob to the pack, unless it's already present. */
+        void add(const blobKey&, slice storedData);
+
+        /** Deletes a blob; returns false if it wasn't in the pack. */
+        bool del(const blobKey&);
+
+        uint64_t count();
+        uint64_t totalSize();
+        std::vector<blobKey> keys();
+
+        /** Deletes all blobs whose filenames (as in blobKey::filename) aren't in the set. */
+        void deleteAllExcept(const std::unordered_set<std::string> &inUse);
+
+        /** The fraction of the segments' space taken up by deleted records. */
+        double deadFraction();
+
+        /** Rewrites segments in which deleted records take up at least kCompactionThreshold of
+            their space. Copied records are synced to disk before a segment is deleted. */
+        void compact();
+
+        /** Closes all files and forgets the index; it'll be rebuilt next time it's needed.
+            Must be called before the directory is moved or deleted. */
+        void close();
+
+        static constexpr uint64_t kMaxSegmentSize = 16 * 1024 * 1024;
+
+        /** Fraction of dead space at which compaction is worthwhile. */
+        static constexpr double kCompactionThreshold = 0.5;
+
+    private:
+        struct blobKeyHash {
+            size_t operator() (const blobKey&) const;
+        };
+
+        struct Location {
+            unsigned segment;       // Index in _segments
+            uint64_t offset;        // Offset of the record header in the segment file
+            uint32_t size;          // Size of the data following the header
+        };
+
+        struct Segment {
+            unsigned number;
+            FILE* file {nullptr};
+            uint64_t scannedTo {0};
+            uint64_t liveBytes {0};
+            bool sealed {false};    // No more records may be appended
+            bool removed {false};   // File has been deleted by compaction
+        };
+
+        explicit BlobPack(const FilePath &dir);
+        FilePath segmentPath(unsigned number) const;
+        FILE* segmentFile(Segment&);
+        void load();
+        void refresh();
+        void scan(unsigned segIndex, bool repair =false);
+        bool truncateSegment(Segment&, uint64_t size);
+        const Location* find(const blobKey&, bool refreshIfMissing);
+        alloc_slice readRecord(const blobKey&, const Location&);
+        void append(const blobKey&, slice storedData);
+        void markDeleted(const blobKey&, const Location&);
+        void syncSegment(unsigned segIndex);
+        void closeFiles();
+
+        FilePath const _dir;
+        std::mutex _mutex;
+        bool _loaded {false};
+        std::vector<Segment> _segments;
+        std::unordered_map<blobKey, Location, blobKeyHash> _index;
+        FILE* _appendFile {nullptr};
+        unsigned _appendSegment {0};    // Index in _segments of segment being appended to
+    };
+
+}
@@ -17,13 +17,18 @@
 //.
 
 #include "BlobStore.hh"
+#include "BlobPack.hh"
+#include "ChunkedBlob.hh"
+#include "AsyncWriteStream.hh"
 #include "FilePath.hh"
+#include "Instrumentation.hh"
 #include "Error.hh"
 #include "EncryptedStream.hh"
 #include "Logging.hh"
 #include "StringUtil.hh"
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <algorithm>
 
 namespace litecore {
@@ -95,6 +100,22 @@ namespace litecore {
     }
 
 
+    // The list of chunks of a chunked blob is stored in a file named like the blob's own file,
+    // but with a ".chunks" extension.
+    static string chunkListFilename(const blobKey &key) {
+        string filename = key.filename();
+        filename.resize(filename.size() - 5);
+        return filename + ".chunks";
+    }
+
+    static bool readChunkListFilename(string filename, blobKey &key) {
+        if (!hasSuffix(filename, ".chunks"))
+            return false;
+        filename.resize(filename.size() - 7);
+        return key.readFromFilename(filename + ".blob");
+    }
+
+
 #pragma mark - BLOB READING:
     
     
@@ -105,51 +126,234 @@ namespace litecore {
     { }
 
 
+    FilePath Blob::chunkListPath() const {
+        return _store.dir()[chunkListFilename(_key)];
+    }
+
+
+    bool Blob::exists() const {
+        return _store.pack().has(_key) || _path.exists() || chunkListPath().exists();
+    }
+
+
     int64_t Blob::contentLength() const {
-        int64_t length = path().dataSize();
-        if (length >= 0 && _store.options().encryptionAlgorithm != kNoEncryption)
-            length -= EncryptedReadStream::kFileSizeOverhead;
-        return length;
+        int64_t length = _store.pack().dataSize(_key);
+        if (length < 0)
+            length = path().dataSize();
+        if (length >= 0) {
+            if (_store.options().encryptionAlgorithm != kNoEncryption)
+                length -= EncryptedReadStream::kFileSizeOverhead;
+            return length;
+        }
+        BlobChunkList chunks;
+        if (readChunkList(chunks))
+            return chunks.totalLength();
+        return -1;
+    }
+
+
+    alloc_slice Blob::chunkListJSON() const {
+        FilePath path = chunkListPath();
+        if (!path.exists())
+            return nullslice;
+        return _store.decrypting(new FileReadStream(path))->readAll();
     }
 
 
+    bool Blob::readChunkList(BlobChunkList &chunks) const {
+        alloc_slice json = chunkListJSON();
+        if (!json)
+            return false;
+        chunks = BlobChunkList(json);
+        return true;
+    }
+
 
     unique_ptr<SeekableReadStream> Blob::read() const {
-        SeekableReadStream *reader = new FileReadStream(_path);
-        auto &options = _store.options();
-        if (options.encryptionAlgorithm != kNoEncryption) {
-            reader = new EncryptedReadStream(shared_ptr<SeekableReadStream>(reader),
-                                             options.encryptionAlgorithm,
-                                             options.encryptionKey);
-        }
-        return unique_ptr<SeekableReadStream>{reader};
+        if (alloc_slice packed = _store.pack().read(_key); packed)
+            return _store.decrypting(new MemoryReadStream(packed));
+        BlobChunkList chunks;
+        if (!_path.exists() && readChunkList(chunks))
+            return make_unique<ChunkedReadStream>(_store, move(chunks));
+        return _store.decrypting(new FileReadStream(_path));
+    }
+
+
+    void Blob::del() {
+        _store.pack().del(_key);
+        _path.del();
+        chunkListPath().del();
     }
 
 
 #pragma mark - BLOB WRITING:
 
 
+    // The output of a BlobWriteStream in a store that packs small blobs. It keeps the data in
+    // memory, until there's too much of it to pack; then it moves it to a temporary file.
+    class PackableWriteStream : public WriteStream {
+    public:
+        PackableWriteStream(BlobWriteStream &owner)
+        :_owner(owner)
+        { }
+
+        void write(slice data) override {
+            if (!_file) {
+                if (_buffer.size() + data.size <= _owner._store.options().packThreshold) {
+                    _buffer.append((const char*)data.buf, data.size);
+                    return;
+                }
+                _file = _owner.createTempFile();
+                _file->write(slice(_buffer));
+                _buffer.clear();
+            }
+            _file->write(data);
+        }
+
+        void close() override {
+            if (_file)
+                _file->close();
+        }
+
+        /** True if the data is still in memory; then `data` returns it. */
+        bool packable() const                   {return !_file;}
+        slice data() const                      {return slice(_buffer);}
+
+    private:
+        BlobWriteStream &_owner;
+        string _buffer;
+        shared_ptr<FileWriteStream> _file;
+    };
+
+
+    // Writes to an anonymous temporary file. Closing it only flushes it, since closing the
+    // file would delete it; the BlobWriteStream closes it after installing it.
+    class AnonymousFileWriteStream : public FileWriteStream {
+    public:
+        explicit AnonymousFileWriteStream(FILE *file)   :FileReadStream(file), FileWriteStream(file) { }
+
+        void close() override {
+            if (_file && fflush(_file) != 0)
+                error::_throwErrno();
+        }
+    };
+
+
+    // Feeds the data written to it into a SHA-1 digest.
+    class DigestWriteStream : public WriteStream {
+    public:
+        explicit DigestWriteStream(SHA1Builder &sha1)   :_sha1(sha1) { }
+        void write(slice data) override                 {_sha1 << data;}
+        void close() override                           { }
+    private:
+        SHA1Builder &_sha1;
+    };
+
+
+    // The stream writes through a pipeline of up to three stages: hashing, and encryption (if
+    // the store is encrypted) followed by file I/O. Each stage is an AsyncWriteStream, which
+    // runs synchronously until the blob reaches kPipelineThreshold; then they all go async.
     BlobWriteStream::BlobWriteStream(BlobStore &store)
     :_store(store)
     {
-        FILE *file;
-        _tmpPath = store.dir()["incoming_"].mkTempFile(&file);
-        _writer = shared_ptr<WriteStream> {new FileWriteStream(file)};
         auto &options = _store.options();
+        shared_ptr<WriteStream> output;
+        if (options.packThreshold > 0) {
+            _packable = make_shared<PackableWriteStream>(*this);
+            output = _packable;
+        } else {
+            output = createTempFile();
+        }
+        _writer = _ioStage = make_shared<AsyncWriteStream>(output);
         if (options.encryptionAlgorithm != kNoEncryption) {
-            _writer = make_shared<EncryptedWriteStream>(_writer,
-                                                        options.encryptionAlgorithm,
-                                                        options.encryptionKey);
+            auto encrypter = make_shared<EncryptedWriteStream>(_ioStage,
+                                                               options.encryptionAlgorithm,
+                                                               options.encryptionKey);
+            _writer = _cryptStage = make_shared<AsyncWriteStream>(encrypter);
         }
+        _hashStage = make_shared<AsyncWriteStream>(make_shared<DigestWriteStream>(_sha1ctx));
     }
 
 
     BlobWriteStream::~BlobWriteStream() {
-        if (!_installed) {
+        // Stop the pipeline's threads before touching the file:
+        _hashStage = nullptr;
+        _writer = _cryptStage = nullptr;
+        _ioStage = nullptr;
+        _packable = nullptr;
+        if (!_installed)
+            deleteTempFile();
+    }
+
+
+    // Creates the temporary file that the data is written to. Where possible this is an
+    // anonymous file, which gets a name only when it's installed and otherwise goes away by
+    // itself; else it's an "incoming_" file in the store's directory.
+    shared_ptr<FileWriteStream> BlobWriteStream::createTempFile() {
+        FILE *file;
+        _tmpPath = _store.dir().mkAnonymousTempFile(&file);
+        if (!_tmpPath.isDir()) {
+            _anonFile = make_shared<AnonymousFileWriteStream>(file);
+            return _anonFile;
+        } else {
+            _tmpPath = _store.dir()["incoming_"].mkTempFile(&file);
+            return make_shared<FileWriteStream>(file);
+        }
+    }
+
+
+    void BlobWriteStream::installTempFile(const Blob &blob) {
+        if (_anonFile) {
+            try {
+                _tmpPath.setReadOnly(true);
+                if (!_tmpPath.linkTo(blob.path())) {
+                    // Another writer installed the same blob meanwhile
+                    deleteTempFile();
+                }
+                return;
+            } catch (const error &x) {
+                // Linking a "/proc/self/fd" path can fail, e.g. in some sandboxes:
+                Warn("BlobWriteStream: unable to link anonymous temporary file (%s)", x.what());
+                copyToNamedTempFile();
+            }
+        }
+        _tmpPath.setReadOnly(true);
+        if (!_tmpPath.moveToIfAbsent(blob.path())) {
+            // Another writer installed the same blob meanwhile
+            deleteTempFile();
+        }
+    }
+
+
+    // Replaces the anonymous temporary file with an "incoming_" file holding the same data.
+    void BlobWriteStream::copyToNamedTempFile() {
+        FILE *file;
+        FilePath named = _store.dir()["incoming_"].mkTempFile(&file);
+        try {
+            FileWriteStream out(file);
+            _anonFile->seek(0);
+            char buffer[32768];
+            size_t bytesRead;
+            while ((bytesRead = _anonFile->read(buffer, sizeof(buffer))) > 0)
+                out.write(slice(buffer, bytesRead));
+            out.close();
+        } catch (...) {
+            named.del();
+            throw;
+        }
+        _anonFile.reset();
+        _tmpPath = named;
+    }
+
+
+    void BlobWriteStream::deleteTempFile() {
+        if (_anonFile) {
+            _anonFile.reset();      // Closing an anonymous file deletes it
+        } else if (!_tmpPath.isDir()) {     // (_tmpPath is unset if data was in memory)
             try {
                 _tmpPath.del();
             } catch (...) {
-                // destructor is not allowed to throw exceptions
+                // this is called by the destructor, which is not allowed to throw exceptions
                 Warn("BlobWriteStream: unable to delete temporary file %s",
                      _tmpPath.path().c_str());
             }
@@ -159,9 +363,15 @@ namespace litecore {
 
     void BlobWriteStream::write(slice data) {
         Assert(!_computedKey, "Attempted to write after computing digest");
+        _hashStage->write(data);
         _writer->write(data);
         _bytesWritten += data.size;
-        _sha1ctx << data;
+        if (_bytesWritten >= kPipelineThreshold && !_ioStage->isAsync()) {
+            _hashStage->goAsync();
+            if (_cryptStage)
+                _cryptStage->goAsync();
+            _ioStage->goAsync();
+        }
     }
 
     void BlobWriteStream::close() {
@@ -171,8 +381,9 @@ namespace litecore {
         }
     }
 
-    blobKey BlobWriteStream::computeKey() noexcept {
+    blobKey BlobWriteStream::computeKey() {
         if (!_computedKey) {
+            _hashStage->close();
             _key.digest = _sha1ctx.finish();
             _computedKey = true;
         }
@@ -181,35 +392,94 @@ namespace litecore {
 
 
     Blob BlobWriteStream::install(const blobKey *expectedKey) {
+        Signpost signpost(Signpost::blobInstall, uintptr_t(this), _bytesWritten);
         close();
         auto key = computeKey();
         if (expectedKey && *expectedKey != key)
             error::_throw(error::CorruptData);
         Blob blob(_store, key);
-        if(!blob.path().exists()) {
-            _tmpPath.setReadOnly(true);
-            _tmpPath.moveTo(blob.path());
+        size_t chunkThreshold = _store.options().chunkThreshold;
+        if (_packable && _packable->packable()) {
+            if (!blob.exists())
+                _store.pack().add(key, _packable->data());
+        } else if (!blob.exists() && (chunkThreshold == 0 || _bytesWritten < chunkThreshold)) {
+            installTempFile(blob);
         } else {
+            if (!blob.exists())
+                installChunked(blob);
             // If the destination already exists, then this blob
             // already exists and doesn't need to be written again
-            if(!_tmpPath.del()) {
-                string tmpPath = _tmpPath.path();
-                Warn("Unable to delete temporary blob %s", tmpPath.c_str());
-            }
+            deleteTempFile();
         }
 
         _installed = true;
         return blob;
     }
+
+
+    // Splits the data in the temporary file into chunks, adds each chunk to the store as a blob
+    // of its own, and writes the list of chunks in place of the blob's file.
+    void BlobWriteStream::installChunked(const Blob &blob) {
+        auto in = _store.decrypting(new FileReadStream(_tmpPath));
+        BlobChunkList chunks;
+        vector<uint8_t> buffer(2 * BlobChunker::kMaxChunkSize);
+        size_t available = 0;
+        bool eof = false;
+        while (true) {
+            while (!eof && available < buffer.size()) {
+                size_t bytesRead = in->read(&buffer[available], buffer.size() - available);
+                eof = (bytesRead == 0);
+                available += bytesRead;
+            }
+            if (available == 0)
+                break;
+            size_t length = BlobChunker::nextChunkLength(slice(buffer.data(), available));
+            Blob chunk = _store.put(slice(buffer.data(), length));
+            chunks.add(chunk.key(), length);
+            memmove(&buffer[0], &buffer[length], available - length);
+            available -= length;
+        }
+        in->close();
+        LogVerbose(BlobLog, "Stored blob %s as %zu chunks",
+                   blob.key().base64String().c_str(), chunks.chunks().size());
+        _store.writeChunkList(blob, chunks);
+    }
     
 #pragma mark - DELETING:
     
     void BlobStore::deleteAllExcept(const unordered_set<string> &inUse) {
-        _dir.forEachFile([&inUse](const FilePath &path) {
-            if(find(inUse.cbegin(), inUse.cend(), path.fileName()) == inUse.cend()) {
+        // The chunks of a chunked blob that's in use are in use too:
+        unordered_set<string> used = inUse;
+        _dir.forEachFile([&](const FilePath &path) {
+            blobKey key;
+            BlobChunkList chunks;
+            if (readChunkListFilename(path.fileName(), key) && inUse.count(key.filename()) > 0
+                    && get(key).readChunkList(chunks)) {
+                for (auto &chunk : chunks.chunks())
+                    used.insert(chunk.key.filename());
+            }
+        });
+
+        _dir.forEachFile([&](const FilePath &path) {
+            if (BlobPack::isSegmentFile(path))
+                return;
+            string filename = path.fileName();
+            blobKey key;
+            if (readChunkListFilename(filename, key))
+                filename = key.filename();
+            if (used.find(filename) == used.end()) {
                 path.del();
             }
         });
+        _pack->deleteAllExcept(used);
+        if (_pack->deadFraction() >= BlobPack::kCompactionThreshold)
+            _pack->compact();
+    }
+
+
+    void BlobStore::deleteStore() {
+        _pack->close();
+        _dir.delRecursive();
     }
 
 
@@ -221,8 +491,12 @@ namespace litecore {
 
     BlobStore::BlobStore(const FilePath &dir, const Options *options)
     :_dir(dir),
-     _options(options ? *options : Options::defaults)
+     _options(options ? *options : Options::defaults),
+     _pack(BlobPack::forDirectory(dir))
     {
+        // Chunks must be below the threshold, or they'd be chunked themselves:
+        if (_options.chunkThreshold > 0)
+            _options.chunkThreshold = max(_options.chunkThreshold, BlobChunker::kMaxChunkSize + 1);
         if (_dir.exists()) {
             _dir.mustExistAsDir();
         } else {
@@ -233,6 +507,42 @@ namespace litecore {
     }
 
 
+    BlobPack& BlobStore::pack() const {
+        return *_pack;
+    }
+
+
+    // Takes ownership of a stream reading stored data, and returns a stream of the content.
+    unique_ptr<SeekableReadStream> BlobStore::decrypting(SeekableReadStream *reader) const {
+        if (_options.encryptionAlgorithm != kNoEncryption) {
+            reader = new EncryptedReadStream(shared_ptr<SeekableReadStream>(reader),
+                                             _options.encryptionAlgorithm,
+                                             _options.encryptionKey);
+        }
+        return unique_ptr<SeekableReadStream>{reader};
+    }
+
+
+    uint64_t BlobStore::count() const {
+        uint64_t n = 0;
+        _dir.forEachFile([&](const FilePath &path) {
+            if (hasSuffix(path.fileName(), ".blob") || hasSuffix(path.fileName(), ".chunks"))
+                ++n;
+        });
+        return n + _pack->count();
+    }
+
+
+    uint64_t BlobStore::totalSize() const {
+        uint64_t size = 0;
+        _dir.forEachFile([&](const FilePath &path) {
+            if (hasSuffix(path.fileName(), ".blob") || hasSuffix(path.fileName(), ".chunks"))
+                size += path.dataSize();
+        });
+        return size + _pack->totalSize();
+    }
+
+
     Blob BlobStore::put(slice data, const blobKey *expectedKey) {
         BlobWriteStream stream(*this);
         stream.write(data);
@@ -240,25 +550,103 @@ namespace litecore {
     }
 
 
-    void BlobStore::copyBlobsTo(BlobStore &toStore) {
-        _dir.forEachFile([&](const FilePath &path) {
-            blobKey key;
-            if (!key.readFromFilename(path.fileName()))
-                return;
-            Blob srcBlob(*this, key);
-            auto src = srcBlob.read();
-            BlobWriteStream dst(toStore);
-            uint8_t buffer[4096];
+    Blob BlobStore::putChunked(slice chunkListJSON, const blobKey *expectedKey) {
+        BlobChunkList chunks(chunkListJSON);
+
+        // Read the chunks, to check them and to compute the key of the whole blob; or to copy
+        // them into a regular blob, if this store doesn't store blobs as chunks:
+        bool storeChunks = (_options.chunkThreshold > 0);
+        unique_ptr<BlobWriteStream> out;
+        if (!storeChunks)
+            out = make_unique<BlobWriteStream>(*this);
+        SHA1Builder sha1;
+        vector<uint8_t> buffer(64 * 1024);
+        for (auto &chunk : chunks.chunks()) {
+            Blob chunkBlob = get(chunk.key);
+            if (!chunkBlob.exists())
+                error::_throw(error::NotFound, "Blob chunk %s is missing",
+                              chunk.key.base64String().c_str());
+            auto in = chunkBlob.read();
+            uint64_t length = 0;
             size_t bytesRead;
-            while ((bytesRead = src->read(buffer, sizeof(buffer))) > 0) {
-                dst.write(slice(buffer, bytesRead));
+            while ((bytesRead = in->read(buffer.data(), buffer.size())) > 0) {
+                slice data(buffer.data(), bytesRead);
+                if (out)
+                    out->write(data);
+                else
+                    sha1 << data;
+                length += bytesRead;
             }
-            dst.install(&key);
+            if (length != chunk.length)
+                error::_throw(error::CorruptData, "Blob chunk %s has the wrong length",
+                              chunk.key.base64String().c_str());
+        }
+        if (out)
+            return out->install(expectedKey);
+
+        blobKey key;
+        key.digest = sha1.finish();
+        if (expectedKey && *expectedKey != key)
+            error::_throw(error::CorruptData);
+        Blob blob(*this, key);
+        if (!blob.exists())
+            writeChunkList(blob, chunks);
+        return blob;
+    }
+
+
+    void BlobStore::writeChunkList(const Blob &blob, const BlobChunkList &chunks) {
+        FILE *file;
+        FilePath tmpPath = _dir["incoming_"].mkTempFile(&file);
+        shared_ptr<WriteStream> out {new FileWriteStream(file)};
+        if (_options.encryptionAlgorithm != kNoEncryption) {
+            out = make_shared<EncryptedWriteStream>(out,
+                                                    _options.encryptionAlgorithm,
+                                                    _options.encryptionKey);
+        }
+        out->write(chunks.toJSON());
+        out->close();
+        tmpPath.setReadOnly(true);
+        tmpPath.moveTo(blob.chunkListPath());
+    }
+
+
+    vector<blobKey> BlobStore::keys() const {
+        vector<blobKey> keys;
+        _dir.forEachFile([&](const FilePath &path) {
+            blobKey key;
+            if (key.readFromFilename(path.fileName())
+                    || readChunkListFilename(path.fileName(), key))
+                keys.push_back(key);
         });
+        for (auto &key : _pack->keys())
+            keys.push_back(key);
+        return keys;
+    }
+
+
+    void BlobStore::copyBlobTo(const blobKey &key, BlobStore &toStore) const {
+        Blob srcBlob(*this, key);
+        auto src = srcBlob.read();
+        BlobWriteStream dst(toStore);
+        uint8_t buffer[4096];
+        size_t bytesRead;
+        while ((bytesRead = src->read(buffer, sizeof(buffer))) > 0) {
+            dst.write(slice(buffer, bytesRead));
+        }
+        dst.install(&key);
+    }
+
+
+    void BlobStore::copyBlobsTo(BlobStore &toStore) {
+        for (auto &key : keys())
+            copyBlobTo(key, toStore);
     }
 
 
     void BlobStore::moveTo(BlobStore &toStore) {
+        _pack->close();
+        toStore._pack->close();
         _dir.moveToReplacingDir(toStore.dir(), true);
         toStore._options = _options;
     }
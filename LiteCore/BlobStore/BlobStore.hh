@@ -22,10 +22,15 @@
 #include "Stream.hh"
 #include "SecureDigest.hh"
 #include <unordered_set>
+#include <vector>
 
 namespace litecore {
+    class BlobChunkList;
+    class BlobPack;
     class BlobStore;
     class FilePath;
+    class PackableWriteStream;
+    class AsyncWriteStream;
 
 
     /** A raw SHA-1 digest used as the unique identifier of a blob. */
@@ -58,9 +63,14 @@ namespace litecore {
     /** Represents a blob stored in a BlobStore. This class is thread-safe. */
     class Blob {
     public:
-        bool exists() const             {return _path.exists();}
+        bool exists() const;
 
         blobKey key() const             {return _key;}
+
+        /** The path of the file the blob would be stored in. A small blob may instead be
+            packed together with others (see BlobStore::Options::packThreshold), and a large
+            one stored as chunks (see BlobStore::Options::chunkThreshold), in which case this
+            file doesn't exist. */
         FilePath path() const           {return _path;}
         int64_t contentLength() const;      // An overestimate, if blob is encrypted
 
@@ -68,13 +78,19 @@ namespace litecore {
 
         std::unique_ptr<SeekableReadStream> read() const;
 
-        void del()                      {_path.del();}
+        /** If the blob is stored as chunks, returns the JSON form of its BlobChunkList;
+            else returns a null slice. */
+        alloc_slice chunkListJSON() const;
+
+        void del();
 
     private:
         friend class BlobStore;
         friend class BlobWriteStream;
         
         Blob(const BlobStore&, const blobKey&);
+        FilePath chunkListPath() const;
+        bool readChunkList(BlobChunkList&) const;
 
         const FilePath _path;
         const blobKey _key;
@@ -82,7 +98,9 @@ namespace litecore {
     };
 
 
-    /** A stream for writing a new Blob. */
+    /** A stream for writing a new Blob.
+        Once enough data has been written to make it worthwhile, hashing, encryption and file I/O
+        move to background threads and run in parallel, each with its own bounded buffer. */
     class BlobWriteStream : public WriteStream {
     public:
         BlobWriteStream(BlobStore&);
@@ -95,7 +113,7 @@ namespace litecore {
 
         /** Derives the blobKey from the digest of the file data.
             No more data can be written after this is called. */
-        blobKey computeKey() noexcept;
+        blobKey computeKey();
 
         /** Adds the blob to the store and returns a Blob referring to it.
             No more data can be written after this is called.
@@ -103,12 +121,26 @@ namespace litecore {
             a CorruptData exception is thrown. */
         Blob install(const blobKey *expectedKey =nullptr);
 
+        /** Blobs at least this large are written through the parallel pipeline. */
+        static constexpr uint64_t kPipelineThreshold = 1024 * 1024;
+
     private:
+        friend class PackableWriteStream;
+
+        std::shared_ptr<FileWriteStream> createTempFile();
+        void installTempFile(const Blob&);
+        void copyToNamedTempFile();
+        void deleteTempFile();
+        void installChunked(const Blob&);
+
         BlobStore &_store;
         FilePath _tmpPath;
+        std::shared_ptr<FileWriteStream> _anonFile; // Open anonymous file at _tmpPath, if any
+        SHA1Builder _sha1ctx;
+        std::shared_ptr<PackableWriteStream> _packable;
+        std::shared_ptr<AsyncWriteStream> _ioStage, _cryptStage, _hashStage;
         std::shared_ptr<WriteStream> _writer;
         uint64_t _bytesWritten {0};
-        SHA1Builder _sha1ctx;
         blobKey _key;
         bool _computedKey {false};
         bool _installed {false};
@@ -124,10 +156,18 @@ namespace litecore {
             bool writeable      :1;     ///< If false, opened read-only
             EncryptionAlgorithm encryptionAlgorithm;
             alloc_slice encryptionKey;
-            
+            size_t packThreshold;       ///< Smaller blobs are packed into shared files (0 = none)
+            size_t chunkThreshold;      ///< Larger blobs are stored as chunks (0 = none)
+
             static const Options defaults;
         };
 
+        /** The packThreshold Database uses, if packed blobs are enabled. */
+        static constexpr size_t kDefaultPackThreshold = 16 * 1024;
+
+        /** The chunkThreshold Database uses, if chunked blobs are enabled. */
+        static constexpr size_t kDefaultChunkThreshold = 1024 * 1024;
+
         BlobStore(const FilePath &dir, const Options* =nullptr);
 
         const FilePath& dir() const                 {return _dir;}
@@ -137,7 +177,7 @@ namespace litecore {
         uint64_t count() const;
         uint64_t totalSize() const;
 
-        void deleteStore()                          {_dir.delRecursive();}
+        void deleteStore();
         void deleteAllExcept(const std::unordered_set<std::string>& inUse);
 
         bool has(const blobKey &key) const          {return get(key).exists();}
@@ -147,12 +187,31 @@ namespace litecore {
 
         Blob put(slice data, const blobKey *expectedKey =nullptr);
 
+        /** Adds a blob made of chunks that are already in the store, given the JSON form of
+            its BlobChunkList. Throws NotFound if a chunk is missing, and CorruptData if
+            expectedKey is given but doesn't match the key of the chunks' data.
+            If this store doesn't store blobs as chunks, the chunks are copied into a regular
+            blob (and left to be deleted by the next compaction.) */
+        Blob putChunked(slice chunkListJSON, const blobKey *expectedKey =nullptr);
+
+        /** Returns the keys of all the blobs in the store. */
+        std::vector<blobKey> keys() const;
+
+        void copyBlobTo(const blobKey&, BlobStore &toStore) const;  // Copy a blob into toStore
         void copyBlobsTo(BlobStore &toStore);       // Copy my blobs into toStore
         void moveTo(BlobStore &toStore);            // Replace toStore's dir & options
 
     private:
+        friend class Blob;
+        friend class BlobWriteStream;
+
+        BlobPack& pack() const;
+        std::unique_ptr<SeekableReadStream> decrypting(SeekableReadStream*) const;
+        void writeChunkList(const Blob&, const BlobChunkList&);
+
         FilePath const  _dir;                           // Location
         Options         _options;                       // Option/capability flags
+        std::shared_ptr<BlobPack> _pack;                // Packed small blobs
     };
 
 }
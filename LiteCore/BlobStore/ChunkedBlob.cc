@@ -0,0 +1,168 @@
+//
+// ChunkedBlob.cc
+//
+// Copyright © 2019 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "ChunkedBlob.hh"
+#include "Error.hh"
+#include "Doc.hh"
+#include <algorithm>
+#include <array>
+#include <sstream>
+
+namespace litecore {
+    using namespace std;
+    using namespace fleece;
+    using namespace fleece::impl;
+
+
+#pragma mark - CHUNKER:
+
+
+    // Boundary masks for "normalized chunking": below the average chunk size a boundary needs
+    // 18 zero bits, above it only 14, which keeps chunk sizes clustered around the average.
+    // (The hash is shifted left per byte, so its high bits cover the most recent 64 bytes.)
+    static constexpr uint64_t kMaskSmall = ~0ull << (64 - 18);
+    static constexpr uint64_t kMaskLarge = ~0ull << (64 - 14);
+
+
+    // The gear table maps each byte value to a random number. It must be the same everywhere,
+    // so that identical data is chunked identically by every peer; so it comes from a PRNG
+    // (splitmix64) with a fixed seed.
+    static const array<uint64_t,256>& gearTable() {
+        static const array<uint64_t,256> sTable = [] {
+            array<uint64_t,256> table;
+            uint64_t state = 0x4C697465436F7265;
+            for (auto &entry : table) {
+                uint64_t z = (state += 0x9E3779B97F4A7C15);
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+                entry = z ^ (z >> 31);
+            }
+            return table;
+        }();
+        return sTable;
+    }
+
+
+    size_t BlobChunker::nextChunkLength(slice data) {
+        if (data.size <= kMinChunkSize)
+            return data.size;
+        auto &gear = gearTable();
+        auto bytes = (const uint8_t*)data.buf;
+        size_t end = min(data.size, kMaxChunkSize);
+        size_t normal = min(end, kAvgChunkSize);
+        uint64_t hash = 0;
+        size_t i = kMinChunkSize;
+        for (; i < normal; ++i) {
+            hash = (hash << 1) + gear[bytes[i]];
+            if ((hash & kMaskSmall) == 0)
+                return i + 1;
+        }
+        for (; i < end; ++i) {
+            hash = (hash << 1) + gear[bytes[i]];
+            if ((hash & kMaskLarge) == 0)
+                return i + 1;
+        }
+        return end;
+    }
+
+
+#pragma mark - CHUNK LIST:
+
+
+    BlobChunkList::BlobChunkList(slice json) {
+        Retained<Doc> doc;
+        try {
+            doc = Doc::fromJSON(json);
+        } catch (const std::exception&) {
+            error::_throw(error::CorruptData, "Invalid blob chunk list");
+        }
+        const Array *array = doc->asArray();
+        if (!array)
+            error::_throw(error::CorruptData, "Invalid blob chunk list");
+        for (Array::iterator i(array); i; ++i) {
+            const Array *item = i.value()->asArray();
+            blobKey key;
+            if (!item || item->count() != 2 || !key.readFromBase64(item->get(0)->asString())
+                      || !item->get(1)->isInteger())
+                error::_throw(error::CorruptData, "Invalid blob chunk list");
+            add(key, item->get(1)->asUnsigned());
+        }
+    }
+
+
+    alloc_slice BlobChunkList::toJSON() const {
+        stringstream out;
+        out << '[';
+        for (auto &chunk : _chunks) {
+            if (&chunk != &_chunks.front())
+                out << ',';
+            out << "[\"" << chunk.key.base64String() << "\"," << chunk.length << ']';
+        }
+        out << ']';
+        return alloc_slice(out.str());
+    }
+
+
+#pragma mark - READ STREAM:
+
+
+    ChunkedReadStream::ChunkedReadStream(const BlobStore &store, BlobChunkList list)
+    :_store(store)
+    ,_list(move(list))
+    {
+        uint64_t offset = 0;
+        for (auto &chunk : _list.chunks()) {
+            _offsets.push_back(offset);
+            offset += chunk.length;
+        }
+        openChunk(0);
+    }
+
+
+    void ChunkedReadStream::openChunk(size_t index) {
+        _chunkIndex = index;
+        if (index < _list.chunks().size())
+            _current = _store.get(_list.chunks()[index].key).read();
+        else
+            _current.reset();
+    }
+
+
+    void ChunkedReadStream::seek(uint64_t pos) {
+        pos = min(pos, getLength());
+        // Find the last chunk starting at or before pos:
+        auto i = upper_bound(_offsets.begin(), _offsets.end(), pos);
+        size_t index = (i == _offsets.begin()) ? 0 : (i - _offsets.begin() - 1);
+        openChunk(index);
+        if (_current)
+            _current->seek(pos - _offsets[index]);
+    }
+
+
+    size_t ChunkedReadStream::read(void *dst, size_t count) {
+        size_t bytesRead = 0;
+        while (bytesRead < count && _current) {
+            size_t n = _current->read((uint8_t*)dst + bytesRead, count - bytesRead);
+            if (n == 0)
+                openChunk(_chunkIndex + 1);
+            bytesRead += n;
+        }
+        return bytesRead;
+    }
+
+}
@@ -0,0 +1,93 @@
+//
+// ChunkedBlob.hh
+//
+// Copyright © 2019 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "BlobStore.hh"
+#include <memory>
+#include <vector>
+
+namespace litecore {
+
+    /** Finds content-defined chunk boundaries in blob data, using a "gear" rolling hash (as in
+        FastCDC.) A boundary depends only on the bytes just before it, so inserting or deleting
+        data in a blob only changes the chunks around the edit; the rest of its chunks are
+        identical to the previous version's, and are stored and transferred only once. */
+    class BlobChunker {
+    public:
+        static constexpr size_t kMinChunkSize =  16 * 1024;
+        static constexpr size_t kAvgChunkSize =  64 * 1024;
+        static constexpr size_t kMaxChunkSize = 256 * 1024;
+
+        /** Returns the length of the first chunk of `data`. If `data` is shorter than
+            kMaxChunkSize and no boundary is found, returns its entire length; so unless this
+            is the end of the blob, callers should pass at least kMaxChunkSize bytes. */
+        static size_t nextChunkLength(slice data);
+    };
+
+
+    /** The list of chunks a chunked blob consists of, in order. Each chunk is itself a blob in
+        the same BlobStore, so chunks shared by several blobs are stored once.
+        Its JSON form, `[["sha1-...", length], ...]`, is what's stored in the blob's ".chunks"
+        file and what the replicator sends. */
+    class BlobChunkList {
+    public:
+        struct Chunk {
+            blobKey key;
+            uint64_t length;
+        };
+
+        BlobChunkList() =default;
+
+        /** Parses the JSON form; throws CorruptData if it's invalid. */
+        explicit BlobChunkList(slice json);
+
+        void add(const blobKey &key, uint64_t length)   {_chunks.push_back({key, length});
+                                                         _totalLength += length;}
+
+        const std::vector<Chunk>& chunks() const        {return _chunks;}
+        uint64_t totalLength() const                    {return _totalLength;}
+
+        alloc_slice toJSON() const;
+
+    private:
+        std::vector<Chunk> _chunks;
+        uint64_t _totalLength {0};
+    };
+
+
+    /** Reads a chunked blob by concatenating its chunks. */
+    class ChunkedReadStream : public virtual SeekableReadStream {
+    public:
+        ChunkedReadStream(const BlobStore&, BlobChunkList);
+
+        virtual uint64_t getLength() const override     {return _list.totalLength();}
+        virtual void seek(uint64_t pos) override;
+        virtual size_t read(void *dst NONNULL, size_t count) override;
+        virtual void close() override                   {_current.reset();}
+
+    private:
+        void openChunk(size_t index);
+
+        const BlobStore &_store;
+        BlobChunkList const _list;
+        std::vector<uint64_t> _offsets;         // Start offset of each chunk
+        size_t _chunkIndex {0};                 // Index of the chunk _current reads
+        std::unique_ptr<SeekableReadStream> _current;
+    };
+
+}
@@ -21,6 +21,7 @@
 #include "Logging.hh"
 #include "PlatformIO.hh"
 #include <errno.h>
+#include <algorithm>
 #include <memory>
 
 namespace litecore {
@@ -104,6 +105,22 @@ namespace litecore {
 
 
 
+    void MemoryReadStream::seek(uint64_t pos) {
+        _pos = (size_t)min(pos, (uint64_t)_data.size);
+    }
+
+
+    size_t MemoryReadStream::read(void *dst, size_t count) {
+        count = min(count, _data.size - _pos);
+        if (count > 0) {
+            memcpy(dst, (const uint8_t*)_data.buf + _pos, count);
+            _pos += count;
+        }
+        return count;
+    }
+
+
+
     void FileWriteStream::write(slice data) {
 		if(_file) {
 			if (fwrite(data.buf, 1, data.size, _file) < data.size)
@@ -69,7 +69,7 @@ namespace litecore {
 
             bool commit;
             try {
-                commit = task(dataFile, &sequenceTracker);
+                commit = task(dataFile, t, &sequenceTracker);
             } catch (const exception &x) {
                 t.abort();
                 sequenceTracker.endTransaction(false);
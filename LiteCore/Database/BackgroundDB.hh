@@ -26,7 +26,7 @@ namespace litecore {
 
         void close();
 
-        using TransactionTask = function_ref<bool(DataFile*, SequenceTracker*)>;
+        using TransactionTask = function_ref<bool(DataFile*, Transaction&, SequenceTracker*)>;
 
         void useInTransaction(TransactionTask task);
 
@@ -39,11 +39,13 @@ namespace litecore {
         void addTransactionObserver(TransactionObserver* NONNULL);
         void removeTransactionObserver(TransactionObserver* NONNULL);
 
+        /** Tells the TransactionObservers about a commit; for use when another process commits. */
+        void notifyTransactionObservers();
+
     private:
         slice fleeceAccessor(slice recordBody) const override;
         alloc_slice blobAccessor(const fleece::impl::Dict*) const override;
         void externalTransactionCommitted(const SequenceTracker &sourceTracker) override;
-        void notifyTransactionObservers();
 
         c4Internal::Database* _database;
         std::vector<TransactionObserver*> _transactionObservers;
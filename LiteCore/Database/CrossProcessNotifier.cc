@@ -0,0 +1,233 @@
+//
+// CrossProcessNotifier.cc
+//
+// Copyright © 2019 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "CrossProcessNotifier.hh"
+#include "Error.hh"
+#include "Logging.hh"
+#include <random>
+
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#endif
+
+namespace litecore {
+    using namespace std;
+
+
+    // The layout of the shared file. Its initial state is all zeroes. Every field is accessed
+    // atomically, since other processes read and write it concurrently.
+    struct CrossProcessNotifier::SharedState {
+        static constexpr uint32_t kMagic = 0x4C43504E;      // 'LCPN'
+        static constexpr uint32_t kRingSize = 64;
+
+        struct Post {
+            atomic<uint64_t> stamp;         // 1 + index of the post stored here; else stale
+            atomic<uint64_t> processID;
+            atomic<uint64_t> firstSeq;
+            atomic<uint64_t> lastSeq;
+        };
+
+        atomic<uint32_t> magic;
+        atomic<uint32_t> postCount;         // Number of posts ever made; also the futex word
+        Post             ring[kRingSize];   // Post #n is stored in ring[n % kRingSize]
+    };
+
+    static_assert(atomic<uint32_t>::is_always_lock_free && atomic<uint64_t>::is_always_lock_free,
+                  "Shared memory needs address-free atomics");
+
+
+    // A number identifying this process, so it can ignore its own posts. The pid alone isn't
+    // enough, since pids get reused; but a random number alone would be inherited by a fork.
+    static uint64_t thisProcessID() {
+        static const uint64_t sRandom = [] {
+            random_device rd;
+            return (uint64_t(rd()) << 32) | rd();
+        }();
+#ifdef _MSC_VER
+        return sRandom;
+#else
+        return sRandom ^ uint64_t(::getpid());
+#endif
+    }
+
+
+#ifdef _MSC_VER
+
+    CrossProcessNotifier::CrossProcessNotifier(const FilePath &path, Callback callback)
+    :_path(path)
+    ,_callback(callback)
+    ,_processID(thisProcessID())
+    {
+        error::_throw(error::Unimplemented, "Cross-process notifications aren't supported");
+    }
+
+    CrossProcessNotifier::~CrossProcessNotifier()                               { }
+    void CrossProcessNotifier::committed(sequence_t firstSeq, sequence_t lastSeq)   { }
+
+#else
+
+    CrossProcessNotifier::CrossProcessNotifier(const FilePath &path, Callback callback)
+    :_path(path)
+    ,_callback(callback)
+    ,_processID(thisProcessID())
+    {
+        _fd = ::open(path.path().c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (_fd < 0)
+            error::_throwErrno();
+        // Every process extends the file to the same size; the new bytes read as zero:
+        struct stat st;
+        if (::fstat(_fd, &st) < 0
+                || (st.st_size < off_t(sizeof(SharedState))
+                        && ::ftruncate(_fd, sizeof(SharedState)) < 0)) {
+            int err = errno;
+            ::close(_fd);
+            error::_throw(error::POSIX, err);
+        }
+        void *mapped = ::mmap(nullptr, sizeof(SharedState), PROT_READ | PROT_WRITE, MAP_SHARED,
+                              _fd, 0);
+        if (mapped == MAP_FAILED) {
+            int err = errno;
+            ::close(_fd);
+            error::_throw(error::POSIX, err);
+        }
+        _shared = (SharedState*)mapped;
+
+        uint32_t magic = 0;
+        if (!_shared->magic.compare_exchange_strong(magic, SharedState::kMagic)
+                && magic != SharedState::kMagic) {
+            ::munmap(_shared, sizeof(SharedState));
+            ::close(_fd);
+            error::_throw(error::CorruptData, "Unknown format of %s", path.path().c_str());
+        }
+
+        _thread = thread([this] {watch();});
+    }
+
+
+    CrossProcessNotifier::~CrossProcessNotifier() {
+        {
+            lock_guard<mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _cond.notify_all();
+        _thread.join();
+        ::munmap(_shared, sizeof(SharedState));
+        ::close(_fd);
+    }
+
+
+    void CrossProcessNotifier::committed(sequence_t firstSeq, sequence_t lastSeq) {
+        // Claim the next post, fill it in, then stamp it so readers know it's complete:
+        uint32_t index = _shared->postCount.fetch_add(1);
+        auto &post = _shared->ring[index % SharedState::kRingSize];
+        post.stamp.store(0);
+        post.processID.store(_processID, memory_order_relaxed);
+        post.firstSeq.store(firstSeq, memory_order_relaxed);
+        post.lastSeq.store(lastSeq, memory_order_relaxed);
+        post.stamp.store(uint64_t(index) + 1, memory_order_release);
+        wake();
+    }
+
+
+    void CrossProcessNotifier::watch() {
+        // If a post stays unstamped this long, its writer must have died while posting it:
+        static constexpr auto kMaxPostDelay = chrono::seconds(1);
+
+        uint32_t seen = _shared->postCount.load(memory_order_acquire);
+        auto stalledSince = chrono::steady_clock::time_point::max();
+        while (!_stopping) {
+            uint32_t count = _shared->postCount.load(memory_order_acquire);
+            bool missed = false;
+            for (; seen != count; ++seen) {
+                auto &post = _shared->ring[seen % SharedState::kRingSize];
+                uint64_t expected = uint64_t(seen) + 1;
+                uint64_t stamp = post.stamp.load(memory_order_acquire);
+                if (stamp == expected) {
+                    uint64_t processID = post.processID.load(memory_order_relaxed);
+                    sequence_t firstSeq = post.firstSeq.load(memory_order_relaxed);
+                    sequence_t lastSeq = post.lastSeq.load(memory_order_relaxed);
+                    if (post.stamp.load(memory_order_acquire) != expected)
+                        missed = true;                  // Overwritten while I read it
+                    else if (processID != _processID)
+                        _callback(firstSeq, lastSeq);
+                } else if (stamp > expected) {
+                    missed = true;                      // Overwritten by a later post
+                } else {
+                    // The post hasn't been stamped yet; come back to it soon, unless it's stuck:
+                    auto now = chrono::steady_clock::now();
+                    if (stalledSince == chrono::steady_clock::time_point::max())
+                        stalledSince = now;
+                    if (now - stalledSince < kMaxPostDelay)
+                        break;
+                    missed = true;
+                }
+                stalledSince = chrono::steady_clock::time_point::max();
+            }
+            if (missed) {
+                LogToAt(DBLog, Verbose, "CrossProcessNotifier: missed posts; rescanning");
+                _callback(0, UINT64_MAX);
+            }
+            if (seen == count)
+                wait(count);
+            else
+                this_thread::sleep_for(chrono::milliseconds(1));
+        }
+    }
+
+
+#ifdef __linux__
+
+    void CrossProcessNotifier::wait(uint32_t postCount) {
+        // Block until another process bumps the post count (or the poll interval elapses, so
+        // that _stopping gets checked):
+        auto nsec = chrono::duration_cast<chrono::nanoseconds>(kPollInterval).count();
+        struct timespec timeout = {time_t(nsec / 1000000000), long(nsec % 1000000000)};
+        syscall(SYS_futex, &_shared->postCount, FUTEX_WAIT, postCount, &timeout, nullptr, 0);
+    }
+
+    void CrossProcessNotifier::wake() {
+        syscall(SYS_futex, &_shared->postCount, FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+    }
+
+#else
+
+    void CrossProcessNotifier::wait(uint32_t postCount) {
+        unique_lock<mutex> lock(_mutex);
+        _cond.wait_for(lock, kPollInterval, [&] {
+            return _stopping || _shared->postCount.load() != postCount;
+        });
+    }
+
+    void CrossProcessNotifier::wake() {
+        _cond.notify_all();     // Other processes will notice when they next poll
+    }
+
+#endif // __linux__
+
+#endif // _MSC_VER
+
+}
@@ -0,0 +1,62 @@
+//
+// CrossProcessNotifier.hh
+//
+// Copyright © 2019 Couchbase. All rights reserved.
+//
+
+#pragma once
+#include "Base.hh"
+#include "FilePath.hh"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace litecore {
+
+    /** Tells other processes that have the same database open about this process's commits,
+        and vice versa. Each commit's range of sequences is posted to a small ring buffer in a
+        memory-mapped file next to the database. A watcher thread waits for new posts (with a
+        futex on Linux, elsewhere by polling the mapped memory) and reports those made by other
+        processes to the callback.
+        Only sequence ranges are shared; the receiver reads the changed documents itself. */
+    class CrossProcessNotifier {
+    public:
+        /** Called on the watcher thread with a range of sequences committed by another process.
+            If posts were missed, because the ring buffer overflowed, the range is
+            0...UINT64_MAX and the receiver should catch up from the last sequence it knows. */
+        using Callback = std::function<void(sequence_t firstSeq, sequence_t lastSeq)>;
+
+        /** Opens or creates the shared file and starts the watcher thread. */
+        CrossProcessNotifier(const FilePath &sharedFile, Callback);
+
+        /** Stops the watcher thread. */
+        ~CrossProcessNotifier();
+
+        /** Posts a commit made by this process. */
+        void committed(sequence_t firstSeq, sequence_t lastSeq);
+
+        /** How often the watcher checks the shared memory, where it can't block on it. */
+        static constexpr auto kPollInterval = std::chrono::milliseconds(50);
+
+    private:
+        struct SharedState;
+
+        void watch();
+        void wait(uint32_t postCount);
+        void wake();
+
+        FilePath const          _path;
+        Callback const          _callback;
+        uint64_t const          _processID;             // Identifies this process's posts
+        int                     _fd {-1};
+        SharedState*            _shared {nullptr};      // The memory-mapped file
+        std::atomic<bool>       _stopping {false};
+        std::mutex              _mutex;                 // Used to interrupt polling
+        std::condition_variable _cond;
+        std::thread             _thread;
+    };
+
+}
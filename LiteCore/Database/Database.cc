@@ -23,8 +23,10 @@
 #include "c4Document+Fleece.h"
 #include "BackgroundDB.hh"
 #include "Housekeeper.hh"
+#include "CrossProcessNotifier.hh"
 #include "DataFile.hh"
 #include "Record.hh"
+#include "VersionedDocument.hh"
 #include "SequenceTracker.hh"
 #include "FleeceImpl.hh"
 #include "BlobStore.hh"
@@ -37,6 +39,7 @@ namespace litecore { namespace constants
 {
     const C4Slice kLocalCheckpointStore   = C4STR("checkpoints");
     const C4Slice kPeerCheckpointStore    = C4STR("peerCheckpoints");
+    const C4Slice kPartialBlobStore       = C4STR("partialBlobs");
     const C4Slice kPreviousPrivateUUIDKey = C4STR("previousPrivateUUID");
 }}
 
@@ -115,6 +118,12 @@ namespace c4Internal {
         options.writeable = (config.flags & kC4DB_ReadOnly) == 0;
         options.upgradeable = (config.flags & kC4DB_NoUpgrade) == 0;
         options.useDocumentKeys = true;
+        options.tuning.cacheSize = config.tuning.cacheSize;
+        options.tuning.mmapSize = config.tuning.mmapSize;
+        options.tuning.journalSizeLimit = config.tuning.journalSizeLimit;
+        options.tuning.pageSize = config.tuning.pageSize;
+        options.tuning.synchronous = config.tuning.synchronous;
+        options.tuning.autoSize = config.tuning.autoSize;
         options.encryptionAlgorithm = (EncryptionAlgorithm)config.encryptionKey.algorithm;
         if (options.encryptionAlgorithm != kNoEncryption) {
 #ifdef COUCHBASE_ENTERPRISE
@@ -179,12 +188,27 @@ namespace c4Internal {
             default:                error::_throw(error::InvalidParameter);
         }
         _documentFactory.reset(factory);
+
+        if ((config.flags & kC4DB_CrossProcessNotifications) && _sequenceTracker) {
+            (void)backgroundDatabase();     // (create it now, since the notifier's thread uses it)
+            _openedAtSequence = _dataFile->defaultKeyStore().lastSequence();
+            try {
+                _crossProcessNotifier.reset(new CrossProcessNotifier(
+                                                    _dataFilePath.appendingToName("-changes"),
+                                                    [this](sequence_t first, sequence_t last) {
+                    externalProcessCommitted(first, last);
+                }));
+            } catch (const std::exception &x) {
+                Warn("Can't observe other processes' commits: %s", x.what());
+            }
+        }
     }
 
 
     Database::~Database() {
         Assert(_transactionLevel == 0,
                "Database being destructed while in a transaction");
+        _crossProcessNotifier.reset();
         FLEncoder_Free(_flEncoder);
         // Eagerly close the data file to ensure that no other instances will
         // be trying to use me as a delegate (for example in externalTransactionCommitted)
@@ -299,6 +323,57 @@ namespace c4Internal {
     }
 
 
+    void Database::backup(const FilePath &destination, bool incremental,
+                          function_ref<bool(const C4BackupProgress&)> progress)
+    {
+        mustNotBeInTransaction();
+        if (destination.exists() && !incremental)
+            error::_throw(error::POSIX, EEXIST);
+        destination.mkdir();
+        C4BackupProgress status = {};
+
+        // Back up the database file first. The copy goes to a temporary file that replaces the
+        // previous backup only when it's complete:
+        FilePath dbFile = destination[_dataFile->filePath().fileName()];
+        FilePath tempFile = dbFile.appendingToName("-backup");
+        auto &factory = _dataFile->factory();
+        factory.deleteFile(tempFile);
+        try {
+            _dataFile->backup(tempFile, [&](uint64_t pagesCopied, uint64_t pagesTotal) {
+                status.pagesCopied = pagesCopied;
+                status.pagesTotal = pagesTotal;
+                return progress(status);
+            });
+            factory.deleteFile(dbFile);
+            tempFile.moveTo(dbFile);
+        } catch (...) {
+            factory.deleteFile(tempFile);
+            throw;
+        }
+
+        // Then the blobs. Any blob the backed-up documents refer to was already in the store
+        // when the database snapshot was taken. Blobs are named by digest, so those the backup
+        // already has don't need to be copied again:
+        BlobStore *blobs = blobStore();
+        auto options = blobs->options();
+        options.create = options.writeable = true;
+        BlobStore backupBlobs(destination.subdirectoryNamed("Attachments"), &options);
+        auto keys = blobs->keys();
+        status.blobsTotal = keys.size();
+        unordered_set<string> backedUp;
+        for (auto &key : keys) {
+            if (!backupBlobs.has(key))
+                blobs->copyBlobTo(key, backupBlobs);
+            backedUp.insert(key.filename());
+            ++status.blobsCopied;
+            if (!progress(status))
+                error::_throw(error::POSIX, ECANCELED);
+        }
+        if (incremental)
+            backupBlobs.deleteAllExcept(backedUp);     // Remove blobs deleted since last backup
+    }
+
+
     void Database::rekey(const C4EncryptionKey *newKey) {
         _dataFile->_logInfo("Rekeying database...");
         C4EncryptionKey keyBuf {kC4EncryptionNone, {}};
@@ -400,6 +475,10 @@ namespace c4Internal {
         FilePath blobStorePath = path().subdirectoryNamed(dirname);
         auto options = BlobStore::Options::defaults;
         options.create = options.writeable = (config.flags & kC4DB_ReadOnly) == 0;
+        if (config.flags & kC4DB_PackedBlobs)
+            options.packThreshold = BlobStore::kDefaultPackThreshold;
+        if (config.flags & kC4DB_ChunkedBlobs)
+            options.chunkThreshold = BlobStore::kDefaultChunkThreshold;
         options.encryptionAlgorithm =(EncryptionAlgorithm)encryptionKey.algorithm;
         if (options.encryptionAlgorithm != kNoEncryption) {
             options.encryptionKey = alloc_slice(encryptionKey.bytes, sizeof(encryptionKey.bytes));
@@ -423,6 +502,7 @@ namespace c4Internal {
 
 
     void Database::stopBackgroundTasks() {
+        _crossProcessNotifier.reset();
         if (_housekeeper) {
             _housekeeper->stop();
             _housekeeper = nullptr;
@@ -437,12 +517,35 @@ namespace c4Internal {
             if (config.flags & kC4DB_ReadOnly)
                 return false;
             _housekeeper = new Housekeeper(this);
+            if (_expirationBatchSize > 0)
+                _housekeeper->setExpirationBatching(_expirationBatchSize, _expirationYield);
             _housekeeper->start();
         }
         return true;
     }
 
 
+    // Remembered, so the settings also apply if housekeeping is started (or restarted) later.
+    void Database::setExpirationBatching(unsigned maxDocsPerTransaction,
+                                         chrono::milliseconds yield)
+    {
+        if (maxDocsPerTransaction == 0) {
+            maxDocsPerTransaction = Housekeeper::kDefaultExpirationBatchSize;
+            yield = Housekeeper::kDefaultExpirationYield;
+        }
+        _expirationBatchSize = maxDocsPerTransaction;
+        _expirationYield = yield;
+        if (_housekeeper)
+            _housekeeper->setExpirationBatching(maxDocsPerTransaction, yield);
+    }
+
+
+    void Database::setMaintenanceInterval(chrono::milliseconds interval) {
+        if (_housekeeper)
+            _housekeeper->setMaintenanceInterval(interval);
+    }
+
+
 #pragma mark - UUIDS:
 
 
@@ -494,6 +597,8 @@ namespace c4Internal {
     void Database::beginTransaction() {
         if (++_transactionLevel == 1) {
             _transaction = new Transaction(_dataFile.get());
+            if (_crossProcessNotifier)
+                _transactionStartSequence = _dataFile->defaultKeyStore().lastSequence();
             if (_sequenceTracker) {
                 _sequenceTracker->use([](SequenceTracker &st) {
                     st.beginTransaction();
@@ -527,16 +632,22 @@ namespace c4Internal {
             error::_throw(error::NotInTransaction);
         if (--_transactionLevel == 0) {
             auto t = _transaction;
+            sequence_t lastSeq = 0;
             try {
-                if (commit)
+                if (commit) {
+                    if (_crossProcessNotifier)
+                        lastSeq = _dataFile->defaultKeyStore().lastSequence();
                     t->commit();
-                else
+                } else {
                     t->abort();
+                }
             } catch (...) {
                 _cleanupTransaction(false);
                 throw;
             }
             _cleanupTransaction(commit);
+            if (lastSeq > _transactionStartSequence)
+                _crossProcessNotifier->committed(_transactionStartSequence + 1, lastSeq);
         }
     }
 
@@ -566,6 +677,43 @@ namespace c4Internal {
     }
 
 
+    // Called on the CrossProcessNotifier's thread when another process commits. Reads the
+    // documents it changed, and adds them to my SequenceTracker and BackgroundDB's observers.
+    void Database::externalProcessCommitted(sequence_t firstSeq, sequence_t lastSeq) {
+        try {
+            if (firstSeq == 0) {
+                // Some commits were missed; catch up from the latest change I know of:
+                firstSeq = _sequenceTracker->use<sequence_t>([&](SequenceTracker &st) {
+                    return max(st.lastSequence(), _openedAtSequence) + 1;
+                });
+            }
+            vector<SequenceTracker::Change> changes;
+            _backgroundDB->use([&](DataFile *dataFile) {
+                if (!dataFile)
+                    return;
+                RecordEnumerator::Options options;
+                options.includeDeleted = true;
+                options.contentOption = kMetaOnly;
+                RecordEnumerator e(dataFile->defaultKeyStore(), firstSeq - 1, options);
+                while (e.next() && e->sequence() <= lastSeq) {
+                    changes.push_back({alloc_slice(e->key()),
+                                       documentFactory().revIDFromVersion(e->version()),
+                                       e->sequence(),
+                                       uint32_t(min(e->bodySize(), size_t(UINT32_MAX)))});
+                }
+            });
+            if (!changes.empty()) {
+                _sequenceTracker->use([&](SequenceTracker &st) {
+                    st.addExternalChanges(changes);
+                });
+            }
+            _backgroundDB->notifyTransactionObservers();
+        } catch (const std::exception &x) {
+            Warn("Error reading another process's changes: %s", x.what());
+        }
+    }
+
+
     void Database::mustNotBeInTransaction() {
         if (inTransaction())
             error::_throw(error::TransactionNotClosed);
@@ -582,12 +730,20 @@ namespace c4Internal {
 #pragma mark - DOCUMENTS:
 
     
+    static void checkRawStoreName(const string &storeName) {
+        if (hasPrefix(storeName, DataFile::kBodiesKeyStorePrefix))
+            error::_throw(error::InvalidParameter, "Reserved raw store name");
+    }
+
+
     Record Database::getRawDocument(const string &storeName, slice key) {
+        checkRawStoreName(storeName);
         return getKeyStore(storeName).get(key);
     }
 
 
     void Database::putRawDocument(const string &storeName, slice key, slice meta, slice body) {
+        checkRawStoreName(storeName);
         KeyStore &localDocs = getKeyStore(storeName);
         auto &t = transaction();
         if (body.buf || meta.buf)
@@ -679,6 +835,7 @@ namespace c4Internal {
 
 
     bool Database::purgeDocument(slice docID) {
+        VersionedDocument::purgeExternalBodies(defaultKeyStore(), docID, transaction());
         if (!defaultKeyStore().del(docID, transaction()))
             return false;
         if (_sequenceTracker) {
@@ -691,14 +848,22 @@ namespace c4Internal {
 
 
     int64_t Database::purgeExpiredDocs() {
+        auto &keyStore = _dataFile->defaultKeyStore();
+        auto purgeBodies = [&](slice docID) {
+            VersionedDocument::purgeExternalBodies(keyStore, docID, transaction());
+        };
         if (_sequenceTracker) {
             return _sequenceTracker->use<int64_t>([&](SequenceTracker &st) {
-                return _dataFile->defaultKeyStore().expireRecords([&](slice docID) {
-                    st.documentPurged(docID);
+                vector<alloc_slice> docIDs;
+                auto expired = keyStore.expireRecords([&](slice docID) {
+                    purgeBodies(docID);
+                    docIDs.emplace_back(docID);
                 });
+                st.documentsPurged(docIDs);
+                return expired;
             });
         } else {
-            return _dataFile->defaultKeyStore().expireRecords(nullptr);
+            return keyStore.expireRecords(purgeBodies);
         }
     }
 
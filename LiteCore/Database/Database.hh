@@ -25,6 +25,7 @@
 #include "FilePath.hh"
 #include "InstanceCounted.hh"
 #include "access_lock.hh"
+#include <chrono>
 #include <memory>
 #include <mutex>
 #include <unordered_set>
@@ -40,6 +41,7 @@ namespace litecore {
     class BlobStore;
     class BackgroundDB;
     class Housekeeper;
+    class CrossProcessNotifier;
 }
 
 
@@ -78,6 +80,9 @@ namespace c4Internal {
 
         void compact();
 
+        void backup(const FilePath &destination, bool incremental,
+                    function_ref<bool(const C4BackupProgress&)> progress);
+
         const C4DatabaseConfig config;
 
         Transaction& transaction() const;
@@ -123,6 +128,8 @@ namespace c4Internal {
         int64_t purgeExpiredDocs();
         bool setExpiration(slice docID, expiration_t);
         bool startHousekeeping();
+        void setExpirationBatching(unsigned maxDocsPerTransaction, std::chrono::milliseconds yield);
+        void setMaintenanceInterval(std::chrono::milliseconds);
 
 #if DEBUG
         void validateRevisionBody(slice body);
@@ -172,6 +179,7 @@ namespace c4Internal {
                                            C4StorageEngine &outStorageEngine);
         static bool deleteDatabaseFileAtPath(const string &dbPath, C4StorageEngine);
         void _cleanupTransaction(bool committed);
+        void externalProcessCommitted(sequence_t firstSeq, sequence_t lastSeq);
         bool getUUIDIfExists(slice key, UUID&);
         UUID generateUUID(slice key, Transaction&, bool overwrite =false);
 
@@ -192,6 +200,11 @@ namespace c4Internal {
         recursive_mutex             _clientMutex;           // Mutex for c4db_lock/unlock
         unique_ptr<BackgroundDB>    _backgroundDB;          // for background operations
         Retained<Housekeeper>       _housekeeper;           // for expiration/cleanup tasks
+        unsigned                    _expirationBatchSize {0}; // Housekeeper's; 0 for default
+        std::chrono::milliseconds   _expirationYield {0};   // Housekeeper's, between batches
+        unique_ptr<CrossProcessNotifier> _crossProcessNotifier; // Commit feed shared w/other processes
+        sequence_t                  _transactionStartSequence {0}; // Last sequence before transaction
+        sequence_t                  _openedAtSequence {0};  // Last sequence when db was opened
     };
 
 }
@@ -20,7 +20,8 @@
 #include "Database.hh"
 #include "SequenceTracker.hh"
 #include "BackgroundDB.hh"
-#include "DataFile.hh"
+#include "SQLiteDataFile.hh"
+#include "VersionedDocument.hh"
 #include "Logging.hh"
 #include <inttypes.h>
 
@@ -28,15 +29,33 @@ namespace litecore {
     using namespace c4Internal;
     using namespace actor;
 
+    // Maintenance vacuums when the free pages add up to this many bytes:
+    static constexpr int64_t kVacuumThreshold = 1024 * 1024;
+
+    // Maximum number of pages to vacuum at once:
+    static constexpr unsigned kVacuumStepPages = 256;
+
+    // Delay between vacuum steps, during which other writers get a chance at the database:
+    static constexpr auto kVacuumStepYield = chrono::milliseconds(50);
+
+    // Maintenance checkpoints a WAL this large even if the database isn't idle:
+    static constexpr uint64_t kMaxWALSize = 32 * 1024 * 1024;
+
+
     Housekeeper::Housekeeper(Database *db)
     :Actor("Housekeeper")
     ,_bgdb(db->backgroundDatabase())
     ,_expiryTimer(std::bind(&Housekeeper::_doExpiration, this))
+    ,_maintenanceTimer([this] {
+        if (!_stopped)
+            enqueue(&Housekeeper::_doMaintenance);
+    })
     { }
 
 
     void Housekeeper::start() {
         enqueue(&Housekeeper::_scheduleExpiration);
+        _maintenanceTimer.fireAfter(_maintenanceInterval.load());
     }
 
 
@@ -47,6 +66,8 @@ namespace litecore {
 
 
     void Housekeeper::_stop() {
+        _stopped = true;
+        _maintenanceTimer.stop();
         _expiryTimer.stop();
         LogToAt(DBLog, Verbose, "Housekeeper: stopped.");
     }
@@ -68,18 +89,41 @@ namespace litecore {
     }
 
 
+    // Purges one batch of expired docs. If there may be more, schedules the next batch after a
+    // brief delay, during which other writers get a chance at the database.
     void Housekeeper::_doExpiration() {
         LogToAt(DBLog, Verbose, "Housekeeper: expiring documents...");
-        _bgdb->useInTransaction([&](DataFile* dataFile, SequenceTracker *sequenceTracker) -> bool {
-            KeyStore::ExpirationCallback callback;
+        unsigned batchSize = _expirationBatchSize, expired = 0;
+        _bgdb->useInTransaction([&](DataFile* dataFile, Transaction &t,
+                                    SequenceTracker *sequenceTracker) -> bool {
+            std::vector<alloc_slice> docIDs;
             auto &keyStore = dataFile->defaultKeyStore();
+            expired = keyStore.expireRecords([&](slice docID) {
+                VersionedDocument::purgeExternalBodies(keyStore, docID, t);
+                if (sequenceTracker)
+                    docIDs.emplace_back(docID);
+            }, batchSize);
             if (sequenceTracker)
-                callback = [&](slice docID) { sequenceTracker->documentPurged(docID); };
-            keyStore.expireRecords(callback);
+                sequenceTracker->documentsPurged(docIDs);
             return true;
         });
 
-        _scheduleExpiration();
+        if (expired >= batchSize) {
+            LogToAt(DBLog, Verbose, "Housekeeper: expired a batch of %u docs; continuing", expired);
+            _expiryTimer.fireAfter(_expirationYield.load());
+        } else {
+            _scheduleExpiration();
+        }
+    }
+
+
+    void Housekeeper::setExpirationBatching(unsigned maxDocsPerTransaction,
+                                            Timer::duration yield)
+    {
+        // (Not enqueued, since the expiry timer calls _doExpiration on its own thread.)
+        Assert(maxDocsPerTransaction > 0);
+        _expirationBatchSize = maxDocsPerTransaction;
+        _expirationYield = yield;
     }
 
 
@@ -92,4 +136,64 @@ namespace litecore {
             LogToAt(DBLog, Verbose, "Housekeeper: rescheduled expiration, now in %" PRIi64 "ms", delay);
     }
 
+
+#pragma mark - MAINTENANCE:
+
+
+    // Runs periodically. Checkpointing and vacuuming are done in small steps, and only while
+    // nobody else is writing to the database, so they don't turn into long stalls at close or
+    // compact time.
+    void Housekeeper::_doMaintenance() {
+        if (_stopped)
+            return;
+        auto delay = _maintenanceInterval.load();
+        _bgdb->use([&](DataFile *dataFile) {
+            if (!dataFile)
+                return;
+            auto df = (SQLiteDataFile*)dataFile;
+            try {
+                uint64_t version = df->dataVersion();
+                bool idle = (version == _lastDataVersion);
+                _lastDataVersion = version;
+                if (!idle)
+                    _walDirty = true;
+
+                // Checkpoint the WAL once writes pause, or whenever it's grown too large:
+                auto stats = df->stats();
+                if ((idle && _walDirty) || stats.walSize > kMaxWALSize) {
+                    uint64_t lag = df->checkpoint();
+                    LogToAt(DBLog, Verbose, "Housekeeper: checkpointed WAL; %" PRIu64
+                            " pages not yet checkpointed", lag);
+                    _walDirty = (lag > 0);
+                }
+
+                // Vacuum a limited number of free pages; if there are more, continue soon:
+                if (idle && int64_t(stats.freePages * stats.pageSize) >= kVacuumThreshold) {
+                    uint64_t freePages = 0;
+                    _bgdb->useInTransaction([&](DataFile *dataFile, Transaction&,
+                                                SequenceTracker*) -> bool {
+                        freePages = ((SQLiteDataFile*)dataFile)->incrementalVacuum(kVacuumStepPages);
+                        return true;
+                    });
+                    LogToAt(DBLog, Verbose, "Housekeeper: vacuumed %" PRIu64 " pages; %" PRIu64
+                            " free pages left", stats.freePages - freePages, freePages);
+                    _walDirty = true;
+                    if (int64_t(freePages * stats.pageSize) >= kVacuumThreshold)
+                        delay = kVacuumStepYield;
+                }
+            } catch (const std::exception &x) {
+                LogToAt(DBLog, Warning, "Housekeeper: maintenance failed: %s", x.what());
+            }
+        });
+        if (!_stopped)
+            _maintenanceTimer.fireAfter(delay);
+    }
+
+
+    void Housekeeper::setMaintenanceInterval(Timer::duration interval) {
+        _maintenanceInterval = interval;
+        if (_maintenanceTimer.scheduled())
+            _maintenanceTimer.fireEarlierAfter(interval);
+    }
+
 }
@@ -9,6 +9,7 @@
 #include "Record.hh"
 #include "Actor.hh"
 #include "Timer.hh"
+#include <atomic>
 
 namespace c4Internal {
     class Database;
@@ -32,14 +33,35 @@ namespace litecore {
         /// reschedule its next expiration for earlier if necessary.
         void documentExpirationChanged(expiration_t exp);
 
+        /// Limits how many expired documents are purged per transaction, and how long to wait
+        /// before the next transaction, so other writers aren't locked out by a mass expiration.
+        void setExpirationBatching(unsigned maxDocsPerTransaction, actor::Timer::duration yield);
+
+        /// Sets how often the Housekeeper checks whether the database file needs maintenance.
+        /// When no other connection has written to the database since the last check, it
+        /// checkpoints the WAL and vacuums a limited number of free pages.
+        void setMaintenanceInterval(actor::Timer::duration);
+
+        static constexpr unsigned kDefaultExpirationBatchSize = 1000;
+        static constexpr auto kDefaultExpirationYield = std::chrono::milliseconds(50);
+        static constexpr auto kDefaultMaintenanceInterval = std::chrono::seconds(5);
+
     private:
         void _start();
         void _stop();
         void _scheduleExpiration();
         void _doExpiration();
+        void _doMaintenance();
 
         BackgroundDB* _bgdb;
         actor::Timer _expiryTimer;
+        actor::Timer _maintenanceTimer;
+        std::atomic<unsigned> _expirationBatchSize {kDefaultExpirationBatchSize};
+        std::atomic<actor::Timer::duration> _expirationYield {kDefaultExpirationYield};
+        std::atomic<actor::Timer::duration> _maintenanceInterval {kDefaultMaintenanceInterval};
+        std::atomic<bool> _stopped {false};
+        uint64_t _lastDataVersion {0};          // data_version at the last maintenance check
+        bool _walDirty {true};                  // WAL may have pages left to checkpoint
     };
 
 
@@ -21,6 +21,7 @@
 #include "Logging.hh"
 #include "StringUtil.hh"
 #include <algorithm>
+#include <cstddef>
 #include <sstream>
 
 
@@ -59,6 +60,25 @@ namespace litecore {
     { }
 
 
+    SequenceTracker::~SequenceTracker() {
+        _transaction.reset();
+        while (!_changes.empty())
+            _destroy(_changes, _changes.begin());
+        while (!_idle.empty())
+            _destroy(_idle, _idle.begin());
+    }
+
+
+    // Unlinks an Entry from its list and the index, and frees it.
+    void SequenceTracker::_destroy(EntryList &list, const_iterator i) {
+        Entry *entry = mutableEntry(i);
+        if (!entry->isPlaceholder())
+            _byDocID.erase(entry);
+        list.remove(entry);
+        _pool.destroy(entry);
+    }
+
+
     void SequenceTracker::beginTransaction() {
         logInfo("begin transaction at #%" PRIu64, _lastSequence);
         auto notifier = new DatabaseChangeNotifier(*this, nullptr);
@@ -101,6 +121,12 @@ namespace litecore {
 
         _transaction.reset();
         removeObsoleteEntries();
+
+        if (!_pendingExternalChanges.empty()) {
+            auto pending = move(_pendingExternalChanges);
+            _pendingExternalChanges.clear();
+            addExternalChanges(pending);
+        }
     }
 
 
@@ -123,26 +149,50 @@ namespace litecore {
     }
 
 
+    void SequenceTracker::documentsPurged(const vector<alloc_slice> &docIDs) {
+        Assert(inTransaction());
+        bool listChanged = false;
+        for (auto &docID : docIDs) {
+            Assert(docID);
+            if (_recordChange(docID, {}, 0, 0))
+                listChanged = true;
+        }
+        if (listChanged)
+            _notifyPlaceholdersBefore(docIDs.size());
+    }
+
+
     void SequenceTracker::_documentChanged(const alloc_slice &docID,
                                            const alloc_slice &revID,
                                            sequence_t sequence,
                                            uint64_t bodySize)
+    {
+        if (_recordChange(docID, revID, sequence, bodySize))
+            _notifyPlaceholdersBefore(1);
+    }
+
+
+    // Adds or moves the doc's entry to the end of the list and notifies its document observers.
+    // Returns false if the list of changes didn't change.
+    bool SequenceTracker::_recordChange(const alloc_slice &docID,
+                                        const alloc_slice &revID,
+                                        sequence_t sequence,
+                                        uint64_t bodySize)
     {
         auto shortBodySize = (uint32_t)min(bodySize, (uint64_t)UINT32_MAX);
         bool listChanged = true;
-        Entry *entry;
-        auto i = _byDocID.find(docID);
-        if (i != _byDocID.end()) {
+        Entry *entry = _byDocID.find(docID);
+        if (entry) {
             // Move existing entry to the end of the list:
-            entry = &*i->second;
+            const_iterator i(entry);
             if (entry->isIdle() && !hasDBChangeNotifiers()) {
                 listChanged = false;
             } else {
                 if (entry->isIdle()) {
-                    _changes.splice(_changes.end(), _idle, i->second);
+                    _changes.splice(_changes.end(), _idle, i);
                     entry->idle = false;
-                } else if (next(i->second) != _changes.end())
-                    _changes.splice(_changes.end(), _changes, i->second);
+                } else if (next(i) != _changes.end())
+                    _changes.splice(_changes.end(), _changes, i);
                 else
                     listChanged = false;
             }
@@ -152,10 +202,9 @@ namespace litecore {
             entry->bodySize = shortBodySize;
         } else {
             // or create a new entry at the end:
-            _changes.emplace_back(docID, revID, sequence, shortBodySize);
-            iterator change = prev(_changes.end());
-            _byDocID[change->docID] = change;
-            entry = &*change;
+            entry = _pool.make(docID, revID, sequence, shortBodySize);
+            _changes.insert(_changes.end(), entry);
+            _byDocID.insert(entry);
         }
 
         if (!inTransaction()) {
@@ -164,13 +213,21 @@ namespace litecore {
         }
 
         // Notify document notifiers:
-        for (auto docNotifier : entry->documentObservers)
+        for (auto docNotifier = entry->documentObservers; docNotifier;
+                  docNotifier = docNotifier->_nextObserver)
             docNotifier->notify(entry);
+        return listChanged;
+    }
+
 
-        if (listChanged && _numPlaceholders > 0) {
-            // Any placeholders right before this change were up to date, should be notified:
+    // Notifies the database observers whose placeholders come right before the latest changes.
+    void SequenceTracker::_notifyPlaceholdersBefore(size_t nChanges) {
+        if (_numPlaceholders > 0) {
+            // Any placeholders right before these changes were up to date, should be notified:
             bool notified = false;
-            auto ph = next(_changes.rbegin());      // iterating _backwards_, skipping latest
+            auto ph = _changes.rbegin();            // iterating _backwards_, skipping the changes
+            for (size_t i = 0; i < nChanges && ph != _changes.rend() && !ph->isPlaceholder(); ++i)
+                ++ph;
             while (ph != _changes.rend() && ph->isPlaceholder()) {
                 auto nextph = ph;
                 ++nextph; // precompute next pos, in case 'ph' moves itself during the callback
@@ -202,15 +259,45 @@ namespace litecore {
     }
 
 
+    void SequenceTracker::addExternalChanges(const vector<Change> &changes) {
+        if (inTransaction()) {
+            // Don't mix them up with the transaction's changes; add them once it ends:
+            _pendingExternalChanges.insert(_pendingExternalChanges.end(),
+                                           changes.begin(), changes.end());
+            return;
+        }
+        bool observed = !_changes.empty() || _numDocObservers > 0;
+        bool listChanged = false;
+        size_t nRecorded = 0;
+        for (auto &change : changes) {
+            _lastSequence = max(_lastSequence, change.sequence);
+            if (!observed)
+                continue;
+            Entry *entry = _byDocID.find(change.docID);
+            if (entry && entry->sequence >= change.sequence)
+                continue;
+            if (_recordChange(change.docID, change.revID, change.sequence, change.bodySize))
+                listChanged = true;
+            ++nRecorded;
+        }
+        if (nRecorded > 0) {
+            logInfo("addExternalChanges: %zu changes from another process", nRecorded);
+            if (listChanged)
+                _notifyPlaceholdersBefore(nRecorded);
+            removeObsoleteEntries();
+        }
+    }
+
+
     SequenceTracker::const_iterator
     SequenceTracker::_since(sequence_t sinceSeq) const {
         if (sinceSeq >= _lastSequence) {
-            return _changes.cend();
+            return _changes.end();
         } else {
             // Scan back till we find a document entry with sequence less than sinceSeq
             // (but not a purge); then back up one:
-            auto result = _changes.crbegin();
-            for (auto i = _changes.crbegin(); i != _changes.crend(); ++i) {
+            auto result = _changes.rbegin();
+            for (auto i = _changes.rbegin(); i != _changes.rend(); ++i) {
                 if (i->sequence > sinceSeq || i->isPurge())
                     result = i;
                 else if (!i->isPlaceholder())
@@ -225,11 +312,11 @@ namespace litecore {
     SequenceTracker::addPlaceholderAfter(DatabaseChangeNotifier *obs, sequence_t seq) {
         Assert(obs);
         ++_numPlaceholders;
-        return _changes.emplace(_since(seq), obs);
+        return _changes.insert(_since(seq), _pool.make(obs));
     }
 
     void SequenceTracker::removePlaceholder(const_iterator placeholder) {
-        _changes.erase(placeholder);
+        _destroy(_changes, placeholder);
         --_numPlaceholders;
         removeObsoleteEntries();
     }
@@ -278,10 +365,9 @@ namespace litecore {
         while (_changes.size() > kMinChangesToKeep + _numPlaceholders
                     && !_changes.front().isPlaceholder()) {
             auto &entry = _changes.front();
-            if (entry.documentObservers.empty()) {
+            if (!entry.documentObservers) {
                 // Remove entry entirely if it has no observers
-                _byDocID.erase(entry.docID);
-                _changes.erase(_changes.begin());
+                _destroy(_changes, _changes.begin());
             } else {
                 // Move entry to idle list if it has observers
                 _idle.splice(_idle.end(), _changes, _changes.begin());
@@ -296,33 +382,37 @@ namespace litecore {
 
     SequenceTracker::const_iterator
     SequenceTracker::addDocChangeNotifier(slice docID, DocChangeNotifier* notifier) {
-        iterator entry;
         // Find the entry for the document:
-        auto i = _byDocID.find(docID);
-        if (i != _byDocID.end()) {
-            entry = i->second;
-        } else {
+        Entry *entry = _byDocID.find(docID);
+        if (!entry) {
             // Document isn't known yet; create an entry and put it in the _idle list
-            entry = _idle.emplace(_idle.end(), alloc_slice(docID), alloc_slice(), 0, 0);
+            entry = _pool.make(alloc_slice(docID), alloc_slice(), 0, 0);
             entry->idle = true;
-            _byDocID[entry->docID] = entry;
+            _idle.insert(_idle.end(), entry);
+            _byDocID.insert(entry);
         }
-        entry->documentObservers.push_back(notifier);
+        // Append the notifier to the entry's list of observers:
+        auto link = &entry->documentObservers;
+        while (*link)
+            link = &(*link)->_nextObserver;
+        *link = notifier;
         ++_numDocObservers;
-        return entry;
+        return const_iterator(entry);
     }
 
 
     void SequenceTracker::removeDocChangeNotifier(const_iterator entry, DocChangeNotifier* notifier) {
-        auto &observers = const_cast<vector<DocChangeNotifier*>&>(entry->documentObservers);
-        auto i = find(observers.begin(), observers.end(), notifier);
-        Assert(i != observers.end());
-        observers.erase(i);
+        auto link = &mutableEntry(entry)->documentObservers;
+        while (*link != notifier) {
+            Assert(*link);
+            link = &(*link)->_nextObserver;
+        }
+        *link = notifier->_nextObserver;
+        notifier->_nextObserver = nullptr;
         --_numDocObservers;
-        if (observers.empty() && entry->isIdle()) {
-            _byDocID.erase(entry->docID);
+        if (!entry->documentObservers && entry->isIdle()) {
             Assert(!_idle.empty());
-            _idle.erase(entry);
+            _destroy(_idle, entry);
         }
     }
 
@@ -358,6 +448,182 @@ namespace litecore {
 #endif
 
 
+#pragma mark - ENTRY LIST:
+
+
+    SequenceTracker::const_iterator
+    SequenceTracker::EntryList::insert(const_iterator pos, Entry *entry) {
+        Entry *next = pos._entry, *prev = next->_prev;
+        entry->_prev = prev;
+        entry->_next = next;
+        prev->_next = next->_prev = entry;
+        ++_size;
+        return const_iterator(entry);
+    }
+
+
+    void SequenceTracker::EntryList::remove(Entry *entry) {
+        DebugAssert(entry != &_head && _size > 0);
+        entry->_prev->_next = entry->_next;
+        entry->_next->_prev = entry->_prev;
+        entry->_prev = entry->_next = nullptr;
+        --_size;
+    }
+
+
+    void SequenceTracker::EntryList::splice(const_iterator pos, EntryList &from, const_iterator i) {
+        if (pos == i)
+            return;
+        Entry *entry = i._entry;
+        from.remove(entry);
+        insert(pos, entry);
+    }
+
+
+#pragma mark - ENTRY POOL:
+
+
+    // A chunk of Entry-sized slots. Slots are handed out in order, then recycled via a free list.
+    struct SequenceTracker::EntryPool::Chunk {
+        static constexpr size_t kCapacity = 256;
+
+        struct Slot {
+            Chunk* chunk;
+            union {
+                Slot* nextFree;
+                alignas(Entry) uint8_t entry[sizeof(Entry)];
+            };
+        };
+
+        Slot    slots[kCapacity];
+        Slot*   freeList {nullptr};
+        size_t  used {0};                   // Number of slots ever handed out
+        size_t  live {0};                   // Number of slots currently allocated
+
+        bool full() const                   {return !freeList && used == kCapacity;}
+
+        static Slot* slotOf(void *entry) {
+            return (Slot*)((uint8_t*)entry - offsetof(Slot, entry));
+        }
+    };
+
+
+    SequenceTracker::EntryPool::~EntryPool() {
+        delete _current;
+        for (auto chunk : _partial)
+            delete chunk;
+    }
+
+
+    void* SequenceTracker::EntryPool::allocate() {
+        if (!_current || _current->full()) {
+            if (!_partial.empty()) {
+                _current = _partial.back();
+                _partial.pop_back();
+            } else {
+                _current = new Chunk;   // (a full chunk is let go; it's freed when it empties)
+            }
+        }
+        Chunk::Slot *slot = _current->freeList;
+        if (slot)
+            _current->freeList = slot->nextFree;
+        else
+            slot = &_current->slots[_current->used++];
+        slot->chunk = _current;
+        ++_current->live;
+        return slot->entry;
+    }
+
+
+    void SequenceTracker::EntryPool::free(void *entry) {
+        Chunk::Slot *slot = Chunk::slotOf(entry);
+        Chunk *chunk = slot->chunk;
+        bool wasFull = chunk->full();
+        slot->nextFree = chunk->freeList;
+        chunk->freeList = slot;
+        --chunk->live;
+        if (chunk == _current)
+            return;
+        if (wasFull) {
+            _partial.push_back(chunk);
+        } else if (chunk->live == 0) {
+            _partial.erase(std::find(_partial.begin(), _partial.end(), chunk));
+            delete chunk;
+        }
+    }
+
+
+#pragma mark - DOC INDEX:
+
+
+    static inline size_t hashDocID(slice docID) {
+        return fleece::sliceHash{}(docID);
+    }
+
+
+    SequenceTracker::Entry* SequenceTracker::DocIndex::find(slice docID) const {
+        if (_count == 0)
+            return nullptr;
+        size_t hash = hashDocID(docID), mask = _table.size() - 1;
+        for (size_t i = hash & mask; _table[i].entry; i = (i + 1) & mask) {
+            if (_table[i].hash == hash && _table[i].entry->docID == docID)
+                return _table[i].entry;
+        }
+        return nullptr;
+    }
+
+
+    void SequenceTracker::DocIndex::insert(Entry *entry) {
+        DebugAssert(!find(entry->docID));
+        if ((_count + 1) * 4 > _table.size() * 3)             // Keep load factor under 3/4
+            resize(max(_table.size() * 2, size_t(16)));
+        place({entry, hashDocID(entry->docID)});
+        ++_count;
+    }
+
+
+    void SequenceTracker::DocIndex::place(Slot slot) {
+        size_t mask = _table.size() - 1;
+        size_t i = slot.hash & mask;
+        while (_table[i].entry)
+            i = (i + 1) & mask;
+        _table[i] = slot;
+    }
+
+
+    void SequenceTracker::DocIndex::erase(const Entry *entry) {
+        size_t mask = _table.size() - 1;
+        size_t i = hashDocID(entry->docID) & mask;
+        while (_table[i].entry != entry) {
+            Assert(_table[i].entry);
+            i = (i + 1) & mask;
+        }
+        // Shift later entries of the probe sequence back into the gap, so lookups don't need
+        // tombstones:
+        for (size_t j = (i + 1) & mask; _table[j].entry; j = (j + 1) & mask) {
+            size_t home = _table[j].hash & mask;
+            if (((j - home) & mask) >= ((j - i) & mask)) {
+                _table[i] = _table[j];
+                i = j;
+            }
+        }
+        _table[i] = {nullptr, 0};
+        --_count;
+        if (_table.size() > 16 && _count * 8 < _table.size())
+            resize(_table.size() / 2);
+    }
+
+
+    void SequenceTracker::DocIndex::resize(size_t tableSize) {
+        vector<Slot> old(tableSize, Slot{nullptr, 0});
+        swap(old, _table);
+        for (auto &slot : old) {
+            if (slot.entry)
+                place(slot);
+        }
+    }
+
+
 #pragma mark - DOC CHANGE NOTIFIER:
 
 
@@ -20,8 +20,8 @@
 #include "Base.hh"
 #include "Error.hh"
 #include "Logging.hh"
-#include <list>
-#include <unordered_map>
+#include <iterator>
+#include <memory>
 #include <vector>
 #include <functional>
 
@@ -44,6 +44,7 @@ namespace litecore {
         struct Entry;
 
         SequenceTracker();
+        ~SequenceTracker();
 
         void beginTransaction();
         void endTransaction(bool commit);
@@ -57,9 +58,20 @@ namespace litecore {
         /** Document implementation calls this to register the change with the Notifier. */
         void documentPurged(slice docID);
 
+        /** Registers a number of purged documents at once, notifying database observers only
+            once for the whole set. (Used when expiring documents.) */
+        void documentsPurged(const std::vector<alloc_slice> &docIDs);
+
         /** Copy the other tracker's transaction's changes into myself as committed & external */
         void addExternalTransaction(const SequenceTracker &from);
 
+        struct Change;
+
+        /** Adds changes committed by another process, as committed & external. Changes older
+            than what's already known about a document are ignored. If a transaction is open,
+            they're added after it ends. */
+        void addExternalChanges(const std::vector<Change>&);
+
         sequence_t lastSequence() const        {return _lastSequence;}
 
         /** Tracks a document's current sequence. */
@@ -70,8 +82,8 @@ namespace litecore {
             // Document entry (when docID != nullslice):
             sequence_t                      committedSequence {0};
             alloc_slice                     revID;
-            std::vector<DocChangeNotifier*> documentObservers;
-            uint32_t                        bodySize;
+            DocChangeNotifier*              documentObservers {nullptr};  // linked list
+            uint32_t                        bodySize {0};
             bool                            idle     :1;
             bool                            external :1;
 
@@ -83,11 +95,16 @@ namespace litecore {
                 DebugAssert(docID != nullslice);
             }
             Entry(DatabaseChangeNotifier *o)
-            :databaseObserver(o) { }    // placeholder
+            :idle(false), external(false), databaseObserver(o) { }    // placeholder
 
             bool isPlaceholder() const          {return docID.buf == nullptr;}
             bool isPurge() const                {return sequence == 0 && !isPlaceholder();}
             bool isIdle() const                 {return idle && !isPlaceholder();}
+
+        private:
+            friend class SequenceTracker;
+            Entry* _prev {nullptr};             // Links in the _changes or _idle list
+            Entry* _next {nullptr};
         };
 
         struct Change {
@@ -108,9 +125,33 @@ namespace litecore {
 
         static size_t kMinChangesToKeep;        // exposed for testing purposes only
 
-    protected:
-        typedef std::list<Entry>::const_iterator const_iterator;
+        /** Bidirectional iterator over a list of Entries. */
+        class const_iterator {
+        public:
+            using iterator_category = std::bidirectional_iterator_tag;
+            using value_type        = const Entry;
+            using difference_type   = ptrdiff_t;
+            using pointer           = const Entry*;
+            using reference         = const Entry&;
+
+            const_iterator()                                =default;
+            explicit const_iterator(Entry *e)               :_entry(e) { }
+
+            const Entry& operator* () const                 {return *_entry;}
+            const Entry* operator-> () const                {return _entry;}
+            const_iterator& operator++ ()                   {_entry = _entry->_next; return *this;}
+            const_iterator& operator-- ()                   {_entry = _entry->_prev; return *this;}
+            const_iterator operator++ (int)                 {auto i = *this; ++*this; return i;}
+            const_iterator operator-- (int)                 {auto i = *this; --*this; return i;}
+            bool operator== (const const_iterator &i) const {return _entry == i._entry;}
+            bool operator!= (const const_iterator &i) const {return _entry != i._entry;}
+
+        private:
+            friend class SequenceTracker;
+            Entry* _entry {nullptr};
+        };
 
+    protected:
         bool inTransaction() const              {return _transaction.get() != nullptr;}
 
         bool hasDBChangeNotifiers() const {
@@ -138,22 +179,103 @@ namespace litecore {
         friend class DocChangeNotifier;
         friend class SequenceTrackerTest;
 
+        /** A circular doubly-linked list of Entries, whose links are inside the Entries. */
+        class EntryList {
+        public:
+            using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+            EntryList()                                 {_head._prev = _head._next = &_head;}
+            EntryList(const EntryList&) =delete;
+
+            const_iterator begin() const                {return const_iterator(_head._next);}
+            const_iterator end() const                  {return const_iterator(head());}
+            const_reverse_iterator rbegin() const       {return const_reverse_iterator(end());}
+            const_reverse_iterator rend() const         {return const_reverse_iterator(begin());}
+            bool empty() const                          {return _size == 0;}
+            size_t size() const                         {return _size;}
+            Entry& front() const                        {return *_head._next;}
+
+            /** Links `entry` into the list before `pos`. */
+            const_iterator insert(const_iterator pos, Entry *entry);
+            /** Unlinks `entry` from the list. */
+            void remove(Entry *entry);
+            /** Moves the entry at `i`, which is in list `from`, to before `pos`. */
+            void splice(const_iterator pos, EntryList &from, const_iterator i);
+
+        private:
+            Entry* head() const                         {return const_cast<Entry*>(&_head);}
+
+            Entry _head {nullptr};                      // Sentinel; not a real Entry
+            size_t _size {0};
+        };
+
+        /** Allocates Entries in chunks, so recording a change rarely has to call malloc.
+            A chunk is freed when all its Entries are. */
+        class EntryPool {
+        public:
+            EntryPool() =default;
+            EntryPool(const EntryPool&) =delete;
+            ~EntryPool();
+
+            template <class... Args>
+            Entry* make(Args&&... args)         {return new (allocate()) Entry(std::forward<Args>(args)...);}
+            void destroy(Entry *entry)          {entry->~Entry(); free(entry);}
+
+        private:
+            struct Chunk;
+            void* allocate();
+            void free(void*);
+
+            Chunk* _current {nullptr};          // Chunk being allocated from
+            std::vector<Chunk*> _partial;       // Other chunks with free space
+        };
+
+        /** Maps docIDs to their Entries. An open-addressing hash table, so adding a document
+            doesn't allocate a node. */
+        class DocIndex {
+        public:
+            Entry* find(slice docID) const;
+            void insert(Entry* NONNULL);
+            void erase(const Entry* NONNULL);
+            size_t size() const                 {return _count;}
+
+        private:
+            struct Slot {
+                Entry* entry;                   // null if the slot is empty
+                size_t hash;                    // hash of entry->docID
+            };
+
+            void resize(size_t tableSize);
+            void place(Slot);
+
+            std::vector<Slot> _table;           // Size is a power of 2
+            size_t _count {0};
+        };
+
+        static Entry* mutableEntry(const_iterator i)    {return i._entry;}
+
         void _documentChanged(const alloc_slice &docID,
                               const alloc_slice &revID,
                               sequence_t sequence,
                               uint64_t bodySize);
+        bool _recordChange(const alloc_slice &docID,
+                           const alloc_slice &revID,
+                           sequence_t sequence,
+                           uint64_t bodySize);
+        void _notifyPlaceholdersBefore(size_t nChanges);
         const_iterator _since(sequence_t s) const;
+        void _destroy(EntryList&, const_iterator);
 
-        typedef std::list<Entry>::iterator iterator;
-
-        std::list<Entry>                        _changes;
-        std::list<Entry>                        _idle;
-        std::unordered_map<slice, iterator, fleece::sliceHash> _byDocID;
+        EntryPool                               _pool;
+        EntryList                               _changes;
+        EntryList                               _idle;
+        DocIndex                                _byDocID;
         sequence_t                              _lastSequence {0};
         size_t                                  _numPlaceholders {0};
         size_t                                  _numDocObservers {0};
         std::unique_ptr<DatabaseChangeNotifier> _transaction;
         sequence_t                              _preTransactionLastSequence;
+        std::vector<Change>                     _pendingExternalChanges;
     };
 
 
@@ -179,6 +301,7 @@ namespace litecore {
     private:
         friend class SequenceTracker;
         SequenceTracker::const_iterator const _docEntry;
+        DocChangeNotifier* _nextObserver {nullptr};     // Next observer of the same Entry
     };
 
 
@@ -31,6 +31,8 @@ namespace litecore {
             kFullText,      ///< Full-text index, for MATCH queries
             kArray,         ///< Index of array values, for UNNEST queries
             kPredictive,    ///< Index of prediction results
+            kVector,        ///< Approximate nearest-neighbor index of vectors
+            kHotProperty,   ///< Property materialized in a table, for faster queries
         };
 
         struct Options {
@@ -38,6 +40,8 @@ namespace litecore {
             bool ignoreDiacritics;  ///< True to strip diacritical marks/accents from letters
             bool disableStemming;   ///< Disables stemming
             const char* stopWords;  ///< NULL for default, or comma-delimited string, or empty
+            unsigned numCentroids;  ///< Vector index: number of clusters, or 0 for default
+            unsigned numProbes;     ///< Vector index: clusters searched per query, or 0 for default
         };
 
         IndexSpec(std::string name_,
@@ -54,7 +58,8 @@ namespace litecore {
         void validateName() const;
 
         const char* typeName() const {
-            static const char* kTypeName[] = {"value", "full-text", "array", "predictive"};
+            static const char* kTypeName[] = {"value", "full-text", "array", "predictive",
+                                                "vector", "hot-property"};
             return kTypeName[type];
         }
 
@@ -66,6 +71,10 @@ namespace litecore {
         /** The optional WHERE clause: the condition for a partial index */
         const fleece::impl::Array* where() const;
 
+        /** The optional INCLUDE clause of a value index: more expressions whose values are
+            stored alongside the indexed ones, making it a covering index. */
+        const fleece::impl::Array* include() const;
+
         std::string const            name;
         Type        const            type;
         alloc_slice const            expressionJSON;
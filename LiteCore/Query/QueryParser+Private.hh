@@ -45,6 +45,9 @@ namespace litecore { namespace qp {
     constexpr slice kArrayFnNameWithParens = "array_of()"_sl;
     constexpr slice kDictFnName = "dict_of"_sl;
     constexpr slice kVersionFnName  = "fl_version"_sl;
+    constexpr slice kScalarValueFnName = "fl_scalar_value"_sl;
+    constexpr slice kSubtypesFnName = "fl_subtypes"_sl;
+    constexpr slice kTypedFnName = "fl_typed"_sl;
 
     // Existing SQLite FTS rank function:
     constexpr slice kRankFnName  = "rank"_sl;
@@ -54,6 +57,10 @@ namespace litecore { namespace qp {
     constexpr slice kPredictionFnName = "prediction"_sl;
     constexpr slice kPredictionFnNameWithParens = "prediction()"_sl;
 
+    constexpr slice kEuclideanDistanceFnName = "euclidean_distance"_sl;
+    constexpr slice kEuclideanDistanceFnNameWithParens = "euclidean_distance()"_sl;
+    constexpr slice kVectorPackFnName = "vector_pack"_sl;
+
     const char* const kDefaultTableAlias = "_doc";
 
 
@@ -0,0 +1,151 @@
+#ifdef COUCHBASE_ENTERPRISE
+
+//
+// QueryParser+VectorSearch.cc
+//
+// Copyright © 2019 Couchbase. All rights reserved.
+//
+//  COUCHBASE LITE ENTERPRISE EDITION
+//
+//  Licensed under the Couchbase License Agreement (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//  https://info.couchbase.com/rs/302-GJY-034/images/2017-10-30_License_Agreement.pdf
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#include "QueryParser.hh"
+#include "QueryParser+Private.hh"
+#include "FleeceImpl.hh"
+#include "DeepIterator.hh"
+#include "StringUtil.hh"
+
+using namespace std;
+using namespace fleece;
+using namespace fleece::impl;
+using namespace litecore::qp;
+
+namespace litecore {
+
+    /*
+     A vector index (see SQLiteKeyStore+VectorIndexes.cc) partitions documents' vectors into
+     buckets, each with a centroid. A query of the form
+        ORDER BY euclidean_distance(<indexed expr>, <target>) LIMIT k
+     is rewritten to join with the vector table, and to only consider the rows whose bucket is
+     one of the `probes` buckets whose centroids are nearest the target.
+     */
+
+
+    // Returns true if an expression can only be a constant vector: an array literal of numbers,
+    // or a query parameter. (The search target can't depend on the document.)
+    static bool isConstantVector(const Value *expr) {
+        for (DeepIterator di(expr); di; ++di) {
+            auto value = di.value();
+            switch (value->type()) {
+                case kNumber:
+                case kArray:
+                    break;
+                case kString: {
+                    slice str = value->asString();
+                    if (str != "[]"_sl && !str.hasPrefix('$'))
+                        return false;
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+        return true;
+    }
+
+
+    // Looks for a nearest-neighbor search -- the first ORDER_BY item is an ascending
+    // euclidean_distance() from a constant vector, and there's a LIMIT -- on an expression that
+    // has a vector index. If found, adds the vector table to _indexJoinTables.
+    void QueryParser::findVectorSearch(const Dict *operands) {
+        auto orderBy = getCaseInsensitive(operands, "ORDER_BY"_sl);
+        if (!orderBy || !getCaseInsensitive(operands, "LIMIT"_sl))
+            return;
+        auto orderArray = orderBy->asArray();
+        if (!orderArray || orderArray->empty())
+            return;
+        auto order = orderArray->get(0)->asArray();
+        if (order && order->count() == 2 && order->get(0)->asString().caseEquivalent("ASC"_sl))
+            order = order->get(1)->asArray();
+        if (!order || order->count() < 3
+                   || !order->get(0)->asString().caseEquivalent(kEuclideanDistanceFnNameWithParens))
+            return;
+
+        for (unsigned i = 1; i <= 2; ++i) {
+            auto vectorExpr = order->get(i)->asArray();
+            auto target = order->get(3 - i);
+            if (!vectorExpr || !isConstantVector(target))
+                continue;
+            string table = vectorTableName(vectorExpr);
+            if (_delegate.tableExists(table)) {
+                _vectorTable = table;
+                _vectorTarget = target;
+                indexJoinTableAlias(table, "vec");
+                return;
+            }
+        }
+    }
+
+
+    // Returns the name of the vector index table for an expression.
+    string QueryParser::vectorTableName(const Value *expression) const {
+        return _delegate.vectorTableName(indexedExpressionName(expression, "vector index"));
+    }
+
+
+    // Returns the name of the table holding a vector index's centroids.
+    /*static*/ string QueryParser::vectorCentroidsTableName(const string &vectorTableName) {
+        return vectorTableName + ":centroids";
+    }
+
+
+    // Writes a euclidean_distance() call that reads the pre-packed vector from the vector table,
+    // if the call's vector expression is the one being searched.
+    bool QueryParser::writeIndexedVectorDistance(const Array *node) {
+        if (_vectorTable.empty())
+            return false;
+        for (unsigned i = 1; i <= 2; ++i) {
+            auto vectorExpr = node->get(i)->asArray();
+            if (!vectorExpr || vectorTableName(vectorExpr) != _vectorTable)
+                continue;
+            _sql << kEuclideanDistanceFnName << "(" << indexJoinTableAlias(_vectorTable)
+                 << ".vector, ";
+            _context.push_back(&kArgListOperation);
+            parseNode(node->get(3 - i));
+            for (unsigned arg = 3; arg < node->count(); ++arg) {
+                _sql << ", ";
+                parseNode(node->get(arg));
+            }
+            _context.pop_back();
+            _sql << ")";
+            return true;
+        }
+        return false;
+    }
+
+
+    // Appends to the WHERE clause a test that restricts the search to the nearest buckets.
+    void QueryParser::writeVectorSearchFilter() {
+        string centroids = vectorCentroidsTableName(_vectorTable);
+        _sql << " AND " << indexJoinTableAlias(_vectorTable) << ".bucket IN "
+                "(SELECT bucket FROM \"" << centroids << "\" ORDER BY "
+             << kEuclideanDistanceFnName << "(vector, ";
+        _context.push_back(&kArgListOperation);
+        parseNode(_vectorTarget);
+        _context.pop_back();
+        _sql << ", 2) LIMIT (SELECT probes FROM \"" << centroids << "\" LIMIT 1))";
+    }
+
+}
+
+#endif // COUCHBASE_ENTERPRISE
@@ -158,6 +158,9 @@ namespace litecore {
         _variables.clear();
         _ftsTables.clear();
         _indexJoinTables.clear();
+        _hotProperties.clear();
+        _vectorTable.clear();
+        _vectorTarget = nullptr;
         _aliases.clear();
         _dbAlias.clear();
         _columnTitles.clear();
@@ -168,6 +171,11 @@ namespace litecore {
     }
 
 
+    // Thrown while generating SQL for a covering index's table, if the query can't be answered
+    // from that table alone.
+    struct NotCovered { };
+
+
     static void handleFleeceException(const FleeceException &x) {
         switch (x.code) {
             case PathSyntaxError:   fail("Invalid property path: %s", x.what());
@@ -187,6 +195,27 @@ namespace litecore {
     
     
     void QueryParser::parse(const Value *expression) {
+        // First try to generate SQL that reads only a covering index's table. If the query needs
+        // anything that table lacks, the attempt is abandoned by throwing NotCovered.
+        auto coveringIndexes = _delegate.coveringIndexes();
+        for (auto &index : coveringIndexes) {
+            _coveringIndex = &index;
+            try {
+                parseStatement(expression);
+                _coveringIndex = nullptr;
+                return;
+            } catch (const NotCovered&) {
+            } catch (...) {
+                _coveringIndex = nullptr;
+                throw;
+            }
+        }
+        _coveringIndex = nullptr;
+        parseStatement(expression);
+    }
+
+
+    void QueryParser::parseStatement(const Value *expression) {
         reset();
         try {
             if (expression->asDict()) {
@@ -238,6 +267,20 @@ namespace litecore {
         // Add the indexed prediction() calls to _indexJoinTables now
         findPredictionCalls(operands);
 
+        // Likewise a nearest-neighbor ORDER BY that can use a vector index:
+        findVectorSearch(operands);
+
+        if (_coveringIndex) {
+            // A covering index's table can't be joined with anything else:
+            if (_aliases.size() > 1 || !_ftsTables.empty() || !_indexJoinTables.empty())
+                throw NotCovered();
+        } else {
+            // Find the properties that can be read from hot-property tables:
+            if (where)
+                findHotProperties(where);
+            findHotProperties(operands);
+        }
+
         _sql << "SELECT ";
 
         // DISTINCT:
@@ -269,6 +312,10 @@ namespace litecore {
 
         // WHERE clause:
         writeWhereClause(where);
+#ifdef COUCHBASE_ENTERPRISE
+        if (!_vectorTable.empty())
+            writeVectorSearchFilter();
+#endif
 
         // GROUP_BY clause:
         bool grouped = (writeSelectListClause(operands, "GROUP_BY"_sl, " GROUP BY ") > 0);
@@ -343,6 +390,15 @@ namespace litecore {
 
     void QueryParser::writeWhereClause(const Value *where) {
         _checkedDeleted = false;
+        if (_coveringIndex) {
+            // A covering index's table only contains live documents:
+            if (where) {
+                _sql << " WHERE (";
+                parseNode(where);
+                _sql << ")";
+            }
+            return;
+        }
         _sql << " WHERE ";
         if (where) {
             _sql << "(";
@@ -358,6 +414,8 @@ namespace litecore {
 
 
     void QueryParser::writeDeletionTest(const string &alias, bool isDeleted) {
+        if (_coveringIndex)
+            throw NotCovered();
         _sql << "(";
         if (!alias.empty())
             _sql << quoteTableName(alias) << '.';
@@ -457,7 +515,10 @@ namespace litecore {
     void QueryParser::writeFromClause(const Value *from) {
         auto fromArray = (const Array*)from;    // already type-checked by parseFromClause
 
-        _sql << " FROM " << _tableName;
+        if (_coveringIndex)
+            _sql << " FROM \"" << _coveringIndex->tableName << "\"";
+        else
+            _sql << " FROM " << _tableName;
 
         if (fromArray && !fromArray->empty()) {
             for (Array::iterator i(fromArray); i; ++i) {
@@ -527,13 +588,22 @@ namespace litecore {
             _sql << " AS " << quoteTableName(_dbAlias);
         }
 
-        // Add joins to index tables (FTS, predictive):
+        // Add joins to index tables (FTS, predictive, vector):
         for (auto &ftsTable : _indexJoinTables) {
             auto &table = ftsTable.first;
             auto &alias = ftsTable.second;
             _sql << " JOIN \"" << table << "\" AS " << alias
                  << " ON " << alias << ".docid = " << quoteTableName(_dbAlias) << ".rowid";
         }
+
+        // Add outer joins to hot-property tables, which lack rows for some docs:
+        for (auto &hot : _hotProperties) {
+            auto &alias = hot.second;
+            if (!alias.empty())
+                _sql << " LEFT JOIN \"" << _delegate.hotPropertyTableName(hot.first) << "\" AS "
+                     << alias << " ON " << alias << ".docid = " << quoteTableName(_dbAlias)
+                     << ".rowid";
+        }
     }
 
 
@@ -567,7 +637,8 @@ namespace litecore {
             case kData:
                 fail("Binary data not supported in query");
             case kArray:
-                parseOpNode((const Array*)node);
+                if (!_coveringIndex || !writeCoveredExpression((const Array*)node))
+                    parseOpNode((const Array*)node);
                 break;
             case kDict:
                 writeDictLiteral((const Dict*)node);
@@ -1148,6 +1219,11 @@ namespace litecore {
 #ifdef COUCHBASE_ENTERPRISE
         if (op.caseEquivalent(kPredictionFnName) && writeIndexedPrediction((const Array*)_curNode))
             return;
+
+        // Special case: "euclidean_distance()" may use a vector index:
+        if (op.caseEquivalent(kEuclideanDistanceFnName)
+                && writeIndexedVectorDistance((const Array*)_curNode))
+            return;
 #endif
 
         if(!_collationUsed && spec->wants_collation) {
@@ -1264,6 +1340,9 @@ namespace litecore {
 
     void QueryParser::writeMetaProperty(slice fn, const string &tablePrefix, const char *property) {
         require(fn == kValueFnName, "can't use '_%s' in this context", property);
+        // A covering index's table has the key and sequence, but no other metadata:
+        if (_coveringIndex && slice(property) != "key"_sl && slice(property) != "sequence"_sl)
+            throw NotCovered();
         _sql << tablePrefix << property;
     }
 
@@ -1340,6 +1419,8 @@ namespace litecore {
                 _checkedDeleted = true;     // note that the query has tested _deleted
                 return;
             } else if (meta == kRevIDProperty) {
+                if (_coveringIndex)
+                    throw NotCovered();
                 _sql << kVersionFnName << "(" << tablePrefix << "version" << ")";
                 return;
             }
@@ -1349,6 +1430,23 @@ namespace litecore {
         if (property.empty() && fn == kValueFnName)
             fn = kRootFnName;
 
+        // A covering index's table has no document bodies:
+        if (_coveringIndex)
+            throw NotCovered();
+
+        // A hot property is read from its table, falling back to the body if it has no row:
+        if (fn == kValueFnName && !param && iType->second == kDBAlias && !_hotProperties.empty()) {
+            string path(property);
+            auto hot = _hotProperties.find(path);
+            if (hot != _hotProperties.end() && !hot->second.empty()) {
+                _sql << "IFNULL(" << hot->second << ".value, "
+                     << fn << "(" << tablePrefix << _bodyColumnName << ", ";
+                writeSQLString(_sql, path);
+                _sql << "))";
+                return;
+            }
+        }
+
         // Write the function call:
         _sql << fn << "(" << tablePrefix << _bodyColumnName;
         if(!property.empty()) {
@@ -1535,13 +1633,14 @@ namespace litecore {
     }
 
 
-    // Returns the index table name for an unnested array property.
-    string QueryParser::unnestedTableName(const Value *arrayExpr) const {
-        string path(propertyFromNode(arrayExpr));
+    // Returns the name identifying an indexed expression in its index table's name: the property
+    // path if it's a property, else a digest.
+    string QueryParser::indexedExpressionName(const Value *expression, const char *what) const {
+        string path(propertyFromNode(expression));
         if (!path.empty()) {
             // It's a property path
             require(path.find('"') == string::npos,
-                    "invalid property path for array index");
+                    "invalid property path for %s", what);
             if (_propertiesUseSourcePrefix) {
                 string dbAliasPrefix = _dbAlias + ".";
                 if (hasPrefix(path, dbAliasPrefix))
@@ -1549,18 +1648,114 @@ namespace litecore {
             }
         } else {
             // It's some other expression; make a unique digest of it:
-            path = expressionIdentifier(arrayExpr->asArray());
+            path = expressionIdentifier(expression->asArray());
         }
-        return _delegate.unnestedTableName(path);
+        return path;
     }
 
 
-#pragma mark - PREDICTIVE QUERY:
+    // Returns the index table name for an unnested array property.
+    string QueryParser::unnestedTableName(const Value *arrayExpr) const {
+        return _delegate.unnestedTableName(indexedExpressionName(arrayExpr, "array index"));
+    }
+
+
+#pragma mark - HOT PROPERTIES:
+
+
+    // Returns the table name of a hot-property index, given the property expression.
+    string QueryParser::hotPropertyTableName(const Value *property) const {
+        string path(propertyFromNode(property));
+        require(!path.empty(), "hot-property index expression must be a property");
+        require(path.find('"') == string::npos && path[0] != '_',
+                "invalid property path for hot-property index");
+        return _delegate.hotPropertyTableName(path);
+    }
+
+
+    // Scans the query for document properties that are materialized in hot-property tables,
+    // and assigns each of those tables a join alias. (Nested SELECTs are parsed separately.)
+    // A property that also has a value index is read from the body as usual, since SQLite
+    // can't use that index for the IFNULL expression that reads a hot property.
+    void QueryParser::findHotProperties(const Value *root) {
+        for (DeepIterator di(root); di; ++di) {
+            auto node = di.value()->asArray();
+            if (!node || node->empty())
+                continue;
+            slice op = node->get(0)->asString();
+            if (op.caseEquivalent("SELECT"_sl)) {
+                di.skipChildren();
+                continue;
+            } else if (!op.hasPrefix('.')) {
+                continue;
+            }
+            Path property = propertyFromNode(node);
+            if (_propertiesUseSourcePrefix) {
+                if (property.empty() || !property[0].isKey()
+                                     || property[0].keyStr() != slice(_dbAlias))
+                    continue;
+                property.drop(1);
+            }
+            if (property.empty())
+                continue;
+            string path(property);
+            if (path[0] == '_' || path.find('"') != string::npos
+                               || _hotProperties.find(path) != _hotProperties.end())
+                continue;
+            string alias;
+            if (_delegate.tableExists(_delegate.hotPropertyTableName(path))
+                    && !_delegate.hasValueIndexOn(path)) {
+                auto n = count_if(_hotProperties.begin(), _hotProperties.end(),
+                                  [](auto &hot) {return !hot.second.empty();});
+                alias = "hot" + to_string(n + 1);
+            }
+            _hotProperties.insert({path, alias});
+        }
+    }
+
+
+#pragma mark - COVERING INDEXES:
+
+
+    // Returns the JSON that identifies an expression stored in a covering index.
+    string QueryParser::coveredExpressionJSON(const Value *expression) {
+        return expression->toJSON(true).asString();
+    }
+
+
+    // If the expression is stored in the covering index's table, writes its column and returns
+    // true. As function arguments and results, values need their subtypes, which fl_typed()
+    // restores; elsewhere, as in comparisons and sorting, SQLite ignores subtypes, so the bare
+    // column is written and the table's index can be used.
+    bool QueryParser::writeCoveredExpression(const Array *node) {
+        string json = coveredExpressionJSON(node);
+        if (_propertiesUseSourcePrefix)
+            replace(json, "[\"." + _dbAlias + ".", "[\".");
+        auto &expressions = _coveringIndex->expressions;
+        auto i = find(expressions.begin(), expressions.end(), json);
+        if (i == expressions.end())
+            return false;
+        auto column = i - expressions.begin();
+        string tablePrefix = quoteTableName(_dbAlias) + ".";
+        if (_context.back() == &kArgListOperation || _context.back() == &kResultListOperation) {
+            _sql << kTypedFnName << "(" << tablePrefix << 'c' << column << ", "
+                 << tablePrefix << "subtypes, " << column << ")";
+        } else {
+            _sql << tablePrefix << 'c' << column;
+        }
+        return true;
+    }
+
+
+#pragma mark - PREDICTIVE & VECTOR QUERY:
 
 
 #ifndef COUCHBASE_ENTERPRISE
     void QueryParser::findPredictionCalls(const Value *root) {
     }
+
+    void QueryParser::findVectorSearch(const Dict *operands) {
+    }
 #endif
 
 }
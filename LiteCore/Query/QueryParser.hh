@@ -38,6 +38,13 @@ namespace litecore {
 
     class QueryParser {
     public:
+        /** A covering value index's table, which holds each live doc's key and sequence plus the
+            values of the index's expressions, in columns "c0", "c1", .... */
+        struct CoveringIndex {
+            std::string tableName;
+            std::vector<std::string> expressions;   // JSON of each column's expression
+        };
+
         /** Delegate knows about the naming & existence of tables. */
         class delegate {
         public:
@@ -46,9 +53,13 @@ namespace litecore {
             virtual std::string bodyColumnName() const        {return "body";}
             virtual std::string FTSTableName(const std::string &property) const =0;
             virtual std::string unnestedTableName(const std::string &property) const =0;
+            virtual std::string hotPropertyTableName(const std::string &property) const =0;
 #ifdef COUCHBASE_ENTERPRISE
             virtual std::string predictiveTableName(const std::string &property) const =0;
+            virtual std::string vectorTableName(const std::string &property) const =0;
 #endif
+            virtual std::vector<CoveringIndex> coveringIndexes() const =0;
+            virtual bool hasValueIndexOn(const std::string &property) const =0;
             virtual bool tableExists(const std::string &tableName) const =0;
         };
 
@@ -87,8 +98,12 @@ namespace litecore {
         std::string FTSExpressionSQL(const fleece::impl::Value*);
         static std::string FTSColumnName(const fleece::impl::Value *expression);
         std::string unnestedTableName(const fleece::impl::Value *key) const;
+        std::string hotPropertyTableName(const fleece::impl::Value *property) const;
         std::string predictiveIdentifier(const fleece::impl::Value *) const;
         std::string predictiveTableName(const fleece::impl::Value *) const;
+        std::string vectorTableName(const fleece::impl::Value *) const;
+        static std::string vectorCentroidsTableName(const std::string &vectorTableName);
+        static std::string coveredExpressionJSON(const fleece::impl::Value *expression);
 
     private:
 
@@ -122,6 +137,7 @@ namespace litecore {
         QueryParser& operator=(const QueryParser&) =delete;
 
         void reset();
+        void parseStatement(const fleece::impl::Value*);
         void parseNode(const fleece::impl::Value*);
         void parseOpNode(const fleece::impl::Array*);
         void handleOperation(const Operation*, slice actualOperator, fleece::impl::Array::iterator& operands);
@@ -189,13 +205,19 @@ namespace litecore {
 
         unsigned findFTSProperties(const fleece::impl::Value *root);
         void findPredictionCalls(const fleece::impl::Value *root);
+        void findHotProperties(const fleece::impl::Value *root);
         const std::string& indexJoinTableAlias(const std::string &key, const char *aliasPrefix =nullptr);
         const std::string&  FTSJoinTableAlias(const fleece::impl::Value *matchLHS, bool canAdd =false);
         const std::string&  predictiveJoinTableAlias(const fleece::impl::Value *expr, bool canAdd =false);
         std::string FTSTableName(const fleece::impl::Value *key) const;
         std::string expressionIdentifier(const fleece::impl::Array *expression, unsigned maxItems =0) const;
+        std::string indexedExpressionName(const fleece::impl::Value *expression, const char *what) const;
         void findPredictiveJoins(const fleece::impl::Value *node, std::vector<std::string> &joins);
         bool writeIndexedPrediction(const fleece::impl::Array *node);
+        void findVectorSearch(const fleece::impl::Dict *operands);
+        bool writeIndexedVectorDistance(const fleece::impl::Array *node);
+        void writeVectorSearchFilter();
+        bool writeCoveredExpression(const fleece::impl::Array *node);
 
         const delegate& _delegate;                  // delegate object (SQLiteKeyStore)
         std::string _tableName;                     // Name of the table containing documents
@@ -210,7 +232,11 @@ namespace litecore {
         std::set<std::string> _parameters;          // Plug-in "$" parameters found in parsing
         std::set<std::string> _variables;           // Active variables, inside ANY/EVERY exprs
         std::map<std::string, std::string> _indexJoinTables;  // index table name --> alias
+        std::map<std::string, std::string> _hotProperties;    // property path --> alias, or ""
         std::vector<std::string> _ftsTables;        // FTS virtual tables being used
+        std::string _vectorTable;                   // Vector index table used for ORDER BY
+        const fleece::impl::Value* _vectorTarget {nullptr}; // Target vector of nearest-neighbor search
+        const CoveringIndex* _coveringIndex {nullptr}; // Covering index whose table is queried
         unsigned _1stCustomResultCol {0};           // Index of 1st result after _baseResultColumns
         bool _aggregatesOK {false};                 // Are aggregate fns OK to call?
         bool _isAggregateQuery {false};             // Is this an aggregate query?
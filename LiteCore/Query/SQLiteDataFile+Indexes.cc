@@ -76,8 +76,8 @@ namespace litecore {
         stmt.bind(      2, spec.type);
         stmt.bindNoCopy(3, keyStoreName);
         stmt.bindNoCopy(4, (char*)spec.expressionJSON.buf, (int)spec.expressionJSON.size);
-        if (spec.type != IndexSpec::kValue)
-            stmt.bindNoCopy(5, indexTableName);
+        if (spec.type != IndexSpec::kValue || (spec.expressionJSON && spec.include()))
+            stmt.bindNoCopy(5, indexTableName);     // (a covering value index has a table too)
         LogStatement(stmt);
         stmt.exec();
     }
@@ -114,8 +114,10 @@ namespace litecore {
             // Existing index is different, so delete it first:
             deleteIndex(*existingSpec);
         }
-        LogTo(QueryLog, "Creating %s index: %s", spec.typeName(), indexSQL.c_str());
-        exec(indexSQL);
+        if (!indexSQL.empty()) {
+            LogTo(QueryLog, "Creating %s index: %s", spec.typeName(), indexSQL.c_str());
+            exec(indexSQL);
+        }
         registerIndex(spec, keyStore->name(), indexTableName);
         return true;
     }
@@ -147,6 +149,9 @@ namespace litecore {
 
         LogTo(QueryLog, "Dropping unused index table '%s'", tableName.c_str());
         exec(CONCAT("DROP TABLE \"" << tableName << "\""));
+        // A vector index table has an auxiliary table of centroids:
+        exec(CONCAT("DROP TABLE IF EXISTS \""
+                    << QueryParser::vectorCentroidsTableName(tableName) << "\""));
 
         stringstream sql;
         static const char* kTriggerSuffixes[] = {"ins", "del", "upd", "preupdate", "postupdate",
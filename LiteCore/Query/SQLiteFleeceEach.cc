@@ -124,6 +124,7 @@ private:
 
     // Destructor for sqlite3_vtab
     static int disconnect(sqlite3_vtab *vtab) noexcept {
+        ((FleeceVTab*)vtab)->context.~fleeceFuncContext();
         free(vtab);
         return SQLITE_OK;
     }
@@ -65,6 +65,23 @@ namespace litecore {
         }
     }
 
+    // fl_scalar_value(body, propertyPath) -> propertyValue, if it's a string or a number that
+    // SQLite can store in a column without losing information (i.e. no subtype); else NULL.
+    // Used to populate hot-property tables.
+    static void fl_scalar_value(sqlite3_context* ctx, int argc, sqlite3_value **argv) noexcept {
+        try {
+            QueryFleeceScope scope(ctx, argv);
+            const Value *val = scope.root;
+            if (val && (val->type() == kString
+                            || (val->type() == kNumber && !val->isUnsigned())))
+                setResultFromValue(ctx, val);
+            else
+                sqlite3_result_null(ctx);
+        } catch (const std::exception &) {
+            sqlite3_result_error(ctx, "fl_scalar_value: exception!", -1);
+        }
+    }
+
     // fl_version(version) -> propertyValue (string)
     static void fl_version(sqlite3_context* ctx, int argc, sqlite3_value **argv) noexcept {
         try {
@@ -287,6 +304,30 @@ namespace litecore {
         sqlite3_result_subtype(ctx, kFleeceIntBoolean);
     }
 
+    // fl_subtypes(value, ...) -> integer with the subtypes of the arguments packed into it, three
+    // bits apiece. Table columns don't preserve subtypes, so covering-index tables store this
+    // alongside the values, and fl_typed() restores them.
+    static void fl_subtypes(sqlite3_context* ctx, int argc, sqlite3_value **argv) noexcept {
+        int64_t subtypes = 0;
+        for (int i = 0; i < argc && i < kMaxPackedSubtypes; ++i) {
+            auto subtype = sqlite3_value_subtype(argv[i]);
+            if (subtype >= kPlainBlobSubtype && subtype <= kFleeceIntUnsigned)
+                subtypes |= int64_t(subtype - kPlainBlobSubtype + 1) << (3 * i);
+        }
+        sqlite3_result_int64(ctx, subtypes);
+    }
+
+    // fl_typed(value, subtypes, n) -> value, with the nth subtype packed by fl_subtypes()
+    static void fl_typed(sqlite3_context* ctx, int argc, sqlite3_value **argv) noexcept {
+        sqlite3_result_value(ctx, argv[0]);
+        auto n = sqlite3_value_int(argv[2]);
+        if (n >= 0 && n < kMaxPackedSubtypes) {
+            auto code = (sqlite3_value_int64(argv[1]) >> (3 * n)) & 7;
+            if (code > 0)
+                sqlite3_result_subtype(ctx, kPlainBlobSubtype + unsigned(code) - 1);
+        }
+    }
+
 
 #pragma mark - CONTAINS()
 
@@ -500,6 +541,7 @@ namespace litecore {
         { "fl_root",           1, fl_root },
         { "fl_value",          2, fl_value },
         { "fl_version",        1, fl_version },
+        { "fl_scalar_value",   2, fl_scalar_value },
         { "fl_nested_value",   2, fl_nested_value },
         { "fl_fts_value",      2, fl_fts_value },
         { "fl_blob",           2, fl_blob },
@@ -509,6 +551,8 @@ namespace litecore {
         { "fl_result",         1, fl_result },
         { "fl_null",           0, fl_null },
         { "fl_bool",           1, fl_bool },
+        { "fl_subtypes",      -1, fl_subtypes },
+        { "fl_typed",          3, fl_typed },
         { "array_of",         -1, array_of },
         { "dict_of",          -1, dict_of },
         { "fl_callback",       4, fl_callback },
@@ -36,26 +36,6 @@ namespace litecore {
     const char* const kFleeceValuePointerType = "FleeceValue";
 
 
-    static slice argAsDocBody(sqlite3_context* ctx, sqlite3_value *arg, bool &copied) {
-        copied = false;
-        auto type = sqlite3_value_type(arg);
-        if (type == SQLITE_NULL)
-            return nullslice;             // No 'body' column; may be deleted doc
-        Assert(type == SQLITE_BLOB);
-        Assert(sqlite3_value_subtype(arg) == 0);
-        slice fleece = fleeceAccessor(ctx, valueAsSlice(arg));
-
-        if (size_t(fleece.buf) & 1) {
-            // Fleece data at odd addresses used to be allowed, and CBL 2.0/2.1 didn't 16-bit-align
-            // revision data, so it could occur. Now that it's not allowed, we have to work around
-            // this by copying the data to an even address. (#589)
-            fleece = fleece.copy();
-            copied = true;
-        }
-        return fleece;
-    }
-
-
     const Value* fleeceParam(sqlite3_context* ctx, sqlite3_value *arg, bool required) noexcept {
         switch (sqlite3_value_type(arg)) {
             case SQLITE_BLOB: {
@@ -125,29 +105,64 @@ namespace litecore {
     }
 
 
-    QueryFleeceScope::QueryFleeceScope(sqlite3_context *ctx, sqlite3_value **argv)
-    :Scope(argAsDocBody(ctx, argv[0], _copied),
-           ((fleeceFuncContext*)sqlite3_user_data(ctx))->sharedKeys)
-    {
-        if (data()) {
-            root = Value::fromTrustedData(data());
-            if (!root) {
-                Warn("Invalid Fleece data in SQLite table");
-                error::_throw(error::CorruptRevisionData);
+    const Value* QueryBodyCache::root(sqlite3_context *ctx, slice rawBody) {
+        for (auto &entry : _entries) {
+            if (entry.root && rawBody == slice(entry.rawBody.data(), entry.rawBody.size())) {
+                if (&entry != &_entries[0])
+                    swap(_entries[0], _entries[1]);
+                return _entries[0].root;
             }
-        } else {
-            root = Dict::kEmpty;             // No current revision body; may be deleted rev
         }
-        if (sqlite3_value_type(argv[1]) != SQLITE_NULL)
-        root = evaluatePathFromArg(ctx, argv, 1, root);
+
+        // Replace the least recently used entry, reusing its buffer:
+        swap(_entries[0], _entries[1]);
+        Entry &entry = _entries[0];
+        entry.scope.reset();
+        entry.root = nullptr;
+        entry.alignedData = nullslice;
+        entry.rawBody.assign((const uint8_t*)rawBody.buf, (const uint8_t*)rawBody.end());
+        slice fleece = fleeceAccessor(ctx, slice(entry.rawBody.data(), entry.rawBody.size()));
+        if (!fleece) {
+            entry.root = Dict::kEmpty;        // No current revision body; may be deleted rev
+            return entry.root;
+        }
+        if (size_t(fleece.buf) & 1) {
+            // Fleece data at odd addresses used to be allowed, and CBL 2.0/2.1 didn't 16-bit-align
+            // revision data, so it could occur. Now that it's not allowed, we have to work around
+            // this by copying the data to an even address. (#589)
+            entry.alignedData = alloc_slice(fleece);
+            fleece = entry.alignedData;
+        }
+        entry.scope = make_unique<Scope>(fleece,
+                                         ((fleeceFuncContext*)sqlite3_user_data(ctx))->sharedKeys);
+        entry.root = Value::fromTrustedData(fleece);
+        if (!entry.root) {
+            Warn("Invalid Fleece data in SQLite table");
+            entry.scope.reset();
+            error::_throw(error::CorruptRevisionData);
+        }
+        return entry.root;
+    }
+
+
+    void QueryBodyCache::clear() {
+        for (auto &entry : _entries)
+            entry = Entry();
     }
 
 
-    QueryFleeceScope::~QueryFleeceScope() {
-        if (_copied) {
-            unregister();
-            data().free();
+    QueryFleeceScope::QueryFleeceScope(sqlite3_context *ctx, sqlite3_value **argv) {
+        auto type = sqlite3_value_type(argv[0]);
+        if (type == SQLITE_NULL) {
+            root = Dict::kEmpty;             // No 'body' column; may be deleted doc
+        } else {
+            Assert(type == SQLITE_BLOB);
+            Assert(sqlite3_value_subtype(argv[0]) == 0);
+            auto context = (fleeceFuncContext*)sqlite3_user_data(ctx);
+            root = context->bodyCache->root(ctx, valueAsSlice(argv[0]));
         }
+        if (sqlite3_value_type(argv[1]) != SQLITE_NULL)
+            root = evaluatePathFromArg(ctx, argv, 1, root);
     }
 
 
@@ -283,6 +298,8 @@ namespace litecore {
 
     void RegisterSQLiteFunctions(sqlite3 *db, fleeceFuncContext context)
     {
+        if (!context.bodyCache)
+            context.bodyCache = make_shared<QueryBodyCache>();
         registerFunctionSpecs(db, context, kFleeceFunctionsSpec);
         registerFunctionSpecs(db, context, kRankFunctionsSpec);
         registerFunctionSpecs(db, context, kN1QLFunctionsSpec);
@@ -294,6 +311,7 @@ namespace litecore {
         // The functions registered below operate on virtual tables, not on the actual db,
         // so they should not use the db's Fleece accessor. That's why we clear it first.
         context.delegate = nullptr;
+        context.bodyCache = make_shared<QueryBodyCache>();
         registerFunctionSpecs(db, context, kFleeceNullAccessorFunctionsSpec);
     }
 
@@ -22,6 +22,7 @@
 #include "SQLite_Internal.hh"
 #include "FleeceImpl.hh"
 #include <sqlite3.h>
+#include <vector>
 
 
 namespace litecore {
@@ -35,21 +36,47 @@ namespace litecore {
         kFleeceIntUnsigned,             // Integer is unsigned
     };
 
+    // The number of subtypes fl_subtypes() can pack into an integer, at three bits apiece:
+    constexpr int kMaxPackedSubtypes = 21;
+
     extern const char* const kFleeceValuePointerType;
 
     static inline const fleece::impl::Value* asFleeceValue(sqlite3_value *value) {
         return (const fleece::impl::Value*) sqlite3_value_pointer(value, kFleeceValuePointerType);
     }
 
+    // Remembers the two most recently used document bodies, so that when a query calls several
+    // Fleece functions on the same row (or alternates between the two sides of a join) a body
+    // only has to be extracted by the delegate's accessor, aligned, and registered as a Scope
+    // once. SQLite doesn't tell a function which row it's on, and the address of a column's data
+    // isn't a usable key, since SQLite reads successive rows into the same buffer; so a hit is
+    // detected by comparing the data. The copies are kept in buffers that are reused, and the
+    // cache is cleared when a query finishes.
+    class QueryBodyCache {
+    public:
+        // Returns the root of the Fleece document in a raw 'body' column value.
+        const fleece::impl::Value* root(sqlite3_context*, slice rawBody);
+
+        // Forgets the cached bodies and frees their memory.
+        void clear();
+
+    private:
+        struct Entry {
+            std::vector<uint8_t> rawBody;                   // Copy of a body column
+            alloc_slice alignedData;                        // Copy of its Fleece data, if misaligned
+            std::unique_ptr<fleece::impl::Scope> scope;     // Scope of the Fleece data
+            const fleece::impl::Value* root {nullptr};      // Root of the Fleece data
+        };
+
+        Entry _entries[2];                                  // Most recently used first
+    };
+
     // Takes a document body from argv[0] and key-path from argv[1].
-    // Establishes a scope for the Fleece data, and evaluates the path, setting `root`
-    class QueryFleeceScope : public fleece::impl::Scope {
+    // Gets the body's Fleece root from the QueryBodyCache, and evaluates the path, setting `root`
+    class QueryFleeceScope {
     public:
         QueryFleeceScope(sqlite3_context *ctx, sqlite3_value **argv);
-        ~QueryFleeceScope();
         const fleece::impl::Value *root;
-    private:
-        bool _copied;
     };
 
 
@@ -0,0 +1,183 @@
+//
+// SQLiteKeyStore+CoveringIndexes.cc
+//
+// Copyright © 2019 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "SQLiteKeyStore.hh"
+#include "SQLiteDataFile.hh"
+#include "SQLiteFleeceUtil.hh"
+#include "QueryParser.hh"
+#include "QueryParser+Private.hh"
+#include "Error.hh"
+#include "StringUtil.hh"
+#include "SQLiteCpp/SQLiteCpp.h"
+
+using namespace std;
+using namespace fleece;
+using namespace fleece::impl;
+
+namespace litecore {
+
+    // A covering index is a regular value index on the kv table, plus a table holding the values
+    // of the indexed and included expressions for each live doc. A query that needs nothing else
+    // is compiled by QueryParser to read only that table, via an index on all its columns, so
+    // the docs' bodies are never read.
+    bool SQLiteKeyStore::createCoveringIndex(const IndexSpec &spec) {
+        if (spec.where())
+            error::_throw(error::InvalidQuery, "Covering index does not support a WHERE clause");
+        vector<const Value*> expressions;
+        for (Array::iterator i(spec.what()); i; ++i)
+            expressions.push_back(i.value());
+        for (Array::iterator i(spec.include()); i; ++i)
+            expressions.push_back(i.value());
+        if (expressions.size() > size_t(kMaxPackedSubtypes))
+            error::_throw(error::InvalidQuery, "Covering index has too many expressions");
+
+        // The table is part of the index, so check for an identical existing index here; and
+        // delete a different one first, so its table isn't garbage-collected out from under this.
+        if (auto existingSpec = db().getIndex(spec.name)) {
+            if (existingSpec->type == spec.type && existingSpec->keyStoreName == name()
+                    && existingSpec->expressionJSON == spec.expressionJSON
+                    && db().tableExists(existingSpec->indexTableName))
+                return false;
+            db().deleteIndex(*existingSpec);
+        }
+
+        auto kvTableName = tableName();
+        auto coveringTableName = kvTableName + ":covering:" + spec.name;
+
+        // Create the table, its index, and the SQL expressions for its columns:
+        stringstream columns, indexColumns;
+        QueryParser qp(*this);
+        vector<string> exprSQL;
+        for (auto expr : expressions)
+            exprSQL.push_back(qp.expressionSQL(expr));
+        qp.setBodyColumnName("new.body");
+        vector<string> newExprSQL;
+        for (auto expr : expressions)
+            newExprSQL.push_back(qp.expressionSQL(expr));
+        for (size_t i = 0; i < expressions.size(); ++i) {
+            columns << ", c" << i;
+            indexColumns << "c" << i << ", ";
+        }
+
+        LogTo(QueryLog, "Creating covering table '%s'", coveringTableName.c_str());
+        db().exec(CONCAT("CREATE TABLE \"" << coveringTableName << "\" "
+                         "(docid INTEGER PRIMARY KEY REFERENCES " << kvTableName << "(rowid), "
+                         "key TEXT NOT NULL, sequence INTEGER" << columns.str() << ", "
+                         "subtypes INTEGER NOT NULL)"));
+        db().exec(CONCAT("CREATE INDEX \"" << coveringTableName << "::index\" "
+                         "ON \"" << coveringTableName << "\" "
+                         "(" << indexColumns.str() << "key, sequence, subtypes)"));
+
+        // Column values are stored as they are; their subtypes, which SQLite doesn't store,
+        // are packed into the 'subtypes' column by fl_subtypes().
+        auto values = [&](const vector<string> &sql) {
+            stringstream out;
+            for (auto &expr : sql)
+                out << ", " << expr;
+            out << ", " << qp::kSubtypesFnName << "(" << join(sql, ", ") << ")";
+            return out.str();
+        };
+
+        // Populate the table with data from existing documents:
+        db().exec(CONCAT("INSERT INTO \"" << coveringTableName << "\" "
+                         "(docid, key, sequence" << columns.str() << ", subtypes) "
+                         "SELECT rowid, key, sequence" << values(exprSQL) <<
+                         " FROM " << kvTableName << " WHERE (flags & 1) = 0"));
+
+        // Set up triggers to keep the table up to date
+        // ...on insertion:
+        string insertTriggerExpr = CONCAT("INSERT INTO \"" << coveringTableName << "\" "
+                                          "(docid, key, sequence" << columns.str() << ", subtypes) "
+                                          "VALUES (new.rowid, new.key, new.sequence"
+                                          << values(newExprSQL) << ")");
+        createTrigger(coveringTableName, "ins",
+                      "AFTER INSERT",
+                      "WHEN (new.flags & 1) = 0",
+                      insertTriggerExpr);
+
+        // ...on delete:
+        string deleteTriggerExpr = CONCAT("DELETE FROM \"" << coveringTableName << "\" "
+                                          "WHERE docid = old.rowid");
+        createTrigger(coveringTableName, "del",
+                      "BEFORE DELETE",
+                      "WHEN (old.flags & 1) = 0",
+                      deleteTriggerExpr);
+
+        // ...on update:
+        createTrigger(coveringTableName, "preupdate",
+                      "BEFORE UPDATE OF body, flags",
+                      "WHEN (old.flags & 1) = 0",
+                      deleteTriggerExpr);
+        createTrigger(coveringTableName, "postupdate",
+                      "AFTER UPDATE OF body, flags",
+                      "WHEN (new.flags & 1) = 0",
+                      insertTriggerExpr);
+
+        // Finally create the regular value index, registered along with the covering table:
+        Array::iterator what(spec.what());
+        qp.setBodyColumnName(bodyColumnName());
+        qp.writeCreateIndex(spec.name, what, nullptr, false);
+        return db().createIndex(spec, this, coveringTableName, qp.SQL());
+    }
+
+
+    // Part of the QueryParser delegate API
+    vector<QueryParser::CoveringIndex> SQLiteKeyStore::coveringIndexes() const {
+        lock_guard<mutex> lock(_indexInfoMutex);
+        return indexInfo().coveringIndexes;
+    }
+
+
+    // Returns true if a value index's first expression is the given document property.
+    bool SQLiteKeyStore::hasValueIndexOn(const std::string &property) const {
+        lock_guard<mutex> lock(_indexInfoMutex);
+        return indexInfo().valueIndexedProperties.count(property) > 0;
+    }
+
+
+    const SQLiteKeyStore::IndexInfo& SQLiteKeyStore::indexInfo() const {
+        // The schema version changes whenever any connection creates or drops a table or index:
+        int64_t schemaVersion = db().intQuery("PRAGMA schema_version");
+        if (_indexInfo && _indexInfo->schemaVersion == schemaVersion)
+            return *_indexInfo;
+
+        IndexInfo info {schemaVersion, {}, {}};
+        for (auto &spec : db().getIndexes(this)) {
+            if (spec.type != IndexSpec::kValue || !spec.expressionJSON)
+                continue;
+            info.valueIndexedProperties.insert(string(qp::propertyFromNode(spec.what()->get(0))));
+            if (spec.indexTableName.empty())
+                continue;
+            QueryParser::CoveringIndex index {spec.indexTableName, {}};
+            for (Array::iterator i(spec.what()); i; ++i)
+                index.expressions.push_back(QueryParser::coveredExpressionJSON(i.value()));
+            for (Array::iterator i(spec.include()); i; ++i)
+                index.expressions.push_back(QueryParser::coveredExpressionJSON(i.value()));
+            info.coveringIndexes.push_back(move(index));
+        }
+        _indexInfo = move(info);
+        return *_indexInfo;
+    }
+
+
+    void SQLiteKeyStore::invalidateIndexInfo() {
+        lock_guard<mutex> lock(_indexInfoMutex);
+        _indexInfo.reset();
+    }
+
+}
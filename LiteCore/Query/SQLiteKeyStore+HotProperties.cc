@@ -0,0 +1,125 @@
+//
+// SQLiteKeyStore+HotProperties.cc
+//
+// Copyright © 2019 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "SQLiteKeyStore.hh"
+#include "SQLiteDataFile.hh"
+#include "QueryParser.hh"
+#include "QueryParser+Private.hh"
+#include "Error.hh"
+#include "StringUtil.hh"
+#include "SQLiteCpp/SQLiteCpp.h"
+
+using namespace std;
+using namespace fleece;
+using namespace fleece::impl;
+
+namespace litecore {
+
+    // A hot-property table holds a row for each live doc whose property value is a string or
+    // number: types that SQLite stores losslessly. fl_scalar_value() returns NULL otherwise,
+    // and no row is stored, so queries fall back to reading those docs' bodies.
+    bool SQLiteKeyStore::createHotPropertyIndex(const IndexSpec &spec) {
+        auto expressions = spec.what();
+        if (expressions->count() != 1)
+            error::_throw(error::InvalidQuery, "Hot-property index requires exactly one property");
+        if (spec.where())
+            error::_throw(error::InvalidQuery, "Hot-property index does not support a WHERE clause");
+        const Value *property = expressions->get(0);
+
+        // The table is the index, so check for an identical existing index here; and delete
+        // a different one first, so its table isn't garbage-collected out from under this one.
+        if (auto existingSpec = db().getIndex(spec.name)) {
+            if (existingSpec->type == spec.type && existingSpec->keyStoreName == name()
+                    && existingSpec->expressionJSON == spec.expressionJSON
+                    && db().tableExists(existingSpec->indexTableName))
+                return false;
+            db().deleteIndex(*existingSpec);
+        }
+
+        QueryParser qp(*this);
+        auto kvTableName = tableName();
+        auto hotTableName = qp.hotPropertyTableName(property);
+        string path(qp::propertyFromNode(property));
+
+        // Create the table, unless an identical one already exists:
+        string sql = CONCAT("CREATE TABLE \"" << hotTableName << "\" "
+                            "(docid INTEGER PRIMARY KEY REFERENCES " << kvTableName << "(rowid), "
+                            " value NOT NULL) "
+                            "WITHOUT ROWID");
+        if (!db().schemaExistsWithSQL(hotTableName, "table", hotTableName, sql)) {
+            LogTo(QueryLog, "Creating hot-property table '%s'", hotTableName.c_str());
+            db().exec(sql);
+
+            auto valueExpr = [&](const char *body) {
+                stringstream expr;
+                expr << qp::kScalarValueFnName << "(" << body << ", ";
+                QueryParser::writeSQLString(expr, slice(path));
+                expr << ")";
+                return expr.str();
+            };
+
+            // Populate the table with data from existing documents:
+            db().exec(CONCAT("INSERT INTO \"" << hotTableName << "\" (docid, value) "
+                             "SELECT docid, value FROM "
+                             "(SELECT rowid AS docid, " << valueExpr("body") << " AS value "
+                             "FROM " << kvTableName << " WHERE (flags & 1) = 0) "
+                             "WHERE value IS NOT NULL"));
+
+            // Set up triggers to keep the table up to date
+            // ...on insertion:
+            string insertTriggerExpr = CONCAT("INSERT INTO \"" << hotTableName <<
+                                              "\" (docid, value) "
+                                              "SELECT new.rowid, value FROM "
+                                              "(SELECT " << valueExpr("new.body") << " AS value) "
+                                              "WHERE value IS NOT NULL");
+            createTrigger(hotTableName, "ins",
+                          "AFTER INSERT",
+                          "WHEN (new.flags & 1) = 0",
+                          insertTriggerExpr);
+
+            // ...on delete:
+            string deleteTriggerExpr = CONCAT("DELETE FROM \"" << hotTableName << "\" "
+                                              "WHERE docid = old.rowid");
+            createTrigger(hotTableName, "del",
+                          "BEFORE DELETE",
+                          "WHEN (old.flags & 1) = 0",
+                          deleteTriggerExpr);
+
+            // ...on update:
+            createTrigger(hotTableName, "preupdate",
+                          "BEFORE UPDATE OF body, flags",
+                          "WHEN (old.flags & 1) = 0",
+                          deleteTriggerExpr);
+            createTrigger(hotTableName, "postupdate",
+                          "AFTER UPDATE OF body, flags",
+                          "WHEN (new.flags & 1) = 0",
+                          insertTriggerExpr);
+        }
+
+        // There's no SQL index; the table itself is what's registered. Queries read the column
+        // as IFNULL(hotN.value, fl_value(body, path)), which no index on it could serve, so one
+        // would only slow down the triggers. (Queries use a value index on the property, if any.)
+        return db().createIndex(spec, this, hotTableName, "");
+    }
+
+
+    string SQLiteKeyStore::hotPropertyTableName(const std::string &property) const {
+        return tableName() + ":hot:" + property;
+    }
+
+}
@@ -26,6 +26,7 @@
 #include "StringUtil.hh"
 #include "SQLiteCpp/SQLiteCpp.h"
 #include "Stopwatch.hh"
+#include "Instrumentation.hh"
 
 using namespace std;
 using namespace fleece;
@@ -35,6 +36,10 @@ namespace litecore {
 
     /*
      - A value index is a SQL index named 'NAME'.
+     - A covering value index (one with an INCLUDE clause) also has:
+         * A SQL table named `kv_default:covering:NAME`, holding each live doc's key, sequence,
+            and the values of the indexed and included expressions
+         * An index on all of that table's columns, named `kv_default:covering:NAME::index`
      - A FTS index is a SQL virtual table named 'kv_default::NAME'
      - An array index has two parts:
          * A SQL table named `kv_default:unnest:PATH`, where PATH is the property path
@@ -43,6 +48,15 @@ namespace litecore {
          * A SQL table named `kv_default:prediction:DIGEST`, where DIGEST is a unique digest
             of the prediction function name and the parameter dictionary
          * An index on that table named `NAME`
+     - A hot-property index is a SQL table named `kv_default:hot:PATH`, where PATH is the
+        property path, holding the property's value for each doc where it's a string or number
+        (there is no SQL index)
+     - A vector index has three parts:
+         * A SQL table named `kv_default:vector:PATH`, where PATH is the property path (or
+            a digest of the expression), holding each doc's packed vector and its bucket
+         * A SQL table named `kv_default:vector:PATH:centroids`, holding each bucket's centroid
+            and the options the index was built with
+         * An index on the bucket column of the first table, named `NAME`
 
      Index table:
         - name (string primary key)
@@ -55,16 +69,20 @@ namespace litecore {
 
     bool SQLiteKeyStore::createIndex(const IndexSpec &spec) {
         spec.validateName();
+        Signpost signpost(Signpost::indexUpdate, uintptr_t(this));
 
         Stopwatch st;
+        invalidateIndexInfo();
         Transaction t(db());
         bool created;
         switch (spec.type) {
             case IndexSpec::kValue:      created = createValueIndex(spec); break;
             case IndexSpec::kFullText:   created = createFTSIndex(spec); break;
             case IndexSpec::kArray:      created = createArrayIndex(spec); break;
+            case IndexSpec::kHotProperty:created = createHotPropertyIndex(spec); break;
 #ifdef COUCHBASE_ENTERPRISE
             case IndexSpec::kPredictive: created = createPredictiveIndex(spec); break;
+            case IndexSpec::kVector:     created = createVectorIndex(spec); break;
 #endif
             default:                     error::_throw(error::Unimplemented);
         }
@@ -98,6 +116,7 @@ namespace litecore {
 
 
     void SQLiteKeyStore::deleteIndex(slice name)  {
+        invalidateIndexInfo();
         Transaction t(db());
         auto spec = db().getIndex(name);
         if (spec) {
@@ -154,6 +173,8 @@ namespace litecore {
 
 
     bool SQLiteKeyStore::createValueIndex(const IndexSpec &spec) {
+        if (spec.include())
+            return createCoveringIndex(spec);
         Array::iterator expressions(spec.what());
         return createIndex(spec, tableName(), expressions);
     }
@@ -0,0 +1,341 @@
+#ifdef COUCHBASE_ENTERPRISE
+
+//
+// SQLiteKeyStore+VectorIndexes.cc
+//
+// Copyright © 2019 Couchbase. All rights reserved.
+//
+//  COUCHBASE LITE ENTERPRISE EDITION
+//
+//  Licensed under the Couchbase License Agreement (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//  https://info.couchbase.com/rs/302-GJY-034/images/2017-10-30_License_Agreement.pdf
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#include "SQLiteKeyStore.hh"
+#include "SQLiteDataFile.hh"
+#include "QueryParser.hh"
+#include "VectorDistance.hh"
+#include "Error.hh"
+#include "Logging.hh"
+#include "StringUtil.hh"
+#include "SQLiteCpp/SQLiteCpp.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+
+using namespace std;
+using namespace fleece;
+using namespace fleece::impl;
+
+namespace litecore {
+
+    /*
+     A vector index is an IVF ("inverted file") index for approximate nearest-neighbor search.
+     When it's created, a sample of the documents' vectors is clustered with k-means; each
+     cluster's centroid is stored in the centroids table with its bucket number. The vector
+     table holds each document's packed vector along with the bucket of its nearest centroid,
+     and triggers keep it up to date. A query then only has to scan the buckets whose centroids
+     are nearest the target (see QueryParser+VectorSearch.cc.)
+     */
+
+    static constexpr unsigned kMaxDefaultCentroids   = 256;
+    static constexpr unsigned kSamplesPerCentroid    = 64;
+    static constexpr unsigned kMaxTrainingIterations = 10;
+    static constexpr unsigned kTrainingSeed          = 0x5EED;
+
+
+    // Returns the index of the centroid nearest to vector `v`.
+    static uint32_t nearestCentroid(const float *v, const vector<float> &centroids, size_t dims) {
+        uint32_t best = 0;
+        double bestDistance = INFINITY;
+        size_t k = centroids.size() / dims;
+        for (size_t c = 0; c < k; ++c) {
+            double d = squaredEuclideanDistance(v, &centroids[c * dims], dims);
+            if (d < bestDistance) {
+                bestDistance = d;
+                best = uint32_t(c);
+            }
+        }
+        return best;
+    }
+
+
+    // Clusters the sample vectors into `k` clusters using Lloyd's algorithm, and returns the
+    // centroids as a flat array of k * dims floats. Deterministic, for reproducible indexes.
+    static vector<float> trainCentroids(const vector<float> &samples, size_t dims, size_t k) {
+        size_t n = samples.size() / dims;
+        minstd_rand rng(kTrainingSeed);
+
+        // Start with k distinct samples chosen at random:
+        vector<size_t> order(n);
+        iota(order.begin(), order.end(), 0);
+        shuffle(order.begin(), order.end(), rng);
+        vector<float> centroids(k * dims);
+        for (size_t c = 0; c < k; ++c)
+            copy_n(&samples[order[c] * dims], dims, &centroids[c * dims]);
+
+        vector<uint32_t> assignment(n, UINT32_MAX);
+        vector<double> sums(k * dims);
+        vector<size_t> counts(k);
+        for (unsigned iteration = 0; iteration < kMaxTrainingIterations; ++iteration) {
+            // Assign each sample to its nearest centroid:
+            bool changed = false;
+            for (size_t i = 0; i < n; ++i) {
+                auto c = nearestCentroid(&samples[i * dims], centroids, dims);
+                if (c != assignment[i]) {
+                    assignment[i] = c;
+                    changed = true;
+                }
+            }
+            if (!changed)
+                break;
+
+            // Move each centroid to the mean of its samples:
+            fill(sums.begin(), sums.end(), 0.0);
+            fill(counts.begin(), counts.end(), 0);
+            for (size_t i = 0; i < n; ++i) {
+                double *sum = &sums[assignment[i] * dims];
+                const float *v = &samples[i * dims];
+                for (size_t d = 0; d < dims; ++d)
+                    sum[d] += v[d];
+                ++counts[assignment[i]];
+            }
+            for (size_t c = 0; c < k; ++c) {
+                float *centroid = &centroids[c * dims];
+                if (counts[c] > 0) {
+                    for (size_t d = 0; d < dims; ++d)
+                        centroid[d] = float(sums[c * dims + d] / counts[c]);
+                } else {
+                    // An empty cluster gets re-seeded with a random sample:
+                    copy_n(&samples[order[rng() % n] * dims], dims, centroid);
+                }
+            }
+        }
+        return centroids;
+    }
+
+
+    bool SQLiteKeyStore::createVectorIndex(const IndexSpec &spec) {
+        auto expressions = spec.what();
+        if (expressions->count() != 1)
+            error::_throw(error::InvalidQuery, "Vector index requires exactly one expression");
+        if (spec.where())
+            error::_throw(error::InvalidQuery, "Vector index does not support a WHERE clause");
+        const Value *expression = expressions->get(0);
+
+        // The index table is populated and clustered here, not by the CREATE INDEX, so check
+        // for an identical existing index now; and delete a different one before building,
+        // so its tables aren't garbage-collected out from under the new index.
+        if (auto existingSpec = db().getIndex(spec.name)) {
+            if (existingSpec->type == spec.type && existingSpec->keyStoreName == name()
+                    && existingSpec->expressionJSON == spec.expressionJSON
+                    && db().tableExists(existingSpec->indexTableName)
+                    && vectorOptionsMatch(existingSpec->indexTableName, spec.optionsPtr()))
+                return false;
+            db().deleteIndex(*existingSpec);
+        }
+
+        string vectorTableName = createVectorTable(expression, spec.optionsPtr());
+        return db().createIndex(spec, this, vectorTableName,
+                                CONCAT("CREATE INDEX \"" << spec.name << "\" ON \""
+                                       << vectorTableName << "\" (bucket)"));
+    }
+
+
+    string SQLiteKeyStore::createVectorTable(const Value *expression,
+                                             const IndexSpec::Options *options)
+    {
+        // Derive the table names from the expression:
+        QueryParser qp(*this);
+        auto kvTableName = tableName();
+        auto vectorTableName = qp.vectorTableName(expression);
+        auto centroidsTableName = QueryParser::vectorCentroidsTableName(vectorTableName);
+
+        // Create the index tables, unless identical ones already exist:
+        string sql = CONCAT("CREATE TABLE \"" << vectorTableName << "\" "
+                            "(docid INTEGER PRIMARY KEY REFERENCES " << kvTableName << "(rowid), "
+                            " bucket INTEGER NOT NULL, "
+                            " vector BLOB NOT NULL) "
+                            "WITHOUT ROWID");
+        if (db().schemaExistsWithSQL(vectorTableName, "table", vectorTableName, sql)) {
+            if (vectorOptionsMatch(vectorTableName, options))
+                return vectorTableName;
+            // Another index shares it, but it was clustered with different options; rebuild it:
+            db().exec(CONCAT("DROP TABLE \"" << vectorTableName << "\""));
+            for (auto suffix : {"ins", "del", "preupdate", "postupdate"})
+                db().exec(CONCAT("DROP TRIGGER IF EXISTS \"" << vectorTableName << "::"
+                                 << suffix << "\""));
+        }
+
+        LogTo(QueryLog, "Creating vector table '%s' on %s", vectorTableName.c_str(),
+              expression->toJSONString().c_str());
+        db().exec(sql);
+        db().exec(CONCAT("DROP TABLE IF EXISTS \"" << centroidsTableName << "\""));
+        db().exec(CONCAT("CREATE TABLE \"" << centroidsTableName << "\" "
+                         "(bucket INTEGER PRIMARY KEY, "
+                         " vector BLOB NOT NULL, "
+                         " probes INTEGER NOT NULL, "
+                         " requestedCentroids INTEGER NOT NULL, "
+                         " requestedProbes INTEGER NOT NULL)"));
+
+        string vectorExpr = CONCAT("vector_pack(" << qp.expressionSQL(expression) << ")");
+        string selectSQL = CONCAT("SELECT rowid, " << vectorExpr << " FROM " << kvTableName
+                                  << " WHERE (flags & 1) = 0");
+
+        // Pick the number of centroids, and sample enough vectors to train them:
+        unsigned const requestedCentroids = options ? options->numCentroids : 0;
+        unsigned const requestedProbes = options ? options->numProbes : 0;
+        unsigned numCentroids = requestedCentroids;
+        if (numCentroids == 0) {
+            auto numDocs = db().intQuery(CONCAT("SELECT count(*) FROM " << kvTableName
+                                                << " WHERE (flags & 1) = 0").c_str());
+            numCentroids = (unsigned)max(1.0, min(sqrt(double(numDocs)),
+                                                  double(kMaxDefaultCentroids)));
+        }
+        size_t maxSamples = size_t(numCentroids) * kSamplesPerCentroid;
+
+        vector<float> samples, floatBuffer;
+        size_t dims = 0, numVectors = 0;
+        minstd_rand rng(kTrainingSeed);
+        {
+            unique_ptr<SQLite::Statement> select(compile(selectSQL));
+            while (select->executeStep()) {
+                PackedVector vec(columnAsSlice(select->getColumn(1)));
+                if (!vec.valid() || vec.count() == 0)
+                    continue;
+                if (dims == 0)
+                    dims = vec.count();
+                else if (vec.count() != dims)
+                    continue;
+                const float *floats = vec.floats(floatBuffer);
+                // Reservoir sampling:
+                size_t slot = numVectors++;
+                if (slot < maxSamples)
+                    samples.insert(samples.end(), floats, floats + dims);
+                else if ((slot = rng() % numVectors) < maxSamples)
+                    copy_n(floats, dims, &samples[slot * dims]);
+            }
+        }
+
+        vector<float> centroids;
+        if (dims > 0) {
+            size_t k = min(size_t(numCentroids), samples.size() / dims);
+            centroids = trainCentroids(samples, dims, k);
+        }
+        size_t k = dims ? centroids.size() / dims : 1;
+        unsigned probes = requestedProbes;
+        if (probes == 0)
+            probes = (unsigned)ceil(sqrt(double(k)));
+        probes = (unsigned)min(size_t(probes), k);
+        LogTo(QueryLog, "    ...%zu vectors of %zu dimensions in %zu buckets, searching %u",
+              numVectors, dims, k, probes);
+
+        {
+            SQLite::Statement insert(db(), CONCAT("INSERT INTO \"" << centroidsTableName << "\" "
+                                                  "(bucket, vector, probes, requestedCentroids,"
+                                                  " requestedProbes) VALUES (?, ?, ?, ?, ?)"));
+            for (size_t c = 0; c < k; ++c) {
+                // With no vectors yet, there's a single bucket with an empty centroid:
+                alloc_slice packed = PackedVector::encode(dims ? &centroids[c * dims] : nullptr,
+                                                          dims);
+                insert.bind(1, (long long)c);
+                insert.bind(2, packed.buf, (int)packed.size);
+                insert.bind(3, (int)probes);
+                insert.bind(4, (int)requestedCentroids);
+                insert.bind(5, (int)requestedProbes);
+                insert.exec();
+                insert.reset();
+            }
+        }
+
+        // Populate the index-table with data from existing documents:
+        {
+            unique_ptr<SQLite::Statement> select(compile(selectSQL));
+            SQLite::Statement insert(db(), CONCAT("INSERT INTO \"" << vectorTableName << "\" "
+                                                  "(docid, bucket, vector) VALUES (?, ?, ?)"));
+            while (select->executeStep()) {
+                slice data = columnAsSlice(select->getColumn(1));
+                PackedVector vec(data);
+                if (!vec.valid())
+                    continue;
+                uint32_t bucket = 0;
+                if (dims > 0 && vec.count() == dims)
+                    bucket = nearestCentroid(vec.floats(floatBuffer), centroids, dims);
+                insert.bind(1, (long long)select->getColumn(0).getInt64());
+                insert.bind(2, (long long)bucket);
+                insert.bindNoCopy(3, data.buf, (int)data.size);
+                insert.exec();
+                insert.reset();
+            }
+        }
+
+        // Set up triggers to keep the index-table up to date
+        // ...on insertion:
+        qp.setBodyColumnName("new.body");
+        vectorExpr = CONCAT("vector_pack(" << qp.expressionSQL(expression) << ")");
+        string insertTriggerExpr = CONCAT("INSERT INTO \"" << vectorTableName <<
+                                          "\" (docid, bucket, vector) "
+                                          "SELECT new.rowid, "
+                                          "IFNULL((SELECT bucket FROM \"" << centroidsTableName <<
+                                          "\" ORDER BY euclidean_distance(vector, v, 2) LIMIT 1), 0), "
+                                          "v FROM (SELECT " << vectorExpr << " AS v) "
+                                          "WHERE v IS NOT NULL");
+        createTrigger(vectorTableName, "ins",
+                      "AFTER INSERT",
+                      "WHEN (new.flags & 1) = 0",
+                      insertTriggerExpr);
+
+        // ...on delete:
+        string deleteTriggerExpr = CONCAT("DELETE FROM \"" << vectorTableName << "\" "
+                                          "WHERE docid = old.rowid");
+        createTrigger(vectorTableName, "del",
+                      "BEFORE DELETE",
+                      "WHEN (old.flags & 1) = 0",
+                      deleteTriggerExpr);
+
+        // ...on update:
+        createTrigger(vectorTableName, "preupdate",
+                      "BEFORE UPDATE OF body, flags",
+                      "WHEN (old.flags & 1) = 0",
+                      deleteTriggerExpr);
+        createTrigger(vectorTableName, "postupdate",
+                      "AFTER UPDATE OF body, flags",
+                      "WHEN (new.flags & 1) = 0",
+                      insertTriggerExpr);
+        return vectorTableName;
+    }
+
+
+    // Returns true if the vector table was built with the same options as `options`. (They're
+    // recorded in every row of the centroids table, which always has at least one row.)
+    bool SQLiteKeyStore::vectorOptionsMatch(const string &vectorTableName,
+                                            const IndexSpec::Options *options)
+    {
+        auto centroidsTableName = QueryParser::vectorCentroidsTableName(vectorTableName);
+        if (!db().tableExists(centroidsTableName))
+            return false;
+        SQLite::Statement stmt(db(), CONCAT("SELECT requestedCentroids, requestedProbes FROM \""
+                                            << centroidsTableName << "\" LIMIT 1"));
+        if (!stmt.executeStep())
+            return false;
+        return stmt.getColumn(0).getInt() == int(options ? options->numCentroids : 0)
+            && stmt.getColumn(1).getInt() == int(options ? options->numProbes : 0);
+    }
+
+
+    string SQLiteKeyStore::vectorTableName(const std::string &property) const {
+        return tableName() + ":vector:" + property;
+    }
+
+}
+
+#endif // COUCHBASE_ENTERPRISE
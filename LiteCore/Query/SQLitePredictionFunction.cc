@@ -21,6 +21,7 @@
 
 #include "SQLiteFleeceUtil.hh"
 #include "PredictiveModel.hh"
+#include "VectorDistance.hh"
 #include "Logging.hh"
 #include "StringUtil.hh"
 #include "HeapValue.hh"
@@ -93,13 +94,10 @@ namespace litecore {
     }
 
 
-    // Creates Fleece array iterators on the 1st two parameters of the function.
-    static bool getArrays(sqlite3_context *ctx, sqlite3_value **argv,
+    // Creates Fleece array iterators on two Fleece array parameters.
+    static bool getArrays(const Value *p1, const Value *p2,
                           Array::iterator &i1, Array::iterator &i2)
     {
-        auto p1 = fleeceParam(ctx, argv[0], false), p2 = fleeceParam(ctx, argv[1], false);
-        if (!p1 || !p2)
-            return false;
         auto a1 = p1->asArray(), a2 = p2->asArray();
         if (!a1 || !a2)
             return false;
@@ -109,16 +107,71 @@ namespace litecore {
     }
 
 
+    // Returns a vector parameter as a Fleece value. A packed vector (see VectorDistance.hh) may
+    // arrive as a plain blob, e.g. a query parameter or a column of a vector index table;
+    // it's wrapped in `packed`.
+    static const Value* vectorParam(sqlite3_context *ctx, sqlite3_value *arg, PackedVector &packed) {
+        if (sqlite3_value_type(arg) == SQLITE_BLOB) {
+            auto subtype = sqlite3_value_subtype(arg);
+            if (subtype == kPlainBlobSubtype || subtype == 0) {
+                // (Table columns lose their subtype, so check untyped blobs for a packed header)
+                packed = PackedVector(valueAsSlice(arg));
+                if (packed.valid() || subtype == kPlainBlobSubtype)
+                    return nullptr;
+            }
+        }
+        return fleeceParam(ctx, arg, false);
+    }
+
+
+    // Gets the first two parameters of the function as float vectors of equal length.
+    // Either one may be a Fleece array of numbers or a packed vector.
+    static bool getVectors(const Value *p1, PackedVector &packed1,
+                           const Value *p2, PackedVector &packed2,
+                           const float* &v1, const float* &v2, size_t &count)
+    {
+        static thread_local vector<float> sBuffer1, sBuffer2;
+        size_t count1, count2;
+        if (packed1.valid()) {
+            v1 = packed1.floats(sBuffer1);
+            count1 = packed1.count();
+        } else if (!vectorFromFleece(p1, sBuffer1, &v1, &count1)) {
+            return false;
+        }
+        if (packed2.valid()) {
+            v2 = packed2.floats(sBuffer2);
+            count2 = packed2.count();
+        } else if (!vectorFromFleece(p2, sBuffer2, &v2, &count2)) {
+            return false;
+        }
+        count = count1;
+        return count1 == count2;
+    }
+
+
     // https://en.wikipedia.org/wiki/Euclidean_distance
     static void euclidean_distance(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
-        Array::iterator i1(nullptr), i2(nullptr);
-        if (!getArrays(ctx, argv, i1, i2))
+        PackedVector packed1, packed2;
+        auto p1 = vectorParam(ctx, argv[0], packed1), p2 = vectorParam(ctx, argv[1], packed2);
+        if ((!p1 && !packed1.valid()) || (!p2 && !packed2.valid()))
             return;
 
         double dist = 0.0;
-        for (; i1; ++i1, ++i2) {
-            double d = i1.value()->asDouble() - i2.value()->asDouble();
-            dist += d * d;
+        Array::iterator i1(nullptr), i2(nullptr);
+        if (p1 && p2 && p1->type() == kArray && p2->type() == kArray) {
+            // Two Fleece arrays: compute in double precision, as always
+            if (!getArrays(p1, p2, i1, i2))
+                return;
+            for (; i1; ++i1, ++i2) {
+                double d = i1.value()->asDouble() - i2.value()->asDouble();
+                dist += d * d;
+            }
+        } else {
+            const float *v1, *v2;
+            size_t count;
+            if (!getVectors(p1, packed1, p2, packed2, v1, v2, count))
+                return;
+            dist = squaredEuclideanDistance(v1, v2, count);
         }
         
         // Optional 3rd param raises result to that power. (Useful for squared-Euclidean distance.)
@@ -135,26 +188,62 @@ namespace litecore {
 
     // https://en.wikipedia.org/wiki/Cosine_similarity
     static void cosine_distance(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
-        Array::iterator i1(nullptr), i2(nullptr);
-        if (!getArrays(ctx, argv, i1, i2))
+        PackedVector packed1, packed2;
+        auto p1 = vectorParam(ctx, argv[0], packed1), p2 = vectorParam(ctx, argv[1], packed2);
+        if ((!p1 && !packed1.valid()) || (!p2 && !packed2.valid()))
             return;
 
         double aa = 0.0, ab = 0.0, bb = 0.0;
-        for (; i1; ++i1, ++i2) {
-            double a = i1.value()->asDouble(), b = i2.value()->asDouble();
-            aa += a * a;
-            ab += a * b;
-            bb += b * b;
+        Array::iterator i1(nullptr), i2(nullptr);
+        if (p1 && p2 && p1->type() == kArray && p2->type() == kArray) {
+            if (!getArrays(p1, p2, i1, i2))
+                return;
+            for (; i1; ++i1, ++i2) {
+                double a = i1.value()->asDouble(), b = i2.value()->asDouble();
+                aa += a * a;
+                ab += a * b;
+                bb += b * b;
+            }
+        } else {
+            const float *v1, *v2;
+            size_t count;
+            if (!getVectors(p1, packed1, p2, packed2, v1, v2, count))
+                return;
+            dotProducts(v1, v2, count, &aa, &ab, &bb);
         }
         double dist =  1.0 - ab / sqrt(aa * bb);
         sqlite3_result_double(ctx, dist);
     }
 
 
+    // vector_pack(v) returns vector `v` -- an array of numbers or a packed vector -- as a packed
+    // vector in a plain blob, or null if it's not a vector. Used by vector indexes.
+    static void vector_pack(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
+        PackedVector packed;
+        auto value = vectorParam(ctx, argv[0], packed);
+        if (packed.valid()) {
+            setResultBlobFromData(ctx, valueAsSlice(argv[0]));
+            return;
+        } else if (!value) {
+            return;
+        } else if (value->type() == kData) {
+            if (PackedVector::isPacked(value->asData()))
+                setResultBlobFromData(ctx, value->asData());
+            return;
+        }
+        static thread_local vector<float> sBuffer;
+        const float *floats;
+        size_t count;
+        if (vectorFromFleece(value, sBuffer, &floats, &count) && count > 0)
+            setResultBlobFromData(ctx, PackedVector::encode(floats, count));
+    }
+
+
     const SQLiteFunctionSpec kPredictFunctionsSpec[] = {
         { "prediction",         -1, predictionFunc  },
         { "euclidean_distance", -1, euclidean_distance  },
         { "cosine_distance",     2, cosine_distance  },
+        { "vector_pack",         1, vector_pack  },
         { }
     };
 
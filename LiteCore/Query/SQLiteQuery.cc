@@ -29,6 +29,8 @@
 #include "MutableDict.hh"
 #include "Path.hh"
 #include "Stopwatch.hh"
+#include "Instrumentation.hh"
+#include "Metrics.hh"
 #include "SQLiteCpp/SQLiteCpp.h"
 #include <sqlite3.h>
 #include <sstream>
@@ -45,6 +47,9 @@ namespace litecore {
 
     class SQLiteQueryEnumerator;
 
+    static metrics::Histogram sQueryRunTime("query.runUsec");
+    static metrics::Counter sQueryRows("query.rows");
+
 
     // Implicit columns in full-text query result:
     enum {
@@ -378,6 +383,7 @@ namespace litecore {
             try {
                 _statement->reset();
             } catch (...) { }
+            ((SQLiteDataFile&)_query->keyStore().dataFile()).clearQueryBodyCache();
         }
 
         void bindParameters(slice json) {
@@ -461,6 +467,7 @@ namespace litecore {
         // Collects all the (remaining) rows into a Fleece array of arrays,
         // and returns an enumerator impl that will replay them.
         SQLiteQueryEnumerator* fastForward() {
+            Signpost signpost(Signpost::queryRun, uintptr_t(_query.get()));
             fleece::Stopwatch st;
             int nCols = _statement->getColumnCount();
             uint64_t rowCount = 0;
@@ -494,6 +501,8 @@ namespace litecore {
 
             enc.endArray();
             Retained<Doc> recording = enc.finishDoc();
+            sQueryRunTime.record(uint64_t(st.elapsed() * 1e6));
+            sQueryRows += rowCount;
             return new SQLiteQueryEnumerator(_query, &_options, _lastSequence, _purgeCount,
                                              recording, rowCount, st.elapsed());
         }
@@ -0,0 +1,452 @@
+//
+// VectorDistance.cc
+//
+// Copyright © 2019 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "VectorDistance.hh"
+#include "Error.hh"
+#include "FleeceImpl.hh"
+#include <cmath>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+    // GCC/Clang: compile AVX2 kernels with a target attribute and pick them at runtime.
+    #define VECTOR_AVX2 1
+    #define AVX2_TARGET __attribute__((target("avx2,fma")))
+    #define F16C_TARGET __attribute__((target("avx,f16c")))
+    #include <immintrin.h>
+#elif defined(_MSC_VER) && defined(__AVX2__)
+    // MSVC only uses AVX2 if the whole build targets it (/arch:AVX2).
+    #define VECTOR_AVX2 1
+    #define AVX2_TARGET
+    #define F16C_TARGET
+    #include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #define VECTOR_NEON 1
+    #include <arm_neon.h>
+#endif
+
+namespace litecore {
+    using namespace std;
+    using namespace fleece;
+    using namespace fleece::impl;
+
+
+#pragma mark - PACKED VECTOR:
+
+
+    static constexpr uint8_t kMagic[2] = {'V', 'x'};
+
+    static constexpr size_t elementSize(VectorElementType type) {
+        return (type == VectorElementType::Float16) ? 2 : 4;
+    }
+
+    static inline bool isLittleEndianHost() {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        return false;
+#else
+        return true;
+#endif
+    }
+
+    static inline uint32_t readLittle32(const uint8_t *p) {
+        return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16)
+                              | (uint32_t(p[3]) << 24);
+    }
+
+    static inline void writeLittle32(uint8_t *p, uint32_t n) {
+        p[0] = uint8_t(n);  p[1] = uint8_t(n >> 8);  p[2] = uint8_t(n >> 16);  p[3] = uint8_t(n >> 24);
+    }
+
+
+    // IEEE 754 half -> single precision.
+    static float halfToFloat(uint16_t h) {
+        uint32_t sign = uint32_t(h & 0x8000) << 16;
+        uint32_t exp  = (h >> 10) & 0x1F;
+        uint32_t mant = h & 0x3FF;
+        uint32_t bits;
+        if (exp == 0) {
+            if (mant == 0) {
+                bits = sign;                                        // zero
+            } else {
+                exp = 127 - 15 + 1;                                 // subnormal: normalize it
+                while ((mant & 0x400) == 0) {
+                    mant <<= 1;
+                    --exp;
+                }
+                bits = sign | (exp << 23) | ((mant & 0x3FF) << 13);
+            }
+        } else if (exp == 0x1F) {
+            bits = sign | 0x7F800000 | (mant << 13);                // Inf or NaN
+        } else {
+            bits = sign | ((exp + 127 - 15) << 23) | (mant << 13);
+        }
+        float f;
+        memcpy(&f, &bits, sizeof(f));
+        return f;
+    }
+
+
+    // IEEE 754 single -> half precision, rounding to nearest-even.
+    static uint16_t floatToHalf(float f) {
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof(bits));
+        uint16_t sign = uint16_t((bits >> 16) & 0x8000);
+        int32_t exp = int32_t((bits >> 23) & 0xFF) - 127 + 15;
+        uint32_t mant = bits & 0x7FFFFF;
+        if (((bits >> 23) & 0xFF) == 0xFF)                         // Inf or NaN
+            return sign | 0x7C00 | (mant ? 0x200 : 0);
+        if (exp >= 0x1F)                                            // overflow -> Inf
+            return sign | 0x7C00;
+        if (exp <= 0) {                                             // subnormal or zero
+            if (exp < -10)
+                return sign;
+            mant |= 0x800000;
+            uint32_t shift = uint32_t(14 - exp);
+            uint32_t half = mant >> shift;
+            uint32_t rem = mant & ((1u << shift) - 1);
+            uint32_t midpoint = 1u << (shift - 1);
+            if (rem > midpoint || (rem == midpoint && (half & 1)))
+                ++half;
+            return uint16_t(sign | half);
+        }
+        uint32_t half = (uint32_t(exp) << 10) | (mant >> 13);
+        uint32_t rem = mant & 0x1FFF;
+        if (rem > 0x1000 || (rem == 0x1000 && (half & 1)))
+            ++half;                                                 // may carry into exponent; OK
+        return uint16_t(sign | half);
+    }
+
+
+#if VECTOR_AVX2
+    F16C_TARGET
+    static void halvesToFloatsF16C(const uint8_t *src, float *dst, size_t count) {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m128i h = _mm_loadu_si128((const __m128i*)(src + 2*i));
+            _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+        }
+        for (; i < count; ++i)
+            dst[i] = halfToFloat(uint16_t(src[2*i] | (src[2*i+1] << 8)));
+    }
+#endif
+
+
+    static void halvesToFloats(const uint8_t *src, float *dst, size_t count) {
+#if VECTOR_AVX2
+    #if defined(__GNUC__) || defined(__clang__)
+        static const bool sHasF16C = __builtin_cpu_supports("f16c");
+        if (sHasF16C)
+    #endif
+        {
+            halvesToFloatsF16C(src, dst, count);
+            return;
+        }
+#elif VECTOR_NEON && defined(__aarch64__)
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            float16x4_t h = vreinterpret_f16_u16(vld1_u16((const uint16_t*)(src + 2*i)));
+            vst1q_f32(dst + i, vcvt_f32_f16(h));
+        }
+        src += 2*i;
+        dst += i;
+        count -= i;
+#endif
+        for (size_t i = 0; i < count; ++i)
+            dst[i] = halfToFloat(uint16_t(src[2*i] | (src[2*i+1] << 8)));
+    }
+
+
+    alloc_slice PackedVector::encode(const float *values, size_t count, VectorElementType type) {
+        if (count > UINT32_MAX)
+            error::_throw(error::InvalidParameter, "Vector is too long");
+        alloc_slice result(kHeaderSize + count * elementSize(type));
+        auto dst = (uint8_t*)result.buf;
+        dst[0] = kMagic[0];
+        dst[1] = kMagic[1];
+        dst[2] = uint8_t(type);
+        dst[3] = 0;
+        writeLittle32(dst + 4, uint32_t(count));
+        dst += kHeaderSize;
+        if (type == VectorElementType::Float16) {
+            for (size_t i = 0; i < count; ++i) {
+                uint16_t h = floatToHalf(values[i]);
+                *dst++ = uint8_t(h);
+                *dst++ = uint8_t(h >> 8);
+            }
+        } else if (isLittleEndianHost()) {
+            memcpy(dst, values, count * sizeof(float));
+        } else {
+            for (size_t i = 0; i < count; ++i, dst += 4) {
+                uint32_t bits;
+                memcpy(&bits, &values[i], 4);
+                writeLittle32(dst, bits);
+            }
+        }
+        return result;
+    }
+
+
+    bool PackedVector::isPacked(slice data) noexcept {
+        return PackedVector(data).valid();
+    }
+
+
+    PackedVector::PackedVector(slice data) noexcept {
+        if (data.size < kHeaderSize)
+            return;
+        auto bytes = (const uint8_t*)data.buf;
+        if (bytes[0] != kMagic[0] || bytes[1] != kMagic[1] || bytes[3] != 0)
+            return;
+        auto type = VectorElementType(bytes[2]);
+        if (type != VectorElementType::Float32 && type != VectorElementType::Float16)
+            return;
+        size_t count = readLittle32(bytes + 4);
+        if (data.size != kHeaderSize + count * elementSize(type))
+            return;
+        _type = type;
+        _count = count;
+        _elements = bytes + kHeaderSize;
+    }
+
+
+    const float* PackedVector::floats(std::vector<float> &buffer) const {
+        Assert(valid());
+        auto src = (const uint8_t*)_elements;
+        if (_type == VectorElementType::Float32) {
+            if (isLittleEndianHost() && (size_t(src) & (alignof(float) - 1)) == 0)
+                return (const float*)src;
+            buffer.resize(_count);
+            for (size_t i = 0; i < _count; ++i) {
+                uint32_t bits = readLittle32(src + 4*i);
+                memcpy(&buffer[i], &bits, 4);
+            }
+        } else {
+            buffer.resize(_count);
+            halvesToFloats(src, buffer.data(), _count);
+        }
+        return buffer.data();
+    }
+
+
+    bool vectorFromFleece(const Value *value, std::vector<float> &buffer,
+                          const float* *outFloats, size_t *outCount)
+    {
+        if (!value)
+            return false;
+        switch (value->type()) {
+            case kData: {
+                PackedVector vec(value->asData());
+                if (!vec.valid())
+                    return false;
+                *outFloats = vec.floats(buffer);
+                *outCount = vec.count();
+                return true;
+            }
+            case kArray: {
+                auto array = value->asArray();
+                buffer.resize(array->count());
+                size_t i = 0;
+                for (Array::iterator iter(array); iter; ++iter)
+                    buffer[i++] = float(iter.value()->asDouble());
+                *outFloats = buffer.data();
+                *outCount = buffer.size();
+                return true;
+            }
+            default:
+                return false;
+        }
+    }
+
+
+#pragma mark - SCALAR KERNELS:
+
+
+    static double squaredEuclideanScalar(const float *a, const float *b, size_t count) noexcept {
+        double sum = 0.0;
+        for (size_t i = 0; i < count; ++i) {
+            double d = double(a[i]) - double(b[i]);
+            sum += d * d;
+        }
+        return sum;
+    }
+
+
+    static void dotProductsScalar(const float *a, const float *b, size_t count,
+                                  double *outAA, double *outAB, double *outBB) noexcept
+    {
+        double aa = 0.0, ab = 0.0, bb = 0.0;
+        for (size_t i = 0; i < count; ++i) {
+            double x = a[i], y = b[i];
+            aa += x * x;
+            ab += x * y;
+            bb += y * y;
+        }
+        *outAA = aa;  *outAB = ab;  *outBB = bb;
+    }
+
+
+#pragma mark - AVX2 KERNELS:
+
+
+#if VECTOR_AVX2
+    AVX2_TARGET
+    static inline double hsum(__m256 v) {
+        // Widen to double before the final reduction, to limit rounding error.
+        __m256d lo = _mm256_cvtps_pd(_mm256_castps256_ps128(v));
+        __m256d hi = _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1));
+        __m256d sum = _mm256_add_pd(lo, hi);
+        __m128d s = _mm_add_pd(_mm256_castpd256_pd128(sum), _mm256_extractf128_pd(sum, 1));
+        s = _mm_add_sd(s, _mm_unpackhi_pd(s, s));
+        return _mm_cvtsd_f64(s);
+    }
+
+
+    AVX2_TARGET
+    static double squaredEuclideanAVX2(const float *a, const float *b, size_t count) noexcept {
+        __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16) {
+            __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i),     _mm256_loadu_ps(b + i));
+            __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+            acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+            acc1 = _mm256_fmadd_ps(d1, d1, acc1);
+        }
+        for (; i + 8 <= count; i += 8) {
+            __m256 d = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+            acc0 = _mm256_fmadd_ps(d, d, acc0);
+        }
+        return hsum(_mm256_add_ps(acc0, acc1)) + squaredEuclideanScalar(a + i, b + i, count - i);
+    }
+
+
+    AVX2_TARGET
+    static void dotProductsAVX2(const float *a, const float *b, size_t count,
+                                double *outAA, double *outAB, double *outBB) noexcept
+    {
+        __m256 aa = _mm256_setzero_ps(), ab = _mm256_setzero_ps(), bb = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256 x = _mm256_loadu_ps(a + i), y = _mm256_loadu_ps(b + i);
+            aa = _mm256_fmadd_ps(x, x, aa);
+            ab = _mm256_fmadd_ps(x, y, ab);
+            bb = _mm256_fmadd_ps(y, y, bb);
+        }
+        dotProductsScalar(a + i, b + i, count - i, outAA, outAB, outBB);
+        *outAA += hsum(aa);
+        *outAB += hsum(ab);
+        *outBB += hsum(bb);
+    }
+
+
+    static bool hasAVX2() noexcept {
+    #if defined(__GNUC__) || defined(__clang__)
+        static const bool sHasAVX2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        return sHasAVX2;
+    #else
+        return true;
+    #endif
+    }
+#endif // VECTOR_AVX2
+
+
+#pragma mark - NEON KERNELS:
+
+
+#if VECTOR_NEON
+    static inline double hsum(float32x4_t v) {
+        return double(vgetq_lane_f32(v, 0)) + double(vgetq_lane_f32(v, 1))
+             + double(vgetq_lane_f32(v, 2)) + double(vgetq_lane_f32(v, 3));
+    }
+
+
+    static double squaredEuclideanNEON(const float *a, const float *b, size_t count) noexcept {
+        float32x4_t acc0 = vdupq_n_f32(0), acc1 = vdupq_n_f32(0);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            float32x4_t d0 = vsubq_f32(vld1q_f32(a + i),     vld1q_f32(b + i));
+            float32x4_t d1 = vsubq_f32(vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+            acc0 = vmlaq_f32(acc0, d0, d0);
+            acc1 = vmlaq_f32(acc1, d1, d1);
+        }
+        return hsum(vaddq_f32(acc0, acc1)) + squaredEuclideanScalar(a + i, b + i, count - i);
+    }
+
+
+    static void dotProductsNEON(const float *a, const float *b, size_t count,
+                                double *outAA, double *outAB, double *outBB) noexcept
+    {
+        float32x4_t aa = vdupq_n_f32(0), ab = vdupq_n_f32(0), bb = vdupq_n_f32(0);
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            float32x4_t x = vld1q_f32(a + i), y = vld1q_f32(b + i);
+            aa = vmlaq_f32(aa, x, x);
+            ab = vmlaq_f32(ab, x, y);
+            bb = vmlaq_f32(bb, y, y);
+        }
+        dotProductsScalar(a + i, b + i, count - i, outAA, outAB, outBB);
+        *outAA += hsum(aa);
+        *outAB += hsum(ab);
+        *outBB += hsum(bb);
+    }
+#endif // VECTOR_NEON
+
+
+#pragma mark - PUBLIC API:
+
+
+    double squaredEuclideanDistance(const float *a, const float *b, size_t count) noexcept {
+#if VECTOR_AVX2
+        if (hasAVX2())
+            return squaredEuclideanAVX2(a, b, count);
+#elif VECTOR_NEON
+        return squaredEuclideanNEON(a, b, count);
+#endif
+        return squaredEuclideanScalar(a, b, count);
+    }
+
+
+    void dotProducts(const float *a, const float *b, size_t count,
+                     double *outAA, double *outAB, double *outBB) noexcept
+    {
+#if VECTOR_AVX2
+        if (hasAVX2())
+            return dotProductsAVX2(a, b, count, outAA, outAB, outBB);
+#elif VECTOR_NEON
+        return dotProductsNEON(a, b, count, outAA, outAB, outBB);
+#endif
+        dotProductsScalar(a, b, count, outAA, outAB, outBB);
+    }
+
+
+    double cosineDistance(const float *a, const float *b, size_t count) noexcept {
+        double aa, ab, bb;
+        dotProducts(a, b, count, &aa, &ab, &bb);
+        return 1.0 - ab / sqrt(aa * bb);
+    }
+
+
+    const char* vectorKernelName() noexcept {
+#if VECTOR_AVX2
+        if (hasAVX2())
+            return "AVX2";
+#elif VECTOR_NEON
+        return "NEON";
+#endif
+        return "scalar";
+    }
+
+}
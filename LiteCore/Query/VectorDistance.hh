@@ -0,0 +1,104 @@
+//
+// VectorDistance.hh
+//
+// Copyright © 2019 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "Base.hh"
+#include <vector>
+
+namespace fleece::impl {
+    class Value;
+}
+
+namespace litecore {
+
+    /** A compact binary encoding of a numeric vector (such as an ML embedding), stored as a
+        Fleece data value or a plain blob. It's much cheaper to read than a Fleece array of
+        numbers, since the elements can be fed directly to SIMD distance kernels.
+
+        Layout (all little-endian):
+            bytes 0-1   magic: 'V', 'x'
+            byte  2     element type (VectorElementType)
+            byte  3     reserved, must be 0
+            bytes 4-7   element count (uint32)
+            bytes 8-    elements, packed */
+    enum class VectorElementType : uint8_t {
+        Float32 = 1,
+        Float16 = 2,
+    };
+
+    class PackedVector {
+    public:
+        static constexpr size_t kHeaderSize = 8;
+
+        /** Encodes an array of floats in packed form. */
+        static alloc_slice encode(const float *values, size_t count,
+                                  VectorElementType =VectorElementType::Float32);
+
+        /** Returns true if the data appears to be a packed vector. */
+        static bool isPacked(slice data) noexcept;
+
+        PackedVector() =default;
+
+        /** Interprets the data as a packed vector. If it isn't one, the result is invalid
+            (its `valid` method returns false.) Does not copy the data. */
+        explicit PackedVector(slice data) noexcept;
+
+        bool valid() const                          {return _elements != nullptr;}
+        size_t count() const                        {return _count;}
+        VectorElementType elementType() const       {return _type;}
+
+        /** Returns the elements as 32-bit floats. If they're stored as float32 and suitably
+            aligned, returns a direct pointer to them; otherwise converts them into `buffer`
+            and returns its data. */
+        const float* floats(std::vector<float> &buffer) const;
+
+    private:
+        const void*       _elements {nullptr};
+        size_t            _count {0};
+        VectorElementType _type {VectorElementType::Float32};
+    };
+
+
+    /** Gets the elements of a Fleece value as an array of floats. The value may be a packed
+        vector stored as data, or an array of numbers. Returns false if it's neither.
+        As with PackedVector::floats, `buffer` is used if the elements have to be converted. */
+    bool vectorFromFleece(const fleece::impl::Value*,
+                          std::vector<float> &buffer,
+                          const float* *outFloats,
+                          size_t *outCount);
+
+
+    //// Distance kernels. These use AVX2/FMA or NEON when available, else portable code.
+
+    /** Returns the sum of the squares of the differences of the elements: the square of the
+        Euclidean distance between the vectors. */
+    double squaredEuclideanDistance(const float *a, const float *b, size_t count) noexcept;
+
+    /** Computes the dot product a·b as well as the squared magnitudes a·a and b·b. */
+    void dotProducts(const float *a, const float *b, size_t count,
+                     double *outAA, double *outAB, double *outBB) noexcept;
+
+    /** Returns the cosine distance (1 - cosine similarity) between the vectors.
+        If either vector has zero magnitude the result is NaN. */
+    double cosineDistance(const float *a, const float *b, size_t count) noexcept;
+
+    /** Returns the name of the kernel implementation in use ("AVX2", "NEON" or "scalar"),
+        for logging and benchmarks. */
+    const char* vectorKernelName() noexcept;
+
+}
@@ -58,9 +58,12 @@ namespace litecore {
         while (entry < raw_tree.end()) {
             RevTree::RemoteID remoteID = endian::dec16(entry->remoteDBID_BE);
             auto revIndex = endian::dec16(entry->revIndex_BE);
-            if (remoteID == 0 || revIndex >= count)
+            if (revIndex >= count)
                 error::_throw(error::CorruptRevisionData);
-            remoteMap[remoteID] = &revs[revIndex];
+            if (remoteID == 0)
+                revs[revIndex]._externalBody = true;
+            else
+                remoteMap[remoteID] = &revs[revIndex];
             ++entry;
         }
 
@@ -76,8 +79,11 @@ namespace litecore {
     {
         // Allocate output buffer:
         size_t totalSize = sizeof(uint32_t);  // start with space for trailing 0 size
-        for (Rev *rev : revs)
+        for (Rev *rev : revs) {
             totalSize += sizeToWrite(*rev);
+            if (rev->_externalBody)
+                totalSize += sizeof(RemoteEntry);
+        }
         totalSize += remoteMap.size() * sizeof(RemoteEntry);
 
         alloc_slice result(totalSize);
@@ -95,6 +101,13 @@ namespace litecore {
             entry->revIndex_BE = endian::enc16(uint16_t(remote.second->index()));
             ++entry;
         }
+        for (size_t i = 0; i < revs.size(); ++i) {
+            if (revs[i]->_externalBody) {
+                entry->remoteDBID_BE = 0;
+                entry->revIndex_BE = endian::enc16(uint16_t(i));
+                ++entry;
+            }
+        }
 
         Assert(entry == result.end());
         return result;
@@ -105,7 +118,7 @@ namespace litecore {
         return offsetof(RawRevision, revID)
              + rev.revID.size
              + SizeOfVarInt(rev.sequence)
-             + rev._body.size;
+             + (rev._externalBody ? 0 : rev._body.size);
     }
 
     RawRevision* RawRevision::copyFrom(const Rev &rev) {
@@ -116,13 +129,15 @@ namespace litecore {
         this->parentIndex_BE = endian::enc16(uint16_t(rev.parent ? rev.parent->index() : kNoParent));
 
         uint8_t dstFlags = rev.flags & ~kNonPersistentFlags;
-        if (rev._body)
+        bool hasData = rev._body && !rev._externalBody;
+        if (hasData)
             dstFlags |= RawRevision::kHasData;
         this->flags = (Rev::Flags)dstFlags;
 
         void *dstData = offsetby(&this->revID[0], rev.revID.size);
         dstData = offsetby(dstData, PutUVarInt(dstData, rev.sequence));
-        memcpy(dstData, rev._body.buf, rev._body.size);
+        if (hasData)
+            memcpy(dstData, rev._body.buf, rev._body.size);
 
         return (RawRevision*)offsetby(this, revSize);
     }
@@ -33,7 +33,8 @@ namespace litecore {
     // followed by a 32-bit zero.
     // Revs are stored in decending priority, with the current leaf rev(s) coming first.
     // Following the revs is a series of (remote DB ID, revision index) pairs that mark which
-    // revision is the current one for every remote database.
+    // revision is the current one for every remote database. Pairs with a remote DB ID of 0
+    // instead mark revisions whose bodies are stored outside the tree (see VersionedDocument).
     class RawRevision {
     public:
         static std::deque<Rev> decodeTree(slice raw_tree,
@@ -164,7 +164,12 @@ namespace litecore {
 
     slice Rev::body() const {
         slice body = _body;
-        if ((size_t)body.buf & 1) {
+        if (!body.buf && _externalBody) {
+            // Body is stored outside the tree, so ask the owner to read it:
+            auto xthis = const_cast<Rev*>(this);
+            auto xowner = const_cast<RevTree*>(owner);
+            body = xthis->_body = (slice)xowner->copyBody(owner->readBodyOfRevision(this));
+        } else if ((size_t)body.buf & 1) {
             // Fleece data must be 2-byte-aligned, so we have to copy body to the heap:
             auto xthis = const_cast<Rev*>(this);
             auto xowner = const_cast<RevTree*>(owner);
@@ -422,7 +427,7 @@ namespace litecore {
     }
 
     void RevTree::removeBody(const Rev* rev) {
-        if (rev->body()) {
+        if (rev->isBodyAvailable()) {
             const_cast<Rev*>(rev)->removeBody();
             _changed = true;
         }
@@ -431,13 +436,30 @@ namespace litecore {
     // Remove bodies of already-saved revs that are no longer leaves:
     void RevTree::removeNonLeafBodies() {
         for (Rev *rev : _revs) {
-            if (rev->_body.size > 0 && !(rev->flags & (Rev::kLeaf | Rev::kNew | Rev::kKeepBody))) {
+            if ((rev->_body.size > 0 || rev->_externalBody)
+                    && !(rev->flags & (Rev::kLeaf | Rev::kNew | Rev::kKeepBody))) {
                 rev->removeBody();
                 _changed = true;
             }
         }
     }
 
+    void RevTree::externalizeNonCurrentBodies() {
+        const Rev *current = currentRevision();
+        for (Rev *rev : _revs) {
+            if (rev == current) {
+                if (rev->_externalBody) {
+                    rev->body();                // read it while it's still external
+                    rev->_externalBody = false;
+                    _changed = true;
+                }
+            } else if (rev->_body.size > 0 && !rev->_externalBody) {
+                rev->_externalBody = true;
+                _changed = true;
+            }
+        }
+    }
+
     unsigned RevTree::prune(unsigned maxDepth) {
         Assert(maxDepth > 0);
         if (_revs.size() <= maxDepth)
@@ -39,7 +39,8 @@ namespace litecore {
         sequence_t      sequence;   /**< DB sequence number that this revision has/had */
 
         slice body() const;
-        bool isBodyAvailable() const{return _body.buf != nullptr;}
+        bool isBodyAvailable() const{return _body.buf != nullptr || _externalBody;}
+        bool hasExternalBody() const{return _externalBody;}
 
         bool isLeaf() const         {return (flags & kLeaf) != 0;}
         bool isDeleted() const      {return (flags & kDeleted) != 0;}
@@ -73,11 +74,12 @@ namespace litecore {
 
     private:
         slice       _body;          /**< Revision body (JSON), or empty if not stored in this tree*/
+        bool        _externalBody;  /**< Is the body stored outside the encoded tree? */
 
         void addFlag(Flags f)           {flags = (Flags)(flags | f);}
         void clearFlag(Flags f)         {flags = (Flags)(flags & ~f);}
         void removeBody()               {clearFlag((Flags)(kKeepBody | kHasAttachments));
-                                         _body = nullslice;}
+                                         _body = nullslice; _externalBody = false;}
         bool isMarkedForPurge() const   {return (flags & kPurge) != 0;}
 #if DEBUG
         void dump(std::ostream&);
@@ -150,6 +152,11 @@ namespace litecore {
 
         void removeNonLeafBodies();
 
+        /** Marks the bodies of all revisions except the current one as external, so `encode`
+            will leave them out, and brings the current revision's body back into the tree
+            (reading it if necessary.) */
+        void externalizeNonCurrentBodies();
+
         /** Removes a leaf revision and any of its ancestors that aren't shared with other leaves. */
         int purge(revid);
         int purgeAll();
@@ -25,6 +25,7 @@
 #include "varint.hh"
 #include "MutableArray.hh"
 #include "MutableDict.hh"
+#include <algorithm>
 #include <ostream>
 
 namespace litecore {
@@ -47,6 +48,7 @@ namespace litecore {
     :RevTree(other)
     ,_store(other._store)
     ,_rec(other._rec)
+    ,_externalBodies(other._externalBodies)
     {
         updateScope();
     }
@@ -63,8 +65,13 @@ namespace litecore {
     void VersionedDocument::decode() {
         _unknown = false;
         updateScope();
+        _externalBodies.clear();
         if (_rec.body().buf) {
             RevTree::decode(_rec.body(), _rec.sequence());
+            for (auto rev : allRevisions()) {
+                if (rev->hasExternalBody())
+                    _externalBodies.emplace_back(rev->revID);
+            }
             // The kSynced flag is set when the document's current revision is pushed to a server.
             // This is done instead of updating the doc body, for reasons of speed. So when loading
             // the document, detect that flag and belatedly update the current revision's flags.
@@ -171,6 +178,7 @@ namespace litecore {
         bool createSequence;
         if (currentRevision()) {
             removeNonLeafBodies();
+            externalizeNonCurrentBodies();
             auto newBody = encode();
             createSequence = seq == 0 || hasNewRevisions();
             // (Don't call _rec.setBody(), because it'd invalidate all the inner pointers from
@@ -188,10 +196,79 @@ namespace litecore {
             if (seq && !_store.del(_rec.key(), transaction, seq))
                 return kConflict;
         }
+        updateExternalBodies(transaction);
         _changed = false;
         return createSequence ? kNewSequence : kNoNewSequence;
     }
 
+
+#pragma mark - EXTERNAL BODIES:
+
+
+    KeyStore& VersionedDocument::bodyStore(KeyStore &store) {
+        return store.dataFile().getKeyStore(DataFile::kBodiesKeyStorePrefix + store.name(),
+                                            KeyStore::Capabilities{false});
+    }
+
+    KeyStore& VersionedDocument::bodyStore() const {
+        if (!_bodyStore)
+            _bodyStore = &bodyStore(_store);
+        return *_bodyStore;
+    }
+
+    alloc_slice VersionedDocument::bodyKey(slice docID, revid revID) {
+        // The key is the docID and the (binary) revID separated by a zero byte:
+        alloc_slice key(docID.size + 1 + revID.size);
+        auto dst = (uint8_t*)key.buf;
+        memcpy(dst, docID.buf, docID.size);
+        dst[docID.size] = 0;
+        memcpy(dst + docID.size + 1, revID.buf, revID.size);
+        return key;
+    }
+
+    alloc_slice VersionedDocument::readBodyOfRevision(const Rev *rev) const {
+        alloc_slice body = RevTree::readBodyOfRevision(rev);
+        if (!body && rev->hasExternalBody())
+            body = bodyStore().get(bodyKey(docID(), rev->revID)).body();
+        return body;
+    }
+
+    // Writes bodies that have just been moved out of the tree to the body store, and deletes
+    // the ones that are no longer needed.
+    void VersionedDocument::updateExternalBodies(Transaction &t) {
+        std::vector<alloc_slice> externalBodies;
+        for (auto rev : allRevisions()) {
+            if (!rev->hasExternalBody())
+                continue;
+            alloc_slice revID(rev->revID);
+            auto i = std::find(_externalBodies.begin(), _externalBodies.end(), revID);
+            if (i != _externalBodies.end())
+                _externalBodies.erase(i);               // already stored
+            else
+                bodyStore().set(bodyKey(docID(), rev->revID), rev->body(), t);
+            externalBodies.push_back(revID);
+        }
+        for (auto &revID : _externalBodies)
+            bodyStore().del(bodyKey(docID(), revid(revID)), t);
+        _externalBodies = std::move(externalBodies);
+    }
+
+    void VersionedDocument::purgeExternalBodies(KeyStore &store, slice docID, Transaction &t) {
+        Record rec = store.get(docID);
+        if (!rec.body())
+            return;
+        RevTree tree(rec.body(), rec.sequence());
+        KeyStore *bodies = nullptr;
+        for (auto rev : tree.allRevisions()) {
+            if (rev->hasExternalBody()) {
+                if (!bodies)
+                    bodies = &bodyStore(store);
+                bodies->del(bodyKey(docID, rev->revID), t);
+            }
+        }
+    }
+
+
 #if DEBUG
     void VersionedDocument::dump(std::ostream& out) {
         out << "\"" << (std::string)docID() << "\" / " << (std::string)revID();
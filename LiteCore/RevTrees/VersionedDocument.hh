@@ -31,7 +31,10 @@ namespace litecore {
     class KeyStore;
     class Transaction;
 
-    /** Manages storage of a serialized RevTree in a Record. */
+    /** Manages storage of a serialized RevTree in a Record.
+        Only the current revision's body is stored in the tree; the bodies of other revisions
+        (kept ancestors and conflicting branches) are stored in a separate KeyStore, keyed by
+        docID and revID, and read on demand. */
     class VersionedDocument : public RevTree {
     public:
 
@@ -71,6 +74,10 @@ namespace litecore {
         /** Given a Fleece Value, finds the VersionedDocument it belongs to. */
         static VersionedDocument* containing(const fleece::impl::Value*);
 
+        /** Deletes the externally-stored revision bodies of a document. Must be called before
+            the document itself is purged from the KeyStore. */
+        static void purgeExternalBodies(KeyStore&, slice docID, Transaction&);
+
         /** A pointer for clients to use */
         void* owner {nullptr};
 
@@ -78,6 +85,7 @@ namespace litecore {
         void dump()          {RevTree::dump();}
 #endif
     protected:
+        virtual alloc_slice readBodyOfRevision(const Rev*) const override;
         virtual alloc_slice copyBody(slice body) override;
         virtual alloc_slice copyBody(const alloc_slice &body) override;
 #if DEBUG
@@ -96,12 +104,19 @@ namespace litecore {
             VersionedDocument* const document;
         };
 
+        static KeyStore& bodyStore(KeyStore&);
+        KeyStore& bodyStore() const;
+        static alloc_slice bodyKey(slice docID, revid);
+
         void decode();
         void updateScope();
         alloc_slice addScope(const alloc_slice &body);
+        void updateExternalBodies(Transaction&);
 
         KeyStore&       _store;
         Record          _rec;
         std::vector<Retained<VersFleeceDoc>> _fleeceScopes;
+        std::vector<alloc_slice> _externalBodies;   // revIDs whose bodies are in bodyStore
+        mutable KeyStore* _bodyStore {nullptr};     // Cached result of bodyStore()
     };
 }
@@ -258,6 +258,7 @@ namespace litecore {
 
     const string DataFile::kDefaultKeyStoreName{"default"};
     const string DataFile::kInfoKeyStoreName{"info"};
+    const string DataFile::kBodiesKeyStorePrefix{"_bodies_"};
 
 
     KeyStore& DataFile::getKeyStore(const string &name) const {
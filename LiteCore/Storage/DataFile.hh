@@ -60,6 +60,16 @@ namespace litecore {
             virtual void externalTransactionCommitted(const SequenceTracker &sourceTracker) { }
         };
 
+        /** Storage-engine tuning parameters. Zero values mean the engine's defaults. */
+        struct Tuning {
+            int64_t             cacheSize {0};          ///< Page cache bytes per connection
+            int64_t             mmapSize {0};           ///< Bytes of file to mmap; negative disables
+            int64_t             journalSizeLimit {0};   ///< Size journal is truncated to
+            uint32_t            pageSize {0};           ///< Page size of a new file
+            uint8_t             synchronous {0};        ///< 1=off, 2=normal, 3=full
+            bool                autoSize {false};       ///< Size cache & mmap from file & RAM size
+        };
+
         struct Options {
             KeyStore::Capabilities keyStores;
             bool                create         :1;      ///< Should the db be created if it doesn't exist?
@@ -68,6 +78,7 @@ namespace litecore {
             bool                upgradeable    :1;      ///< DB schema can be upgraded
             EncryptionAlgorithm encryptionAlgorithm;    ///< What encryption (if any)
             alloc_slice         encryptionKey;          ///< Encryption key, if encrypting
+            Tuning              tuning;                 ///< Engine tuning parameters
             static const Options defaults;
         };
 
@@ -99,6 +110,15 @@ namespace litecore {
 
         virtual void rekey(EncryptionAlgorithm, slice newKey);
 
+        /** Called periodically during a backup with the number of pages copied so far and the
+            total number; returning false cancels the backup. */
+        using BackupProgress = function_ref<bool(uint64_t pagesCopied, uint64_t pagesTotal)>;
+
+        /** Copies the database to a new file, without closing it or blocking writers. The copy
+            is a consistent snapshot of the database as of the start of the backup, encrypted
+            with the same key. Throws POSIX ECANCELED if the progress callback cancels. */
+        virtual void backup(const FilePath &destination, BackupProgress) =0;
+
         Delegate* delegate() const                          {return _delegate;}
         fleece::impl::SharedKeys* documentKeys() const;
 
@@ -117,6 +137,10 @@ namespace litecore {
         static const std::string kDefaultKeyStoreName;
         static const std::string kInfoKeyStoreName;
 
+        /** Reserved prefix of the names of KeyStores that hold the revision bodies of documents
+            in another KeyStore (see VersionedDocument.) */
+        static const std::string kBodiesKeyStorePrefix;
+
         /** The DataFile's default key-value store. */
         KeyStore& defaultKeyStore() const           {return defaultKeyStore(_options.keyStores);}
         KeyStore& defaultKeyStore(KeyStore::Capabilities) const;
@@ -137,9 +137,12 @@ namespace litecore {
 
         using ExpirationCallback = std::function<void(slice docID)>;
 
-        /** Deletes all records whose expiration time is in the past.
+        /** Deletes records whose expiration time is in the past, earliest first.
+            @param callback  If non-null, is called with the key of each record before it's deleted.
+            @param maxRecords  The maximum number of records to delete, or 0 for no limit.
             @return  The number of records deleted */
-        virtual unsigned expireRecords(ExpirationCallback =nullptr) =0;
+        virtual unsigned expireRecords(ExpirationCallback callback =nullptr,
+                                       unsigned maxRecords =0) =0;
 
 
         //////// Indexing:
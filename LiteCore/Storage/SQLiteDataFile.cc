@@ -21,22 +21,27 @@
  * 201: Initial Version
  * 301: Add index table for use with FTS
  * 302: Add purgeCnt entry to kvmeta
+ * 400: Add revision-body KeyStores ("_bodies_" prefix), which older versions don't know about
  */
 
 #include "SQLiteDataFile.hh"
 #include "SQLiteKeyStore.hh"
 #include "SQLite_Internal.hh"
+#include "SQLiteFleeceUtil.hh"
 #include "Record.hh"
 #include "UnicodeCollator.hh"
 #include "Error.hh"
 #include "FilePath.hh"
 #include "SharedKeys.hh"
 #include "Stopwatch.hh"
+#include "Instrumentation.hh"
+#include "Metrics.hh"
 #include "StringUtil.hh"
 #include "SQLiteCpp/SQLiteCpp.h"
 #include "SecureRandomize.hh"
 #include "PlatformCompat.hh"
 #include "fleece/Fleece.hh"
+#include <errno.h>
 #include <mutex>
 #include <sqlite3.h>
 #include <sstream>
@@ -49,10 +54,17 @@ extern "C" {
 
 #if __APPLE__
 #include <TargetConditionals.h>
-#else
-#if defined(_MSC_VER) && !WINAPI_FAMILY_PARTITION(WINAPI_PARTITION_DESKTOP)
+#include <sys/sysctl.h>
+#elif defined(_MSC_VER)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#if !WINAPI_FAMILY_PARTITION(WINAPI_PARTITION_DESKTOP)
 #include "SQLiteTempDirectory.h"
 #endif
+#else
+#include <unistd.h>
 #endif
 
 using namespace std;
@@ -61,22 +73,27 @@ namespace litecore {
 
     static const int64_t MB = 1024 * 1024;
 
-    // SQLite page size
-    static const int64_t kPageSize = 4096;
+    // The defaults below can be overridden by DataFile::Options::tuning.
 
     // SQLite cache size (per connection)
-    static const size_t kCacheSize = 10 * MB;
+    static const int64_t kDefaultCacheSize = 10 * MB;
 
     // Maximum size WAL journal will be left at after a commit
-    static const int64_t kJournalSize = 5 * MB;
+    static const int64_t kDefaultJournalSize = 5 * MB;
 
     // Amount of file to memory-map
 #if TARGET_OS_OSX || TARGET_OS_SIMULATOR
-    static const int kMMapSize =  -1;    // Avoid possible file corruption hazard on macOS
+    static const int64_t kDefaultMMapSize =  -1;    // Avoid possible file corruption hazard on macOS
 #else
-    static const int kMMapSize = 50 * MB;
+    static const int64_t kDefaultMMapSize = 50 * MB;
 #endif
 
+    // Limit on the auto-sized memory-map in a 32-bit address space
+    static const int64_t kMaxMMapSize32 = 256 * MB;
+
+    // Number of WAL pages that triggers a checkpoint (SQLite's default)
+    static const int kAutoCheckpointFrames = 1000;
+
     // If this fraction of the database is composed of free pages, vacuum it on close
     static const float kVacuumFractionThreshold = 0.25;
     // If the database has many bytes of free space, vacuum it on close
@@ -89,6 +106,9 @@ namespace litecore {
 
     LogDomain SQL("SQL", LogLevel::Warning);
 
+    static metrics::Histogram sCommitTime("db.commitUsec");
+    static metrics::Counter sRollbacks("db.rollbacks");
+
     void LogStatement(const SQLite::Statement &st) {
         LogTo(SQL, "... %s", st.getQuery().c_str());
     }
@@ -191,6 +211,12 @@ namespace litecore {
             if (_schemaVersion == SchemaVersion::None) {
                 isNew = true;
                 // Configure persistent db settings, and create the schema.
+                // The page size has to be set before the db is first written to.
+                if (auto pageSize = options().tuning.pageSize; pageSize != 0) {
+                    if (pageSize < 512 || pageSize > 65536 || (pageSize & (pageSize - 1)) != 0)
+                        error::_throw(error::InvalidParameter, "Invalid page size");
+                    _exec(format("PRAGMA page_size=%u", pageSize));
+                }
                 // `auto_vacuum` has to be enabled ASAP, before anything's written to the db!
                 // (even setting `auto_vacuum` writes to the db, it turns out! See CBSE-7971.)
                 _exec("PRAGMA auto_vacuum=incremental; "
@@ -231,12 +257,8 @@ namespace litecore {
             }
         });
 
-        _exec(format("PRAGMA cache_size=%d; "            // Memory cache
-                     "PRAGMA mmap_size=%d; "             // Memory-mapped reads
-                     "PRAGMA synchronous=normal; "       // Speeds up commits
-                     "PRAGMA journal_size_limit=%lld; "  // Limit WAL disk usage
-                     "PRAGMA case_sensitive_like=true",  // Case sensitive LIKE, for N1QL compat
-                     -(int)kCacheSize/1024, kMMapSize, (long long)kJournalSize));
+        configureEngine();
+        _pageSize = intQuery("PRAGMA page_size");
 
 #if DEBUG
         // Deliberately make unordered queries unpredictable, to expose any LiteCore code that
@@ -257,7 +279,8 @@ namespace litecore {
 
         // Register collators, custom functions, and the FTS tokenizer:
         RegisterSQLiteUnicodeCollations(sqlite, _collationContexts);
-        RegisterSQLiteFunctions(sqlite, {delegate(), documentKeys()});
+        _queryBodyCache = make_shared<QueryBodyCache>();
+        RegisterSQLiteFunctions(sqlite, {delegate(), documentKeys(), _queryBodyCache});
         int rc = register_unicodesn_tokenizer(sqlite);
         if (rc != SQLITE_OK)
             warn("Unable to register FTS tokenizer: SQLite err %d", rc);
@@ -278,6 +301,148 @@ namespace litecore {
         _sqlDb = make_unique<SQLite::Database>(filePath().path().c_str(),
                                                sqlFlags,
                                                kBusyTimeoutSecs * 1000);
+        _walFrames = _walCheckpointed = 0;
+        sqlite3_wal_hook(_sqlDb->getHandle(), &walHook, this);
+    }
+
+
+    static int64_t physicalMemorySize() {
+#if __APPLE__
+        int64_t size;
+        size_t length = sizeof(size);
+        if (sysctlbyname("hw.memsize", &size, &length, nullptr, 0) == 0)
+            return size;
+#elif defined(_MSC_VER)
+        MEMORYSTATUSEX status;
+        status.dwLength = sizeof(status);
+        if (GlobalMemoryStatusEx(&status))
+            return int64_t(status.ullTotalPhys);
+#else
+        long pages = sysconf(_SC_PHYS_PAGES), pageSize = sysconf(_SC_PAGESIZE);
+        if (pages > 0 && pageSize > 0)
+            return int64_t(pages) * pageSize;
+#endif
+        return 0;
+    }
+
+
+    // Sets the per-connection SQLite parameters from the tuning options, or the defaults.
+    void SQLiteDataFile::configureEngine() {
+        static const char* const kSynchronousModes[] = {"normal", "off", "normal", "full"};
+        auto &tuning = options().tuning;
+        if (tuning.synchronous >= sizeof(kSynchronousModes)/sizeof(kSynchronousModes[0]))
+            error::_throw(error::InvalidParameter, "Invalid synchronous mode");
+
+        int64_t cacheSize = tuning.cacheSize, mmapSize = tuning.mmapSize;
+        if (tuning.autoSize) {
+            // Scale the cache and memory-map to the database, leaving the memory-map room to
+            // grow, but keep them within a share of the physical memory:
+            int64_t dbSize = filePath().exists() ? filePath().dataSize() : 0;
+            int64_t ram = physicalMemorySize();
+            if (cacheSize == 0)
+                cacheSize = max(min(dbSize / 20, ram / 32), kDefaultCacheSize);
+#if !(TARGET_OS_OSX || TARGET_OS_SIMULATOR)
+            if (mmapSize == 0) {
+                mmapSize = max(min(dbSize + dbSize / 4, ram / 2), kDefaultMMapSize);
+                if (sizeof(void*) < 8)
+                    mmapSize = min(mmapSize, kMaxMMapSize32);
+            }
+#endif
+            logInfo("Auto-sized SQLite cache to %lldMB, mmap to %lldMB (file is %lldMB)",
+                    (long long)cacheSize/MB, (long long)max(mmapSize, int64_t(0))/MB,
+                    (long long)dbSize/MB);
+        }
+        if (cacheSize <= 0)
+            cacheSize = kDefaultCacheSize;
+        if (mmapSize == 0)
+            mmapSize = kDefaultMMapSize;
+        else if (mmapSize < 0)
+            mmapSize = 0;
+        int64_t journalSize = tuning.journalSizeLimit ? tuning.journalSizeLimit
+                                                      : kDefaultJournalSize;
+
+        _exec(format("PRAGMA cache_size=%lld; "          // Memory cache
+                     "PRAGMA mmap_size=%lld; "           // Memory-mapped reads
+                     "PRAGMA synchronous=%s; "           // `normal` speeds up commits
+                     "PRAGMA journal_size_limit=%lld; "  // Limit WAL disk usage
+                     "PRAGMA case_sensitive_like=true",  // Case sensitive LIKE, for N1QL compat
+                     -(long long)cacheSize/1024, (long long)mmapSize,
+                     kSynchronousModes[tuning.synchronous], (long long)journalSize));
+    }
+
+
+    // Called by SQLite after each commit. This replaces SQLite's default WAL hook, which
+    // checkpoints the WAL once it reaches kAutoCheckpointFrames pages, to do the same while
+    // keeping track of how much of the WAL has been checkpointed.
+    int SQLiteDataFile::walHook(void *context, sqlite3 *db, const char *dbName, int nFrames) {
+        auto self = (SQLiteDataFile*)context;
+        if (nFrames < self->_walCheckpointed)
+            self->_walCheckpointed = 0;                 // The WAL has been restarted
+        self->_walFrames = nFrames;
+        if (nFrames >= kAutoCheckpointFrames) {
+            int logFrames, checkpointedFrames;
+            if (sqlite3_wal_checkpoint_v2(db, dbName, SQLITE_CHECKPOINT_PASSIVE,
+                                          &logFrames, &checkpointedFrames) == SQLITE_OK) {
+                self->_walFrames = logFrames;
+                self->_walCheckpointed = checkpointedFrames;
+            }
+        }
+        return SQLITE_OK;
+    }
+
+
+    uint64_t SQLiteDataFile::dataVersion() {
+        return intQuery("PRAGMA data_version");
+    }
+
+
+    uint64_t SQLiteDataFile::checkpoint() {
+        checkOpen();
+        int logFrames, checkpointedFrames;
+        int rc = sqlite3_wal_checkpoint_v2(_sqlDb->getHandle(), nullptr, SQLITE_CHECKPOINT_PASSIVE,
+                                           &logFrames, &checkpointedFrames);
+        if (rc != SQLITE_OK && rc != SQLITE_BUSY)
+            error::_throw(error::SQLite, rc);
+        if (logFrames < 0)                          // db isn't in WAL mode
+            return 0;
+        _walFrames = logFrames;
+        _walCheckpointed = checkpointedFrames;
+        return logFrames - checkpointedFrames;
+    }
+
+
+    uint64_t SQLiteDataFile::incrementalVacuum(unsigned maxPages) {
+        _exec(format("PRAGMA incremental_vacuum(%u)", maxPages));
+        return intQuery("PRAGMA freelist_count");
+    }
+
+
+    SQLiteDataFile::Stats SQLiteDataFile::stats() {
+        checkOpen();
+        auto sqlite = _sqlDb->getHandle();
+        auto dbStatus = [&](int op) -> uint64_t {
+            int current = 0, highwater = 0;
+            sqlite3_db_status(sqlite, op, &current, &highwater, false);
+            return current;
+        };
+
+        Stats stats;
+        stats.cacheHits = dbStatus(SQLITE_DBSTATUS_CACHE_HIT);
+        stats.cacheMisses = dbStatus(SQLITE_DBSTATUS_CACHE_MISS);
+        stats.cacheUsed = dbStatus(SQLITE_DBSTATUS_CACHE_USED);
+        stats.pageSize = _pageSize;
+        // A negative cache_size is in KB, a positive one in pages:
+        int64_t cacheSize = intQuery("PRAGMA cache_size");
+        stats.cacheSize = (cacheSize < 0) ? -cacheSize * 1024 : cacheSize * _pageSize;
+        stats.mmapSize = intQuery("PRAGMA mmap_size");
+        stats.pageCount = intQuery("PRAGMA page_count");
+        stats.freePages = intQuery("PRAGMA freelist_count");
+        FilePath walPath = filePath().appendingToName("-wal");
+        stats.walSize = walPath.exists() ? walPath.dataSize() : 0;
+        int walFrames = _walFrames, checkpointed = _walCheckpointed;
+        stats.walFrames = walFrames;
+        stats.checkpointLag = walFrames - min(checkpointed, walFrames);
+        return stats;
     }
 
 
@@ -465,12 +630,21 @@ namespace litecore {
 
 
     void SQLiteDataFile::_endTransaction(Transaction *t, bool commit) {
+        Signpost signpost(Signpost::commit, uintptr_t(this), commit);
         // Notify key-stores so they can save state:
         forOpenKeyStores([commit](KeyStore &ks) {
             ((SQLiteKeyStore&)ks).transactionWillEnd(commit);
         });
 
-        exec(commit ? "COMMIT" : "ROLLBACK");
+        if (commit) {
+            metrics::Histogram::Timer timer(sCommitTime);
+            exec("COMMIT");
+        } else {
+            ++sRollbacks;
+            exec("ROLLBACK");
+            // The transaction may have raised the schema version:
+            _schemaVersion = SchemaVersion(intQuery("PRAGMA user_version"));
+        }
     }
 
 
@@ -641,6 +815,12 @@ namespace litecore {
     }
 
 
+    void SQLiteDataFile::clearQueryBodyCache() {
+        if (_queryBodyCache)
+            _queryBodyCache->clear();
+    }
+
+
     void SQLiteDataFile::vacuum(bool always) {
         // <https://blogs.gnome.org/jnelson/2015/01/06/sqlite-vacuum-and-auto_vacuum/>
         try {
@@ -651,11 +831,11 @@ namespace litecore {
                        100.0 * freePages / pageCount);
 
             if (!always && (pageCount == 0 || (float)freePages / pageCount < kVacuumFractionThreshold)
-                        && (freePages * kPageSize < kVacuumSizeThreshold))
+                        && (freePages * _pageSize < kVacuumSizeThreshold))
                 return;
 
             string sql;
-            bool fixAutoVacuum = (always || (pageCount * kPageSize) < 10*MB)
+            bool fixAutoVacuum = (always || (pageCount * _pageSize) < 10*MB)
                                     && (intQuery("PRAGMA auto_vacuum") == 0);
             if (fixAutoVacuum) {
                 // Due to issue CBL-707, auto-vacuum did not take effect when creating databases.
@@ -678,7 +858,7 @@ namespace litecore {
 
             int64_t shrunk = pageCount - intQuery("PRAGMA page_count");
             logInfo("    ...removed %lld pages (%lldKB) in %.3f sec",
-                    shrunk, shrunk * kPageSize / 1024, elapsed);
+                    shrunk, shrunk * _pageSize / 1024, elapsed);
 
             if (fixAutoVacuum && intQuery("PRAGMA auto_vacuum") == 0)
                 warn("auto_vacuum mode did not take effect after running full VACUUM!");
@@ -695,6 +875,61 @@ namespace litecore {
     }
 
 
+    void SQLiteDataFile::backup(const FilePath &destination, BackupProgress progress) {
+        static constexpr int kPagesPerStep = 256;
+        checkOpen();
+        logInfo("Backing up to %s", destination.path().c_str());
+
+        // Read from a separate connection, inside a read transaction: in WAL mode that gives a
+        // consistent snapshot that other connections' commits don't disturb, so SQLite never
+        // has to restart the backup, and the writers never wait for it.
+        SQLite::Database src(filePath().path().c_str(), SQLite::OPEN_READONLY,
+                             kBusyTimeoutSecs * 1000);
+        SQLite::Database dst(destination.path().c_str(),
+                             SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE,
+                             kBusyTimeoutSecs * 1000);
+#ifdef COUCHBASE_ENTERPRISE
+        slice key;
+        if (options().encryptionAlgorithm != kNoEncryption)
+            key = options().encryptionKey;
+        for (auto db : {&src, &dst}) {
+            int rc = sqlite3_key_v2(db->getHandle(), nullptr, key.buf, (int)key.size);
+            if (rc != SQLITE_OK)
+                error::_throw(error::UnsupportedEncryption,
+                              "Unable to set encryption key (SQLite error %d)", rc);
+        }
+#endif
+        src.exec("BEGIN");
+        (void)src.execAndGet("SELECT count(*) FROM sqlite_master");   // starts the snapshot
+
+        sqlite3_backup *bk = sqlite3_backup_init(dst.getHandle(), "main", src.getHandle(), "main");
+        if (!bk)
+            error::_throw(error::SQLite, sqlite3_extended_errcode(dst.getHandle()));
+        int rc;
+        bool canceled = false;
+        do {
+            rc = sqlite3_backup_step(bk, kPagesPerStep);
+            if (rc == SQLITE_BUSY || rc == SQLITE_LOCKED) {
+                sqlite3_sleep(10);
+                rc = SQLITE_OK;
+            } else if (rc == SQLITE_OK || rc == SQLITE_DONE) {
+                int total = sqlite3_backup_pagecount(bk);
+                canceled = !progress(total - sqlite3_backup_remaining(bk), total);
+            }
+        } while (rc == SQLITE_OK && !canceled);
+        sqlite3_backup_finish(bk);
+        src.exec("COMMIT");
+
+        if (canceled) {
+            logInfo("Backup canceled");
+            error::_throw(error::POSIX, ECANCELED);
+        } else if (rc != SQLITE_DONE) {
+            error::_throw(error::SQLite, rc);
+        }
+        logInfo("Finished backing up to %s", destination.path().c_str());
+    }
+
+
     alloc_slice SQLiteDataFile::rawQuery(const string &query) {
         SQLite::Statement stmt(*_sqlDb, query);
         int nCols = stmt.getColumnCount();
@@ -21,8 +21,11 @@
 #include "DataFile.hh"
 #include "IndexSpec.hh"
 #include "UnicodeCollator.hh"
+#include <atomic>
 #include <optional>
 
+struct sqlite3;
+
 namespace SQLite {
     class Database;
     class Statement;
@@ -34,6 +37,7 @@ namespace litecore {
 
     class SQLiteKeyStore;
     struct SQLiteIndexSpec;
+    class QueryBodyCache;
 
 
     /** SQLite implementation of DataFile. */
@@ -47,9 +51,35 @@ namespace litecore {
 
         uint64_t fileSize() override;
         void compact() override;
+        void backup(const FilePath &destination, BackupProgress) override;
         void optimize();
         void vacuum(bool always);
 
+        /** Frees the document bodies cached by the Fleece SQL functions; call when a query ends. */
+        void clearQueryBodyCache();
+
+        /** Storage statistics; the cache and WAL figures are for this connection. */
+        struct Stats {
+            uint64_t cacheHits, cacheMisses, cacheUsed;
+            int64_t  cacheSize, mmapSize;
+            uint64_t pageSize, pageCount, freePages;
+            uint64_t walSize, walFrames, checkpointLag;
+        };
+        Stats stats();
+
+        /** The value of `PRAGMA data_version`, which changes whenever another connection
+            commits a change to the database. */
+        uint64_t dataVersion();
+
+        /** Runs a PASSIVE checkpoint, which copies as much of the WAL into the database as it
+            can without waiting for any reader or writer. Returns the number of pages left
+            un-checkpointed. Must not be called in a transaction. */
+        uint64_t checkpoint();
+
+        /** Moves up to `maxPages` free pages to the end of the file and truncates them.
+            Returns the number of free pages remaining. */
+        uint64_t incrementalVacuum(unsigned maxPages);
+
         static void shutdown() { }
 
         operator SQLite::Database&() {return *_sqlDb;}
@@ -128,14 +158,17 @@ namespace litecore {
         enum class SchemaVersion {
             None            = 0,    // Newly created database
             MinReadable     = 201,  // Cannot open earlier versions than this (CBL 2.0)
-            MaxReadable     = 399,  // Cannot open versions newer than this
+            MaxReadable     = 499,  // Cannot open versions newer than this
 
             WithIndexTable  = 301,  // Added 'indexes' table (CBL 2.5)
             WithPurgeCount  = 302,  // Added 'purgeCnt' column to KeyStores (CBL 2.7)
+            WithExternalBodies = 400, // Revision bodies stored outside their documents
         };
 
         void reopenSQLiteHandle();
+        void configureEngine();
         void ensureSchemaVersionAtLeast(SchemaVersion);
+        static int walHook(void *context, sqlite3*, const char *dbName, int nFrames);
         void decrypt();
         bool _decrypt(EncryptionAlgorithm, slice key);
         int _exec(const std::string &sql);
@@ -151,10 +184,14 @@ namespace litecore {
         std::vector<SQLiteIndexSpec> getIndexesOldStyle(const KeyStore *store =nullptr);
 
         std::unique_ptr<SQLite::Database>    _sqlDb;         // SQLite database object
+        std::shared_ptr<QueryBodyCache>      _queryBodyCache; // Used by the Fleece SQL functions
         std::unique_ptr<SQLite::Statement>   _getLastSeqStmt, _setLastSeqStmt;
         std::unique_ptr<SQLite::Statement>   _getPurgeCntStmt, _setPurgeCntStmt;
         CollationContextVector               _collationContexts;
         SchemaVersion                        _schemaVersion {SchemaVersion::None};
+        int64_t                              _pageSize {4096};
+        std::atomic<int>                     _walFrames {0};         // Pages in the WAL
+        std::atomic<int>                     _walCheckpointed {0};   // ...of which checkpointed
     };
 
 
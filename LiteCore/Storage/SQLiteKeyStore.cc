@@ -68,6 +68,9 @@ namespace litecore {
                                   "  flags INTEGER DEFAULT 0,"
                                   "  version BLOB,"
                                   "  body BLOB)"));
+            // Older versions would ignore the revision bodies stored here:
+            if (hasPrefix(name, DataFile::kBodiesKeyStorePrefix))
+                db.ensureSchemaVersionAtLeast(SQLiteDataFile::SchemaVersion::WithExternalBodies);
         }
     }
 
@@ -194,6 +197,8 @@ namespace litecore {
 
         _lastSequence = -1;
         _purgeCountValid = false;
+        if (!commit)
+            invalidateIndexInfo();      // It may describe indexes that were just rolled back
 
         if (!commit && _uncommittedExpirationColumn)
             _hasExpirationColumn = false;
@@ -539,16 +544,19 @@ namespace litecore {
     }
 
 
-    unsigned SQLiteKeyStore::expireRecords(ExpirationCallback callback) {
+    unsigned SQLiteKeyStore::expireRecords(ExpirationCallback callback, unsigned maxRecords) {
         if (!hasExpiration())
             return 0;
         expiration_t t = now();
+        long long limit = maxRecords ? maxRecords : -1;     // (a negative LIMIT means no limit)
         unsigned expired = 0;
         bool none = false;
         if (callback) {
-            compile(_findExpStmt, "SELECT key FROM kv_@ WHERE expiration <= ?");
+            compile(_findExpStmt, "SELECT key FROM kv_@ WHERE expiration <= ? "
+                                  "ORDER BY expiration, rowid LIMIT ?");
             UsingStatement u(*_findExpStmt);
             _findExpStmt->bind(1, (long long)t);
+            _findExpStmt->bind(2, limit);
             none = true;
             while (_findExpStmt->executeStep()) {
                 none = false;
@@ -556,8 +564,16 @@ namespace litecore {
             }
         }
         if (!none) {
-            expired = db().exec(format("DELETE FROM kv_%s WHERE expiration <= %" PRId64,
-                                       name().c_str(), t));
+            if (maxRecords == 0) {
+                expired = db().exec(format("DELETE FROM kv_%s WHERE expiration <= %" PRId64,
+                                           name().c_str(), t));
+            } else {
+                // Delete the same records the callback was given:
+                expired = db().exec(format("DELETE FROM kv_%s WHERE rowid IN "
+                                           "(SELECT rowid FROM kv_%s WHERE expiration <= %" PRId64
+                                           " ORDER BY expiration, rowid LIMIT %u)",
+                                           name().c_str(), name().c_str(), t, maxRecords));
+            }
         }
         db()._logInfo("Purged %u expired documents", expired);
         return expired;
@@ -22,6 +22,8 @@
 #include "FleeceImpl.hh"
 #include <mutex>
 #include <atomic>
+#include <optional>
+#include <set>
 
 namespace SQLite {
     class Column;
@@ -58,7 +60,8 @@ namespace litecore {
         virtual bool setExpiration(slice key, expiration_t) override;
         virtual expiration_t getExpiration(slice key) override;
         virtual expiration_t nextExpiration() override;
-        virtual unsigned expireRecords(ExpirationCallback =nullptr) override;
+        virtual unsigned expireRecords(ExpirationCallback =nullptr,
+                                       unsigned maxRecords =0) override;
 
         bool supportsIndexes(IndexSpec::Type t) const override               {return true;}
         bool createIndex(const IndexSpec&) override;
@@ -77,9 +80,13 @@ namespace litecore {
         virtual std::string tableName() const override  {return std::string("kv_") + name();}
         virtual std::string FTSTableName(const std::string &property) const override;
         virtual std::string unnestedTableName(const std::string &property) const override;
+        virtual std::string hotPropertyTableName(const std::string &property) const override;
 #ifdef COUCHBASE_ENTERPRISE
         virtual std::string predictiveTableName(const std::string &property) const override;
+        virtual std::string vectorTableName(const std::string &property) const override;
 #endif
+        virtual std::vector<CoveringIndex> coveringIndexes() const override;
+        virtual bool hasValueIndexOn(const std::string &property) const override;
         virtual bool tableExists(const std::string &tableName) const override;
 
 
@@ -118,6 +125,7 @@ namespace litecore {
                            std::string when,
                            string_view statements);
         bool createValueIndex(const IndexSpec&);
+        bool createCoveringIndex(const IndexSpec&);
         bool createIndex(const IndexSpec&,
                               const std::string &sourceTableName,
                               fleece::impl::Array::iterator &expressions);
@@ -125,6 +133,7 @@ namespace litecore {
         bool createFTSIndex(const IndexSpec&);
         bool createArrayIndex(const IndexSpec&);
         std::string createUnnestedTable(const fleece::impl::Value *arrayPath, const IndexSpec::Options*);
+        bool createHotPropertyIndex(const IndexSpec&);
         bool hasExpiration();
         void addExpiration();
 
@@ -132,8 +141,22 @@ namespace litecore {
         bool createPredictiveIndex(const IndexSpec&);
         std::string createPredictionTable(const fleece::impl::Value *arrayPath, const IndexSpec::Options*);
         void garbageCollectPredictiveIndexes();
+        bool createVectorIndex(const IndexSpec&);
+        std::string createVectorTable(const fleece::impl::Value *expression, const IndexSpec::Options*);
+        bool vectorOptionsMatch(const std::string &vectorTableName, const IndexSpec::Options*);
 #endif
 
+        // What the QueryParser needs to know about indexes, cached since it's asked for by every
+        // query compilation. It's invalidated when this KeyStore creates or deletes an index,
+        // and reloaded when the schema changes, as when another connection does so.
+        struct IndexInfo {
+            int64_t schemaVersion;
+            std::vector<CoveringIndex> coveringIndexes;
+            std::set<std::string> valueIndexedProperties;
+        };
+        const IndexInfo& indexInfo() const;         // Must be called under _indexInfoMutex
+        void invalidateIndexInfo();
+
         // All of these Statement pointers have to be reset in the close() method.
         std::unique_ptr<SQLite::Statement> _recCountStmt;
         std::unique_ptr<SQLite::Statement> _getByKeyStmt, _getCurByKeyStmt, _getMetaByKeyStmt;
@@ -152,6 +175,8 @@ namespace litecore {
         bool _hasExpirationColumn {false};
         bool _uncommittedExpirationColumn {false};
         mutable std::mutex _stmtMutex;
+        mutable std::optional<IndexInfo> _indexInfo;
+        mutable std::mutex _indexInfoMutex;
     };
 
 }
@@ -59,15 +59,19 @@ namespace litecore {
     };
 
 
+    class QueryBodyCache;
+
     // What the user_data of a registered function points to
     struct fleeceFuncContext {
         fleeceFuncContext(DataFile::Delegate *d,
-                          fleece::impl::SharedKeys *sk)
-        :delegate(d), sharedKeys(sk)
+                          fleece::impl::SharedKeys *sk,
+                          std::shared_ptr<QueryBodyCache> bc =nullptr)
+        :delegate(d), sharedKeys(sk), bodyCache(std::move(bc))
         { }
 
         DataFile::Delegate* delegate;
         fleece::impl::SharedKeys* const sharedKeys;
+        std::shared_ptr<QueryBodyCache> bodyCache;  // Shared by the functions of a connection
     };
 
 
@@ -0,0 +1,142 @@
+//
+// AsyncWriteStream.cc
+//
+// Copyright © 2019 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "AsyncWriteStream.hh"
+#include <algorithm>
+
+namespace litecore {
+    using namespace std;
+
+
+    AsyncWriteStream::AsyncWriteStream(shared_ptr<WriteStream> output, size_t maxQueued)
+    :_output(move(output))
+    ,_maxQueued(max(maxQueued, kBufferSize))
+    { }
+
+
+    AsyncWriteStream::~AsyncWriteStream() {
+        stop(true);
+    }
+
+
+    void AsyncWriteStream::goAsync() {
+        if (!_thread.joinable())
+            _thread = thread(&AsyncWriteStream::run, this);
+    }
+
+
+    void AsyncWriteStream::write(slice data) {
+        if (!isAsync()) {
+            _output->write(data);
+            return;
+        }
+        while (data.size > 0) {
+            if (_buffer.capacity() < kBufferSize)
+                _buffer.reserve(kBufferSize);
+            size_t n = min(data.size, kBufferSize - _buffer.size());
+            _buffer.append((const char*)data.buf, n);
+            data.moveStart(n);
+            if (_buffer.size() >= kBufferSize)
+                enqueueBuffer();
+        }
+    }
+
+
+    // Hands the current buffer to the background thread, first waiting for room in the queue.
+    void AsyncWriteStream::enqueueBuffer() {
+        unique_lock<mutex> lock(_mutex);
+        _cond.wait(lock, [&]{return _queuedBytes < _maxQueued || _error;});
+        if (_error)
+            rethrow_exception(_error);
+        if (_buffer.empty())
+            return;
+        _queuedBytes += _buffer.size();
+        _queue.push_back(move(_buffer));
+        if (_spares.empty()) {
+            _buffer = string();
+        } else {
+            _buffer = move(_spares.front());
+            _spares.pop_front();
+        }
+        _cond.notify_all();
+    }
+
+
+    void AsyncWriteStream::flush() {
+        if (!isAsync())
+            return;
+        enqueueBuffer();
+        unique_lock<mutex> lock(_mutex);
+        _cond.wait(lock, [&]{return _queuedBytes == 0 || _error;});
+        if (_error)
+            rethrow_exception(_error);
+    }
+
+
+    void AsyncWriteStream::close() {
+        flush();
+        stop(false);
+        _output->close();
+    }
+
+
+    void AsyncWriteStream::stop(bool discard) {
+        if (!isAsync())
+            return;
+        {
+            lock_guard<mutex> lock(_mutex);
+            if (discard)
+                _queue.clear();
+            _stopping = true;
+            _cond.notify_all();
+        }
+        _thread.join();
+        _stopping = false;
+    }
+
+
+    // Body of the background thread.
+    void AsyncWriteStream::run() {
+        unique_lock<mutex> lock(_mutex);
+        while (true) {
+            _cond.wait(lock, [&]{return !_queue.empty() || _stopping;});
+            if (_queue.empty())
+                break;
+            string buffer = move(_queue.front());
+            _queue.pop_front();
+            if (!_error) {
+                // Write without holding the lock, so the writer can fill the next buffer:
+                exception_ptr error;
+                lock.unlock();
+                try {
+                    _output->write(slice(buffer));
+                } catch (...) {
+                    error = current_exception();
+                }
+                lock.lock();
+                if (error)
+                    _error = error;
+            }
+            _queuedBytes -= buffer.size();
+            buffer.clear();
+            _spares.push_back(move(buffer));
+            _cond.notify_all();
+        }
+    }
+
+}
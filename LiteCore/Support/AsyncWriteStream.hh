@@ -0,0 +1,83 @@
+//
+// AsyncWriteStream.hh
+//
+// Copyright © 2019 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "Stream.hh"
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace litecore {
+
+    /** A WriteStream that passes data on to another WriteStream, optionally on a background
+        thread. It starts out synchronous; after `goAsync` is called, written data is copied into
+        buffers that a background thread writes to the output, so the caller can go on producing
+        data while the output is consuming it. Several of these can be chained into a pipeline
+        whose stages run in parallel.
+        At most `maxQueued` bytes are buffered; beyond that, `write` blocks until the output
+        catches up. An exception thrown by the output on the background thread is rethrown by the
+        next call to `write`, `flush` or `close`. */
+    class AsyncWriteStream : public WriteStream {
+    public:
+        static constexpr size_t kBufferSize = 64 * 1024;
+        static constexpr size_t kDefaultMaxQueued = 1024 * 1024;
+
+        explicit AsyncWriteStream(std::shared_ptr<WriteStream> output,
+                                  size_t maxQueued =kDefaultMaxQueued);
+
+        /** Stops the background thread, discarding any unwritten data. Does not close the output,
+            since that could throw. */
+        ~AsyncWriteStream();
+
+        /** Starts the background thread. Has no effect if it's already running. */
+        void goAsync();
+
+        bool isAsync() const                    {return _thread.joinable();}
+
+        /** Blocks until all data written so far has been written to the output. */
+        void flush();
+
+        virtual void write(slice) override;
+
+        /** Writes all remaining data, stops the background thread, then closes the output on the
+            calling thread. */
+        virtual void close() override;
+
+    private:
+        void enqueueBuffer();
+        void run();
+        void stop(bool discard);
+
+        std::shared_ptr<WriteStream> const _output;
+        size_t const _maxQueued;
+        std::string _buffer;                    // Buffer being filled by the writer
+        std::thread _thread;
+        std::mutex _mutex;
+        std::condition_variable _cond;
+        std::deque<std::string> _queue;         // Filled buffers waiting to be written
+        std::deque<std::string> _spares;        // Empty buffers available for reuse
+        size_t _queuedBytes {0};                // Bytes queued or being written
+        bool _stopping {false};
+        std::exception_ptr _error;              // Exception thrown by the output
+    };
+
+}
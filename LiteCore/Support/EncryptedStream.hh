@@ -18,9 +18,11 @@
 
 #pragma once
 #include "Stream.hh"
+#include <memory>
 
 
 namespace litecore {
+    class AES256Cipher;
 
     /** Abstract base class of EncryptedReadStream and EncryptedWriteStream. */
     class EncryptedStream {
@@ -28,16 +30,18 @@ namespace litecore {
         static constexpr size_t kKeySize = kEncryptionKeySize[kAES256];
         static const unsigned kFileSizeOverhead = kKeySize;
         static const unsigned kFileBlockSize = 4096;
+        static const unsigned kBatchBlocks = 8;     // Max # of blocks encrypted/decrypted at once
 
     protected:
-        EncryptedStream() { }
+        EncryptedStream();
         void initEncryptor(EncryptionAlgorithm alg,
                            slice encryptionKey,
-                           slice nonce);
+                           slice nonce,
+                           bool encrypting);
         virtual ~EncryptedStream();
 
         EncryptionAlgorithm _alg;
-        uint8_t _key[kKeySize];
+        std::unique_ptr<AES256Cipher> _cipher;  // Keeps the key schedule for all blocks
         uint8_t _nonce[kKeySize];
         uint8_t _buffer[kFileBlockSize];    // stores partially read/written blocks across calls
         size_t _bufferPos {0};        // Indicates how much of buffer is used
@@ -58,6 +62,7 @@ namespace litecore {
 
     private:
         void writeBlock(slice plaintext, bool finalBlock);
+        void writeBlocks(slice plaintext);
 
         std::shared_ptr<WriteStream> _output;    // Wrapped stream that will write the ciphertext
     };
@@ -77,6 +82,7 @@ namespace litecore {
 
     private:
         size_t readBlockFromFile(slice output);
+        size_t readBlocksFromFile(slice output, unsigned count);
         void readFromBuffer(slice &dst);
         void fillBuffer();
         void findLength();
@@ -40,6 +40,7 @@
 #elif defined(__linux__)
 #include "strlcat.h"
 #include <sys/sendfile.h>
+#include <sys/syscall.h>
 #endif
 #else
 #include <atlbase.h>
@@ -584,6 +585,36 @@ namespace litecore {
     }
 
 
+    FilePath FilePath::mkAnonymousTempFile(FILE* *outHandle) const {
+#if defined(__linux__) && defined(O_TMPFILE)
+        int fd = open(dir().path().c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+        if (fd < 0) {
+            // Older kernels and some filesystems don't support O_TMPFILE:
+            if (errno == EOPNOTSUPP || errno == EISDIR || errno == EINVAL)
+                return FilePath();
+            error::_throwErrno();
+        }
+        *outHandle = fdopen(fd, "wb+");
+        if (*outHandle == nullptr) {
+            fdclose(fd);
+            error::_throwErrno();
+        }
+        // This "magic" symlink refers to the open file itself, even though it has no name.
+        // It's unusable if /proc isn't mounted, as in some containers and chroots:
+        char pathBuf[64];
+        sprintf(pathBuf, "/proc/self/fd/%d", fd);
+        if (access(pathBuf, F_OK) != 0) {
+            fclose(*outHandle);
+            *outHandle = nullptr;
+            return FilePath();
+        }
+        return FilePath(pathBuf);
+#else
+        return FilePath();
+#endif
+    }
+
+
     FilePath FilePath::mkTempDir() const {
         char pathBuf[kPathBufSize];
         makePathTemplate(this, pathBuf);
@@ -693,6 +724,40 @@ namespace litecore {
     }
 
 
+    bool FilePath::moveToIfAbsent(const FilePath &to) const {
+#if defined(__linux__) && defined(SYS_renameat2)
+        // renameat2 isn't wrapped by older versions of glibc, so call it directly:
+        static constexpr unsigned kRenameNoReplace = 1;     // RENAME_NOREPLACE
+        if (syscall(SYS_renameat2, AT_FDCWD, path().c_str(),
+                    AT_FDCWD, to.path().c_str(), kRenameNoReplace) == 0)
+            return true;
+        else if (errno == EEXIST)
+            return false;
+        else if (errno != ENOSYS && errno != EINVAL)
+            error::_throwErrno();
+        // else the kernel or filesystem doesn't support it; fall through...
+#endif
+        if (to.exists())
+            return false;
+        moveTo(to);
+        return true;
+    }
+
+
+    bool FilePath::linkTo(const FilePath &to) const {
+#ifdef _MSC_VER
+        error::_throw(error::Unimplemented);
+#else
+        // AT_SYMLINK_FOLLOW makes this work on a "/proc/self/fd" path of an anonymous file
+        if (linkat(AT_FDCWD, path().c_str(), AT_FDCWD, to.path().c_str(), AT_SYMLINK_FOLLOW) == 0)
+            return true;
+        if (errno == EEXIST)
+            return false;
+        error::_throwErrno();
+#endif
+    }
+
+
     void FilePath::moveToReplacingDir(const FilePath &to, bool asyncCleanup) const {
 #ifdef _MSC_VER
         bool overwriting = to.exists();
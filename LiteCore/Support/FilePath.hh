@@ -130,6 +130,14 @@ namespace litecore {
             If the `outHandle` parameter is non-null, it will be set to a writeable file handle. */
         FilePath mkTempFile(FILE* *outHandle =nullptr) const;
 
+        /** Creates an anonymous temporary file on this directory's filesystem. It has no name
+            until `linkTo` gives it one, and vanishes once it's no longer open.
+            Returns a path that refers to the file as long as it's open, and sets `outHandle` to a
+            writeable file handle. If the platform or filesystem doesn't support anonymous files
+            (only Linux does), or /proc isn't available, returns an empty FilePath, which can be
+            detected with `isDir`. */
+        FilePath mkAnonymousTempFile(FILE* *outHandle NONNULL) const;
+
         /** Creates an empty temporary directory by appending a random 6-letter/digit string. */
         FilePath mkTempDir() const;
 
@@ -146,6 +154,14 @@ namespace litecore {
         void moveTo(const FilePath& to) const  {moveTo(to.path());}
         void moveTo(const std::string&) const;
 
+        /** Like moveTo, but leaves an existing file at the destination alone, returning false.
+            (This is atomic where the platform supports it.) */
+        bool moveToIfAbsent(const FilePath &to) const;
+
+        /** Creates a hard link to this file at the path `to`; this is how an anonymous temporary
+            file gets a name. Returns false if a file already exists at `to`. */
+        bool linkTo(const FilePath &to) const;
+
         /** Like moveTo, but can replace a non-empty directory.
              First moves the destination dir aside to the temp directory,
              then moves the source into place,
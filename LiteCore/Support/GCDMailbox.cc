@@ -19,6 +19,7 @@
 #include "GCDMailbox.hh"
 #include "Actor.hh"
 #include "Logging.hh"
+#include "Metrics.hh"
 #include <algorithm>
 #include "betterassert.hh"
 
@@ -26,6 +27,8 @@ using namespace std;
 
 namespace litecore { namespace actor {
 
+    static metrics::Histogram sEventTime("actor.eventUsec");
+
 
 #if ACTORS_TRACK_STATS
 #define beginLatency()  fleece::Stopwatch st
@@ -83,6 +86,7 @@ namespace litecore { namespace actor {
 
 
     void GCDMailbox::safelyCall(void (^block)()) const {
+        metrics::Histogram::Timer timer(sEventTime);
         try {
             block();
         } catch (const std::exception &x) {
@@ -17,32 +17,205 @@
 //
 
 #include "Instrumentation.hh"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
 
 #ifdef __APPLE__
 #include <sys/kdebug_signpost.h>
 #endif
 
 namespace litecore {
+    using namespace std;
 
-#if defined(__APPLE__) && LITECORE_SIGNPOSTS
+#if LITECORE_SIGNPOSTS
+
+#pragma mark - TRACE BUFFERS:
+
+
+    static const char* const kTypeNames[] = {
+        nullptr, "transaction", "replicatorConnect", "replicatorDisconnect", "replication",
+        "changesBackPressure", "revsBackPressure", "handlingChanges", "handlingRev",
+        "blipReceived", "blipSent", "commit", "queryRun", "indexUpdate", "blobInstall",
+        "blipFrameSent", "blipFrameReceived",
+    };
+
+
+    namespace {
+        struct TraceEvent {
+            int64_t     time;           // nanoseconds since tracing started
+            uintptr_t   param1, param2;
+            uint8_t     type;
+            char        phase;          // Chrome trace-event phase: 'b', 'e' or 'i'
+        };
+
+
+        // A fixed-size buffer of the events recorded by one thread. Only the owning thread
+        // writes events; it publishes each one by incrementing `count`, so `stopTracing` can
+        // read the events below `count` without locking. When the buffer is full, further
+        // events are counted but not recorded.
+        struct ThreadTrace {
+            static constexpr size_t kCapacity = 16384;
+
+            explicit ThreadTrace(unsigned tid_)         :tid(tid_) { }
+
+            unsigned const          tid;
+            unique_ptr<TraceEvent[]> events {new TraceEvent[kCapacity]};
+            atomic<size_t>          count {0};
+            atomic<size_t>          dropped {0};
+            atomic<unsigned>        generation {0};     // Trace session the events belong to
+        };
+    }
+
+
+    static atomic<bool>     sTracing {false};
+    static atomic<unsigned> sGeneration {0};
+    static atomic<int64_t>  sStartTime {0};
+    static mutex            sTraceMutex;                // Guards sThreadTraces
+    static vector<shared_ptr<ThreadTrace>> sThreadTraces;
+    static unsigned         sNextTID = 1;
+
+
+    static int64_t traceClock() {
+        return chrono::duration_cast<chrono::nanoseconds>(
+                            chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+
+    static ThreadTrace& threadTrace() {
+        static thread_local shared_ptr<ThreadTrace> tTrace;
+        if (!tTrace) {
+            lock_guard<mutex> lock(sTraceMutex);
+            tTrace = make_shared<ThreadTrace>(sNextTID++);
+            sThreadTraces.push_back(tTrace);
+        }
+        return *tTrace;
+    }
+
+
+    static void record(char phase, Signpost::Type t, uintptr_t param, uintptr_t param2) {
+        if (!sTracing.load(memory_order_relaxed))
+            return;
+        int64_t time = traceClock() - sStartTime.load(memory_order_relaxed);
+        ThreadTrace &trace = threadTrace();
+        unsigned gen = sGeneration.load(memory_order_acquire);
+        if (trace.generation.load(memory_order_relaxed) != gen) {
+            // First event of a new trace session; discard the old session's events:
+            trace.count.store(0, memory_order_relaxed);
+            trace.dropped.store(0, memory_order_relaxed);
+            trace.generation.store(gen, memory_order_release);
+        }
+        size_t n = trace.count.load(memory_order_relaxed);
+        if (n >= ThreadTrace::kCapacity) {
+            trace.dropped.fetch_add(1, memory_order_relaxed);
+            return;
+        }
+        trace.events[n] = {time, param, param2, uint8_t(t), phase};
+        trace.count.store(n + 1, memory_order_release);
+    }
+
+
+    void Signpost::startTracing() {
+        lock_guard<mutex> lock(sTraceMutex);
+        // Forget the buffers of threads that have exited:
+        sThreadTraces.erase(remove_if(sThreadTraces.begin(), sThreadTraces.end(),
+                                      [](const shared_ptr<ThreadTrace> &trace) {
+                                          return trace.use_count() == 1;
+                                      }),
+                            sThreadTraces.end());
+        sStartTime = traceClock();
+        ++sGeneration;
+        sTracing = true;
+    }
+
+
+    bool Signpost::tracing() {
+        return sTracing;
+    }
+
+
+    string Signpost::stopTracing() {
+        sTracing = false;
+        unsigned gen = sGeneration;
+
+        stringstream out;
+        out << "{\"traceEvents\":[";
+        bool first = true;
+        size_t dropped = 0;
+        lock_guard<mutex> lock(sTraceMutex);
+        for (auto &trace : sThreadTraces) {
+            if (trace->generation.load(memory_order_acquire) != gen)
+                continue;
+            size_t count = trace->count.load(memory_order_acquire);
+            dropped += trace->dropped;
+            for (size_t i = 0; i < count; ++i) {
+                const TraceEvent &e = trace->events[i];
+                if (!first)
+                    out << ",\n";
+                first = false;
+                char ts[32];
+                snprintf(ts, sizeof(ts), "%.3f", e.time / 1000.0);     // in microseconds
+                out << "{\"name\":\"" << kTypeNames[e.type] << "\",\"cat\":\"litecore\""
+                    << ",\"ph\":\"" << e.phase << "\",\"ts\":" << ts
+                    << ",\"pid\":1,\"tid\":" << trace->tid;
+                if (e.phase == 'i')
+                    out << ",\"s\":\"t\"";
+                else
+                    out << ",\"id\":\"0x" << hex << e.param1 << dec << "\"";
+                out << ",\"args\":{\"param\":" << e.param1
+                    << ",\"param2\":" << e.param2 << "}}";
+            }
+        }
+        out << "],\"displayTimeUnit\":\"ms\",\"otherData\":{\"droppedEvents\":"
+            << dropped << "}}";
+        return out.str();
+    }
+
+
+#pragma mark - SIGNPOSTS:
+
+
+#ifdef __APPLE__
     enum Color {
         blue, green, purple, orange, red    // used for last argument
     };
+#endif
 
     void Signpost::mark(Type t, uintptr_t param, uintptr_t param2) {
+#ifdef __APPLE__
         if (__builtin_available(macOS 10.12, iOS 10, tvOS 10, *))
             kdebug_signpost(t, param, param2, 0, (t % 5));
+#endif
+        record('i', t, param, param2);
     }
 
     void Signpost::begin(Type t, uintptr_t param, uintptr_t param2) {
+#ifdef __APPLE__
         if (__builtin_available(macOS 10.12, iOS 10, tvOS 10, *))
             kdebug_signpost_start(t, param, param2, 0, (t % 5));
+#endif
+        record('b', t, param, param2);
     }
 
     void Signpost::end(Type t, uintptr_t param, uintptr_t param2) {
+#ifdef __APPLE__
         if (__builtin_available(macOS 10.12, iOS 10, tvOS 10, *))
             kdebug_signpost_end(t, param, param2, 0, (t % 5));
-    }
 #endif
+        record('e', t, param, param2);
+    }
+
+#else // LITECORE_SIGNPOSTS
+
+    void Signpost::startTracing()       { }
+    bool Signpost::tracing()            {return false;}
+    string Signpost::stopTracing()      {return "{\"traceEvents\":[]}";}
+
+#endif // LITECORE_SIGNPOSTS
 
 }
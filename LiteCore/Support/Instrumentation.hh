@@ -18,14 +18,20 @@
 
 #pragma once
 #include <stdint.h>
+#include <string>
 
 namespace litecore {
 
-#ifdef __APPLE__
+// Define this as 0 to compile signposts out entirely.
+#ifndef LITECORE_SIGNPOSTS
 #define LITECORE_SIGNPOSTS 1
 #endif
 
-    /** A utility for logging chronological points and regions of interest, for profiling. */
+    /** A utility for logging chronological points and regions of interest, for profiling.
+        On Apple platforms they're sent to kdebug, where Instruments shows them. On every
+        platform, while tracing is on they're also recorded into per-thread buffers, which
+        can be written out as a Chrome trace-event JSON file (viewable in Perfetto's UI or
+        chrome://tracing.) */
     class Signpost {
     public:
         enum Type {
@@ -39,8 +45,24 @@ namespace litecore {
             handlingRev,
             blipReceived,
             blipSent,           // 10
+            commit,                     // begin/end
+            queryRun,                   // begin/end
+            indexUpdate,                // begin/end
+            blobInstall,                // begin/end
+            blipFrameSent,      // 15
+            blipFrameReceived,
         };
 
+        /** Starts recording signposts, discarding any previously recorded. */
+        static void startTracing();
+
+        /** Stops recording signposts, and returns the ones recorded since `startTracing`
+            as Chrome trace-event JSON. */
+        static std::string stopTracing();
+
+        /** True if signposts are being recorded. */
+        static bool tracing();
+
 #if LITECORE_SIGNPOSTS
         static void mark(Type, uintptr_t param =0, uintptr_t param2 =0);
         static void begin(Type, uintptr_t param =0, uintptr_t param2 =0);
@@ -61,7 +83,7 @@ namespace litecore {
         static inline void begin(Type, uintptr_t param =0, uintptr_t param2 =0)   { }
         static inline void end(Type, uintptr_t param =0, uintptr_t param2 =0)     { }
 
-        Signpost(Type t)                                    { }
+        Signpost(Type t, uintptr_t param1 =0, uintptr_t param2 =0)   { }
         ~Signpost()                                         { }
 #endif
     };
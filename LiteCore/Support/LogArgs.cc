@@ -0,0 +1,245 @@
+//
+// LogArgs.cc
+//
+// Copyright © 2019 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "LogArgs.hh"
+#include "StringUtil.hh"
+#include <algorithm>
+
+#if __APPLE__
+#import <CoreFoundation/CFBase.h>
+#import <CoreFoundation/CFString.h>
+#endif
+
+namespace litecore {
+    using namespace std;
+    using namespace fleece;
+
+
+    bool LogArgs::nextSpec(const char* &c, Spec &spec) {
+        c = strchr(c, '%');
+        if (!c)
+            return false;
+        spec.start = c++;
+        spec.minus = (*c == '-');
+        if (spec.minus)
+            ++c;
+        c += strspn(c, "#0- +'");
+        while (isdigit(*c))
+            ++c;
+        spec.dotStar = false;
+        if (*c == '.') {
+            ++c;
+            if (*c == '*') {
+                spec.dotStar = true;
+                ++c;
+            } else {
+                while (isdigit(*c))
+                    ++c;
+            }
+        }
+        spec.lengthMod = c;
+        spec.lengthModSize = strspn(c, "hljtzq");
+        c += spec.lengthModSize;
+        spec.conversion = *c;
+        if (*c)
+            ++c;
+        spec.end = c;
+        return true;
+    }
+
+
+    enum ArgSize {kInt, kLong, kLongLong, kSize};
+
+    // The size of an integer argument, according to its length modifier. (This follows the same
+    // rules as LogEncoder.)
+    static ArgSize argSize(const LogArgs::Spec &spec) {
+        if (spec.lengthModSize == 0)
+            return kInt;
+        switch (spec.lengthMod[spec.lengthModSize - 1]) {
+            case 'q': case 'j':
+                return kLongLong;
+            case 'z': case 't':
+                return kSize;
+            case 'l':
+                return (spec.lengthModSize >= 2 && spec.lengthMod[spec.lengthModSize - 2] == 'l')
+                            ? kLongLong : kLong;
+            default:
+                return kInt;
+        }
+    }
+
+
+    template <class T>
+    static inline void put(string &out, T value) {
+        out.append((const char*)&value, sizeof(value));
+    }
+
+    static inline void putString(string &out, const char *str, size_t size) {
+        put(out, uint32_t(size));
+        out.append(str, size);
+    }
+
+
+    void LogArgs::capture(const char *format, va_list args, string &out) {
+        Spec spec;
+        for (const char *c = format; nextSpec(c, spec);) {
+            switch (spec.conversion) {
+                case 'c':
+                case 'd':
+                case 'i': {
+                    int64_t param = 0;
+                    switch (argSize(spec)) {
+                        case kInt:      param = va_arg(args, int); break;
+                        case kLong:     param = va_arg(args, long); break;
+                        case kLongLong: param = va_arg(args, long long); break;
+                        case kSize:     param = va_arg(args, ptrdiff_t); break;
+                    }
+                    put(out, param);
+                    break;
+                }
+                case 'u':
+                case 'x': case 'X': {
+                    uint64_t param = 0;
+                    switch (argSize(spec)) {
+                        case kInt:      param = va_arg(args, unsigned int); break;
+                        case kLong:     param = va_arg(args, unsigned long); break;
+                        case kLongLong: param = va_arg(args, unsigned long long); break;
+                        case kSize:     param = va_arg(args, size_t); break;
+                    }
+                    put(out, param);
+                    break;
+                }
+                case 'e': case 'E':
+                case 'f': case 'F':
+                case 'g': case 'G':
+                case 'a': case 'A':
+                    put(out, va_arg(args, double));
+                    break;
+                case 's': {
+                    const char *str;
+                    size_t size;
+                    if (spec.dotStar) {
+                        size = va_arg(args, int);
+                        str = va_arg(args, const char*);
+                    } else {
+                        str = va_arg(args, const char*);
+                        if (!str)
+                            str = "(null)";
+                        size = strlen(str);
+                    }
+                    putString(out, str, size);
+                    break;
+                }
+                case 'p':
+                    put(out, uint64_t(uintptr_t(va_arg(args, void*))));
+                    break;
+#if __APPLE__
+                case '@': {
+                    // "%@" substitutes an Objective-C or CoreFoundation object's description.
+                    CFTypeRef param = va_arg(args, CFTypeRef);
+                    if (param == nullptr) {
+                        putString(out, "(null)", 6);
+                    } else {
+                        CFStringRef description;
+                        if (CFGetTypeID(param) == CFStringGetTypeID())
+                            description = (CFStringRef)param;
+                        else
+                            description = CFCopyDescription(param);
+                        nsstring_slice descSlice(description);
+                        putString(out, (const char*)descSlice.buf, descSlice.size);
+                        if (description != param)
+                            CFRelease(description);
+                    }
+                    break;
+                }
+#endif
+                case '%':
+                    break;
+                default:
+                    return;     // Unknown type; can't tell what the remaining args are
+            }
+        }
+    }
+
+
+    void LogArgs::format(const char *fmt, slice args, string &out) {
+        Reader in(args);
+        Spec spec;
+        const char *c = fmt;
+        while (true) {
+            const char *literal = c;
+            if (!nextSpec(c, spec)) {
+                out.append(literal);
+                return;
+            }
+            out.append(literal, spec.start - literal);
+            // The spec up to its length modifier; the argument is formatted using the length
+            // modifier of the type it was captured as:
+            string prefix(spec.start, spec.lengthMod);
+            switch (spec.conversion) {
+                case 'c':
+                    out += litecore::format((prefix + "c").c_str(), int(in.readSigned()));
+                    break;
+                case 'd':
+                case 'i':
+                    out += litecore::format((prefix + "lld").c_str(), (long long)in.readSigned());
+                    break;
+                case 'u':
+                case 'x': case 'X':
+                    out += litecore::format((prefix + "ll" + spec.conversion).c_str(),
+                                            (unsigned long long)in.readUnsigned());
+                    break;
+                case 'e': case 'E':
+                case 'f': case 'F':
+                case 'g': case 'G':
+                case 'a': case 'A':
+                    out += litecore::format((prefix + spec.conversion).c_str(), in.readDouble());
+                    break;
+                case '@':
+                case 's': {
+                    slice str = in.readString();
+                    if (spec.dotStar)
+                        out += litecore::format((prefix + "s").c_str(), int(str.size), str.buf);
+                    else
+                        out += litecore::format((prefix + "s").c_str(), string(str).c_str());
+                    break;
+                }
+                case 'p':
+                    out += litecore::format((prefix + "p").c_str(),
+                                            (void*)uintptr_t(in.readUnsigned()));
+                    break;
+                case '%':
+                    out += '%';
+                    break;
+                default:
+                    // Unknown type; the rest of the args weren't captured
+                    out.append(spec.start);
+                    return;
+            }
+        }
+    }
+
+
+    slice LogArgs::Reader::readString() {
+        size_t size = min(size_t(read<uint32_t>()), _args.size);
+        slice str(_args.buf, size);
+        _args.moveStart(size);
+        return str;
+    }
+
+}
@@ -0,0 +1,77 @@
+//
+// LogArgs.hh
+//
+// Copyright © 2019 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "fleece/slice.hh"
+#include <cstring>
+#include <stdarg.h>
+#include <string>
+
+namespace litecore {
+
+    /** Captures the arguments of a log message, so that it can be formatted later on another
+        thread, after the values they point to (like strings) may be gone. */
+    class LogArgs {
+    public:
+        /** A parsed printf format specification, like "%-8.*zu". */
+        struct Spec {
+            const char *start;          // The '%'
+            const char *end;            // Just past the conversion character
+            const char *lengthMod;      // The length modifier, like "ll" or "z"
+            size_t lengthModSize;
+            char conversion;            // 'd', 's', etc.; or 0 if the format ends early
+            bool minus, dotStar;
+        };
+
+        /** Finds the next format spec at or after `format`, and advances `format` past it.
+            Returns false if there are no more. */
+        static bool nextSpec(const char* &format, Spec&);
+
+        /** Appends the captured form of the arguments to `out`. Each integer, double and pointer
+            is stored in 8 bytes, and each string as a 4-byte length followed by its bytes. */
+        static void capture(const char *format, va_list args, std::string &out);
+
+        /** Appends the message formatted from captured arguments to `out`. The result is the
+            same as vsnprintf would have produced from the original arguments. */
+        static void format(const char *format, fleece::slice args, std::string &out);
+
+        /** Reads the captured arguments in order. */
+        class Reader {
+        public:
+            explicit Reader(fleece::slice args)     :_args(args) { }
+
+            int64_t readSigned()                    {return read<int64_t>();}
+            uint64_t readUnsigned()                 {return read<uint64_t>();}
+            double readDouble()                     {return read<double>();}
+            fleece::slice readString();
+
+        private:
+            template <class T> T read() {
+                T value {};
+                if (_args.size >= sizeof(T)) {
+                    memcpy(&value, _args.buf, sizeof(T));
+                    _args.moveStart(sizeof(T));
+                }
+                return value;
+            }
+
+            fleece::slice _args;
+        };
+    };
+
+}
@@ -18,6 +18,7 @@
 
 #include "LogEncoder.hh"
 #include "LogDecoder.hh"
+#include "LogArgs.hh"
 #include "Endian.hh"
 #include "StringUtil.hh"
 #include "varint.hh"
@@ -82,17 +83,16 @@ namespace litecore {
         return int64_t(_st.elapsed() * kTicksPerSec);
     }
 
-    void LogEncoder::vlog(const char *domain, const map<unsigned, string> &objectMap,
-                          ObjectRef object, const char *format, va_list args) {
-        lock_guard<mutex> lock(_mutex);
-
+    void LogEncoder::_writeHeader(const char *domain, const map<unsigned, string> &objectMap,
+                                  ObjectRef object)
+    {
         // Write the number of ticks elapsed since the last message:
         auto elapsed = _timeElapsed();
         uint64_t delta = elapsed - _lastElapsed;
         _lastElapsed = elapsed;
         _writeUVarInt(delta);
 
-        // Write level, domain, format string:
+        // Write level, domain:
         _writer.write(&_level, sizeof(_level));
         _writeStringToken(domain ? domain : "");
 
@@ -108,7 +108,20 @@ namespace litecore {
                 _writer.write("\0", 1);
             }
         }
+    }
+
+    void LogEncoder::_endMessage() {
+        if (_writer.length() > kBufferSize)
+            _flush();
+        else
+            _scheduleFlush();
+    }
 
+
+    void LogEncoder::vlog(const char *domain, const map<unsigned, string> &objectMap,
+                          ObjectRef object, const char *format, va_list args) {
+        lock_guard<mutex> lock(_mutex);
+        _writeHeader(domain, objectMap, object);
         _writeStringToken(format);
 
         // Parse the format string looking for substitutions:
@@ -238,10 +251,71 @@ namespace litecore {
             }
         }
 
-        if (_writer.length() > kBufferSize)
-            _flush();
-        else
-            _scheduleFlush();
+        _endMessage();
+    }
+
+
+    void LogEncoder::logCaptured(const char *domain, const map<unsigned, string> &objectMap,
+                                 ObjectRef object, const char *format, slice args) {
+        lock_guard<mutex> lock(_mutex);
+        _writeHeader(domain, objectMap, object);
+        _writeStringToken(format);
+
+        LogArgs::Reader in(args);
+        LogArgs::Spec spec;
+        for (const char *c = format; LogArgs::nextSpec(c, spec);) {
+            switch (spec.conversion) {
+                case 'c':
+                case 'd':
+                case 'i': {
+                    int64_t param = in.readSigned();
+                    uint8_t sign = (param < 0) ? 1 : 0;
+                    _writer.write(&sign, 1);
+                    _writeUVarInt(sign ? -param : param);
+                    break;
+                }
+                case 'u':
+                case 'x': case 'X':
+                    _writeUVarInt(in.readUnsigned());
+                    break;
+                case 'e': case 'E':
+                case 'f': case 'F':
+                case 'g': case 'G':
+                case 'a': case 'A': {
+                    fleece::endian::littleEndianDouble param = in.readDouble();
+                    _writer.write(&param, sizeof(param));
+                    break;
+                }
+                case '@':
+                case 's': {
+                    slice str = in.readString();
+                    if (spec.conversion == 's' && spec.minus && !spec.dotStar) {
+                        // Tokens are identified by address, so intern the captured string:
+                        _writeStringToken(_capturedTokens.emplace(str).first->c_str());
+                    } else {
+                        _writeUVarInt(str.size);
+                        if (str.size > 0)
+                            _writer.write(str);
+                    }
+                    break;
+                }
+                case 'p': {
+                    size_t param = (size_t)in.readUnsigned();
+                    if (sizeof(param) == 8)
+                        param = fleece::endian::encLittle64(param);
+                    else
+                        param = fleece::endian::encLittle32(param);
+                    _writer.write(&param, sizeof(param));
+                    break;
+                }
+                case '%':
+                    break;
+                default:
+                    throw invalid_argument("Unknown type in LogEncoder format string");
+            }
+        }
+
+        _endMessage();
     }
 
     void LogEncoder::_writeUVarInt(uint64_t n) {
@@ -47,6 +47,10 @@ namespace litecore {
 
         void log(const char *domain, const std::map<unsigned, std::string>&, ObjectRef, const char *format, ...) __printflike(5, 6);
 
+        /** Logs a message whose arguments were captured by LogArgs::capture. */
+        void logCaptured(const char *domain, const std::map<unsigned, std::string>&, ObjectRef,
+                         const char *format, fleece::slice args);
+
         void flush();
 
         /** A timestamp, given as a standard time_t (seconds since 1/1/1970) plus microseconds. */
@@ -65,6 +69,8 @@ namespace litecore {
 
     private:
         int64_t _timeElapsed() const;
+        void _writeHeader(const char *domain, const std::map<unsigned, std::string>&, ObjectRef);
+        void _endMessage();
         void _writeUVarInt(uint64_t);
         void _writeStringToken(const char *token);
         void _flush();
@@ -81,6 +87,7 @@ namespace litecore {
         LogLevel _level;
         std::unordered_map<size_t, unsigned> _formats;
         std::unordered_set<unsigned> _seenObjects;
+        std::unordered_set<std::string> _capturedTokens;    // Tokens ("%-s") from logCaptured
     };
 
 }
@@ -0,0 +1,264 @@
+//
+// LogQueue.cc
+//
+// Copyright © 2019 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "LogQueue.hh"
+#include <algorithm>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace litecore {
+    using namespace std;
+    using namespace fleece;
+
+
+#pragma mark - RING BUFFER:
+
+
+    // A single-producer, single-consumer ring buffer of captured log messages. Each thread that
+    // logs has its own, so logging threads never contend with each other; the consumer is
+    // whichever thread is draining the queue, which holds sDrainMutex.
+    class LogRing {
+    public:
+        static constexpr size_t kCapacity = 1024;       // Must be a power of 2
+
+        /** Called on the owning thread: returns an empty record to fill in, or nullptr if
+            the buffer is full. Call `push` when done. */
+        LogRecord* nextRecord() {
+            size_t head = _head.load(memory_order_relaxed);
+            if (head - _tail.load(memory_order_acquire) >= kCapacity)
+                return nullptr;
+            return &_records[head & (kCapacity - 1)];
+        }
+
+        void push() {
+            _head.store(_head.load(memory_order_relaxed) + 1, memory_order_release);
+        }
+
+        size_t size() const {
+            return _head.load(memory_order_relaxed) - _tail.load(memory_order_relaxed);
+        }
+
+        /** Called by the consumer: appends all the records to `out`. (The records are copied,
+            so their `args` strings keep their capacity and the producer rarely allocates.) */
+        void popAll(vector<LogRecord> &out) {
+            size_t tail = _tail.load(memory_order_relaxed);
+            size_t head = _head.load(memory_order_acquire);
+            for (; tail != head; ++tail)
+                out.push_back(_records[tail & (kCapacity - 1)]);
+            _tail.store(tail, memory_order_release);
+        }
+
+        atomic<bool> orphaned {false};          // Set when the owning thread exits
+
+    private:
+        LogRecord _records[kCapacity];
+        alignas(64) atomic<size_t> _head {0};   // Next record to push (owning thread)
+        alignas(64) atomic<size_t> _tail {0};   // Next record to pop (consumer)
+    };
+
+
+    // Gives the ring back to the queue when its thread exits.
+    struct LogRingOwner {
+        shared_ptr<LogRing> ring;
+        ~LogRingOwner()                         {if (ring) ring->orphaned = true;}
+    };
+
+
+    // These are allocated on the heap and never freed, since threads may still be logging while
+    // static destructors run at exit.
+    static mutex &sRingsMutex = *new mutex;
+    static vector<shared_ptr<LogRing>> &sRings = *new vector<shared_ptr<LogRing>>;
+    static mutex &sDrainMutex = *new mutex;             // Held while draining the rings
+    static vector<LogRecord> &sBatch = *new vector<LogRecord>;  // Guarded by sDrainMutex
+
+    static mutex &sControlMutex = *new mutex;           // Held while starting/stopping
+    static mutex &sWakeMutex = *new mutex;
+    static condition_variable &sWakeCond = *new condition_variable;
+    static thread* sThread;
+    static bool sStopping;
+    static atomic<bool> sWake;
+
+    static atomic<uint64_t> sDropped;
+    static uint64_t sDroppedReported;                   // Guarded by sDrainMutex
+
+    static thread_local LogRingOwner tRing;
+
+    atomic<bool> LogQueue::sEnabled;
+
+    // The longest a queued message waits to be delivered, unless the queue is woken sooner.
+    static constexpr auto kMaxLatency = chrono::milliseconds(50);
+
+
+    static LogRing* myRing() {
+        if (!tRing.ring) {
+            tRing.ring = make_shared<LogRing>();
+            lock_guard<mutex> lock(sRingsMutex);
+            sRings.push_back(tRing.ring);
+        }
+        return tRing.ring.get();
+    }
+
+
+#pragma mark - LOGQUEUE:
+
+
+    bool LogQueue::enqueue(LogDomain &domain, LogLevel level, unsigned objRef, bool callback,
+                           const char *format, va_list args)
+    {
+        if (level >= LogLevel::Warning) {
+            // Warnings and errors are logged synchronously, in case the process is about to
+            // crash or abort; deliver what's queued first, to keep the messages in order:
+            flush();
+            return false;
+        }
+        LogRing *ring = myRing();
+        LogRecord *record = ring->nextRecord();
+        if (!record) {
+            ++sDropped;
+            wake();
+            return true;
+        }
+        record->time = chrono::steady_clock::now();
+        record->domain = &domain;
+        record->format = format;
+        record->objRef = objRef;
+        record->level = level;
+        record->callback = callback;
+        record->args.clear();
+        LogArgs::capture(format, args, record->args);
+        ring->push();
+
+        if (ring->size() >= LogRing::kCapacity / 2)
+            wake();
+        return true;
+    }
+
+
+    bool LogQueue::enqueueUnregister(unsigned objRef) {
+        LogRing *ring = myRing();
+        LogRecord *record = ring->nextRecord();
+        if (!record)
+            return false;
+        record->time = chrono::steady_clock::now();
+        record->domain = nullptr;
+        record->format = nullptr;
+        record->objRef = objRef;
+        record->args.clear();
+        ring->push();
+        return true;
+    }
+
+
+    static void captureArgs(string &out, const char *format, ...) {
+        va_list args;
+        va_start(args, format);
+        LogArgs::capture(format, args, out);
+        va_end(args);
+    }
+
+
+    void LogQueue::flush() {
+        lock_guard<mutex> lock(sDrainMutex);
+        sBatch.clear();
+        {
+            lock_guard<mutex> ringsLock(sRingsMutex);
+            for (auto i = sRings.begin(); i != sRings.end(); ) {
+                bool orphaned = (*i)->orphaned;     // (check this before draining the ring)
+                (*i)->popAll(sBatch);
+                if (orphaned)
+                    i = sRings.erase(i);
+                else
+                    ++i;
+            }
+        }
+
+        uint64_t dropped = sDropped;
+        if (dropped > sDroppedReported) {
+            LogRecord record {chrono::steady_clock::now(), &kC4Cpp_DefaultLog,
+                              "Logging fell behind; dropped %llu messages", {},
+                              0, LogLevel::Warning, true};
+            captureArgs(record.args, record.format,
+                        (unsigned long long)(dropped - sDroppedReported));
+            sBatch.push_back(move(record));
+            sDroppedReported = dropped;
+        }
+
+        if (sBatch.empty())
+            return;
+        // Merge the threads' messages back into chronological order:
+        stable_sort(sBatch.begin(), sBatch.end(), [](const LogRecord &a, const LogRecord &b) {
+            return a.time < b.time;
+        });
+        LogDomain::deliverQueued(sBatch);
+    }
+
+
+    void LogQueue::wake() {
+        if (!sWake.exchange(true))
+            sWakeCond.notify_one();
+    }
+
+
+    // Body of the background thread.
+    void LogQueue::run() {
+        unique_lock<mutex> lock(sWakeMutex);
+        while (!sStopping) {
+            sWakeCond.wait_for(lock, kMaxLatency, []{return sWake || sStopping;});
+            sWake = false;
+            lock.unlock();
+            flush();
+            lock.lock();
+        }
+    }
+
+
+    void LogQueue::setEnabled(bool enabled) {
+        lock_guard<mutex> lock(sControlMutex);
+        if (enabled == sEnabled)
+            return;
+        if (enabled) {
+            sEnabled = true;
+            sThread = new thread(&LogQueue::run);
+            // Make sure to stop the thread and deliver the queue when the process exits:
+            static once_flag once;
+            call_once(once, []{
+                atexit([]{ setEnabled(false); });
+            });
+        } else {
+            sEnabled = false;       // From now on, messages are logged synchronously
+            {
+                lock_guard<mutex> wakeLock(sWakeMutex);
+                sStopping = true;
+            }
+            sWakeCond.notify_one();
+            sThread->join();
+            delete sThread;
+            sThread = nullptr;
+            sStopping = false;
+            flush();
+        }
+    }
+
+
+    uint64_t LogQueue::droppedCount() {
+        return sDropped;
+    }
+
+}
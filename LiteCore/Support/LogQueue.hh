@@ -0,0 +1,76 @@
+//
+// LogQueue.hh
+//
+// Copyright © 2019 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "Logging.hh"
+#include "LogArgs.hh"
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace litecore {
+
+    /** A log message waiting to be delivered by the LogQueue. */
+    struct LogRecord {
+        std::chrono::steady_clock::time_point time;
+        LogDomain* domain;
+        const char* format;             // nullptr if this unregisters an object
+        std::string args;               // Captured by LogArgs
+        unsigned objRef;
+        LogLevel level;
+        bool callback;
+    };
+
+
+    /** Asynchronous delivery of log messages. While enabled, LogDomain::vlog just captures the
+        message into a lock-free ring buffer belonging to the calling thread; a background thread
+        drains the buffers, then formats, encodes and writes the messages and invokes the callback.
+        If a thread logs faster than that, its buffer fills up and further messages are dropped.
+        Warnings and errors are always logged synchronously, after delivering the queue.
+        Only the arguments are copied, so the format string must be a literal (or otherwise
+        outlive the process); messages whose format comes from a client aren't queued. */
+    class LogQueue {
+    public:
+        /** Starts or stops asynchronous logging. Stopping it delivers any queued messages. */
+        static void setEnabled(bool);
+
+        static bool enabled()                       {return sEnabled.load(std::memory_order_relaxed);}
+
+        /** Queues a message; `format` must stay valid indefinitely.
+            Returns false if it should be logged synchronously instead. */
+        static bool enqueue(LogDomain&, LogLevel, unsigned objRef, bool callback,
+                            const char *format, va_list args);
+
+        /** Queues the unregistration of an object, so that messages it logged earlier still get
+            its name. Returns false if it should be done synchronously instead. */
+        static bool enqueueUnregister(unsigned objRef);
+
+        /** Delivers all queued messages, on the calling thread. */
+        static void flush();
+
+        /** The number of messages dropped so far because a thread's buffer was full. */
+        static uint64_t droppedCount();
+
+    private:
+        static void wake();
+        static void run();
+
+        static std::atomic<bool> sEnabled;
+    };
+
+}
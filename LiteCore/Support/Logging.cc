@@ -20,6 +20,7 @@
 #include "StringUtil.hh"
 #include "LogEncoder.hh"
 #include "LogDecoder.hh"
+#include "LogQueue.hh"
 #include "PlatformIO.hh"
 #include "FilePath.hh"
 #include <string>
@@ -191,6 +192,7 @@ namespace litecore {
 
 
     void LogDomain::setCallback(Callback_t callback, bool preformatted) {
+        LogQueue::flush();      // deliver queued messages to the old callback
         unique_lock<mutex> lock(sLogMutex);
         if (!callback)
             sCallbackMinLevel = LogLevel::None;
@@ -203,6 +205,7 @@ namespace litecore {
     void LogDomain::writeEncodedLogsTo(const LogFileOptions& options,
                                        const string &initialMessage)
     {
+        LogQueue::flush();      // write queued messages to the old files
         unique_lock<mutex> lock(sLogMutex);
         sMaxSize = max((int64_t)1024, options.maxSize);
         sMaxCount = max(0, options.maxCount);
@@ -245,6 +248,7 @@ namespace litecore {
             static once_flag f;
             call_once(f, []{
                 atexit([]{
+                    LogQueue::setEnabled(false);
                     if (sLogMutex.try_lock()) {     // avoid deadlock on crash inside logging code
                         if (sLogEncoder[0]) {
                             for(auto& encoder : sLogEncoder) {
@@ -377,12 +381,19 @@ namespace litecore {
 
     static char sFormatBuffer[2048];
 
-    void LogDomain::vlog(LogLevel level, unsigned objRef, bool doCallback, const char *fmt, va_list args) {
+    void LogDomain::vlog(LogLevel level, unsigned objRef, bool doCallback, const char *fmt, va_list args,
+                         bool queueable)
+    {
         if (_effectiveLevel == LogLevel::Uninitialized)
             computeLevel();
         if (!willLog(level))
             return;
 
+        // In async mode the message is just queued, and delivered by LogQueue's thread:
+        if (queueable && LogQueue::enabled()
+                && LogQueue::enqueue(*this, level, objRef, doCallback, fmt, args))
+            return;
+
         unique_lock<mutex> lock(sLogMutex);
 
         // Invoke the client callback:
@@ -436,6 +447,11 @@ namespace litecore {
     }
 
 
+    void LogDomain::vlogUnqueued(LogLevel level, const char *fmt, va_list args) {
+        vlog(level, LogEncoder::None, true, fmt, args, false);
+    }
+
+
     void LogDomain::logNoCallback(LogLevel level, const char *fmt, ...) {
         va_list args;
         va_start(args, fmt);
@@ -482,6 +498,66 @@ namespace litecore {
         va_end(args);
     }
 
+    // Delivers messages queued by LogQueue, which calls this on its background thread.
+    void LogDomain::deliverQueued(vector<LogRecord> &records) {
+        unique_lock<mutex> lock(sLogMutex);
+        string message;
+        for (auto &record : records) {
+            if (!record.format) {
+                sObjNames.erase(record.objRef);     // A queued unregisterObject()
+                continue;
+            }
+            auto level = record.level;
+            bool toCallback = record.callback && sCallback && level >= _callbackLogLevel();
+            bool toFile = level >= sFileMinLevel;
+            if (!toCallback && !toFile)
+                continue;
+
+            // The encoder takes the captured args; the callback and plaintext file need text:
+            if (toCallback || !sLogEncoder[(int)level]) {
+                message.clear();
+                if (record.objRef)
+                    message = format("{%s#%u} ", getObject(record.objRef).c_str(), record.objRef);
+                LogArgs::format(record.format, fleece::slice(record.args), message);
+            }
+            try {
+                if (toCallback)
+                    invokeCallback(*record.domain, level, "%s", message.c_str());
+                if (toFile)
+                    record.domain->dylogQueued(record, message);
+            } catch (...) {
+                // This is on the LogQueue's thread, so there's nobody to throw to
+            }
+        }
+
+        // Plaintext files are flushed once per batch, instead of after every line:
+        for (int i = 0; i < 5; i++) {
+            if (sFileOut[i] && !sLogEncoder[i])
+                sFileOut[i]->flush();
+        }
+    }
+
+    // Must be called from a method holding sLogMutex
+    void LogDomain::dylogQueued(const LogRecord &record, const string &message) {
+        auto level = record.level;
+        if (sLogEncoder[(int)level]) {
+            sLogEncoder[(int)level]->logCaptured(_name, sObjNames,
+                                                 (LogEncoder::ObjectRef)record.objRef,
+                                                 record.format, fleece::slice(record.args));
+        } else if (sFileOut[(int)level]) {
+            LogDecoder::writeTimestamp(LogDecoder::now(), *sFileOut[(int)level]);
+            LogDecoder::writeHeader(kLevels[(int)level], _name, *sFileOut[(int)level]);
+            *sFileOut[(int)level] << message << '\n';
+        } else {
+            return;
+        }
+
+        const auto pos = sFileOut[(int)level]->tellp();
+        if(pos >= sMaxSize) {
+            Logging::rotateLog(level);
+        }
+    }
+
     // The default logging callback writes to stderr, or on Android to __android_log_write.
     void LogDomain::defaultCallback(const LogDomain &domain, LogLevel level,
                                     const char *fmt, va_list args){
@@ -531,6 +607,9 @@ namespace litecore {
     }
 
     void LogDomain::unregisterObject(unsigned objectRef) {
+        // In async mode, messages from the object may still be queued; so queue this too:
+        if (LogQueue::enabled() && LogQueue::enqueueUnregister(objectRef))
+            return;
         unique_lock<mutex> lock(sLogMutex);
         sObjNames.erase(objectRef);
     }
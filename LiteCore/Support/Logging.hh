@@ -22,6 +22,7 @@
 #include <atomic>
 #include <map>
 #include <string>
+#include <vector>
 #include <stdarg.h>
 #include <stdint.h>
 #include <inttypes.h> //for stdint.h fmt specifiers
@@ -53,6 +54,8 @@
 
 namespace litecore {
 
+struct LogRecord;
+
 enum class LogLevel : int8_t {
     Uninitialized = -1,
     Debug,
@@ -101,6 +104,10 @@ public:
     void vlog(LogLevel level, const char *fmt, va_list);
     void vlogNoCallback(LogLevel level, const char* fmt, va_list);
 
+    /** Like vlog, but never queued by the LogQueue, so `fmt` needn't outlive the call.
+        Use this for formats that aren't string literals, such as ones passed in by clients. */
+    void vlogUnqueued(LogLevel level, const char *fmt, va_list);
+
     using Callback_t = void(*)(const LogDomain&, LogLevel, const char *format, va_list);
 
     static void defaultCallback(const LogDomain&, LogLevel, const char *format, va_list);
@@ -124,11 +131,13 @@ public:
 
 private:
     friend class Logging;
+    friend class LogQueue;
     static std::string getObject(unsigned);
     unsigned registerObject(const void *object, const std::string &description,
                             const std::string &nickname, LogLevel level);
     void unregisterObject(unsigned obj);
-    void vlog(LogLevel level, unsigned obj, bool callback, const char *fmt, va_list);
+    void vlog(LogLevel level, unsigned obj, bool callback, const char *fmt, va_list,
+              bool queueable =true);
 
 private:
     static LogLevel _callbackLogLevel() noexcept;
@@ -137,6 +146,8 @@ private:
     static void _invalidateEffectiveLevels() noexcept;
 
     void dylog(LogLevel level, const char* domain, unsigned objRef, const char *fmt, va_list);
+    void dylogQueued(const LogRecord&, const std::string &message);
+    static void deliverQueued(std::vector<LogRecord>&);
 
     std::atomic<LogLevel> _effectiveLevel {LogLevel::Uninitialized};
     std::atomic<LogLevel> _level;
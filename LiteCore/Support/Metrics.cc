@@ -0,0 +1,223 @@
+//
+// Metrics.cc
+//
+// Copyright © 2019 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "Metrics.hh"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace litecore { namespace metrics {
+    using namespace std;
+
+
+    Metric* Metric::sFirst = nullptr;
+
+
+    unsigned Metric::shardIndex() {
+        static atomic<unsigned> sNextShard {0};
+        static thread_local unsigned tShard = sNextShard++ % kNumShards;
+        return tShard;
+    }
+
+
+    Metric* Metric::named(const char *name) {
+        for (auto m = sFirst; m; m = m->_next)
+            if (strcmp(m->_name, name) == 0)
+                return m;
+        return nullptr;
+    }
+
+
+    string Metric::toJSON() {
+        vector<Metric*> all;
+        for (auto m = sFirst; m; m = m->_next)
+            all.push_back(m);
+        sort(all.begin(), all.end(), [](Metric *a, Metric *b) {
+            return strcmp(a->_name, b->_name) < 0;
+        });
+
+        stringstream out;
+        out << '{';
+        for (auto m : all) {
+            if (m != all.front())
+                out << ',';
+            out << '"' << m->_name << "\":";
+            m->writeJSON(out);
+        }
+        out << '}';
+        return out.str();
+    }
+
+
+#pragma mark - COUNTER:
+
+
+    int64_t Counter::value() const {
+        int64_t total = 0;
+        for (auto &shard : _shards)
+            total += shard.value.load(memory_order_relaxed);
+        return total;
+    }
+
+    void Counter::writeJSON(ostream &out) const {
+        out << value();
+    }
+
+    void Counter::reset() {
+        for (auto &shard : _shards)
+            shard.value = 0;
+    }
+
+
+#pragma mark - GAUGE:
+
+
+    void Gauge::updateMax(int64_t value) {
+        int64_t max = _max.load(memory_order_relaxed);
+        while (value > max && !_max.compare_exchange_weak(max, value, memory_order_relaxed))
+            ;
+    }
+
+    void Gauge::writeJSON(ostream &out) const {
+        out << "{\"value\":" << value() << ",\"max\":" << max() << '}';
+    }
+
+    void Gauge::reset() {
+        _value = 0;
+        _max = 0;
+    }
+
+
+#pragma mark - HISTOGRAM:
+
+
+    static unsigned highBit(uint64_t n) {    // Index of the highest 1 bit; n must be nonzero
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanReverse64(&index, n);
+        return index;
+#else
+        return 63 - __builtin_clzll(n);
+#endif
+    }
+
+
+    unsigned Histogram::bucketIndex(uint64_t value) {
+        if (value < kLinearRange)
+            return unsigned(value);
+        unsigned shift = highBit(value) - kSubBucketBits;
+        return kLinearRange + (shift - 1) * kSubBuckets
+                            + unsigned((value >> shift) & (kSubBuckets - 1));
+    }
+
+
+    uint64_t Histogram::bucketMaxValue(unsigned bucket) {
+        if (bucket < kLinearRange)
+            return bucket;
+        unsigned shift = (bucket - kLinearRange) / kSubBuckets + 1;
+        uint64_t sub = (bucket - kLinearRange) % kSubBuckets;
+        return ((kSubBuckets + sub) << shift) + ((uint64_t(1) << shift) - 1);
+    }
+
+
+    void Histogram::record(uint64_t value) {
+        Shard &shard = _shards[shardIndex()];
+        shard.buckets[bucketIndex(value)].fetch_add(1, memory_order_relaxed);
+        shard.sum.fetch_add(value, memory_order_relaxed);
+        uint64_t max = shard.max.load(memory_order_relaxed);
+        while (value > max && !shard.max.compare_exchange_weak(max, value, memory_order_relaxed))
+            ;
+    }
+
+
+    uint64_t Histogram::count() const {
+        uint64_t total = 0;
+        for (auto &shard : _shards)
+            for (auto &bucket : shard.buckets)
+                total += bucket.load(memory_order_relaxed);
+        return total;
+    }
+
+
+    uint64_t Histogram::max() const {
+        uint64_t result = 0;
+        for (auto &shard : _shards)
+            result = std::max(result, shard.max.load(memory_order_relaxed));
+        return result;
+    }
+
+
+    double Histogram::mean() const {
+        uint64_t n = count(), sum = 0;
+        if (n == 0)
+            return 0.0;
+        for (auto &shard : _shards)
+            sum += shard.sum.load(memory_order_relaxed);
+        return sum / double(n);
+    }
+
+
+    uint64_t Histogram::percentile(double fraction) const {
+        vector<uint64_t> counts(kNumBuckets);
+        uint64_t total = 0;
+        for (auto &shard : _shards) {
+            for (unsigned i = 0; i < kNumBuckets; ++i) {
+                auto n = shard.buckets[i].load(memory_order_relaxed);
+                counts[i] += n;
+                total += n;
+            }
+        }
+        if (total == 0)
+            return 0;
+        auto target = uint64_t(ceil(fraction * total));
+        uint64_t seen = 0;
+        for (unsigned i = 0; i < kNumBuckets; ++i) {
+            seen += counts[i];
+            if (seen >= std::max(target, uint64_t(1)))
+                return min(bucketMaxValue(i), max());
+        }
+        return max();
+    }
+
+
+    void Histogram::writeJSON(ostream &out) const {
+        char mean[32];
+        snprintf(mean, sizeof(mean), "%.1f", this->mean());
+        out << "{\"count\":" << count() << ",\"mean\":" << mean << ",\"max\":" << max()
+            << ",\"p50\":" << percentile(0.50) << ",\"p90\":" << percentile(0.90)
+            << ",\"p99\":" << percentile(0.99) << ",\"p999\":" << percentile(0.999) << '}';
+    }
+
+
+    void Histogram::reset() {
+        for (auto &shard : _shards) {
+            shard.sum = 0;
+            shard.max = 0;
+            for (auto &bucket : shard.buckets)
+                bucket = 0;
+        }
+    }
+
+} }
@@ -0,0 +1,170 @@
+//
+// Metrics.hh
+//
+// Copyright © 2019 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <iosfwd>
+#include <stdint.h>
+#include <string>
+
+namespace litecore { namespace metrics {
+
+    /** Abstract base class of runtime metrics. Metrics are meant to be declared as static
+        objects in the source file that updates them; each one adds itself to a global list at
+        construction, from which `toJSON` reports them all.
+        Metric names are dotted paths like "db.commits", grouped by subsystem. */
+    class Metric {
+    public:
+        const char* name() const                    {return _name;}
+
+        /** Writes the metric's current value as JSON. */
+        virtual void writeJSON(std::ostream&) const =0;
+
+        /** Resets the metric to its initial state. */
+        virtual void reset() =0;
+
+        /** Returns the metric with the given name, or nullptr. */
+        static Metric* named(const char *name);
+
+        /** Returns all metrics as a JSON object mapping names to values, sorted by name. */
+        static std::string toJSON();
+
+    protected:
+        explicit Metric(const char *name)
+        :_name(name)
+        ,_next(sFirst)
+        {
+            sFirst = this;
+        }
+
+        virtual ~Metric() =default;
+
+        // Updates from different threads go to different shards, so they don't contend for
+        // the same cache line; readers add up the shards.
+        static constexpr unsigned kNumShards = 8;
+        static unsigned shardIndex();
+
+    private:
+        const char* const _name;
+        Metric* const _next;
+        static Metric* sFirst;
+    };
+
+
+    /** A monotonically increasing count, such as the number of bytes written. */
+    class Counter : public Metric {
+    public:
+        explicit Counter(const char *name)          :Metric(name) { }
+
+        void add(int64_t n)                         {_shards[shardIndex()].value.fetch_add(
+                                                                    n, std::memory_order_relaxed);}
+        Counter& operator++ ()                      {add(1); return *this;}
+        Counter& operator+= (int64_t n)             {add(n); return *this;}
+
+        int64_t value() const;
+
+        virtual void writeJSON(std::ostream&) const override;
+        virtual void reset() override;
+
+    private:
+        struct alignas(64) Shard {
+            std::atomic<int64_t> value {0};
+        };
+        Shard _shards[kNumShards];
+    };
+
+
+    /** A value that goes up and down, such as a queue depth. Also tracks the maximum value. */
+    class Gauge : public Metric {
+    public:
+        explicit Gauge(const char *name)            :Metric(name) { }
+
+        void set(int64_t value)                     {_value.store(value, std::memory_order_relaxed);
+                                                     updateMax(value);}
+        void add(int64_t delta)                     {updateMax(_value.fetch_add(
+                                                        delta, std::memory_order_relaxed) + delta);}
+
+        int64_t value() const                       {return _value.load(std::memory_order_relaxed);}
+        int64_t max() const                         {return _max.load(std::memory_order_relaxed);}
+
+        virtual void writeJSON(std::ostream&) const override;
+        virtual void reset() override;
+
+    private:
+        void updateMax(int64_t value);
+
+        std::atomic<int64_t> _value {0}, _max {0};
+    };
+
+
+    /** A distribution of values, usually latencies in microseconds. Like an HDR histogram,
+        values are counted in buckets of logarithmically increasing width, so percentiles are
+        accurate to within 1/8 of the value across the whole range, at a fixed cost in memory
+        and time. */
+    class Histogram : public Metric {
+    public:
+        explicit Histogram(const char *name)        :Metric(name) { }
+
+        void record(uint64_t value);
+
+        /** Records the duration of its own lifetime, in microseconds. */
+        class Timer {
+        public:
+            explicit Timer(Histogram &h)            :_histogram(h) { }
+            ~Timer()                                {_histogram.record(elapsedUsec());}
+            uint64_t elapsedUsec() const {
+                return std::chrono::duration_cast<std::chrono::microseconds>(
+                                    std::chrono::steady_clock::now() - _start).count();
+            }
+        private:
+            Histogram &_histogram;
+            std::chrono::steady_clock::time_point const _start {std::chrono::steady_clock::now()};
+        };
+
+        uint64_t count() const;
+        uint64_t max() const;
+        double mean() const;
+
+        /** Returns the value below which the given fraction (0.0 ... 1.0) of values fall;
+            this is the upper bound of that value's bucket, but no greater than `max()`. */
+        uint64_t percentile(double fraction) const;
+
+        virtual void writeJSON(std::ostream&) const override;
+        virtual void reset() override;
+
+        // Values below kLinearRange get a bucket each; above that, each power of two is
+        // divided into kSubBuckets buckets.
+        static constexpr unsigned kSubBucketBits = 3;
+        static constexpr unsigned kSubBuckets = 1 << kSubBucketBits;
+        static constexpr unsigned kLinearRange = 2 * kSubBuckets;
+        static constexpr unsigned kNumBuckets = kLinearRange + (64 - kSubBucketBits - 1) * kSubBuckets;
+
+        static unsigned bucketIndex(uint64_t value);
+        static uint64_t bucketMaxValue(unsigned bucket);
+
+    private:
+        struct alignas(64) Shard {
+            std::atomic<uint64_t> sum {0}, max {0};
+            std::atomic<uint64_t> buckets[kNumBuckets] {};
+        };
+        Shard _shards[kNumShards];
+    };
+
+
+} }
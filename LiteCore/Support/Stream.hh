@@ -78,6 +78,21 @@ namespace litecore {
         FILE* _file {nullptr};
     };
 
+    /** Concrete ReadStream that reads data in memory. */
+    class MemoryReadStream : public virtual SeekableReadStream {
+    public:
+        explicit MemoryReadStream(alloc_slice data)     :_data(std::move(data)) { }
+
+        virtual uint64_t getLength() const override     {return _data.size;}
+        virtual void seek(uint64_t pos) override;
+        virtual size_t read(void *dst NONNULL, size_t count) override;
+        virtual void close() override                   {_data = nullslice; _pos = 0;}
+
+    private:
+        alloc_slice _data;
+        size_t _pos {0};
+    };
+
 #ifdef _MSC_VER
 #pragma warning(disable: 4250)
 #endif
@@ -23,6 +23,7 @@
 #include "Error.hh"
 #include "Timer.hh"
 #include "Logging.hh"
+#include "Metrics.hh"
 #include "Channel.cc"       // Brings in the definitions of the template methods
 #include <future>
 #include <random>
@@ -32,6 +33,8 @@ using namespace std;
 
 namespace litecore { namespace actor {
 
+    static metrics::Histogram sEventTime("actor.eventUsec");
+
 #if ACTORS_TRACK_STATS
 #define beginLatency()  fleece::Stopwatch st
 #define endLatency()    _maxLatency = max(_maxLatency, (double)st.elapsed())
@@ -184,6 +187,7 @@ namespace litecore { namespace actor {
 
     void ThreadedMailbox::safelyCall(const std::function<void()>& f) const
     {
+        metrics::Histogram::Timer timer(sEventTime);
         try {
             f();
         } catch(std::exception& x) {
@@ -442,6 +442,40 @@ N_WAY_TEST_CASE_METHOD (DataFileTestFixture, "DataFile Compact", "[DataFile]") {
     CHECK(newSize < oldSize - 100000);
 }
 
+
+N_WAY_TEST_CASE_METHOD (DataFileTestFixture, "DataFile Expire In Batches", "[DataFile]") {
+    createNumberedDocs(store, 100, false);
+    expiration_t now = KeyStore::now();
+    {
+        Transaction t(db);
+        for (int i = 1; i <= 25; i++)
+            store->setExpiration(slice(stringWithFormat("rec-%03d", i)), now - 1000 + i);
+        store->setExpiration("rec-100"_sl, now + 100000);
+        t.commit();
+    }
+
+    vector<string> expired;
+    auto callback = [&](slice docID) {expired.push_back(string(docID));};
+    for (int batch = 0; batch < 3; batch++) {
+        Transaction t(db);
+        CHECK(store->expireRecords(callback, 10) == (batch < 2 ? 10 : 5));
+        t.commit();
+    }
+    {
+        Transaction t(db);
+        CHECK(store->expireRecords(callback, 10) == 0);
+        t.commit();
+    }
+
+    // Records expire earliest first, and each one is reported exactly once:
+    REQUIRE(expired.size() == 25);
+    for (int i = 1; i <= 25; i++)
+        CHECK(expired[i-1] == stringWithFormat("rec-%03d", i));
+    CHECK(!store->get("rec-025"_sl).exists());
+    CHECK(store->get("rec-026"_sl).exists());
+    CHECK(store->nextExpiration() == now + 100000);
+}
+
 TEST_CASE("CanonicalPath") {
 #ifdef _MSC_VER
     const char* startPath = "C:\\folder\\..\\subfolder\\";
@@ -19,11 +19,13 @@
 
 #include "LogEncoder.hh"
 #include "LogDecoder.hh"
+#include "LogQueue.hh"
 #include "LiteCoreTest.hh"
 #include "StringUtil.hh"
 #include <regex>
 #include <sstream>
 #include <fstream>
+#include <iterator>
 
 #define DATESTAMP "\\w+, \\d{2}/\\d{2}/\\d{2}"
 #define TIMESTAMP "\\d{2}:\\d{2}:\\d{2}\\.\\d{6}\\| "
@@ -101,6 +103,80 @@ TEST_CASE("LogEncoder formatting", "[Log]") {
 }
 
 
+static string formatCaptured(const char *format, ...) __printflike(1, 2);
+static string formatCaptured(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    string captured;
+    LogArgs::capture(format, args, captured);
+    va_end(args);
+    string result;
+    LogArgs::format(format, slice(captured), result);
+    return result;
+}
+
+
+TEST_CASE("LogArgs formatting", "[Log]") {
+    size_t size = 0xabcdabcd;
+    ptrdiff_t ptrdiff = -1234567890;
+    string temp = "temporary";
+    slice buf("hello");
+    CHECK(formatCaptured("Unsigned %u, Long %lu, LongLong %llu, Size %zx, Hex %08X, Pointer %p",
+                         1234567890U, 2345678901LU, 123456789123456789LLU, size, 0xbeefu,
+                         (void*)0x7fff5fbc)
+          == format("Unsigned %u, Long %lu, LongLong %llu, Size %zx, Hex %08X, Pointer %p",
+                    1234567890U, 2345678901LU, 123456789123456789LLU, size, 0xbeefu,
+                    (void*)0x7fff5fbc));
+    CHECK(formatCaptured("Int %d, Width %5d|%-5d|, Long %ld, LongLong %lld, Size %zd, Char %c",
+                         -1, 42, 7, -234567890L, 123456789123456789LL, ptrdiff, '@')
+          == format("Int %d, Width %5d|%-5d|, Long %ld, LongLong %lld, Size %zd, Char %c",
+                    -1, 42, 7, -234567890L, 123456789123456789LL, ptrdiff, '@'));
+    CHECK(formatCaptured("String '%s', slice '%.*s', token %-s, %10s|, %.3f %g 100%%",
+                         "C string", SPLAT(buf), temp.c_str(), "right", 3.14159, 1e-9)
+          == format("String '%s', slice '%.*s', token %-s, %10s|, %.3f %g 100%%",
+                    "C string", SPLAT(buf), temp.c_str(), "right", 3.14159, 1e-9));
+}
+
+
+// Logs a message directly, then again from captured args.
+static void logBoth(LogEncoder &logger, const char *format, ...) {
+    map<unsigned, string> dummy;
+    va_list args, args2;
+    va_start(args, format);
+    va_copy(args2, args);
+    logger.vlog(nullptr, dummy, LogEncoder::None, format, args2);
+    va_end(args2);
+    string captured;
+    LogArgs::capture(format, args, captured);
+    va_end(args);
+    logger.logCaptured(nullptr, dummy, LogEncoder::None, format, slice(captured));
+}
+
+
+TEST_CASE("LogEncoder captured args", "[Log]") {
+    // A message logged from captured args must decode the same as one logged directly:
+    stringstream out;
+    {
+        LogEncoder logger(out, LogLevel::Info);
+        slice buf("hello");
+        string token = "TOKEN";
+        logBoth(logger, "Int %d, LongLong %lld, Unsigned %u, Hex %zx, Char %c",
+                -1234567890, 123456789123456789LL, 42u, size_t(0xabcd), '@');
+        logBoth(logger, "String is '%s', slice is '%.*s' (hex %-.*s), token %-s, double %g",
+                "C string", SPLAT(buf), SPLAT(buf), token.c_str(), 3.5);
+    }
+    stringstream in(out.str());
+    LogDecoder decoder(in);
+    vector<string> messages;
+    while (decoder.next())
+        messages.push_back(decoder.readMessage());
+    REQUIRE(messages.size() == 4);
+    CHECK(messages[0] == messages[1]);
+    CHECK(messages[2] == messages[3]);
+    CHECK(messages[2] == "String is 'C string', slice is 'hello' (hex 68656c6c6f), token TOKEN, double 3.5");
+}
+
+
 TEST_CASE("LogEncoder levels/domains", "[Log]") {
     static const vector<string> kLevels = {"***", "", "", "WARNING", "ERROR"};
     stringstream out[4];
@@ -292,3 +368,104 @@ TEST_CASE("Logging plaintext", "[Log]") {
     CHECK(lines[1].find("This will be in plaintext") != string::npos);
 }
 
+
+TEST_CASE("Logging async", "[Log]") {
+    static LogDomain AsyncTestLog("AsyncTest", LogLevel::Verbose);
+    char folderName[64];
+    sprintf(folderName, "Log_Async_%lld/", chrono::milliseconds(time(nullptr)).count());
+    FilePath tmpLogDir = FilePath::tempDirectory()[folderName];
+    tmpLogDir.delRecursive();
+    tmpLogDir.mkdir();
+
+    LogFileOptions fileOptions { tmpLogDir.canonicalPath(), LogLevel::Verbose, 1024 * 1024, 5, true };
+    LogDomain::writeEncodedLogsTo(fileOptions, "Hello");
+    LogQueue::setEnabled(true);
+    uint64_t droppedBefore = LogQueue::droppedCount();
+
+    // Log from several threads at once, few enough messages that none are dropped:
+    static constexpr int kThreads = 4, kMessages = 200;
+    vector<thread> threads;
+    for (int t = 0; t < kThreads; t++) {
+        threads.emplace_back([t] {
+            for (int i = 0; i < kMessages; i++) {
+                string name = format("thread%d", t);      // (goes away before it's written)
+                LogToAt(AsyncTestLog, Verbose, "%s message %d", name.c_str(), i);
+            }
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+    LogQueue::setEnabled(false);        // delivers the queued messages
+    CHECK(LogQueue::droppedCount() == droppedBefore);
+
+    vector<string> verboseFiles;
+    tmpLogDir.forEachFile([&verboseFiles](const FilePath f) {
+        if(f.path().find("verbose") != string::npos)
+            verboseFiles.push_back(f.path());
+    });
+    REQUIRE(verboseFiles.size() == 1);
+    ifstream fin(verboseFiles[0]);
+    string line;
+    int next[kThreads] = {};
+    while (getline(fin, line)) {
+        auto pos = line.find("[AsyncTest]: thread");
+        if (pos == string::npos)
+            continue;
+        int t, i;
+        REQUIRE(sscanf(line.c_str() + pos, "[AsyncTest]: thread%d message %d", &t, &i) == 2);
+        REQUIRE(t >= 0);
+        REQUIRE(t < kThreads);
+        CHECK(i == next[t]++);              // each thread's messages arrive in order
+    }
+    for (int t = 0; t < kThreads; t++)
+        CHECK(next[t] == kMessages);
+}
+
+
+static void logUnqueued(LogDomain &domain, LogLevel level, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    domain.vlogUnqueued(level, format, args);
+    va_end(args);
+}
+
+static string readLogFile(const FilePath &dir, const char *level) {
+    string contents;
+    dir.forEachFile([&](const FilePath f) {
+        if (f.path().find(level) != string::npos) {
+            ifstream fin(f.path());
+            contents.assign(istreambuf_iterator<char>(fin), istreambuf_iterator<char>());
+        }
+    });
+    return contents;
+}
+
+
+TEST_CASE("Logging async synchronous messages", "[Log]") {
+    static LogDomain AsyncSyncTestLog("AsyncSyncTest", LogLevel::Info);
+    char folderName[64];
+    sprintf(folderName, "Log_AsyncSync_%lld/", chrono::milliseconds(time(nullptr)).count());
+    FilePath tmpLogDir = FilePath::tempDirectory()[folderName];
+    tmpLogDir.delRecursive();
+    tmpLogDir.mkdir();
+
+    LogFileOptions fileOptions { tmpLogDir.canonicalPath(), LogLevel::Info, 1024 * 1024, 5, true };
+    LogDomain::writeEncodedLogsTo(fileOptions, "Hello");
+    LogQueue::setEnabled(true);
+
+    // A warning is written before logging returns, after the messages queued before it:
+    LogToAt(AsyncSyncTestLog, Info, "queued before the warning");
+    LogToAt(AsyncSyncTestLog, Warning, "the warning");
+    CHECK(readLogFile(tmpLogDir, "info").find("queued before the warning") != string::npos);
+    CHECK(readLogFile(tmpLogDir, "warning").find("the warning") != string::npos);
+
+    // A format string that doesn't outlive the call isn't queued:
+    {
+        string format = "client message %d";
+        logUnqueued(AsyncSyncTestLog, LogLevel::Info, format.c_str(), 17);
+        format.assign(format.size(), 'x');
+    }
+    CHECK(readLogFile(tmpLogDir, "info").find("client message 17") != string::npos);
+
+    LogQueue::setEnabled(false);
+}
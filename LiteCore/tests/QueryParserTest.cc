@@ -334,6 +334,45 @@ TEST_CASE_METHOD(QueryParserTest, "QueryParser SELECT UNNEST optimized", "[Query
 }
 
 
+TEST_CASE_METHOD(QueryParserTest, "QueryParser SELECT hot properties", "[Query]") {
+    hotTablesExist = true;
+    CHECK(parseWhere("['SELECT', {WHAT: [['.first'], ['._id']],\
+                                 WHERE: ['=', ['.', 'last'], 'Smith']}]")
+          == "SELECT fl_result(IFNULL(hot2.value, fl_value(_doc.body, 'first'))), fl_result(_doc.key) FROM kv_default AS _doc LEFT JOIN \"kv_default:hot:first\" AS hot2 ON hot2.docid = _doc.rowid LEFT JOIN \"kv_default:hot:last\" AS hot1 ON hot1.docid = _doc.rowid WHERE (IFNULL(hot1.value, fl_value(_doc.body, 'last')) = 'Smith') AND (_doc.flags & 1 = 0)");
+    CHECK(parseWhere("['SELECT', {FROM: [{as: 'person'}],\
+                                 WHERE: ['=', ['.person.last'], 'Smith']}]")
+          == "SELECT \"person\".key, \"person\".sequence FROM kv_default AS \"person\" LEFT JOIN \"kv_default:hot:last\" AS hot1 ON hot1.docid = \"person\".rowid WHERE (IFNULL(hot1.value, fl_value(\"person\".body, 'last')) = 'Smith') AND (\"person\".flags & 1 = 0)");
+
+    // A property with a value index is read from the body, so the value index can be used:
+    valueIndexedProperties.insert("last");
+    CHECK(parseWhere("['SELECT', {WHERE: ['=', ['.last'], 'Smith']}]")
+          == "SELECT _doc.key, _doc.sequence FROM kv_default AS _doc WHERE (fl_value(_doc.body, 'last') = 'Smith') AND (_doc.flags & 1 = 0)");
+}
+
+
+TEST_CASE_METHOD(QueryParserTest, "QueryParser SELECT covering index", "[Query]") {
+    auto expressionJSON = [](const char *json) {
+        alloc_slice fleece = fleece::impl::JSONConverter::convertJSON(json5(json));
+        return QueryParser::coveredExpressionJSON(fleece::impl::Value::fromTrustedData(fleece));
+    };
+    coveringIndexList.push_back({"kv_default:covering:names",
+                                 {expressionJSON("['.last']"), expressionJSON("['.first']")}});
+    CHECK(parse("{WHAT: [['.first'], ['._id']],\
+                 WHERE: ['=', ['.', 'last'], 'Smith'],\
+              ORDER_BY: [['.first']]}")
+          == "SELECT fl_result(fl_typed(_doc.c1, _doc.subtypes, 1)), fl_result(_doc.key) FROM \"kv_default:covering:names\" AS _doc WHERE (_doc.c0 = 'Smith') ORDER BY _doc.c1");
+    CHECK(parse("{WHAT: [['.person.first']],\
+                  FROM: [{as: 'person'}],\
+                 WHERE: ['>', ['length()', ['.person.last']], 3]}")
+          == "SELECT fl_result(fl_typed(\"person\".c1, \"person\".subtypes, 1)) FROM \"kv_default:covering:names\" AS \"person\" WHERE (N1QL_length(fl_typed(\"person\".c0, \"person\".subtypes, 0)) > 3)");
+    // Queries that need anything else read the documents as usual:
+    CHECK(parse("{WHAT: [['.middle']], WHERE: ['=', ['.', 'last'], 'Smith']}")
+          == "SELECT fl_result(fl_value(_doc.body, 'middle')) FROM kv_default AS _doc WHERE (fl_value(_doc.body, 'last') = 'Smith') AND (_doc.flags & 1 = 0)");
+    CHECK(parse("{WHAT: [['.first']], WHERE: ['AND', ['=', ['.last'], 'Smith'], ['._deleted']]}")
+          == "SELECT fl_result(fl_value(_doc.body, 'first')) FROM kv_default AS _doc WHERE (fl_value(_doc.body, 'last') = 'Smith' AND (_doc.flags & 1 != 0))");
+}
+
+
 TEST_CASE_METHOD(QueryParserTest, "QueryParser Collate", "[Query][Collation]") {
     CHECK(parseWhere("['AND',['COLLATE',{'UNICODE':true,'CASE':false,'DIAC':false},['=',['.Artist'],['$ARTIST']]],['IS',['.Compilation'],['MISSING']]]")
           == "fl_value(body, 'Artist') COLLATE \"LCUnicode_CD_\" = $_ARTIST AND fl_value(body, 'Compilation') IS NULL");
@@ -19,6 +19,7 @@
 #pragma once
 #include "QueryParser.hh"
 #include "fleece/Fleece.h"
+#include <set>
 #include <string>
 #include "LiteCoreTest.hh"
 
@@ -44,14 +45,31 @@ protected:
     virtual std::string unnestedTableName(const std::string &property) const override {
         return tableName() + ":unnest:" + property;
     }
+    virtual std::string hotPropertyTableName(const std::string &property) const override {
+        return tableName() + ":hot:" + property;
+    }
+    virtual std::vector<CoveringIndex> coveringIndexes() const override {
+        return coveringIndexList;
+    }
+    virtual bool hasValueIndexOn(const std::string &property) const override {
+        return valueIndexedProperties.count(property) > 0;
+    }
     virtual bool tableExists(const string &tableName) const override {
+        if (tableName.find(":hot:") != string::npos)
+            return hotTablesExist;
         return tablesExist;
     }
 #ifdef COUCHBASE_ENTERPRISE
     virtual std::string predictiveTableName(const std::string &property) const override {
         return tableName() + ":predict:" + property;
     }
+    virtual std::string vectorTableName(const std::string &property) const override {
+        return tableName() + ":vector:" + property;
+    }
 #endif
 
     bool tablesExist {false};
+    bool hotTablesExist {false};
+    std::vector<CoveringIndex> coveringIndexList;
+    std::set<std::string> valueIndexedProperties;
 };
@@ -18,8 +18,10 @@
 
 #include "QueryTest.hh"
 #include "SQLiteDataFile.hh"
+#include "VectorDistance.hh"
 #include <time.h>
 #include <float.h>
+#include <random>
 
 using namespace fleece::impl;
 
@@ -146,6 +148,141 @@ TEST_CASE_METHOD(QueryTest, "Partial Index with NOT MISSING", "[Query]") {
 }
 
 
+TEST_CASE_METHOD(QueryTest, "Hot Property Index", "[Query]") {
+    addNumberedDocs(1, 20);
+    {
+        Transaction t(store->dataFile());
+        // A string is materialized, but a boolean isn't and has to be read from the body:
+        writeDoc("rec-str"_sl, DocumentFlags::kNone, t, [](Encoder &enc) {
+            enc.writeKey("num");
+            enc.writeString("twenty");
+        });
+        writeDoc("rec-bool"_sl, DocumentFlags::kNone, t, [](Encoder &enc) {
+            enc.writeKey("num");
+            enc.writeBool(true);
+        });
+        t.commit();
+    }
+
+    auto run = [&](const char *json, bool expectHot) {
+        Retained<Query> query = store->compileQuery(json5(json));
+        string explanation = query->explain();
+        Log("Explanation: %s", explanation.c_str());
+        CHECK((explanation.find(":hot:") != string::npos) == expectHot);
+        vector<string> results;
+        Retained<QueryEnumerator> e(query->createEnumerator());
+        while (e->next())
+            results.push_back(e->columns()[0]->asString().asString() + "="
+                              + e->columns()[1]->toJSONString());
+        return results;
+    };
+    const char *allQuery = "{WHAT: [['._id'], ['.num']], ORDER_BY: [['._id']]}";
+    const char *filterQuery = "{WHAT: [['._id'], ['.num']], WHERE: ['>=', ['.num'], 18],"
+                              " ORDER_BY: [['.num']]}";
+
+    auto all = run(allQuery, false);
+    CHECK(all.size() == 22);
+    auto filtered = run(filterQuery, false);
+    CHECK(filtered == (vector<string>{"rec-018=18", "rec-019=19", "rec-020=20",
+                                      "rec-str=\"twenty\""}));
+
+    CHECK(store->createIndex("num"_sl, json5("[['.num']]"), IndexSpec::kHotProperty));
+    CHECK(!store->createIndex("num"_sl, json5("[['.num']]"), IndexSpec::kHotProperty));
+    CHECK(run(allQuery, true) == all);
+    CHECK(run(filterQuery, true) == filtered);
+
+    // The table is updated when docs change:
+    {
+        Transaction t(store->dataFile());
+        writeDoc("rec-005"_sl, DocumentFlags::kNone, t, [](Encoder &enc) {
+            enc.writeKey("num");
+            enc.writeInt(99);
+        });
+        t.commit();
+    }
+    filtered = {"rec-018=18", "rec-019=19", "rec-020=20", "rec-005=99", "rec-str=\"twenty\""};
+    CHECK(run(filterQuery, true) == filtered);
+
+    // With a value index on the property too, queries use that index instead of the table:
+    CHECK(store->createIndex("numValue"_sl, json5("[['.num']]")));
+    CHECK(run(filterQuery, false) == filtered);
+    store->deleteIndex("numValue"_sl);
+
+    store->deleteIndex("num"_sl);
+    CHECK(run(filterQuery, false) == filtered);
+}
+
+
+TEST_CASE_METHOD(QueryTest, "Covering Index", "[Query]") {
+    addNumberedDocs(1, 20);
+    {
+        Transaction t(store->dataFile());
+        // Values with subtypes have to come back from the index unchanged:
+        writeDoc("rec-bool"_sl, DocumentFlags::kNone, t, [](Encoder &enc) {
+            enc.writeKey("num");
+            enc.writeBool(true);
+            enc.writeKey("type");
+            enc.writeNull();
+        });
+        t.commit();
+    }
+
+    auto run = [&](const char *json, bool expectCovered) {
+        Retained<Query> query = store->compileQuery(json5(json));
+        string explanation = query->explain();
+        Log("Explanation: %s", explanation.c_str());
+        CHECK((explanation.find(":covering:") != string::npos) == expectCovered);
+        vector<string> results;
+        Retained<QueryEnumerator> e(query->createEnumerator());
+        while (e->next())
+            results.push_back(e->columns()[0]->asString().asString() + "="
+                              + e->columns()[1]->toJSONString() + ","
+                              + e->columns()[2]->toJSONString());
+        return results;
+    };
+    const char *filterQuery = "{WHAT: [['._id'], ['.num'], ['.type']],"
+                              " WHERE: ['>=', ['.num'], 18], ORDER_BY: [['.num']]}";
+    const char *boolQuery = "{WHAT: [['._id'], ['.num'], ['.type']],"
+                            " WHERE: ['=', ['._id'], 'rec-bool']}";
+    const char *uncoveredQuery = "{WHAT: [['._id'], ['.num'], ['.str']],"
+                                 " WHERE: ['>=', ['.num'], 18], ORDER_BY: [['.num']]}";
+
+    auto filtered = run(filterQuery, false);
+    CHECK(filtered == (vector<string>{"rec-018=18,\"number\"", "rec-019=19,\"number\"",
+                                      "rec-020=20,\"number\""}));
+    CHECK(run(boolQuery, false) == (vector<string>{"rec-bool=true,null"}));
+
+    CHECK(store->createIndex("nums"_sl, json5("{WHAT: [['.num']], INCLUDE: [['.type']]}"),
+                             IndexSpec::kValue));
+    CHECK(!store->createIndex("nums"_sl, json5("{WHAT: [['.num']], INCLUDE: [['.type']]}"),
+                              IndexSpec::kValue));
+    CHECK(run(filterQuery, true) == filtered);
+    CHECK(run(boolQuery, true) == (vector<string>{"rec-bool=true,null"}));
+    // The filter query is answered by an index-only scan:
+    Retained<Query> query = store->compileQuery(json5(filterQuery));
+    CHECK(query->explain().find("USING COVERING INDEX") != string::npos);
+    run(uncoveredQuery, false);
+
+    // The table is updated when docs change:
+    {
+        Transaction t(store->dataFile());
+        writeDoc("rec-005"_sl, DocumentFlags::kNone, t, [](Encoder &enc) {
+            enc.writeKey("num");
+            enc.writeInt(99);
+            enc.writeKey("type");
+            enc.writeString("big");
+        });
+        writeDoc("rec-019"_sl, DocumentFlags::kDeleted, t, [](Encoder &enc) { });
+        t.commit();
+    }
+    filtered = {"rec-018=18,\"number\"", "rec-020=20,\"number\"", "rec-005=99,\"big\""};
+    CHECK(run(filterQuery, true) == filtered);
+
+    store->deleteIndex("nums"_sl);
+    CHECK(run(filterQuery, false) == filtered);
+}
+
+
 TEST_CASE_METHOD(QueryTest, "Query SELECT", "[Query]") {
     addNumberedDocs();
     // Use a (SQL) query based on the Fleece "num" property:
@@ -973,9 +1110,255 @@ TEST_CASE_METHOD(QueryTest, "Query Distance Metrics", "[Query]") {
         {"['cosine_distance()', ['[]', 10, 10], ['[]', 13]]",           "null"},
     } );
 }
+
+
+TEST_CASE_METHOD(QueryTest, "Query Distance Metrics Packed Vectors", "[Query]") {
+    const float a[3] = {10, 10, 0}, b[3] = {13, 14, 0}, c[2] = {1, 2};
+    {
+        Transaction t(store->dataFile());
+        writeDoc("vecs"_sl, DocumentFlags::kNone, t, [&](Encoder &enc) {
+            enc.writeKey("a");
+            enc.writeData(PackedVector::encode(a, 3));
+            enc.writeKey("b");
+            enc.writeData(PackedVector::encode(b, 3));
+            enc.writeKey("bHalf");
+            enc.writeData(PackedVector::encode(b, 3, VectorElementType::Float16));
+            enc.writeKey("bArray");
+            enc.beginArray();
+            for (float f : b)
+                enc.writeFloat(f);
+            enc.endArray();
+            enc.writeKey("c");
+            enc.writeData(PackedVector::encode(c, 2));
+            enc.writeKey("junk");
+            enc.writeData("not a vector"_sl);
+        });
+        t.commit();
+    }
+    auto check = [&](const char *what, const char *expected) {
+        INFO("Testing " << what);
+        Retained<Query> query = store->compileQuery(json5(CONCAT("{'WHAT': [" << what << "]}")));
+        Retained<QueryEnumerator> e(query->createEnumerator());
+        REQUIRE(e->next());
+        CHECK(e->columns()[0]->toString() == slice(expected));
+    };
+    check("['euclidean_distance()', ['.a'], ['.b']]",          "5");
+    check("['euclidean_distance()', ['.a'], ['.b'], 2]",       "25");
+    check("['euclidean_distance()', ['.a'], ['.bHalf']]",      "5");
+    check("['euclidean_distance()', ['.a'], ['.bArray']]",     "5");
+    check("['euclidean_distance()', ['.bArray'], ['.a']]",     "5");
+    check("['euclidean_distance()', ['.a'], ['.a']]",          "0");
+    check("['euclidean_distance()', ['.a'], ['.c']]",          "null");
+    check("['euclidean_distance()', ['.a'], ['.junk']]",       "null");
+    check("['cosine_distance()', ['.a'], ['.a']]",             "0");
+    check("['cosine_distance()', ['.b'], ['.bHalf']]",         "0");
+    check("['cosine_distance()', ['.a'], ['.c']]",             "null");
+}
+
+
+TEST_CASE_METHOD(QueryTest, "Vector Index", "[Query]") {
+    // Docs on a 20x20 grid; odd ones store packed vectors, even ones arrays of numbers:
+    auto writeVectorDoc = [&](int i, float x, float y, Transaction &t) {
+        writeDoc(slice(stringWithFormat("rec-%03d", i)), DocumentFlags::kNone, t, [&](Encoder &enc) {
+            const float vec[2] = {x, y};
+            enc.writeKey("vec");
+            if (i % 2) {
+                enc.writeData(PackedVector::encode(vec, 2));
+            } else {
+                enc.beginArray();
+                enc.writeFloat(x);
+                enc.writeFloat(y);
+                enc.endArray();
+            }
+        });
+    };
+    {
+        Transaction t(store->dataFile());
+        for (int i = 0; i < 400; ++i)
+            writeVectorDoc(i, float(i % 20), float(i / 20), t);
+        t.commit();
+    }
+
+    auto nearest = [&](bool expectIndex) {
+        Retained<Query> query = store->compileQuery(json5(
+            "{'WHAT': [['._id']],"
+            " 'ORDER_BY': [['euclidean_distance()', ['.vec'], ['$target']]],"
+            " 'LIMIT': 4}"));
+        string explanation = query->explain();
+        Log("Explanation: %s", explanation.c_str());
+        CHECK((explanation.find(":vector:") != string::npos) == expectIndex);
+        Query::Options options(R"({"target": [3.1, 7.2]})"_sl);
+        Retained<QueryEnumerator> e(query->createEnumerator(&options));
+        vector<string> results;
+        while (e->next())
+            results.push_back(e->columns()[0]->asString().asString());
+        return results;
+    };
+
+    // Nearest are (3,7), (3,8), (4,7), (2,7):
+    const vector<string> expected {"rec-143", "rec-163", "rec-144", "rec-142"};
+    CHECK(nearest(false) == expected);
+
+    // Searching all the buckets gives exact results:
+    IndexSpec::Options options {};
+    options.numCentroids = 16;
+    options.numProbes = 16;
+    CHECK(store->createIndex("vecIndex"_sl, json5("[['.vec']]"), IndexSpec::kVector, &options));
+    CHECK(!store->createIndex("vecIndex"_sl, json5("[['.vec']]"), IndexSpec::kVector, &options));
+    CHECK(nearest(true) == expected);
+
+    // Changing only the options rebuilds the index:
+    options.numProbes = 8;
+    CHECK(store->createIndex("vecIndex"_sl, json5("[['.vec']]"), IndexSpec::kVector, &options));
+    options.numProbes = 16;
+    CHECK(store->createIndex("vecIndex"_sl, json5("[['.vec']]"), IndexSpec::kVector, &options));
+    CHECK(nearest(true) == expected);
+
+    // The index is updated when docs change:
+    {
+        Transaction t(store->dataFile());
+        writeVectorDoc(399, 3.1f, 7.2f, t);
+        t.commit();
+    }
+    CHECK(nearest(true) == (vector<string>{"rec-399", "rec-143", "rec-163", "rec-144"}));
+
+    store->deleteIndex("vecIndex"_sl);
+    CHECK(nearest(false) == (vector<string>{"rec-399", "rec-143", "rec-163", "rec-144"}));
+}
 #endif
 
 
+TEST_CASE("Packed Vectors", "[Query]") {
+    // Odd lengths exercise the SIMD kernels' tail handling:
+    for (size_t n : {0, 1, 7, 8, 17, 512, 1001}) {
+        INFO("n = " << n);
+        vector<float> a(n), b(n);
+        for (size_t i = 0; i < n; ++i) {
+            a[i] = float(i % 13) * 0.25f - 1.0f;
+            b[i] = float((i * 7) % 11) * 0.5f;
+        }
+        alloc_slice data = PackedVector::encode(a.data(), n);
+        CHECK(data.size == PackedVector::kHeaderSize + 4 * n);
+        CHECK(PackedVector::isPacked(data));
+        PackedVector vec(data);
+        REQUIRE(vec.valid());
+        CHECK(vec.count() == n);
+        vector<float> buffer;
+        const float *floats = vec.floats(buffer);
+        CHECK(memcmp(floats, a.data(), n * sizeof(float)) == 0);
+
+        // These values are exactly representable in float16:
+        alloc_slice halfData = PackedVector::encode(a.data(), n, VectorElementType::Float16);
+        CHECK(halfData.size == PackedVector::kHeaderSize + 2 * n);
+        PackedVector halfVec(halfData);
+        REQUIRE(halfVec.valid());
+        CHECK(halfVec.elementType() == VectorElementType::Float16);
+        floats = halfVec.floats(buffer);
+        CHECK(memcmp(floats, a.data(), n * sizeof(float)) == 0);
+
+        double expectedSq = 0, aa = 0, ab = 0, bb = 0;
+        for (size_t i = 0; i < n; ++i) {
+            double d = double(a[i]) - double(b[i]);
+            expectedSq += d * d;
+            aa += double(a[i]) * a[i];
+            ab += double(a[i]) * b[i];
+            bb += double(b[i]) * b[i];
+        }
+        CHECK(squaredEuclideanDistance(a.data(), b.data(), n) == Approx(expectedSq));
+        double aa2, ab2, bb2;
+        dotProducts(a.data(), b.data(), n, &aa2, &ab2, &bb2);
+        CHECK(aa2 == Approx(aa));
+        CHECK(ab2 == Approx(ab));
+        CHECK(bb2 == Approx(bb));
+    }
+
+    CHECK(!PackedVector::isPacked(nullslice));
+    CHECK(!PackedVector::isPacked("Vx\x01\x00\x05\x00\x00\x00"_sl));     // truncated
+    CHECK(!PackedVector::isPacked("hello, world"_sl));
+}
+
+
+TEST_CASE("Packed Vector Distance Benchmark", "[Query][Perf][.slow]") {
+    static constexpr size_t kDimensions = 512, kPoolSize = 16384, kNumVectors = 1000000;
+    vector<float> pool(kDimensions * kPoolSize);
+    minstd_rand random;
+    uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+    for (auto &f : pool)
+        f = distribution(random);
+    vector<float> target(pool.begin(), pool.begin() + kDimensions);
+    Log("Vector kernel: %s", vectorKernelName());
+
+    double total = 0;
+    Stopwatch st;
+    for (size_t i = 0; i < kNumVectors; ++i)
+        total += squaredEuclideanDistance(target.data(), &pool[(i % kPoolSize) * kDimensions],
+                                          kDimensions);
+    st.printReport("Euclidean distance of 512-dim float32 vectors", kNumVectors, "vector");
+    CHECK(total > 0);
+
+    // Compare with the old technique of iterating Fleece arrays:
+    Encoder enc;
+    enc.beginArray();
+    for (size_t i = 0; i < kDimensions; ++i)
+        enc.writeFloat(pool[kDimensions + i]);
+    enc.endArray();
+    alloc_slice encoded = enc.finish();
+    const Array *array = Value::fromTrustedData(encoded)->asArray();
+    static constexpr size_t kNumArrays = kNumVectors / 10;
+    total = 0;
+    st.reset();
+    for (size_t i = 0; i < kNumArrays; ++i) {
+        size_t j = 0;
+        for (Array::iterator iter(array); iter; ++iter, ++j) {
+            double d = iter.value()->asDouble() - target[j];
+            total += d * d;
+        }
+    }
+    st.printReport("Euclidean distance of 512-dim Fleece arrays", kNumArrays, "vector");
+    CHECK(total > 0);
+}
+
+
+TEST_CASE_METHOD(QueryTest, "Query Column Extraction Benchmark", "[Query][Perf][.slow]") {
+    // Measures the per-row cost of a query as the number of properties it extracts grows.
+    // After the first property, the doc body comes from the per-connection QueryBodyCache.
+    static constexpr int kNumDocs = 50000, kNumProperties = 16;
+    {
+        Transaction t(store->dataFile());
+        for (int i = 0; i < kNumDocs; ++i) {
+            writeDoc(slice(stringWithFormat("rec-%06d", i)), DocumentFlags::kNone, t,
+                     [=](Encoder &enc) {
+                for (int p = 0; p < kNumProperties; ++p) {
+                    enc.writeKey(slice(stringWithFormat("p%d", p)));
+                    if (p % 2)
+                        enc.writeString(stringWithFormat("value %d of doc %d", p, i));
+                    else
+                        enc.writeInt(i * kNumProperties + p);
+                }
+            });
+        }
+        t.commit();
+    }
+
+    for (int nCols = 1; nCols <= kNumProperties; nCols *= 2) {
+        stringstream json;
+        json << "{\"WHAT\": [";
+        for (int p = 0; p < nCols; ++p)
+            json << (p ? ", " : "") << "[\".p" << p << "\"]";
+        json << "]}";
+        Retained<Query> query = store->compileQuery(json.str());
+        Stopwatch st;
+        Retained<QueryEnumerator> e(query->createEnumerator());
+        int rows = 0;
+        while (e->next())
+            ++rows;
+        st.printReport(stringWithFormat("Query of %2d properties", nCols).c_str(),
+                       rows, "row");
+        CHECK(rows == kNumDocs);
+    }
+}
+
+
 TEST_CASE_METHOD(QueryTest, "Query Date Functions", "[Query]") {
     // Calculate offset
     time_t rawtime = 1540252800; // 2018-10-23 midnight GMT
@@ -123,6 +123,24 @@ N_WAY_TEST_CASE_METHOD(SQLiteFunctionsTest, "SQLite fl_contains", "[Query]") {
 }
 
 
+N_WAY_TEST_CASE_METHOD(SQLiteFunctionsTest, "SQLite fl_value of alternating bodies", "[Query]") {
+    // The decoded body is cached between calls; make sure switching bodies invalidates it
+    insert("a",   "{\"x\": 1, \"y\": \"one\"}");
+    insert("b",   "{\"x\": 2, \"y\": \"two\"}");
+
+    CHECK(query("SELECT fl_value(a.body, 'x') || fl_value(b.body, 'y') || fl_value(a.body, 'y') "
+                "FROM kv a, kv b ORDER BY a.key, b.key")
+            == (vector<string>{"1oneone", "1twoone", "2onetwo", "2twotwo"}));
+
+    // Three bodies per row evict each other from the cache:
+    insert("c",   "{\"x\": 3, \"y\": \"three\"}");
+    CHECK(query("SELECT fl_value(a.body, 'x') || fl_value(b.body, 'x') || fl_value(c.body, 'x') "
+                "|| fl_value(a.body, 'y') FROM kv a, kv b, kv c "
+                "WHERE a.key = 'a' AND b.key = 'b' AND c.key = 'c'")
+            == (vector<string>{"123one"}));
+}
+
+
 N_WAY_TEST_CASE_METHOD(SQLiteFunctionsTest, "SQLite array_sum of fl_value", "[Query]") {
     insert("a",   "{\"hey\": [1, 2, 3, 4]}");
     insert("b",   "{\"hey\": [2, 4, 6, 8]}");
@@ -18,8 +18,19 @@
 
 #include "LiteCoreTest.hh"
 #include "SequenceTracker.hh"
+#include "CrossProcessNotifier.hh"
+#include "Defer.hh"
+#include "StringUtil.hh"
+#include "Benchmark.hh"
+#include <condition_variable>
+#include <mutex>
 #include <sstream>
 
+#ifndef _MSC_VER
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
 using namespace std;
 using namespace litecore;
 using namespace fleece;
@@ -399,6 +410,45 @@ TEST_CASE_METHOD(litecore::SequenceTrackerTest, "SequenceTracker ExternalChanges
 }
 
 
+TEST_CASE_METHOD(litecore::SequenceTrackerTest, "SequenceTracker Changes From Another Process", "[notification]") {
+    int count1 = 0;
+    DatabaseChangeNotifier cn(tracker, [&](DatabaseChangeNotifier&) {++count1;}, 0);
+
+    tracker.beginTransaction();
+    tracker.documentChanged("A"_asl, "1-aa"_asl, ++seq, 1111);
+    tracker.documentChanged("B"_asl, "1-bb"_asl, ++seq, 2222);
+    tracker.endTransaction(true);
+    CHECK(count1 == 1);
+    SequenceTracker::Change changes[10];
+    bool external;
+    REQUIRE(cn.readChanges(changes, 10, external) == 2);
+
+    // Another process changed B and Z. A's change is no newer than what's known, so it's ignored:
+    tracker.addExternalChanges({{"A"_asl, "1-aa"_asl, 1, 1111},
+                                {"B"_asl, "2-bb"_asl, 3, 3333},
+                                {"Z"_asl, "1-zz"_asl, 4, 4444}});
+    CHECK(tracker.lastSequence() == 4);
+    CHECK_IF_DEBUG(tracker.dump() == "[*, B@3', Z@4']");
+    CHECK(count1 == 2);
+    REQUIRE(cn.readChanges(changes, 10, external) == 2);
+    CHECK(external == true);
+    CHECK(changes[0].docID == "B"_sl);
+    CHECK(changes[0].revID == "2-bb"_sl);
+    CHECK(changes[0].sequence == 3);
+    CHECK(changes[1].docID == "Z"_sl);
+
+    // Changes arriving during a transaction are added after it ends:
+    tracker.beginTransaction();
+    tracker.documentChanged("C"_asl, "1-cc"_asl, 6, 6666);
+    tracker.addExternalChanges({{"D"_asl, "1-dd"_asl, 5, 5555}});
+    CHECK_IF_DEBUG(tracker.dump() == "[B@3', Z@4', *, (C@6)]");
+    tracker.endTransaction(true);
+    CHECK_IF_DEBUG(tracker.dump() == "[*, C@6, D@5']");
+    CHECK(tracker.lastSequence() == 6);
+    CHECK(count1 == 3);
+}
+
+
 TEST_CASE_METHOD(litecore::SequenceTrackerTest, "SequenceTracker Purge", "[notification]") {
     int count1=0;
     DatabaseChangeNotifier cn1(tracker, [&](DatabaseChangeNotifier&) {++count1;});
@@ -422,3 +472,112 @@ TEST_CASE_METHOD(litecore::SequenceTrackerTest, "SequenceTracker Purge", "[notif
         CHECK(changes[1].sequence == 0);
     }
 }
+
+
+TEST_CASE_METHOD(litecore::SequenceTrackerTest, "SequenceTracker Bulk Purge", "[notification]") {
+    int count1=0;
+    DatabaseChangeNotifier cn1(tracker, [&](DatabaseChangeNotifier&) {++count1;});
+
+    tracker.beginTransaction();
+    tracker.documentChanged("A"_asl, "1-aa"_asl, ++seq, 1111);
+    tracker.documentChanged("B"_asl, "1-bb"_asl, ++seq, 2222);
+    CHECK(count1 == 1);
+
+    SequenceTracker::Change changes[5];
+    bool external;
+    REQUIRE(cn1.readChanges(changes, 5, external) == 2);
+
+    tracker.documentsPurged({"A"_asl, "C"_asl, "D"_asl});
+    CHECK(count1 == 2);     // notified only once for the whole set
+    REQUIRE_IF_DEBUG(dump() == "[(B@2, *, A@0, C@0, D@0)]");
+    REQUIRE(cn1.readChanges(changes, 5, external) == 3);
+    CHECK(changes[0].docID == "A"_sl);
+    CHECK(changes[1].docID == "C"_sl);
+    CHECK(changes[2].docID == "D"_sl);
+    CHECK(changes[2].revID == nullslice);
+    CHECK(changes[2].sequence == 0);
+}
+
+
+#ifndef _MSC_VER
+TEST_CASE_METHOD(TestFixture, "CrossProcessNotifier", "[notification]") {
+    FilePath path = GetPath("CrossProcessNotifier", "changes");
+    path.del();
+
+    // Fork before starting any notifier thread; the child waits till the parent is listening,
+    // then posts two commits:
+    int ready[2];
+    REQUIRE(pipe(ready) == 0);
+    pid_t child = fork();
+    REQUIRE(child >= 0);
+    if (child == 0) {
+        char c;
+        if (read(ready[0], &c, 1) != 1)
+            _exit(1);
+        try {
+            CrossProcessNotifier childNotifier(path, [](sequence_t, sequence_t) { });
+            childNotifier.committed(4, 10);
+            childNotifier.committed(11, 11);
+        } catch (...) {
+            _exit(1);
+        }
+        _exit(0);
+    }
+    close(ready[0]);
+
+    mutex m;
+    condition_variable cond;
+    vector<pair<sequence_t,sequence_t>> received;
+    {
+        DEFER {
+            close(ready[1]);                // (lets the child exit if something goes wrong)
+            waitpid(child, nullptr, 0);
+        };
+        CrossProcessNotifier notifier(path, [&](sequence_t first, sequence_t last) {
+            lock_guard<mutex> lock(m);
+            received.emplace_back(first, last);
+            cond.notify_all();
+        });
+        notifier.committed(1, 3);       // My own commits aren't reported back to me
+        REQUIRE(write(ready[1], "!", 1) == 1);
+
+        unique_lock<mutex> lock(m);
+        cond.wait_for(lock, chrono::seconds(5), [&] {return received.size() >= 2;});
+    }
+    REQUIRE(received.size() == 2);
+    CHECK(received[0] == make_pair(sequence_t(4), sequence_t(10)));
+    CHECK(received[1] == make_pair(sequence_t(11), sequence_t(11)));
+    path.del();
+}
+#endif
+
+
+TEST_CASE_METHOD(litecore::SequenceTrackerTest, "SequenceTracker Change Throughput", "[notification][Perf][.slow]") {
+    // Records changes to many documents and drains them through an observer in batches,
+    // the way a replicator's push feed does.
+    static constexpr size_t kNumDocs = 100000, kNumRounds = 10, kBatchSize = 200;
+    SequenceTracker::kMinChangesToKeep = 100;
+    vector<alloc_slice> docIDs;
+    for (size_t i = 0; i < kNumDocs; ++i)
+        docIDs.emplace_back(stringWithFormat("doc-%06zu", i));
+    alloc_slice revID("1-abcdef"_sl);
+
+    DatabaseChangeNotifier cn(tracker, [](DatabaseChangeNotifier&) { });
+    SequenceTracker::Change changes[kBatchSize];
+    bool external;
+    size_t nRead = 0;
+    Stopwatch st;
+    for (size_t round = 0; round < kNumRounds; ++round) {
+        tracker.beginTransaction();
+        for (auto &docID : docIDs)
+            tracker.documentChanged(docID, revID, ++seq, 1000);
+        tracker.endTransaction(true);
+        size_t n;
+        while ((n = cn.readChanges(changes, kBatchSize, external)) > 0) {
+            CHECK(changes[n-1].sequence == seq - kNumDocs + nRead % kNumDocs + n);
+            nRead += n;
+        }
+    }
+    st.printReport("Recording and reading changes", kNumRounds * kNumDocs, "change");
+    CHECK(nRead == kNumRounds * kNumDocs);
+}
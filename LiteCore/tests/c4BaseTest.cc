@@ -18,6 +18,10 @@
 
 #include "c4Internal.hh"
 #include "InstanceCounted.hh"
+#include "Instrumentation.hh"
+#include "Metrics.hh"
+#include "fleece/Fleece.hh"
+#include <thread>
 #include "catch.hpp"
 
 using namespace fleece;
@@ -73,6 +77,95 @@ TEST_CASE("C4Error exceptions") {
     CHECK(messageStr == "Oops");
 }
 
+TEST_CASE("Signpost tracing") {
+    using namespace litecore;
+    Signpost::mark(Signpost::commit);           // not tracing yet; ignored
+    c4_startTracing();
+    CHECK(Signpost::tracing());
+    {
+        Signpost signpost(Signpost::commit, 0x1234, 1);
+        std::thread([] {
+            Signpost::mark(Signpost::blipFrameSent, 7, 100);
+        }).join();
+    }
+    C4StringResult result = c4_stopTracing();
+    CHECK(!Signpost::tracing());
+    Signpost::mark(Signpost::commit);           // not tracing anymore; ignored
+
+    string json = result2string(result);
+    c4slice_free(result);
+    Doc doc = Doc::fromJSON(slice(json));
+    REQUIRE(doc);
+    Array events = doc.root().asDict()["traceEvents"].asArray();
+    REQUIRE(events.count() == 3);
+    CHECK(events[0].asDict()["name"].asString() == "commit"_sl);
+    CHECK(events[0].asDict()["ph"].asString() == "b"_sl);
+    CHECK(events[0].asDict()["id"].asString() == "0x1234"_sl);
+    CHECK(events[1].asDict()["ph"].asString() == "e"_sl);
+    CHECK(events[2].asDict()["name"].asString() == "blipFrameSent"_sl);
+    CHECK(events[2].asDict()["ph"].asString() == "i"_sl);
+    CHECK(events[2].asDict()["args"].asDict()["param2"].asInt() == 100);
+    CHECK(events[2].asDict()["tid"].asInt() != events[0].asDict()["tid"].asInt());
+    CHECK(events[1].asDict()["ts"].asDouble() >= events[0].asDict()["ts"].asDouble());
+}
+
+
+TEST_CASE("Metrics") {
+    using namespace litecore::metrics;
+    static Counter sCounter("test.counter");
+    static Gauge sGauge("test.gauge");
+    static Histogram sHistogram("test.histogramUsec");
+    sCounter.reset();
+    sGauge.reset();
+    sHistogram.reset();
+
+    vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([] {
+            for (uint64_t i = 1; i <= 1000; ++i) {
+                ++sCounter;
+                sGauge.add(1);
+                sHistogram.record(i);
+                sGauge.add(-1);
+            }
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    CHECK(sCounter.value() == 4000);
+    CHECK(sGauge.value() == 0);
+    CHECK(sGauge.max() >= 1);
+    CHECK(sHistogram.count() == 4000);
+    CHECK(sHistogram.max() == 1000);
+    CHECK(sHistogram.mean() == Approx(500.5));
+    // Percentiles are accurate to within 1/8:
+    CHECK(sHistogram.percentile(0.5) >= 500);
+    CHECK(sHistogram.percentile(0.5) <= 500 + 500/8);
+    CHECK(sHistogram.percentile(1.0) == 1000);
+    CHECK(Metric::named("test.counter") == &sCounter);
+
+    for (uint64_t v : {0ull, 1ull, 15ull, 16ull, 17ull, 1000ull, 123456789ull, ~0ull}) {
+        unsigned bucket = Histogram::bucketIndex(v);
+        REQUIRE(bucket < Histogram::kNumBuckets);
+        CHECK(Histogram::bucketMaxValue(bucket) >= v);
+        if (bucket > 0)
+            CHECK(Histogram::bucketMaxValue(bucket - 1) < v);
+    }
+
+    C4StringResult result = c4_getMetrics();
+    string json = result2string(result);
+    c4slice_free(result);
+    Doc doc = Doc::fromJSON(slice(json));
+    REQUIRE(doc);
+    Dict root = doc.root().asDict();
+    CHECK(root["test.counter"].asInt() == 4000);
+    CHECK(root["test.gauge"].asDict()["value"].asInt() == 0);
+    CHECK(root["test.histogramUsec"].asDict()["count"].asInt() == 4000);
+    CHECK(root["test.histogramUsec"].asDict()["p999"].asInt() == 1000);
+    CHECK(root["db.commitUsec"]);
+}
+
 namespace {
 
     class NonVirt {
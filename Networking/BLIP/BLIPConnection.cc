@@ -24,6 +24,8 @@
 #include "Batcher.hh"
 #include "Codec.hh"
 #include "Error.hh"
+#include "Instrumentation.hh"
+#include "Metrics.hh"
 #include "Logging.hh"
 #include "StringUtil.hh"
 #include "varint.hh"
@@ -54,6 +56,10 @@ namespace litecore { namespace blip {
     LogDomain BLIPLog("BLIP", LogLevel::Warning);
     static LogDomain BLIPMessagesLog("BLIPMessages", LogLevel::None);
 
+    static metrics::Counter sBytesSent("blip.bytesSent"), sBytesReceived("blip.bytesReceived");
+    static metrics::Counter sFramesSent("blip.framesSent"), sFramesReceived("blip.framesReceived");
+    static metrics::Gauge sOutboxDepth("blip.outboxDepth");
+
 
     /** Queue of outgoing messages; each message gets to send one frame in turn. */
     class MessageQueue : public vector<Retained<MessageOut>> {
@@ -265,6 +271,7 @@ namespace litecore { namespace blip {
                     logVerbose("Sending %s", msg->description().c_str());
             }
             _maxOutboxDepth = max(_maxOutboxDepth, _outbox.size()+1);
+            sOutboxDepth.set(_outbox.size()+1);
             _totalOutboxDepth += _outbox.size()+1;
             ++_countOutboxDepth;
             requeue(msg, true);
@@ -367,6 +374,8 @@ namespace litecore { namespace blip {
                                prevBytesSent, msg->_bytesSent - 1);
                     //logVerbose("    %s", frame.hexString().c_str());
                     // Write it to the WebSocket:
+                    Signpost::mark(Signpost::blipFrameSent, uintptr_t(msg->_number), frame.size);
+                    ++sFramesSent;
                     _writeable = _webSocket->send(frame);
                 }
                 
@@ -387,6 +396,7 @@ namespace litecore { namespace blip {
                 }
             }
             _totalBytesWritten += bytesWritten;
+            sBytesSent += bytesWritten;
             logVerbose("...Wrote %zu bytes to WebSocket (writeable=%d)",
                        bytesWritten, _writeable);
         }
@@ -407,10 +417,13 @@ namespace litecore { namespace blip {
                     // Read the frame header:
                     slice payload = wsMessage->data;
                     _totalBytesRead += payload.size;
+                    sBytesReceived += payload.size;
+                    ++sFramesReceived;
                     uint64_t msgNo, flagsInt;
                     if (!ReadUVarInt(&payload, &msgNo) || !ReadUVarInt(&payload, &flagsInt))
                         throw runtime_error("Illegal BLIP frame header");
                     auto flags = (FrameFlags)flagsInt;
+                    Signpost::mark(Signpost::blipFrameReceived, uintptr_t(msgNo), payload.size);
                     logVerbose("Received frame: %s #%" PRIu64 " %c%c%c%c, length %5ld",
                                kMessageTypeNames[flags & kTypeMask], msgNo,
                                (flags & kMoreComing ? 'M' : '-'),
@@ -626,7 +639,8 @@ namespace litecore { namespace blip {
         else
             logInfo("Opening connection...");
 
-        _compressionLevel = kDefaultCompressionLevel;
+        // Compressing messages to a peer in the same process would just waste time:
+        _compressionLevel = webSocket->isInProcess() ? 0 : kDefaultCompressionLevel;
         auto levelP = options.get(kCompressionLevelOption);
         if (levelP.isInteger())
             _compressionLevel = (int8_t)levelP.asInt();
@@ -48,7 +48,8 @@ namespace litecore { namespace blip {
         static constexpr const char *kWSProtocolName = "BLIP_3";
 
         /** Option to set the 'deflate' compression level. Value must be an integer in the range
-            0 (no compression) to 9 (best compression). */
+            0 (no compression) to 9 (best compression). The default is 0 if the WebSocket's peer
+            is in the same process. */
         static constexpr const char *kCompressionLevelOption = "BLIPCompressionLevel";
 
         /** Creates a BLIP connection on a WebSocket. */
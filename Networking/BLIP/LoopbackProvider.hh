@@ -23,6 +23,7 @@
 #include "Error.hh"
 #include "Logging.hh"
 #include <atomic>
+#include <cerrno>
 #include <chrono>
 #include <iomanip>
 #include <memory>
@@ -80,6 +81,15 @@ namespace litecore { namespace websocket {
             _driver->enqueue(&Driver::_close, status, fleece::alloc_slice(message));
         }
 
+        virtual bool isInProcess() const override   {return true;}
+
+        /** Makes the connection fail, as though the network dropped, once this socket has sent
+            `byteCount` more bytes. Both sides then close with a POSIX ECONNRESET error.
+            (For testing.) */
+        void simulateDisconnectAfter(size_t byteCount) {
+            _driver->enqueue(&Driver::_simulateDisconnectAfter, byteCount);
+        }
+
 
     protected:
 
@@ -226,6 +236,12 @@ namespace litecore { namespace websocket {
                     logDebug("SEND: %s", formatMsg(msg, binary).c_str());
                     Retained<Message> message(new LoopbackMessage(_webSocket, msg, binary));
                     _peer->received(message, _latency);
+                    if (_disconnectAfter > 0) {
+                        if (msg.size >= _disconnectAfter)
+                            _disconnect(ECONNRESET);
+                        else
+                            _disconnectAfter -= msg.size;
+                    }
                 } else {
                     logInfo("SEND: Failed, socket is closed");
                 }
@@ -259,6 +275,19 @@ namespace litecore { namespace websocket {
                 _closed({kWebSocketClose, status, message});
             }
 
+            void _simulateDisconnectAfter(size_t byteCount) {
+                _disconnectAfter = byteCount;
+            }
+
+            // Closes both sides without a WebSocket close handshake, like a network failure.
+            void _disconnect(int errorCode) {
+                logInfo("DISCONNECT (simulated); error=%d", errorCode);
+                const char *message = "Simulated network failure";
+                if (_peer)
+                    _peer->closed(kPOSIXError, errorCode, message, _latency);
+                _closed({kPOSIXError, errorCode, fleece::alloc_slice(message)});
+            }
+
             virtual void _closed(CloseStatus status) {
                 if (_state == State::closed)
                     return;
@@ -310,6 +339,7 @@ namespace litecore { namespace websocket {
             Retained<LoopbackWebSocket> _peer;
             websocket::Headers _responseHeaders;
             std::atomic<size_t> _bufferedBytes {0};
+            size_t _disconnectAfter {0};                // Bytes to send before disconnecting
             State _state {State::unconnected};
         };
     };
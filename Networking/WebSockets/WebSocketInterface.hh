@@ -141,6 +141,9 @@ namespace litecore { namespace websocket {
         /** Closes the WebSocket. Callable from any thread. */
         virtual void close(int status =kCodeNormal, fleece::slice message =fleece::nullslice) =0;
 
+        /** True if the peer is in this same process, so messages never go over a network. */
+        virtual bool isInProcess() const            {return false;}
+
     protected:
         WebSocket(const URL &url, Role role);
         virtual ~WebSocket();
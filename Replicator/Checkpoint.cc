@@ -20,6 +20,7 @@
 #include "Logging.hh"
 #include "StringUtil.hh"
 #include "fleece/Fleece.hh"
+#include "varint.hh"
 #include <limits>
 #include <sstream>
 
@@ -32,6 +33,8 @@ namespace litecore { namespace repl {
 
     bool Checkpoint::gWriteTimestamps = true;
 
+    static constexpr uint8_t kDataFormat = 1;   // First byte of toData(); JSON starts with '{'
+
 
     void Checkpoint::resetLocal() {
         _completed.clear();
@@ -85,14 +88,14 @@ namespace litecore { namespace repl {
             _remote = root["remote"_sl].toJSON();
 
 #ifdef SPARSE_CHECKPOINTS
-            // New properties for sparse checkpoint:
-            Array pending = root["localPending"].asArray();
-            if (pending) {
-                for (Array::iterator i(pending); i; ++i) {
-                    C4SequenceNumber first = i->asInt();
-                    C4SequenceNumber last = (++i)->asInt();
-                    if (last >= first)
-                        _completed.add(first, last + 1);
+            // New property for sparse checkpoint; (sequence, length) pairs as written by toJSON:
+            Array completed = root["localCompleted"].asArray();
+            if (completed) {
+                for (Array::iterator i(completed); i; ++i) {
+                    auto first = C4SequenceNumber(i->asUnsigned());
+                    if (!++i)
+                        break;
+                    _completed.add(first, first + i->asUnsigned());
                 }
             } else
 #endif
@@ -107,6 +110,59 @@ namespace litecore { namespace repl {
     }
 
 
+    alloc_slice Checkpoint::toData() const {
+        alloc_slice data(1 + (1 + 2 * _completed.rangesCount()) * kMaxVarintLen64 + _remote.size);
+        auto out = (uint8_t*)data.buf;
+        *out++ = kDataFormat;
+        out += PutUVarInt(out, _completed.rangesCount());
+        C4SequenceNumber end = 0;
+        for (auto &range : _completed) {
+            out += PutUVarInt(out, range.first - end);
+            out += PutUVarInt(out, range.second - range.first);
+            end = range.second;
+        }
+        if (_remote.size > 0) {
+            memcpy(out, _remote.buf, _remote.size);
+            out += _remote.size;
+        }
+        data.shorten(out - (uint8_t*)data.buf);
+        return data;
+    }
+
+
+    void Checkpoint::readData(slice data) {
+        if (data.size == 0 || data[0] != kDataFormat) {
+            readJSON(data);
+            return;
+        }
+        resetLocal();
+        _remote = nullslice;
+        slice in = data;
+        in.moveStart(1);
+        uint64_t count;
+        if (ReadUVarInt(&in, &count)) {
+            C4SequenceNumber end = 0;
+            for (; count > 0; --count) {
+                uint64_t gap, length;
+                if (!ReadUVarInt(&in, &gap) || !ReadUVarInt(&in, &length))
+                    break;
+                _completed.add(end + gap, end + gap + length);
+                end += gap + length;
+            }
+            if (count == 0) {
+                // Normalize the remote sequence the same way readJSON does, so it compares
+                // equal to the one in the remote checkpoint:
+                if (in.size > 0)
+                    _remote = Doc::fromJSON(in, nullptr).root().toJSON();
+                return;
+            }
+        }
+        // Corrupt data; start over, as though there were no checkpoint:
+        LogTo(SyncLog, "Local checkpoint data is invalid; ignoring it");
+        resetLocal();
+    }
+
+
     bool Checkpoint::validateWith(const Checkpoint &remoteSequences) {
         bool match = true;
         if (_completed != remoteSequences._completed) {
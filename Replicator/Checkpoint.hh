@@ -14,8 +14,9 @@ namespace litecore { namespace repl {
 
     /**
      * Tracks the state of replication, i.e. which sequences have been sent/received and which
-     * haven't. This state is persisted by storing a JSON serialization of the Checkpoint into
-     * a pair of documents, one local and one on the server. At the start of replication both
+     * haven't. This state is persisted by storing a serialization of the Checkpoint into
+     * a pair of documents, one local and one on the server. The server's copy is JSON; the local
+     * one uses a compact binary form (see `toData`.) At the start of replication both
      * documents are read, and if they agree, the replication continues from that state, otherwise
      * it starts over from the beginning.
      *
@@ -44,6 +45,16 @@ namespace litecore { namespace repl {
 
         fleece::alloc_slice toJSON() const;
 
+        /** Reads the local checkpoint, which is either in the form written by `toData`, or JSON
+            written by earlier versions. */
+        void readData(fleece::slice data);
+
+        /** Encodes the checkpoint compactly, for local storage: a format byte, the number of
+            completed sequence ranges, each range as varints of its distance from the end of the
+            previous range and its length, then the remote sequence as-is. This stays small even
+            when a push out of order has fragmented the completed sequences. */
+        fleece::alloc_slice toData() const;
+
         bool validateWith(const Checkpoint &remoteSequences);
 
         //---- Local sequences:
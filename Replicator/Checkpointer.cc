@@ -20,6 +20,7 @@
 #include "Checkpoint.hh"
 #include "DBAccess.hh"
 #include "Logging.hh"
+#include "Metrics.hh"
 #include "SecureDigest.hh"
 #include "StringUtil.hh"
 #include "c4Database.h"
@@ -34,6 +35,10 @@ namespace litecore { namespace repl {
     using namespace std;
     using namespace fleece;
 
+    static metrics::Histogram sCheckpointEncodeTime("replicator.checkpointEncodeUsec");
+    static metrics::Histogram sCheckpointSize("replicator.checkpointBytes");
+    static metrics::Histogram sCheckpointJSONSize("replicator.checkpointJSONBytes");
+
 
 #pragma mark - CHECKPOINT ACCESSORS:
 
@@ -157,8 +162,12 @@ namespace litecore { namespace repl {
             Assert(_checkpoint);
             _changed = false;
             _saving = true;
+            // Encode both forms now, so the local checkpoint matches the one sent to the peer:
+            metrics::Histogram::Timer timer(sCheckpointEncodeTime);
             json = _checkpoint->toJSON();
+            _dataToWrite = _checkpoint->toData();
         }
+        sCheckpointJSONSize.record(json.size);
         _saveCallback(json);
         return true;
     }
@@ -287,8 +296,8 @@ namespace litecore { namespace repl {
         LOCK();
         _checkpoint.reset(new Checkpoint);
         if (body && !_resetCheckpoint) {
-            _checkpoint->readJSON(body);
-            _checkpointJSON = body;
+            _checkpoint->readData(body);
+            _checkpointJSON = body.hasPrefix("{"_sl) ? body : _checkpoint->toJSON();
             return true;
         } else {
             *outError = {};
@@ -305,11 +314,18 @@ namespace litecore { namespace repl {
     }
 
 
-    bool Checkpointer::write(C4Database *db, slice data, C4Error *outError) {
+    bool Checkpointer::write(C4Database *db, C4Error *outError) {
+        alloc_slice data;
+        {
+            LOCK();
+            data = _dataToWrite;
+        }
+        Assert(data);
         const auto checkpointID = remoteDocID(db, outError);
         if (!checkpointID || !c4raw_put(db, constants::kLocalCheckpointStore,
                                          checkpointID, nullslice, data, outError))
             return false;
+        sCheckpointSize.record(data.size);
         // Now that we've saved, use the real checkpoint ID for any future reads:
         _initialDocID = checkpointID;
         _resetCheckpoint = false;
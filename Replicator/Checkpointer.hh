@@ -72,7 +72,7 @@ namespace litecore { namespace repl {
         /** Returns the doc ID where the checkpoint is to be stored. */
         alloc_slice checkpointID() const        {Assert(_docID); return _docID;}
 
-        /** The actual JSON read from the local checkpoint.
+        /** The local checkpoint as read, in JSON form.
             (Kept around for logging. Only available until the checkpoint changes.) */
         slice checkpointJSON() const            {return _checkpointJSON;}
 
@@ -87,11 +87,12 @@ namespace litecore { namespace repl {
         /** Updates the checkpoint from the database if it's changed. */
         bool reread(C4Database *db NONNULL, C4Error *outError);
 
-        /** Writes serialized checkpoint state to the local database.
+        /** Writes the checkpoint state last passed to the SaveCallback to the local database,
+            in the compact form produced by `Checkpoint::toData`.
             Does not write the current checkpoint state, because it may have changed since the
             remote save. It's important that the saved data be the same as what was saved on
             the remote peer. */
-        bool write(C4Database *db NONNULL, slice checkpointData, C4Error *outError);
+        bool write(C4Database *db NONNULL, C4Error *outError);
 
         // Autosave:
 
@@ -158,6 +159,7 @@ namespace litecore { namespace repl {
         bool                            _changed  {false};
         bool                            _saving {false};
         bool                            _overdueForSave {false};
+        alloc_slice                     _dataToWrite;       // Local form of the save in progress
         std::unique_ptr<actor::Timer>   _timer;
         SaveCallback                    _saveCallback;
         duration                        _saveTime;
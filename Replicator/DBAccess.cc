@@ -20,6 +20,7 @@
 #include "ReplicatedRev.hh"
 #include "ReplicatorTuning.hh"
 #include "Error.hh"
+#include "Metrics.hh"
 #include "Stopwatch.hh"
 #include "StringUtil.hh"
 #include "c4BlobStore.h"
@@ -37,6 +38,8 @@ namespace litecore { namespace repl {
     using namespace std;
     using namespace fleece;
 
+    static metrics::Counter sRevsReEncoded("replicator.revsReEncoded");
+
 
     DBAccess::DBAccess(C4Database* db, bool disableBlobSupport)
     :access_lock(move(db))
@@ -304,6 +307,46 @@ namespace litecore { namespace repl {
     }
 
 
+    // Returns true if any dict in the value has integer keys. The peer encodes bodies without
+    // SharedKeys, so such keys can't be resolved to strings.
+    static bool hasIntegerKeys(Value value) {
+        if (Dict dict = value.asDict(); dict) {
+            for (Dict::iterator i(dict); i; ++i) {
+                if (i.key().type() != kFLString || hasIntegerKeys(i.value()))
+                    return true;
+            }
+        } else if (Array array = value.asArray(); array) {
+            for (Array::iterator i(array); i; ++i) {
+                if (hasIntegerKeys(i.value()))
+                    return true;
+            }
+        }
+        return false;
+    }
+
+
+    Doc DBAccess::tempEncodeFleece(alloc_slice fleeceBody, FLError *err) {
+        try {
+            Doc received(fleeceBody, kFLUntrusted);
+            if (!received || !received.root().asDict() || hasIntegerKeys(received.root())) {
+                *err = kFLInvalidData;
+                return {};
+            }
+            Encoder enc;
+            enc.setSharedKeys(tempSharedKeys());
+            enc.writeValue(received.root());
+            Doc doc = enc.finishDoc();
+            if (!doc)
+                *err = enc.error();
+            return doc;
+        } catch (const exception &x) {
+            WarnError("Re-encoding incoming Fleece body failed: %s", x.what());
+            *err = kFLInvalidData;
+            return {};
+        }
+    }
+
+
     alloc_slice DBAccess::reEncodeForDatabase(Doc doc) {
         bool reEncode;
         {
@@ -313,6 +356,7 @@ namespace litecore { namespace repl {
         }
         if (reEncode) {
             // Re-encode with database's current sharedKeys:
+            ++sRevsReEncoded;
             return useForInsert<alloc_slice>([&](C4Database* idb) {
                 SharedEncoder enc(c4db_getSharedFleeceEncoder(idb));
                 enc.writeValue(doc.root());
@@ -453,11 +497,18 @@ namespace litecore { namespace repl {
     }
 
     bool DBAccess::endTransaction(bool commit, C4Error *outError) {
-        return useForInsert<bool>([&](C4Database *idb) {
+        bool ok = useForInsert<bool>([&](C4Database *idb) {
             Assert(_inTransaction);
             _inTransaction = false;
             return c4db_endTransaction(idb, commit, outError);
         });
+        if (ok && commit) {
+            // The commit may have saved keys that _tempSharedKeys added since it was copied.
+            // Catch up with them, so revs encoded from now on can go into the database as-is,
+            // instead of being re-encoded by reEncodeForDatabase while the transaction's open:
+            updateTempSharedKeys();
+        }
+        return ok;
     }
 
 
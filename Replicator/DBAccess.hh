@@ -134,6 +134,11 @@ namespace litecore { namespace repl {
             isn't in a transaction. */
         fleece::Doc tempEncodeJSON(slice jsonBody, FLError *err);
 
+        /** Like tempEncodeJSON, but re-encodes a Fleece body received from the peer, which has
+            no SharedKeys. Fails with kFLInvalidData if the body isn't valid Fleece, isn't a dict,
+            or contains integer (shared) keys. */
+        fleece::Doc tempEncodeFleece(alloc_slice fleeceBody, FLError *err);
+
         /** Takes a document produced by tempEncodeJSON and re-encodes it if necessary with the
             database's real SharedKeys, so it's suitable for saving. This can only be called
             inside a transaction. */
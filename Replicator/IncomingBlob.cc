@@ -18,9 +18,11 @@
 
 #include "IncomingBlob.hh"
 #include "Replicator.hh"
+#include "ReplicatorTuning.hh"
 #include "StringUtil.hh"
 #include "MessageBuilder.hh"
 #include "c4BlobStore.h"
+#include "c4Private.h"
 #include <atomic>
 
 using namespace fleece;
@@ -51,33 +53,52 @@ namespace litecore { namespace repl {
     void IncomingBlob::_start(PendingBlob blob) {
         Assert(!_writer);
         _blob = blob;
+        readPartialBlob();
         logVerbose("Requesting blob (%" PRIu64 " bytes, compress=%d)", _blob.length, _blob.compressible);
 
         addProgress({0, _blob.length});
+        requestBlob(_blob.key, _blob.length >= tuning::kMinBlobSizeForChunks);
+    }
+
 
+    // Sends a getAttachment request for a blob, or for one chunk of it. If `chunks` is true,
+    // the peer may instead reply with the blob's chunk list.
+    void IncomingBlob::requestBlob(C4BlobKey key, bool chunks) {
+        _currentKey = key;
         MessageBuilder req("getAttachment"_sl);
-        alloc_slice digest = c4blob_keyToString(_blob.key);
+        alloc_slice digest = c4blob_keyToString(key);
         req["digest"_sl] = digest;
         if (_blob.compressible)
             req["compress"_sl] = "true"_sl;
+        if (chunks)
+            req["chunks"_sl] = "true"_sl;
+        if (_offset > 0 && !_chunks)
+            req["offset"_sl] = _offset;
         sendRequest(req, [=](blip::MessageProgress progress) {
             //... After request is sent:
             if (_busy) {
                 if (progress.state == MessageProgress::kDisconnected) {
+                    savePartialBlob();
                     // Set some error, so my IncomingRev will know I didn't complete [CBL-608]
                     onError({POSIXDomain, ECONNRESET});
                 } else if (progress.reply) {
+                    bool complete = progress.state == MessageProgress::kComplete;
                     if (progress.reply->isError()) {
                         gotError(progress.reply);
                         notifyProgress(true);
+                    } else if (progress.reply->boolProperty("chunks"_sl)) {
+                        if (complete)
+                            gotChunkList(progress.reply->extractBody());
                     } else {
-                        bool complete = progress.state == MessageProgress::kComplete;
+                        bool isChunk = (bool)_chunks;
+                        if (!_writer && !isChunk)
+                            checkResumed(progress.reply);
                         auto data = progress.reply->extractBody();
                         writeToBlob(data);
                         if (complete)
                             finishBlob();
                         if (complete || data.size > 0)
-                            notifyProgress(complete);
+                            notifyProgress(complete && !isChunk);
                     }
                 }
             }
@@ -86,6 +107,64 @@ namespace litecore { namespace repl {
     }
 
 
+    // Called when the reply to a request for the whole blob starts to arrive. If I asked the
+    // peer to skip the part I received earlier, checks that it did; older peers ignore "offset"
+    // and send the whole blob.
+    void IncomingBlob::checkResumed(MessageIn *reply) {
+        if (_offset == 0)
+            return;
+        if (reply->intProperty("offset"_sl) == int64_t(_offset)) {
+            logVerbose("Resuming blob after the %" PRIu64 " bytes received earlier", _offset);
+            addProgress({_offset, 0});
+        } else {
+            forgetPartialBlob(true);
+        }
+    }
+
+
+    void IncomingBlob::gotChunkList(alloc_slice chunkList) {
+        if (!_segments.empty())
+            forgetPartialBlob(true);        // I'll get the chunks I don't have instead
+        _chunks = Doc::fromJSON(chunkList);
+        if (!_chunks.asArray()) {
+            _chunks = Doc();
+            return gotError(c4error_make(LiteCoreDomain, kC4ErrorCorruptData,
+                                         "Invalid blob chunk list"_sl));
+        }
+        _chunkList = chunkList;
+        _chunkIndex = 0;
+        logVerbose("Blob is stored in %u chunks", _chunks.asArray().count());
+        requestNextChunk();
+    }
+
+
+    // Requests the next chunk that isn't in the local store yet. When all are present, adds the
+    // blob itself.
+    void IncomingBlob::requestNextChunk() {
+        Array chunks = _chunks.asArray();
+        while (_chunkIndex < chunks.count()) {
+            Array chunk = chunks[_chunkIndex++].asArray();
+            C4BlobKey key;
+            if (!c4blob_keyFromString(chunk[0].asString(), &key)) {
+                return gotError(c4error_make(LiteCoreDomain, kC4ErrorCorruptData,
+                                             "Invalid blob chunk list"_sl));
+            }
+            if (c4blob_getSize(_blobStore, key) < 0)
+                return requestBlob(key, false);
+            addProgress({chunk[1].asUnsigned(), 0});
+        }
+
+        logVerbose("Received all %u chunks of blob", chunks.count());
+        C4Error err;
+        if (!c4blob_createFromChunks(_blobStore, _chunkList, &_blob.key, nullptr, &err))
+            gotError(err);
+        _chunks = Doc();
+        _chunkList = nullslice;
+        _busy = false;
+        notifyProgress(true);
+    }
+
+
     void IncomingBlob::writeToBlob(alloc_slice data) {
         C4Error err;
 		if(_writer == nullptr) {
@@ -110,12 +189,132 @@ namespace litecore { namespace repl {
 
 
     void IncomingBlob::finishBlob() {
-        alloc_slice digest = c4blob_keyToString(_blob.key);
-        logVerbose("Finished receiving blob %.*s (%" PRIu64 " bytes)", SPLAT(digest), _blob.length);
+        if (!_segments.empty() && !_chunks)
+            return finishSegments();
+        alloc_slice digest = c4blob_keyToString(_currentKey);
+        logVerbose("Finished receiving %s %.*s (%" PRIu64 " bytes)",
+                   (_chunks ? "chunk" : "blob"), SPLAT(digest), _blob.length);
         C4Error err;
-        if (!c4stream_install(_writer, &_blob.key, &err))
+        bool installed = c4stream_install(_writer, &_currentKey, &err);
+        if (!installed)
             gotError(err);
         closeWriter();
+        if (installed && _chunks)
+            requestNextChunk();
+    }
+
+
+    // Adds the data in the writer to the store as a blob of its own, and appends it to _segments.
+    bool IncomingBlob::installSegment(C4Error *outError) {
+        uint64_t length = c4stream_bytesWritten(_writer);
+        if (length == 0)
+            return true;
+        C4BlobKey key = c4stream_computeBlobKey(_writer);
+        if (!c4stream_install(_writer, nullptr, outError))
+            return false;
+        _segments.push_back({key, length});
+        _offset += length;
+        return true;
+    }
+
+
+    // Returns _segments in the JSON form of a blob chunk list.
+    alloc_slice IncomingBlob::segmentListJSON() const {
+        JSONEncoder enc;
+        enc.beginArray();
+        for (auto &segment : _segments) {
+            enc.beginArray();
+            enc.writeString(alloc_slice(c4blob_keyToString(segment.key)));
+            enc.writeUInt(segment.length);
+            enc.endArray();
+        }
+        enc.endArray();
+        return enc.finish();
+    }
+
+
+    // Finishes a blob whose first part was received over an earlier connection: the rest
+    // becomes one more segment, and the segments are then combined as the chunks of the blob,
+    // which checks its digest.
+    void IncomingBlob::finishSegments() {
+        C4Error err;
+        bool installed = installSegment(&err);
+        if (installed) {
+            logVerbose("Finished receiving blob; combining %zu segments", _segments.size());
+            installed = c4blob_createFromChunks(_blobStore, segmentListJSON(), &_blob.key,
+                                                nullptr, &err);
+        }
+        // If the store keeps the blob as chunks, the segments are now its chunks; otherwise
+        // their data was copied. Bad data mustn't be resumed from again, either:
+        bool chunked = installed && alloc_slice(c4blob_getChunkList(_blobStore, _blob.key,
+                                                                    nullptr));
+        forgetPartialBlob(!chunked);
+        if (!installed)
+            gotError(err);
+        closeWriter();
+    }
+
+
+    // Looks up the parts of the blob received over earlier connections, if any.
+    void IncomingBlob::readPartialBlob() {
+        _segments.clear();
+        _offset = 0;
+        alloc_slice digest = c4blob_keyToString(_blob.key);
+        c4::ref<C4RawDocument> doc = _db->getRawDoc(constants::kPartialBlobStore, digest,
+                                                    nullptr);
+        if (!doc)
+            return;
+        Doc segments = Doc::fromJSON(doc->body);
+        for (Array::iterator i(segments.asArray()); i; ++i) {
+            Array segment = i.value().asArray();
+            C4BlobKey key;
+            if (!c4blob_keyFromString(segment[0].asString(), &key)
+                    || c4blob_getSize(_blobStore, key) < 0) {
+                // Compaction deletes segments, since no document refers to them:
+                return forgetPartialBlob(true);
+            }
+            _segments.push_back({key, segment[1].asUnsigned()});
+            _offset += _segments.back().length;
+        }
+        if (_offset == 0 || _offset >= _blob.length)
+            return forgetPartialBlob(true);
+        logVerbose("Have %" PRIu64 " bytes of the blob from earlier", _offset);
+    }
+
+
+    // Called when the connection drops while receiving the blob. Saves the data received so far
+    // as another segment, so that next time only the rest needs to be requested.
+    void IncomingBlob::savePartialBlob() {
+        if (!_writer || _chunks || c4stream_bytesWritten(_writer) < tuning::kMinPartialBlobSize)
+            return;
+        C4Error err;
+        bool saved = installSegment(&err);
+        if (saved) {
+            alloc_slice digest = c4blob_keyToString(_blob.key);
+            alloc_slice json = segmentListJSON();
+            saved = _db->use<bool>([&](C4Database *db) {
+                return c4raw_put(db, constants::kPartialBlobStore, digest, nullslice, json, &err);
+            });
+        }
+        if (saved)
+            logInfo("Saved the first %" PRIu64 " bytes of the blob, to resume later", _offset);
+        else
+            warn("Couldn't save the partial blob: error %d/%d", err.domain, err.code);
+    }
+
+
+    // Deletes the record of the blob's partial data, and optionally the segments themselves.
+    void IncomingBlob::forgetPartialBlob(bool deleteSegments) {
+        if (deleteSegments) {
+            for (auto &segment : _segments)
+                c4blob_delete(_blobStore, segment.key, nullptr);
+        }
+        _segments.clear();
+        _offset = 0;
+        alloc_slice digest = c4blob_keyToString(_blob.key);
+        _db->use([&](C4Database *db) {
+            c4raw_put(db, constants::kPartialBlobStore, digest, nullslice, nullslice, nullptr);
+        });
     }
 
 
@@ -149,6 +348,7 @@ namespace litecore { namespace repl {
 
     void IncomingBlob::onError(C4Error err) {
         closeWriter();
+        _chunks = Doc();
         Worker::onError(err);
         // Bump progress to 100% so as not to mess up overall progress tracking:
         setProgress({_blob.length, _blob.length});
@@ -20,6 +20,7 @@
 #include "Worker.hh"
 #include "ReplicatorTypes.hh"
 #include "c4.hh"
+#include <vector>
 
 namespace litecore { namespace repl {
 
@@ -35,9 +36,21 @@ namespace litecore { namespace repl {
         virtual std::string loggingIdentifier() const override;
 
     private:
+        struct Segment {C4BlobKey key; uint64_t length;};
+
         void _start(PendingBlob);
+        void requestBlob(C4BlobKey key, bool chunks);
+        void checkResumed(blip::MessageIn*);
+        void gotChunkList(fleece::alloc_slice);
+        void requestNextChunk();
         void writeToBlob(fleece::alloc_slice);
         void finishBlob();
+        bool installSegment(C4Error*);
+        fleece::alloc_slice segmentListJSON() const;
+        void finishSegments();
+        void readPartialBlob();
+        void savePartialBlob();
+        void forgetPartialBlob(bool deleteSegments);
         void notifyProgress(bool always);
         void closeWriter();
         virtual void onError(C4Error) override;
@@ -45,6 +58,12 @@ namespace litecore { namespace repl {
 
         C4BlobStore* const _blobStore;
         PendingBlob _blob;
+        C4BlobKey _currentKey;                  // The blob, or chunk, being received
+        fleece::alloc_slice _chunkList;         // JSON chunk list, if receiving chunks
+        fleece::Doc _chunks;                    // Parsed _chunkList
+        unsigned _chunkIndex {0};               // Index of the next chunk to check for
+        std::vector<Segment> _segments;         // Parts of the blob received earlier, if any
+        uint64_t _offset {0};                   // Total length of _segments
         c4::ref<C4WriteStream> _writer;
         bool _busy {false};
         actor::Timer::time _lastNotifyTime;
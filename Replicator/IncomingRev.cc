@@ -97,15 +97,23 @@ namespace litecore { namespace repl {
         if (!_rev->historyBuf && c4rev_getGeneration(_rev->revID) > 1)
             warn("Server sent no history with '%.*s' #%.*s", SPLAT(_rev->docID), SPLAT(_rev->revID));
 
-        auto jsonBody = _revMessage->extractBody();
+        // If RevFinder told the peer it could, it may send non-delta bodies as Fleece:
+        bool fleeceBody = _revMessage->boolProperty("fleece"_sl) && !_options.disableFleeceBodies();
+        auto body = _revMessage->extractBody();
 
         if (_revMessage->noReply())
             _revMessage = nullptr;
 
         if (_rev->deltaSrcRevID == nullslice) {
             // It's not a delta. Convert body to Fleece and process:
-            FLError err;
-            Doc fleeceDoc = _db->tempEncodeJSON(jsonBody, &err);
+            // (Either way it's encoded here, with the temporary SharedKeys, so that the
+            // Inserter can usually save it as-is instead of re-encoding it in its transaction.)
+            FLError err = kFLNoError;
+            Doc fleeceDoc;
+            if (fleeceBody)
+                fleeceDoc = _db->tempEncodeFleece(body, &err);
+            else
+                fleeceDoc = _db->tempEncodeJSON(body, &err);
             if(!fleeceDoc) {
                 warn("Incoming rev failed to encode (Fleece error %d)", err);
                 _rev->error = c4error_make(FleeceDomain, (int)err, "Incoming rev failed to encode"_sl);
@@ -114,13 +122,13 @@ namespace litecore { namespace repl {
             }
 
             processBody(fleeceDoc, {FleeceDomain, err});
-        } else if (_options.pullValidator || jsonBody.containsBytes("\"digest\""_sl)) {
+        } else if (_options.pullValidator || body.containsBytes("\"digest\""_sl)) {
             // It's a delta, but we need the entire document body now because either it has to be
             // passed to the validation function, or it may contain new blobs to download.
             logVerbose("Need to apply delta immediately for '%.*s' #%.*s ...",
                        SPLAT(_rev->docID), SPLAT(_rev->revID));
             C4Error err;
-            Doc fleeceDoc = _db->applyDelta(_rev->docID, _rev->deltaSrcRevID, jsonBody, &err);
+            Doc fleeceDoc = _db->applyDelta(_rev->docID, _rev->deltaSrcRevID, body, &err);
             if (!fleeceDoc && err.domain==LiteCoreDomain && err.code==kC4ErrorDeltaBaseUnknown) {
                 // Don't have the body of the source revision. This might be because I'm in
                 // no-conflict mode and the peer is trying to push me a now-obsolete revision.
@@ -135,7 +143,7 @@ namespace litecore { namespace repl {
             processBody(fleeceDoc, err);
         } else {
             // It's a delta, but it can be applied later while inserting:
-            _rev->deltaSrc = jsonBody;
+            _rev->deltaSrc = body;
             insertRevision();
         }
     }
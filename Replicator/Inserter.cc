@@ -23,6 +23,7 @@
 #include "fleece/Fleece.hh"
 #include "StringUtil.hh"
 #include "Instrumentation.hh"
+#include "Metrics.hh"
 #include "c4.hh"
 #include "c4Private.h"
 #include "c4Document+Fleece.h"
@@ -36,6 +37,10 @@ using namespace litecore::blip;
 
 namespace litecore { namespace repl {
 
+    static metrics::Counter sRevsInserted("replicator.revsInserted");
+    static metrics::Counter sRevsFailed("replicator.revsFailed");
+    static metrics::Histogram sInsertBatchTime("replicator.insertBatchUsec");
+
 
     Inserter::Inserter(Replicator *repl)
     :Worker(repl, "Insert")
@@ -75,6 +80,7 @@ namespace litecore { namespace repl {
                 if (docSaved) {
                     rev->owner->revisionProvisionallyInserted();
                 } else {
+                    ++sRevsFailed;
                     // Notify owner of a rev that failed:
                     alloc_slice desc = c4error_getDescription(docErr);
                     warn("Failed to insert '%.*s' #%.*s : %.*s",
@@ -105,6 +111,8 @@ namespace litecore { namespace repl {
             gotError(transactionErr);
         } else {
             double t = st.elapsed();
+            sRevsInserted += revs->size();
+            sInsertBatchTime.record(uint64_t(t * 1e6));
             logInfo("Inserted %3zu revs in %6.2fms (%5.0f/sec) of which %4.1f%% was commit",
                     revs->size(), t*1000, revs->size()/t, commitTime/t*100);
         }
@@ -139,7 +139,7 @@ namespace litecore { namespace repl {
             handleChangesNow(req);
         }
 
-#ifdef LITECORE_SIGNPOSTS
+#if LITECORE_SIGNPOSTS
         bool backPressure = !_waitingRevMessages.empty();
         if (_changesBackPressure != backPressure) {
             _changesBackPressure = backPressure;
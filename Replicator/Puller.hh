@@ -88,7 +88,7 @@ namespace litecore { namespace repl {
         unsigned _unfinishedIncomingRevs {0};
         unsigned _pendingRevFinderCalls {0};
 
-#ifdef LITECORE_SIGNPOSTS
+#if LITECORE_SIGNPOSTS
         bool _changesBackPressure {false};
 #endif
 
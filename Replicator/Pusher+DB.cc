@@ -21,6 +21,7 @@
 #include "Pusher.hh"
 #include "fleece/Fleece.hh"
 #include "StringUtil.hh"
+#include "Metrics.hh"
 #include "c4.hh"
 #include "c4Private.h"
 #include "c4DocEnumerator.h"
@@ -37,6 +38,8 @@ using namespace litecore::blip;
 
 namespace litecore { namespace repl {
 
+    static metrics::Counter sRevsSent("replicator.revsSent"), sDeltasSent("replicator.deltasSent");
+
 #pragma mark - CHANGES:
 
 
@@ -316,10 +319,18 @@ namespace litecore { namespace repl {
             alloc_slice delta = createRevisionDelta(doc, request, root, revisionBody.size,
                                                     sendLegacyAttachments);
             if (delta) {
+                ++sDeltasSent;
                 msg["deltaSrc"_sl] = doc->selectedRev.revID;
                 msg.jsonBody().writeRaw(delta);
             } else if (root.empty()) {
                 msg.write("{}"_sl);
+            } else if (_fleeceBodiesOK && !sendLegacyAttachments) {
+                // The peer is LiteCore and said it takes Fleece, so skip the JSON round-trip. The
+                // body has to be re-encoded without our SharedKeys, which the peer doesn't know:
+                Encoder enc;
+                enc.writeValue(root);
+                msg["fleece"_sl] = true;
+                msg.write(enc.finish());
             } else {
                 auto &bodyEncoder = msg.jsonBody();
                 if (sendLegacyAttachments)
@@ -330,6 +341,7 @@ namespace litecore { namespace repl {
             }
             logVerbose("Transmitting 'rev' message with '%.*s' #%.*s",
                        SPLAT(request->docID), SPLAT(request->revID));
+            ++sRevsSent;
             sendRequest(msg, onProgress);
 
         } else {
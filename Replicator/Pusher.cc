@@ -19,6 +19,7 @@
 
 #include "Pusher.hh"
 #include "c4BlobStore.h"
+#include "c4Private.h"
 #include "Error.hh"
 #include "StringUtil.hh"
 #include "SecureDigest.hh"
@@ -30,6 +31,9 @@ using namespace fleece;
 
 namespace litecore { namespace repl {
 
+    bool Pusher::gIgnoreBlobOffsets = false;
+
+
     Pusher::Pusher(Replicator *replicator, Checkpointer &checkpointer)
     :Worker(replicator, "Push")
     ,_continuous(_options.push == kC4Continuous)
@@ -290,6 +294,9 @@ namespace litecore { namespace repl {
             if (!_deltasOK && reply->boolProperty("deltas"_sl)
                            && !_options.properties[kC4ReplicatorOptionDisableDeltas].asBool())
                 _deltasOK = true;
+            if (!_fleeceBodiesOK && reply->boolProperty("fleece"_sl)
+                                 && !_options.disableFleeceBodies())
+                _fleeceBodiesOK = true;
 
             // The response body consists of an array that parallels the `changes` array I sent:
             auto requests = reply->JSONBody().asArray();
@@ -541,12 +548,39 @@ namespace litecore { namespace repl {
         Replicator::BlobProgress progress;
         C4Error err;
         C4ReadStream* blob = readBlobFromRequest(req, digest, progress, &err);
+        if (blob && req->boolProperty("chunks"_sl)) {
+            // The peer can take the blob as a list of chunks, if it's stored that way; then it
+            // only needs to get the chunks it doesn't have:
+            alloc_slice chunkList = c4blob_getChunkList(_db->blobStore(), progress.key, &err);
+            if (chunkList) {
+                c4stream_close(blob);
+                logVerbose("Sending chunk list of blob %.*s", SPLAT(digest));
+                MessageBuilder reply(req);
+                reply.compressed = true;
+                reply["chunks"_sl] = "true"_sl;
+                reply.write(chunkList);
+                req->respond(reply);
+                return;
+            } else if (err.code) {
+                c4stream_close(blob);
+                blob = nullptr;
+            }
+        }
         if (blob) {
             increment(_blobsInFlight);
             MessageBuilder reply(req);
             reply.compressed = req->boolProperty("compress"_sl);
-            logVerbose("Sending blob %.*s (length=%" PRId64 ", compress=%d)",
-                       SPLAT(digest), c4stream_getLength(blob, nullptr), reply.compressed);
+            // If the peer already has the start of the blob, from a transfer that was cut off,
+            // skip that part; echoing "offset" tells it I did:
+            int64_t offset = gIgnoreBlobOffsets ? 0 : req->intProperty("offset"_sl);
+            if (seekBlob(blob, offset)) {
+                reply["offset"_sl] = offset;
+                progress.bytesCompleted = offset;
+            } else {
+                offset = 0;
+            }
+            logVerbose("Sending blob %.*s (length=%" PRId64 ", offset=%" PRId64 ", compress=%d)",
+                       SPLAT(digest), c4stream_getLength(blob, nullptr), offset, reply.compressed);
             Retained<Replicator> repl = replicator();
             auto lastNotifyTime = actor::Timer::clock::now();
             if (progressNotificationLevel() >= 2)
@@ -586,6 +620,16 @@ namespace litecore { namespace repl {
     }
 
 
+    bool Pusher::seekBlob(C4ReadStream *blob, int64_t offset) {
+        if (offset <= 0 || offset >= c4stream_getLength(blob, nullptr))
+            return false;
+        if (c4stream_seek(blob, offset, nullptr))
+            return true;
+        c4stream_seek(blob, 0, nullptr);
+        return false;
+    }
+
+
     void Pusher::_attachmentSent() {
         decrement(_blobsInFlight);
     }
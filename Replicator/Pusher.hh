@@ -47,6 +47,13 @@ namespace litecore { namespace repl {
             enqueue(&Pusher::_docRemoteAncestorChanged, docID, remoteAncestorRevID);
         }
 
+        /** Seeks a blob that's about to be sent to `offset`, the number of bytes the peer
+            already has. Returns false, leaving the stream at the start, if the offset isn't
+            within the blob or the seek fails. */
+        static bool seekBlob(C4ReadStream* NONNULL, int64_t offset);
+
+        static bool gIgnoreBlobOffsets; // for testing; set to true to act like an older peer
+
     protected:
         virtual void afterEvent() override;
         virtual void _connectionClosed() override;
@@ -113,6 +120,7 @@ namespace litecore { namespace repl {
         bool _started {false};
         bool _caughtUp {false};                   // Received backlog of existing changes?
         bool _deltasOK {false};                   // OK to send revs in delta form?
+        bool _fleeceBodiesOK {false};             // OK to send rev bodies as Fleece?
         unsigned _changeListsInFlight {0};        // # change lists being requested from db or sent to peer
         unsigned _revisionsInFlight {0};          // # 'rev' messages being sent
         MessageSize _revisionBytesAwaitingReply {0}; // # 'rev' message bytes sent but not replied
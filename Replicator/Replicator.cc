@@ -599,7 +599,7 @@ namespace litecore { namespace repl {
                 C4Error err;
                 bool ok = _db->use<bool>([&](C4Database *db) {
                     _db->markRevsSyncedNow();
-                    return _checkpointer.write(db, json, &err);
+                    return _checkpointer.write(db, &err);
                 });
                 if (ok)
                     logInfo("Saved local checkpoint '%.*s': %.*s",
@@ -91,6 +91,7 @@ namespace litecore { namespace repl {
         bool noOutgoingConflicts() const  {return properties[kC4ReplicatorOptionNoIncomingConflicts].asBool();}
         int progressLevel() const  {return (int)properties[kC4ReplicatorOptionProgressLevel].asInt();}
         bool disableDeltaSupport() const {return properties[kC4ReplicatorOptionDisableDeltas].asBool();}
+        bool disableFleeceBodies() const {return properties[kC4ReplicatorOptionDisableFleeceBodies].asBool();}
 
         /** Returns a string that uniquely identifies the remote database; by default its URL,
             or the 'remoteUniqueID' option if that's present (for P2P dbs without stable URLs.) */
@@ -139,6 +140,10 @@ namespace litecore { namespace repl {
             return setProperty(C4STR(kC4ReplicatorOptionDisableDeltas), true);
         }
 
+        Options& setNoFleeceBodies() {
+            return setProperty(C4STR(kC4ReplicatorOptionDisableFleeceBodies), true);
+        }
+
         explicit operator std::string() const;
     };
 
@@ -64,6 +64,14 @@ namespace litecore { namespace repl {
 
         constexpr unsigned kMaxUnfinishedIncomingRevs = 200;
 
+        /* Minimum blob size for which the puller asks for the blob's chunk list, if the peer
+            stores it as chunks, so it can request only the chunks it doesn't already have. */
+        constexpr uint64_t kMinBlobSizeForChunks = 1024*1024;
+
+        /* If the connection drops while a blob is being received, the data received so far is
+            kept, and the rest is requested by offset next time, if there's at least this much. */
+        constexpr uint64_t kMinPartialBlobSize = 64*1024;
+
 
         //// Pusher:
 
@@ -76,6 +76,11 @@ namespace litecore { namespace repl {
             response["deltas"_sl] = "true"_sl;
             _announcedDeltaSupport = true;
         }
+        if ( !_announcedFleeceBodies && !_options.disableFleeceBodies()) {
+            // Tells a LiteCore peer it can send 'rev' bodies as Fleece instead of JSON:
+            response["fleece"_sl] = "true"_sl;
+            _announcedFleeceBodies = true;
+        }
 
         Stopwatch st;
 
@@ -48,6 +48,7 @@ namespace litecore { namespace repl {
                                alloc_slice &outCurrentRevID);
 
         bool _announcedDeltaSupport {false};                // Did I send "deltas:true" yet?
+        bool _announcedFleeceBodies {false};                // Did I send "fleece:true" yet?
     };
 
 } }
@@ -9,9 +9,11 @@
 #include "ReplicatorLoopbackTest.hh"
 #include "Worker.hh"
 #include "DBAccess.hh"
+#include "Pusher.hh"
 #include "Timer.hh"
 #include "c4Database.hh"
 #include "PrebuiltCopier.hh"
+#include "Metrics.hh"
 #include <chrono>
 #include "betterassert.hh"
 #include "fleece/Mutable.hh"
@@ -115,6 +117,63 @@ TEST_CASE_METHOD(ReplicatorLoopbackTest, "Push large docs", "[Push]") {
 }
 
 
+TEST_CASE_METHOD(ReplicatorLoopbackTest, "Push/Pull JSON Bodies", "[Push][Pull]") {
+    // LiteCore peers normally send each other Fleece bodies; check that the JSON path, which
+    // Sync Gateway uses, still works when the receiving side doesn't announce Fleece support:
+    importJSONLines(sFixturesDir + "names_100.json");
+    _expectedDocumentCount = 100;
+    SECTION("Push") {
+        runReplicators(Replicator::Options::pushing(),
+                       Replicator::Options::passive().setNoFleeceBodies());
+    }
+    SECTION("Pull") {
+        runReplicators(Replicator::Options::passive(),
+                       Replicator::Options::pulling().setNoFleeceBodies());
+    }
+    compareDatabases();
+}
+
+
+TEST_CASE_METHOD(ReplicatorLoopbackTest, "Incoming Fleece Bodies", "[Pull]") {
+    // A peer sends Fleece bodies encoded without SharedKeys; anything else is rejected:
+    auto acc = make_shared<DBAccess>(db, false);
+    FLError err = kFLNoError;
+    {
+        Encoder enc;
+        enc.beginDict();
+        enc.writeKey("name"_sl);
+        enc.writeString("Zegpold"_sl);
+        enc.endDict();
+        Doc doc = acc->tempEncodeFleece(enc.finish(), &err);
+        REQUIRE(doc);
+        CHECK(doc.root().asDict()["name"_sl].asString() == "Zegpold"_sl);
+    }
+
+    alloc_slice body;
+    SECTION("Malformed") {
+        body = alloc_slice("this is not Fleece data"_sl);
+    }
+    SECTION("Not a dict") {
+        Encoder enc;
+        enc.beginArray();
+        enc.writeString("Zegpold"_sl);
+        enc.endArray();
+        body = enc.finish();
+    }
+    SECTION("Integer keys") {
+        Encoder enc;
+        enc.setSharedKeys(SharedKeys::create());
+        enc.beginDict();
+        enc.writeKey("name"_sl);            // (encoded as an integer, since it's a shared key)
+        enc.writeString("Zegpold"_sl);
+        enc.endDict();
+        body = enc.finish();
+    }
+    CHECK(!acc->tempEncodeFleece(body, &err));
+    CHECK(err == kFLInvalidData);
+}
+
+
 TEST_CASE_METHOD(ReplicatorLoopbackTest, "Push deletion", "[Push]") {
     createRev("dok"_sl, kRevID, kFleeceBody);
     _expectedDocumentCount = 1;
@@ -483,6 +542,41 @@ static Replicator::Options pushOptionsWithProperty(const char *property, vector<
 }
 
 
+TEST_CASE("Checkpoint Data", "[Push][Pull]") {
+    Checkpoint::gWriteTimestamps = false;
+    Checkpoint checkpoint;
+    vector<C4SequenceNumber> pending {7, 12, 13, 500, 100000};
+    for (C4SequenceNumber seq = 1; seq <= 100001; ++seq) {
+        if (find(pending.begin(), pending.end(), seq) == pending.end())
+            checkpoint.completedSequence(seq);
+    }
+    checkpoint.setRemoteMinSequence("\"123:45\""_sl);
+
+    // The compact form reads back as the same state:
+    alloc_slice data = checkpoint.toData();
+    alloc_slice json = checkpoint.toJSON();
+    CHECK(data.size < json.size);
+    Checkpoint fromData;
+    fromData.readData(data);
+    CHECK(fromData.completedSequences() == checkpoint.completedSequences());
+    CHECK(fromData.remoteMinSequence() == checkpoint.remoteMinSequence());
+    CHECK(fromData.localMinSequence() == 6);
+    CHECK(fromData.toJSON() == json);
+
+    // So does the JSON form, which is what the peer stores, and what older versions stored:
+    Checkpoint fromJSON;
+    fromJSON.readData(json);
+    CHECK(fromJSON.completedSequences() == checkpoint.completedSequences());
+    CHECK(fromJSON.validateWith(fromData));
+
+    // Truncated data is ignored:
+    Checkpoint truncated;
+    truncated.readData(slice(data.buf, 5));
+    CHECK(truncated.localMinSequence() == 0);
+    CHECK(!truncated.remoteMinSequence());
+}
+
+
 TEST_CASE_METHOD(ReplicatorLoopbackTest, "Different Checkpoint IDs", "[Push]") {
     // Test that replicators with different channel or docIDs options use different checkpoints
     // (#386)
@@ -740,6 +834,240 @@ TEST_CASE_METHOD(ReplicatorLoopbackTest, "Pull Large Attachments", "[Pull][blob]
 }
 
 
+// Returns `size` bytes of pseudo-random data, which won't compress.
+static string randomBlobData(size_t size) {
+    string data(size, '\0');
+    uint32_t state = 12345;
+    for (char &c : data) {
+        state = state * 1103515245 + 12345;
+        c = char(state >> 24);
+    }
+    return data;
+}
+
+
+// Returns the total length of the parts of a blob saved by interrupted pulls, and their keys.
+static uint64_t partialBlobLength(C4Database *database, C4BlobKey blobKey,
+                                  vector<C4BlobKey> &outSegments)
+{
+    outSegments.clear();
+    alloc_slice digest = c4blob_keyToString(blobKey);
+    c4::ref<C4RawDocument> raw = c4raw_get(database, constants::kPartialBlobStore, digest,
+                                           nullptr);
+    if (!raw)
+        return 0;
+    uint64_t length = 0;
+    Doc segments = Doc::fromJSON(raw->body);
+    for (Array::iterator i(segments.asArray()); i; ++i) {
+        Array segment = i.value().asArray();
+        C4BlobKey key;
+        REQUIRE(c4blob_keyFromString(segment[0].asString(), &key));
+        outSegments.push_back(key);
+        length += segment[1].asUnsigned();
+    }
+    return length;
+}
+
+
+TEST_CASE_METHOD(ReplicatorLoopbackTest, "Pull Resumed Attachment", "[Pull][blob]") {
+    string att = randomBlobData(300000);
+    vector<string> attachments = {att};
+    vector<C4BlobKey> blobKeys;
+    {
+        TransactionHelper t(db);
+        blobKeys = addDocWithAttachments("att1"_sl, attachments, "application/octet-stream");
+        _expectedDocumentCount = 1;
+    }
+
+    // Pretend an earlier pull was cut off after receiving the first 200000 bytes of the blob:
+    C4Error error;
+    C4BlobStore *store2 = c4db_getBlobStore(db2, &error);
+    REQUIRE(store2);
+    C4BlobKey segmentKey;
+    REQUIRE(c4blob_create(store2, slice(att.data(), 200000), nullptr, &segmentKey, &error));
+    alloc_slice digest = c4blob_keyToString(blobKeys[0]);
+    alloc_slice segmentDigest = c4blob_keyToString(segmentKey);
+    string segments = format("[[\"%.*s\",200000]]", SPLAT(segmentDigest));
+    REQUIRE(c4raw_put(db2, constants::kPartialBlobStore, digest, nullslice, slice(segments),
+                      &error));
+
+    auto bytesSent = dynamic_cast<metrics::Counter*>(metrics::Metric::named("blip.bytesSent"));
+    REQUIRE(bytesSent);
+    int64_t bytesSentBefore = bytesSent->value();
+    runPullReplication();
+    compareDatabases();
+    checkAttachments(db2, blobKeys, attachments);
+
+    // Only the rest of the blob was sent, and the segment and its record are gone:
+    CHECK(bytesSent->value() - bytesSentBefore < 200000);
+    CHECK(c4blob_getSize(store2, segmentKey) < 0);
+    c4::ref<C4RawDocument> raw = c4raw_get(db2, constants::kPartialBlobStore, digest, &error);
+    CHECK(!raw);
+}
+
+
+TEST_CASE_METHOD(ReplicatorLoopbackTest, "Pull Interrupted Attachment", "[Pull][blob]") {
+    string att = randomBlobData(300000);
+    vector<string> attachments = {att};
+    vector<C4BlobKey> blobKeys;
+    {
+        TransactionHelper t(db);
+        blobKeys = addDocWithAttachments("att1"_sl, attachments, "application/octet-stream");
+    }
+
+    // The connection drops while the blob is being sent:
+    _serverDisconnectsAfter = 200000;
+    _expectedError = {POSIXDomain, ECONNRESET};
+    _expectedDocPullErrors = {"att1"};
+    runPullReplication();
+
+    // The part that arrived was saved as a segment, with a record of it:
+    C4Error error;
+    C4BlobStore *store2 = c4db_getBlobStore(db2, &error);
+    REQUIRE(store2);
+    CHECK(c4blob_getSize(store2, blobKeys[0]) < 0);
+    vector<C4BlobKey> segments;
+    uint64_t offset = partialBlobLength(db2, blobKeys[0], segments);
+    CHECK(offset >= tuning::kMinPartialBlobSize);
+    CHECK(offset < 200000);
+    REQUIRE(segments.size() == 1);
+    alloc_slice segmentData = c4blob_getContents(store2, segments[0], &error);
+    CHECK(segmentData == slice(att.data(), offset));
+
+    // The next pull gets only the rest of the blob:
+    _serverDisconnectsAfter = 0;
+    _expectedError = {};
+    _docPullErrors.clear();
+    _expectedDocPullErrors.clear();
+    _expectedDocumentCount = 1;
+    auto bytesSent = dynamic_cast<metrics::Counter*>(metrics::Metric::named("blip.bytesSent"));
+    REQUIRE(bytesSent);
+    int64_t bytesSentBefore = bytesSent->value();
+    runPullReplication();
+    compareDatabases();
+    checkAttachments(db2, blobKeys, attachments);
+
+    CHECK(bytesSent->value() - bytesSentBefore < int64_t(att.size() - offset) + 20000);
+    CHECK(c4blob_getSize(store2, segments[0]) < 0);
+    CHECK(partialBlobLength(db2, blobKeys[0], segments) == 0);
+}
+
+
+TEST_CASE_METHOD(ReplicatorLoopbackTest, "Pull Resumed Attachment From Older Peer", "[Pull][blob]") {
+    string att = randomBlobData(300000);
+    vector<string> attachments = {att};
+    vector<C4BlobKey> blobKeys;
+    {
+        TransactionHelper t(db);
+        blobKeys = addDocWithAttachments("att1"_sl, attachments, "application/octet-stream");
+        _expectedDocumentCount = 1;
+    }
+
+    // Pretend an earlier pull was cut off after receiving the first 200000 bytes of the blob:
+    C4Error error;
+    C4BlobStore *store2 = c4db_getBlobStore(db2, &error);
+    REQUIRE(store2);
+    C4BlobKey segmentKey;
+    REQUIRE(c4blob_create(store2, slice(att.data(), 200000), nullptr, &segmentKey, &error));
+    alloc_slice digest = c4blob_keyToString(blobKeys[0]);
+    alloc_slice segmentDigest = c4blob_keyToString(segmentKey);
+    string segments = format("[[\"%.*s\",200000]]", SPLAT(segmentDigest));
+    REQUIRE(c4raw_put(db2, constants::kPartialBlobStore, digest, nullslice, slice(segments),
+                      &error));
+
+    // The pusher doesn't understand "offset", so it sends the whole blob:
+    auto bytesSent = dynamic_cast<metrics::Counter*>(metrics::Metric::named("blip.bytesSent"));
+    REQUIRE(bytesSent);
+    int64_t bytesSentBefore = bytesSent->value();
+    Pusher::gIgnoreBlobOffsets = true;
+    runPullReplication();
+    Pusher::gIgnoreBlobOffsets = false;
+    compareDatabases();
+    checkAttachments(db2, blobKeys, attachments);
+
+    // The segment was discarded, not combined with the whole blob:
+    CHECK(bytesSent->value() - bytesSentBefore >= int64_t(att.size()));
+    CHECK(c4blob_getSize(store2, segmentKey) < 0);
+    vector<C4BlobKey> remaining;
+    CHECK(partialBlobLength(db2, blobKeys[0], remaining) == 0);
+}
+
+
+TEST_CASE_METHOD(ReplicatorLoopbackTest, "Pusher Blob Offsets", "[Push][blob]") {
+    string att = randomBlobData(1000);
+    C4Error error;
+    C4BlobStore *store = c4db_getBlobStore(db, &error);
+    REQUIRE(store);
+    C4BlobKey key;
+    REQUIRE(c4blob_create(store, slice(att), nullptr, &key, &error));
+
+    // Returns what the pusher would send after being asked to start at `offset`:
+    auto sendFrom = [&](int64_t offset, bool expectSeek) {
+        c4::ref<C4ReadStream> stream = c4blob_openReadStream(store, key, &error);
+        REQUIRE(stream);
+        CHECK(Pusher::seekBlob(stream, offset) == expectSeek);
+        string data(att.size(), '\0');
+        data.resize(c4stream_read(stream, &data[0], data.size(), &error));
+        return data;
+    };
+
+    CHECK(sendFrom(600, true) == att.substr(600));
+    CHECK(sendFrom(999, true) == att.substr(999));
+
+    // An offset the pusher can't seek to is ignored, and the whole blob is sent:
+    CHECK(sendFrom(0, false) == att);
+    CHECK(sendFrom(-1, false) == att);
+    CHECK(sendFrom(1000, false) == att);
+    CHECK(sendFrom(1000000, false) == att);
+}
+
+
+TEST_CASE_METHOD(ReplicatorLoopbackTest, "Pull Chunked Attachments", "[Pull][blob]") {
+    // Reopen both databases with chunked blobs enabled:
+    C4Error error;
+    auto config = *c4db_getConfig(db);
+    config.flags |= kC4DB_ChunkedBlobs;
+    closeDB();
+    db = c4db_open(databasePath(), &config, &error);
+    REQUIRE(db);
+    REQUIRE(c4db_delete(db2, &error));
+    c4db_release(db2);
+    db2 = createDatabase("2");
+
+    string att(2 * 1024 * 1024, '\0');
+    uint32_t state = 12345;
+    for (char &c : att) {
+        state = state * 1103515245 + 12345;
+        c = char(state >> 24);
+    }
+    vector<string> attachments = {att};
+    vector<C4BlobKey> blobKeys;
+    {
+        TransactionHelper t(db);
+        blobKeys = addDocWithAttachments("att1"_sl, attachments, "application/octet-stream");
+        _expectedDocumentCount = 1;
+    }
+    runPullReplication();
+    checkAttachments(db2, blobKeys, attachments);
+
+    // Edit the blob; the puller only needs the chunks around the edit:
+    attachments[0].insert(1024 * 1024, "This text was inserted in the middle of the blob");
+    {
+        TransactionHelper t(db);
+        blobKeys = addDocWithAttachments("att2"_sl, attachments, "application/octet-stream");
+        _expectedDocumentCount = 1;
+    }
+    runPullReplication();
+    compareDatabases();
+    checkAttachments(db2, blobKeys, attachments);
+
+    // The blob was received as chunks:
+    alloc_slice chunkList = c4blob_getChunkList(c4db_getBlobStore(db2, nullptr), blobKeys[0],
+                                                &error);
+    CHECK(chunkList);
+}
+
+
 TEST_CASE_METHOD(ReplicatorLoopbackTest, "Pull Lots Of Attachments", "[Pull][blob]") {
     static const int kNumDocs = 1000, kNumBlobsPerDoc = 5;
     Log("Creating %d docs, with %d blobs each ...", kNumDocs, kNumBlobsPerDoc);
@@ -76,10 +76,10 @@ public:
 
         // Create client (active) and server (passive) replicators:
         _replClient = new Replicator(dbClient,
-                                     new LoopbackWebSocket(alloc_slice("ws://srv/"_sl), Role::Client, kLatency),
+                                     new LoopbackWebSocket(alloc_slice("ws://srv/"_sl), Role::Client, _latency),
                                      *this, opts1);
         _replServer = new Replicator(dbServer,
-                                     new LoopbackWebSocket(alloc_slice("ws://cli/"_sl), Role::Server, kLatency),
+                                     new LoopbackWebSocket(alloc_slice("ws://cli/"_sl), Role::Server, _latency),
                                      *this, opts2);
 
         // Response headers:
@@ -88,6 +88,9 @@ public:
 
         // Bind the replicators' WebSockets and start them:
         LoopbackWebSocket::bind(_replClient->webSocket(), _replServer->webSocket(), headers);
+        if (_serverDisconnectsAfter > 0)
+            dynamic_cast<LoopbackWebSocket*>(_replServer->webSocket())
+                                            ->simulateDisconnectAfter(_serverDisconnectsAfter);
         Stopwatch st;
         _replClient->start();
         _replServer->start();
@@ -482,7 +485,15 @@ public:
                                               &err) );
         INFO("Checking " << (local ? "local" : "remote") << " checkpoint '" << string(_checkpointID) << "'; err = " << err.domain << "," << err.code);
         REQUIRE(doc);
-        CHECK(doc->body == c4str(body));
+        if (local) {
+            // The local checkpoint is stored in binary form; compare its JSON equivalent:
+            litecore::repl::Checkpoint checkpoint;
+            checkpoint.readData(doc->body);
+            alloc_slice json = checkpoint.toJSON();
+            CHECK(json == c4str(body));
+        } else {
+            CHECK(doc->body == c4str(body));
+        }
         if (!local)
             CHECK(c4rev_getGeneration(doc->meta) >= c4rev_getGeneration(c4str(meta)));
     }
@@ -517,6 +528,8 @@ public:
     }
 
     C4Database* db2 {nullptr};
+    duration _latency {kLatency};           // Simulated network latency, in each direction
+    size_t _serverDisconnectsAfter {0};     // If nonzero, server drops after sending this many bytes
     Retained<Replicator> _replClient, _replServer;
     alloc_slice _checkpointID;
     unique_ptr<thread> _parallelThread;
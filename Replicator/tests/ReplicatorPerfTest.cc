@@ -0,0 +1,312 @@
+//
+//  ReplicatorPerfTest.cc
+//  LiteCore
+//
+//  Copyright © 2019 Couchbase. All rights reserved.
+//
+
+// Replication benchmarks over the loopback WebSocket. They're tagged [.slow] so they only run
+// when asked for, e.g. `CppTests "[Perf][Replication]"`. Each benchmark writes one JSON object
+// per line to stdout (and appends it to $REPL_BENCH_OUTPUT, if set), so results can be collected
+// and compared between builds. The workload is configured by environment variables:
+//   REPL_BENCH_DOCS        Number of documents (or updates, for the streaming benchmark); 10000
+//   REPL_BENCH_DOC_SIZE    Approximate size in bytes of each doc body, or each blob; 1000
+//   REPL_BENCH_LATENCY_MS  Simulated network latency in each direction, in ms; 0
+//   REPL_BENCH_PULL_DOCS   Number of documents for the large-pull benchmark; 100000
+
+#include "ReplicatorLoopbackTest.hh"
+#include "Metrics.hh"
+#include "DBAccess.hh"
+#include "BLIPConnection.hh"
+#include "fleece/Mutable.hh"
+#include <cstdio>
+#include <cstdlib>
+
+#ifndef _MSC_VER
+#include <sys/resource.h>
+#endif
+
+using namespace litecore::metrics;
+
+
+class ReplicatorPerfTest : public ReplicatorLoopbackTest {
+public:
+    ReplicatorPerfTest() {
+        _numDocs = envInt("REPL_BENCH_DOCS", 10000);
+        _docSize = envInt("REPL_BENCH_DOC_SIZE", 1000);
+        _latency = chrono::milliseconds(envInt("REPL_BENCH_LATENCY_MS", 0));
+    }
+
+
+    static unsigned envInt(const char *name, unsigned defaultValue) {
+        const char *str = getenv(name);
+        return str ? unsigned(strtoul(str, nullptr, 10)) : defaultValue;
+    }
+
+
+    static string randomText(size_t size) {
+        string text(size, ' ');
+        for (auto &c : text)
+            c = char('a' + RandomNumber(26));
+        return text;
+    }
+
+
+    // Returns a doc body of roughly _docSize bytes, encoded for the given database.
+    alloc_slice makeBody(C4Database *database, unsigned n) {
+        Encoder enc(c4db_createFleeceEncoder(database));
+        enc.beginDict();
+        enc.writeKey("n"_sl);
+        enc.writeInt(n);
+        enc.writeKey("text"_sl);
+        enc.writeString(randomText(_docSize));
+        enc.endDict();
+        return enc.finish();
+    }
+
+
+    static string docIDFor(unsigned n) {
+        return format("doc-%07u", n);
+    }
+
+
+    // Creates `_numDocs` docs, each with the given revID (or a generated one if it's null.)
+    void createDocs(C4Database *database, slice revID =nullslice) {
+        TransactionHelper t(database);
+        for (unsigned n = 0; n < _numDocs; ++n) {
+            string docID = docIDFor(n);
+            alloc_slice body = makeBody(database, n);
+            if (revID)
+                createRev(database, slice(docID), revID, body);
+            else
+                createNewRev(database, slice(docID), body);
+        }
+    }
+
+
+    // A snapshot of the process's resource usage and the replication metrics.
+    struct Sample {
+        Sample() {
+            wireBytes = counter("blip.bytesSent");
+            revsSent = counter("replicator.revsSent");
+            deltasSent = counter("replicator.deltasSent");
+            revsReEncoded = counter("replicator.revsReEncoded");
+#ifndef _MSC_VER
+            struct rusage usage;
+            getrusage(RUSAGE_SELF, &usage);
+            cpuTime = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+                    + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1.0e6;
+#ifdef __APPLE__
+            peakMemory = usage.ru_maxrss;
+#else
+            peakMemory = usage.ru_maxrss * 1024;
+#endif
+#endif
+        }
+
+        static int64_t counter(const char *name) {
+            auto c = dynamic_cast<Counter*>(Metric::named(name));
+            return c ? c->value() : 0;
+        }
+
+        chrono::steady_clock::time_point time {chrono::steady_clock::now()};
+        int64_t wireBytes, revsSent, deltasSent, revsReEncoded;
+        double cpuTime {0};
+        int64_t peakMemory {0};                 // Peak RSS of the process so far, in bytes
+    };
+
+
+    // Writes the results of a benchmark as a line of JSON.
+    void report(const char *benchmark, uint64_t docs, const Sample &start, const Sample &end) {
+        double elapsed = chrono::duration<double>(end.time - start.time).count();
+        char json[600];
+        snprintf(json, sizeof(json),
+                 "{\"benchmark\":\"%s\",\"docs\":%llu,\"docSize\":%u,\"latencyMs\":%lld,"
+                 "\"elapsedSec\":%.3f,\"docsPerSec\":%.1f,\"wireBytes\":%lld,\"revsSent\":%lld,"
+                 "\"deltasSent\":%lld,\"revsReEncoded\":%lld,\"cpuSec\":%.3f,\"peakMemory\":%lld}",
+                 benchmark, (unsigned long long)docs, _docSize,
+                 (long long)chrono::duration_cast<chrono::milliseconds>(_latency).count(),
+                 elapsed, docs / elapsed,
+                 (long long)(end.wireBytes - start.wireBytes),
+                 (long long)(end.revsSent - start.revsSent),
+                 (long long)(end.deltasSent - start.deltasSent),
+                 (long long)(end.revsReEncoded - start.revsReEncoded),
+                 end.cpuTime - start.cpuTime, (long long)end.peakMemory);
+        printf("%s\n", json);
+        if (const char *path = getenv("REPL_BENCH_OUTPUT")) {
+            FILE *out = fopen(path, "a");
+            REQUIRE(out);
+            fprintf(out, "%s\n", json);
+            fclose(out);
+        }
+    }
+
+
+    unsigned _numDocs, _docSize;
+};
+
+
+TEST_CASE_METHOD(ReplicatorPerfTest, "Replication Benchmark: Initial Push", "[Perf][Replication][Push][.slow]") {
+    createDocs(db);
+    _expectedDocumentCount = _numDocs;
+    Sample start;
+    runPushReplication();
+    report("initialPush", _numDocs, start, Sample());
+    CHECK(c4db_getDocumentCount(db2) == _numDocs);
+}
+
+
+TEST_CASE_METHOD(ReplicatorPerfTest, "Replication Benchmark: Push Compression", "[Perf][Replication][Push][.slow]") {
+    // In-process peers don't compress BLIP messages by default; this measures the difference
+    // from the compression level used over real networks.
+    createDocs(db);
+    _expectedDocumentCount = _numDocs;
+    auto pushOpts = Replicator::Options::pushing(), passiveOpts = Replicator::Options::passive();
+    const char *benchmark = "pushUncompressed";
+    SECTION("Uncompressed") { }
+    SECTION("Compressed") {
+        benchmark = "pushCompressed";
+        pushOpts.setProperty(slice(blip::Connection::kCompressionLevelOption), 6);
+        passiveOpts.setProperty(slice(blip::Connection::kCompressionLevelOption), 6);
+    }
+    Sample start;
+    runReplicators(pushOpts, passiveOpts);
+    report(benchmark, _numDocs, start, Sample());
+    CHECK(c4db_getDocumentCount(db2) == _numDocs);
+}
+
+
+TEST_CASE_METHOD(ReplicatorPerfTest, "Replication Benchmark: Initial Pull", "[Perf][Replication][Pull][.slow]") {
+    createDocs(db2);
+    _expectedDocumentCount = _numDocs;
+    Sample start;
+    runPullReplication();
+    report("initialPull", _numDocs, start, Sample());
+    CHECK(c4db_getDocumentCount(db) == _numDocs);
+}
+
+
+TEST_CASE_METHOD(ReplicatorPerfTest, "Replication Benchmark: Large Initial Pull", "[Perf][Replication][Pull][.slow]") {
+    // Pulling this many docs takes many insertion batches. Once the first batch has saved the
+    // docs' property names as shared keys, incoming revs are encoded compatibly on arrival, so
+    // the Inserter shouldn't need to re-encode them inside its transactions.
+    _numDocs = envInt("REPL_BENCH_PULL_DOCS", 100000);
+    createDocs(db2);
+    _expectedDocumentCount = _numDocs;
+    Sample start;
+    runPullReplication();
+    Sample end;
+    report("largePull", _numDocs, start, end);
+    CHECK(c4db_getDocumentCount(db) == _numDocs);
+    // Only revs encoded before the first insertion transaction commits should need it: at most
+    // the first batch, plus the others the puller lets be in progress meanwhile.
+    CHECK(end.revsReEncoded - start.revsReEncoded
+            <= int64_t(tuning::kInsertionBatchSize + tuning::kMaxUnfinishedIncomingRevs));
+}
+
+
+TEST_CASE_METHOD(ReplicatorPerfTest, "Replication Benchmark: Continuous Updates", "[Perf][Replication][Push][Continuous][.slow]") {
+    // A continuous push of a stream of small updates to a few docs, each in its own transaction.
+    // The benchmark ends when the last update has arrived at db2.
+    static constexpr unsigned kNumStreamDocs = 10;
+    {
+        TransactionHelper t(db);
+        for (unsigned n = 0; n < kNumStreamDocs; ++n)
+            createNewRev(db, slice(docIDFor(n)), kFleeceBody);
+    }
+    alloc_slice body = makeBody(db, 0);
+    unsigned numUpdates = _numDocs;
+    _expectedDocumentCount = -1;        // Depends on how many updates get coalesced
+
+    Sample start;
+    unique_ptr<Sample> end;
+    _parallelThread.reset(runInParallel([&]() {
+        // Note: Can't use Catch (CHECK, REQUIRE) on a background thread
+        string lastRevIDs[kNumStreamDocs];
+        for (unsigned i = 0; i < numUpdates; ++i) {
+            unsigned n = i % kNumStreamDocs;
+            lastRevIDs[n] = createNewRev(db, slice(docIDFor(n)), body);
+        }
+        for (unsigned n = 0; n < kNumStreamDocs; ++n) {
+            while (true) {
+                c4::ref<C4Document> doc = c4doc_get(db2, slice(docIDFor(n)), false, nullptr);
+                if (doc && slice(doc->revID) == slice(lastRevIDs[n]))
+                    break;
+                this_thread::sleep_for(chrono::milliseconds(5));
+            }
+        }
+        end.reset(new Sample);
+        stopWhenIdle();
+    }));
+    runPushReplication(kC4Continuous);
+    _parallelThread->join();
+    _parallelThread.reset();
+    report("continuousUpdates", numUpdates, start, *end);
+}
+
+
+TEST_CASE_METHOD(ReplicatorPerfTest, "Replication Benchmark: Delta Sync", "[Perf][Replication][Push][Delta][.slow]") {
+    // Push the docs, then change one small property of each and push again:
+    createDocs(db);
+    _expectedDocumentCount = _numDocs;
+    runPushReplication();
+
+    {
+        TransactionHelper t(db);
+        for (unsigned n = 0; n < _numDocs; ++n) {
+            string docID = docIDFor(n);
+            c4::ref<C4Document> doc = c4doc_get(db, slice(docID), true, nullptr);
+            REQUIRE(doc);
+            MutableDict props = Value::fromData(doc->selectedRev.body).asDict()
+                                                        .mutableCopy(kFLDeepCopyImmutables);
+            props["n"_sl] = int64_t(n) + 1;
+            Encoder enc(c4db_createFleeceEncoder(db));
+            enc.writeValue(props);
+            alloc_slice body = enc.finish();
+            createNewRev(db, slice(docID), body);
+        }
+    }
+
+    auto deltasApplied = DBAccess::gNumDeltasApplied.load();
+    Sample start;
+    runPushReplication();
+    report("deltaPush", _numDocs, start, Sample());
+    CHECK(DBAccess::gNumDeltasApplied - deltasApplied == _numDocs);
+}
+
+
+TEST_CASE_METHOD(ReplicatorPerfTest, "Replication Benchmark: Blobs", "[Perf][Replication][Push][blob][.slow]") {
+    // Each doc has a blob of _docSize random bytes:
+    {
+        TransactionHelper t(db);
+        for (unsigned n = 0; n < _numDocs; ++n) {
+            string blob(_docSize, '\0');
+            for (auto &c : blob)
+                c = char(RandomNumber(256));
+            addDocWithAttachments(slice(docIDFor(n)), {blob}, "application/octet-stream");
+        }
+    }
+    _expectedDocumentCount = _numDocs;
+    Sample start;
+    runPushReplication();
+    report("blobPush", _numDocs, start, Sample());
+    CHECK(c4db_getDocumentCount(db2) == _numDocs);
+}
+
+
+TEST_CASE_METHOD(ReplicatorPerfTest, "Replication Benchmark: Conflicts", "[Perf][Replication][Pull][Conflict][.slow]") {
+    // Give both databases the same docs, update every doc differently on each side, then pull;
+    // every pulled revision is a conflict.
+    createDocs(db, "1-11111111"_sl);
+    _expectedDocumentCount = _numDocs;
+    runPushReplication();
+
+    createDocs(db,  "2-2a2a2a2a"_sl);
+    createDocs(db2, "2-2b2b2b2b"_sl);
+    for (unsigned n = 0; n < _numDocs; ++n)
+        _expectedDocPullErrors.insert(docIDFor(n));
+
+    Sample start;
+    runReplicators(Replicator::Options::pulling(), Replicator::Options::passive());
+    report("conflictPull", _numDocs, start, Sample());
+}
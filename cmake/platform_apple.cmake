@@ -33,7 +33,6 @@ function(set_support_source)
         ${BASE_SUPPORT_FILES}
         LiteCore/Support/StringUtil_Apple.mm
         LiteCore/Support/LibC++Debug.cc
-        LiteCore/Support/Instrumentation.cc
         Crypto/PublicKey+Apple.mm
         PARENT_SCOPE
     )
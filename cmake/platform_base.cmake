@@ -24,9 +24,12 @@ function(set_litecore_source_base)
         C/c4Observer.cc
         C/c4PredictiveQuery.cc
         C/c4Query.cc
+        LiteCore/BlobStore/BlobPack.cc
+        LiteCore/BlobStore/ChunkedBlob.cc
         LiteCore/BlobStore/BlobStore.cc
         LiteCore/BlobStore/Stream.cc
         LiteCore/Database/BackgroundDB.cc
+        LiteCore/Database/CrossProcessNotifier.cc
         LiteCore/Database/Database.cc
         LiteCore/Database/Document.cc
         LiteCore/Database/Housekeeper.cc
@@ -41,6 +44,7 @@ function(set_litecore_source_base)
         LiteCore/Query/PredictiveModel.cc
         LiteCore/Query/Query.cc
         LiteCore/Query/QueryParser+Prediction.cc
+        LiteCore/Query/QueryParser+VectorSearch.cc
         LiteCore/Query/QueryParser.cc
         LiteCore/Query/SQLiteDataFile+Indexes.cc
         LiteCore/Query/SQLiteFleeceEach.cc
@@ -49,11 +53,15 @@ function(set_litecore_source_base)
         LiteCore/Query/SQLiteFTSRankFunction.cc
         LiteCore/Query/SQLiteKeyStore+ArrayIndexes.cc
         LiteCore/Query/SQLiteKeyStore+FTSIndexes.cc
+        LiteCore/Query/SQLiteKeyStore+HotProperties.cc
+        LiteCore/Query/SQLiteKeyStore+CoveringIndexes.cc
         LiteCore/Query/SQLiteKeyStore+Indexes.cc
         LiteCore/Query/SQLiteKeyStore+PredictiveIndexes.cc
+        LiteCore/Query/SQLiteKeyStore+VectorIndexes.cc
         LiteCore/Query/SQLiteN1QLFunctions.cc
         LiteCore/Query/SQLitePredictionFunction.cc
         LiteCore/Query/SQLiteQuery.cc
+        LiteCore/Query/VectorDistance.cc
         LiteCore/Query/N1QL_Parser/n1ql.cc
         LiteCore/RevTrees/RawRevTree.cc
         LiteCore/RevTrees/RevID.cc
@@ -93,6 +101,7 @@ function(set_litecore_source_base)
         Replicator/RevFinder.cc
         Replicator/Worker.cc
         LiteCore/Support/Logging.cc
+        LiteCore/Support/LogQueue.cc
         LiteCore/Support/DefaultLogger.cc
         LiteCore/Support/Error.cc
         PARENT_SCOPE
@@ -109,12 +118,16 @@ function(set_support_source_base)
     set(
         ${BASE_SSS_RESULT}
         LiteCore/Support/c4ExceptionUtils.cc
+        LiteCore/Support/AsyncWriteStream.cc
         LiteCore/Support/EncryptedStream.cc
         LiteCore/Support/Error.cc
         LiteCore/Support/FilePath.cc
+        LiteCore/Support/Instrumentation.cc
+        LiteCore/Support/LogArgs.cc
         LiteCore/Support/LogDecoder.cc
         LiteCore/Support/LogEncoder.cc
         LiteCore/Support/Logging_Stub.cc
+        LiteCore/Support/Metrics.cc
         LiteCore/Support/PlatformIO.cc
         LiteCore/Support/StringUtil.cc
         Crypto/SecureRandomize.cc